@@ -1,24 +1,24 @@
 #pragma once
 
 #include <ctime>
-#include <map>
+#include <cstdint>
 
 namespace custom_ctime
 {
-    std::map<uint8_t, uint8_t> months =
+    constexpr uint8_t months[12] =
     {
-        {0, 31}, {1, 28},  {2, 31},
-        {3, 30}, {4, 31},  {5, 30},
-        {6, 31}, {7, 31},  {8, 30},
-        {9, 31}, {10, 30}, {11, 31},
+        31, 28, 31,
+        30, 31, 30,
+        31, 31, 30,
+        31, 30, 31,
     };
 
-    tm* gmtime(const time_t *_Time/*timestamp format*/)
+    //Fills the caller's tm, like the POSIX function of the same name
+    tm* gmtime_r(const time_t *_Time/*timestamp format*/, tm* date)
     {
-        if (_Time == nullptr)
+        if (_Time == nullptr || date == nullptr)
             return nullptr;
 
-        tm* date = new tm();
         time_t temp_time = *_Time;
 
         int32_t timestamp_year = temp_time / 31536000;
@@ -43,7 +43,7 @@ namespace custom_ctime
         int32_t days_in_year = date->tm_yday + 1;
         for (auto i = 0; i != 11; ++i)
         {
-            const int32_t count_days = months.at(i);
+            const int32_t count_days = months[i];
             if (days_in_year < count_days)
             {
                 date->tm_mon = i;
@@ -17,17 +17,52 @@
 
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
 #include <eosio/crypto.hpp>
 #include <eosio/system.hpp>
 #include <eosio/producer_schedule.hpp>
 #include <eosio/singleton.hpp>
+#include <algorithm>
 #include <math.h>
+#include <string_view>
+
+#include "scratch_arena.hpp"
+
+//Feature switches, set per variant by src/CMakeLists.txt. A bare eosio-cpp
+//build gets the full contract.
+#ifndef DELPHIORACLE_WITH_REWARDS
+#define DELPHIORACLE_WITH_REWARDS 1
+#endif
+
+#ifndef DELPHIORACLE_WITH_MEDIANS
+#define DELPHIORACLE_WITH_MEDIANS 1
+#endif
+
+#ifndef DELPHIORACLE_WITH_LEGACY
+#define DELPHIORACLE_WITH_LEGACY 1
+#endif
+
+#if DELPHIORACLE_WITH_LEGACY && !DELPHIORACLE_WITH_MEDIANS
+#error "DELPHIORACLE_WITH_LEGACY requires DELPHIORACLE_WITH_MEDIANS"
+#endif
+
+//Debug builds print memory use at the end of every action
+#ifndef DELPHIORACLE_HEAP_STATS
+#define DELPHIORACLE_HEAP_STATS 0
+#endif
 
 using namespace eosio;
 
-static const std::string system_str("system");
+#if DELPHIORACLE_WITH_REWARDS
+//Globals are literal types so that no static constructor runs per action
+static constexpr std::string_view system_str = "system";
 
-static const asset one_larimer = asset(1, symbol("TLOS", 4));
+static constexpr symbol tlos_symbol = symbol("TLOS", 4);
+
+inline asset one_larimer() {
+  return asset(1, tlos_symbol);
+}
+#endif
 
 enum class median_types : uint8_t {
     day = 0,
@@ -38,9 +73,29 @@ enum class median_types : uint8_t {
     none = 255,
 };
 
-const checksum256 NULL_HASH;
 const eosio::time_point NULL_TIME_POINT = eosio::time_point(eosio::microseconds(0));
 
+#if DELPHIORACLE_HEAP_STATS
+//Lives as long as the contract object, which the dispatcher creates and
+//destroys around each action
+struct heap_stats {
+  size_t start_pages = memory_pages();
+
+  ~heap_stats() {
+    print("heap: linear memory ", start_pages * 64, " -> ", memory_pages() * 64, " KiB, scratch peak ",
+          scratch().peak(), " of ", scratch_arena::capacity, " bytes, ", scratch().overflows(), " overflows\n");
+  }
+
+  static size_t memory_pages() {
+#if defined(__wasm__)
+    return __builtin_wasm_memory_size(0);
+#else
+    return 0;
+#endif
+  }
+};
+#endif
+
 CONTRACT delphioracle : public eosio::contract {
  public:
  	using contract::contract;
@@ -72,7 +127,7 @@ CONTRACT delphioracle : public eosio::contract {
   };
 
   struct pairinput {
-    name name;
+    eosio::name name;
     symbol base_symbol;
     asset_type base_type;
     eosio::name base_contract;
@@ -88,6 +143,62 @@ CONTRACT delphioracle : public eosio::contract {
     name pair;
   };
 
+  //Quote signed off-chain by an oracle, relayed in a writeagg batch. The
+  //signature is over report_digest, so it is only good on one chain.
+  struct report {
+    name owner;
+    name pair;
+    uint64_t value;
+    time_point timestamp;
+    signature sig;
+  };
+
+  //A rate derived by getcross through one or more pairs
+  struct crossrate {
+    symbol_code base;
+    symbol_code quote;
+    uint64_t rate;          //quote per base, with precision decimals
+    uint8_t precision;
+    std::vector<name> path;
+    time_point timestamp;   //of the oldest of the pairs' last datapoints
+    bool cached;
+  };
+
+#if DELPHIORACLE_WITH_REWARDS
+  //What one compactdons call did to a donor's ledger
+  struct compaction {
+    name donor;
+    uint64_t folded;       //old donation rows added to the donor's totals
+    uint64_t erased;       //rows released
+    int64_t ram_reclaimed; //bytes, net of the totals rows created
+    bool done;             //no old rows left
+  };
+#endif
+
+  //RAM billed for one table of a pair, in one scope
+  struct tableram {
+    name table;
+    name scope;
+    uint64_t rows;
+    int64_t bytes;
+  };
+
+  struct pairram {
+    name pair;
+    int64_t bytes;
+    std::vector<tableram> tables;
+  };
+
+  //Dispersion of the live datapoints window of a pair
+  struct pairquantiles {
+    name pair;
+    uint64_t count;
+    uint64_t median;
+    std::vector<uint64_t> quantiles;
+    uint64_t spread;
+    uint64_t mad;
+  };
+
    struct [[eosio::table, eosio::contract("eosio.system")]] producer_info {
       name                  owner;
       double                total_votes = 0;
@@ -119,12 +230,14 @@ CONTRACT delphioracle : public eosio::contract {
                         (location)(kick_reason_id)(kick_reason)(times_kicked)(kick_penalty_hours)(last_time_kicked) )
    };
 
+#if DELPHIORACLE_WITH_REWARDS
   struct st_transfer {
       name  from;
       name  to;
       asset quantity;
       std::string memo;
   };
+#endif
 
   //Global config
   TABLE global {
@@ -146,9 +259,33 @@ CONTRACT delphioracle : public eosio::contract {
     uint64_t min_bounty_delay = 604800;
     uint64_t new_bounty_delay = 259200;
 
+    //oracle the next payout batch starts from, 0 to start over
+    binary_extension<uint64_t> payout_cursor;
+
+    //seconds without a write after which a pair can be retired, 0 for never
+    binary_extension<uint64_t> retire_after;
+
+    //user the next updateusers batch starts from, 0 to start over
+    binary_extension<uint64_t> users_cursor;
+
+    //id of the chain the contract runs on, which writeagg reports sign;
+    //contracts cannot read it, so setchain records it
+    binary_extension<checksum256> chain_id;
+
+    //Extensions serialize in order, so one is only stored if all those
+    //before it are present. Whatever sets one calls this first: it gives
+    //the missing ones the 0 they are read as when absent. chain_id has no
+    //such value and comes last.
+    void fill_extensions() {
+      payout_cursor = payout_cursor.value_or(0);
+      retire_after = retire_after.value_or(0);
+      users_cursor = users_cursor.value_or(0);
+    }
+
     uint64_t primary_key() const { return id; }
   };
 
+#if DELPHIORACLE_WITH_LEGACY
   TABLE oglobal {
     uint64_t id;
     uint64_t total_datapoints_count;
@@ -156,6 +293,7 @@ CONTRACT delphioracle : public eosio::contract {
 
     uint64_t primary_key() const { return id; }
   };
+#endif
 
   //Holds the last datapoints_count datapoints from qualified oracles
   TABLE datapoints {
@@ -165,11 +303,16 @@ CONTRACT delphioracle : public eosio::contract {
     uint64_t median;
     time_point timestamp;
 
+    //the write's place among all writes, which orders the writes of one
+    //block; rows not written since it was added have none
+    binary_extension<uint64_t> seq;
+
     uint64_t primary_key() const { return id; }
     uint64_t by_timestamp() const { return timestamp.elapsed.to_seconds(); }
     uint64_t by_value() const { return value; }
   };
 
+#if DELPHIORACLE_WITH_LEGACY
   //Holds the last hashes from qualified oracles
   [[deprecated]] TABLE hashes {
     uint64_t id;
@@ -184,6 +327,7 @@ CONTRACT delphioracle : public eosio::contract {
     uint64_t by_owner() const {return owner.value; }
     checksum256 by_hash() const { return hash; }
   };
+#endif
 
   //Holds the count and time of last writes for qualified oracles
   TABLE stats {
@@ -193,11 +337,21 @@ CONTRACT delphioracle : public eosio::contract {
     time_point last_claim;
     asset balance;
 
+    //pair scope only: datapoints of count already settled against the
+    //pair's bounty
+    binary_extension<uint64_t> bounty_settled;
+
+    //pair scope only: the oracle's last value, which writepacked values are
+    //relative to
+    binary_extension<uint64_t> last_value;
+
     uint64_t primary_key() const { return owner.value; }
     uint64_t by_count() const { return -count; }
   };
 
-  //Holds rewards information
+#if DELPHIORACLE_WITH_REWARDS
+  //Recent donations of a donor, scoped by donor. Only the last
+  //recent_donations are kept, for auditing; donortotals holds the sums.
   TABLE donations {
     uint64_t id;
     name donator;
@@ -205,44 +359,84 @@ CONTRACT delphioracle : public eosio::contract {
     time_point timestamp;
     asset amount;
 
+    //set once the row is counted in donortotals; rows from before the
+    //totals existed are counted when compacted or pushed out of the ring
+    binary_extension<bool> folded;
+
     uint64_t primary_key() const { return id; }
     uint64_t by_donator() const { return donator.value; }
   };
 
+  static constexpr uint64_t recent_donations = 8;
+
+  //seconds a user's proxied stake is trusted before eosio's voters table is
+  //read again
+  static constexpr uint32_t score_ttl = 86400;
+
+  //donation rows not compacted yet that a score lookup sums before giving up
+  //on caching what the donor gave
+  static constexpr uint64_t legacy_scan = 100;
+
+  //What a donor gave to each pair, _self for the whole contract, scoped by donor
+  TABLE donortotals {
+    name pair;
+    asset total;
+    uint64_t count;
+    time_point first;
+    time_point last;
+
+    uint64_t primary_key() const { return pair.value; }
+  };
+
   //Holds users information
   TABLE users {
-    name name;
+    eosio::name name;
     asset contribution;
     uint64_t score;
     time_point creation_timestamp;
 
+    //score is donated plus proxied, the stake the user proxies to the
+    //contract as of refreshed
+    binary_extension<uint64_t> donated;
+    binary_extension<uint64_t> proxied;
+    binary_extension<time_point> refreshed;
+
     uint64_t primary_key() const { return name.value; }
     uint64_t by_score() const { return score; }
   };
 
   TABLE abusers {
-    name name;
+    eosio::name name;
     uint64_t votes;
 
     uint64_t primary_key() const { return name.value; }
     uint64_t by_votes() const { return votes; }
   };
+#endif
 
   //Holds custodians information
   TABLE custodians {
-    name name;
+    eosio::name name;
 
     uint64_t primary_key() const { return name.value; }
   };
 
+  //Key each oracle signs its writeagg reports with
+  TABLE oraclekeys {
+    name owner;
+    public_key key;
+
+    uint64_t primary_key() const { return owner.value; }
+  };
+
   //Holds the list of pairs
   TABLE pairs {
     bool active = false;
     bool bounty_awarded = false;
     bool bounty_edited_by_custodians = false;
 
-    name proposer;
-    name name;
+    eosio::name proposer;
+    eosio::name name;
 
     asset bounty_amount = asset(0, symbol("TLOS", 4));
 
@@ -259,9 +453,80 @@ CONTRACT delphioracle : public eosio::contract {
 
     uint64_t quoted_precision;
 
+    //Sparse writes, set by setband. Oracles write when the price moves
+    //deviation_bps from their last value or heartbeat seconds have passed,
+    //and points older than heartbeat plus the write cooldown leave the
+    //median. No heartbeat means every oracle writes every cooldown.
+    binary_extension<uint64_t> deviation_bps;
+    binary_extension<uint32_t> heartbeat;
+
+    //the pair's number in writepacked, see ordinals
+    binary_extension<uint64_t> ordinal;
+
+    //as global::fill_extensions; ordinal has no neutral value
+    void fill_extensions() {
+      deviation_bps = deviation_bps.value_or(0);
+      heartbeat = heartbeat.value_or(0);
+    }
+
     uint64_t primary_key() const { return name.value; }
   };
 
+  //Consumer contracts notified when a pair's median moves, scoped by pair
+  TABLE subscribers {
+    name consumer;
+    uint64_t deviation_bps;  //notify when the median moves this far from the last one sent, 0 for never
+    uint32_t heartbeat;      //notify at least this often in seconds, on the next write; 0 for never
+    uint64_t last_median;
+    time_point last_notified;
+
+    uint64_t primary_key() const { return consumer.value; }
+  };
+
+  //A write notifies at most this many consumers per pair
+  static constexpr uint64_t max_subscribers = 16;
+
+  //Cross rates last derived by getcross, scoped by base symbol code. A row
+  //holds while each pair of its path still has the last datapoint listed.
+  TABLE crossrates {
+    symbol_code quote;
+    uint64_t rate;
+    uint8_t precision;
+    std::vector<name> path;
+    std::vector<time_point> updated;
+
+    uint64_t primary_key() const { return quote.raw(); }
+  };
+
+  static constexpr uint8_t max_cross_hops = 3;
+
+  //What is left of a retired pair, scoped by the contract
+  TABLE tombstones {
+    name pair;
+    symbol base_symbol;
+    symbol quote_symbol;
+    uint64_t quoted_precision;
+    uint64_t median;        //the last median written
+    time_point timestamp;   //when it was written
+    time_point retired;
+
+    uint64_t primary_key() const { return pair.value; }
+  };
+
+  //Pairs by the number writepacked names them with, scoped by the contract.
+  //Numbers are handed out in order and never reused: a retired pair keeps
+  //its row, and a pair proposed again gets a new number.
+  TABLE ordinals {
+    uint64_t ordinal;
+    name pair;
+
+    uint64_t primary_key() const { return ordinal; }
+  };
+
+  //RAM the chain bills for each row, and again for each secondary index entry
+  static constexpr int64_t row_overhead_bytes = 112;
+
+#if DELPHIORACLE_WITH_REWARDS
   TABLE voter_info {
     name                owner;     /// the voter
     name                proxy;     /// the proxy set by the voter, if any
@@ -292,7 +557,9 @@ CONTRACT delphioracle : public eosio::contract {
     // explicit serialization macro is not necessary, used here only to improve compilation time
     // EOSLIB_SERIALIZE( voter_info, (owner)(proxy)(producers)(staked)(last_vote_weight)(proxied_vote_weight)(is_proxy)(flags1)(reserved2)(reserved3) )
   };
+#endif
 
+#if DELPHIORACLE_WITH_MEDIANS
   TABLE medians {
     uint64_t   id;
     uint8_t    type = get_type(median_types::none);
@@ -300,6 +567,13 @@ CONTRACT delphioracle : public eosio::contract {
     uint64_t   request_count = 0;
     time_point timestamp = NULL_TIME_POINT;
 
+    //lowest, highest, first and last value added to the period; set
+    //together, from the first value added after they were introduced
+    binary_extension<uint64_t> low;
+    binary_extension<uint64_t> high;
+    binary_extension<uint64_t> first;
+    binary_extension<uint64_t> last;
+
     uint64_t primary_key() const { return id; }
     uint64_t by_timestamp() const { return timestamp.elapsed.to_seconds(); }
 
@@ -308,54 +582,89 @@ CONTRACT delphioracle : public eosio::contract {
     }
   };
 
+  //One period of a pair's medians, as getperiods returns it. type is
+  //0 for a day, 1 for a week, 2 for a month and 4 for the current week.
+  struct periodsummary {
+    uint8_t type;
+    time_point start;
+    uint64_t request_count;
+    uint64_t average;
+    uint64_t low;
+    uint64_t high;
+    uint64_t first;
+    uint64_t last;
+  };
+
   TABLE flagmedians {
     bool is_active = false;
   };
   using singleton_flag_medians = eosio::singleton<"flagmedians"_n, flagmedians>;
+#endif
       
   //Multi index types definition
   typedef eosio::multi_index<"global"_n, global> globaltable;
+#if DELPHIORACLE_WITH_LEGACY
   typedef eosio::multi_index<"global"_n, oglobal> oglobaltable;
+#endif
 
   typedef eosio::multi_index<"custodians"_n, custodians> custodianstable;
+  typedef eosio::multi_index<"oraclekeys"_n, oraclekeys> oraclekeystable;
 
   typedef eosio::multi_index<"stats"_n, stats,
       indexed_by<"count"_n, const_mem_fun<stats, uint64_t, &stats::by_count>>> statstable;
 
   typedef eosio::multi_index<"pairs"_n, pairs> pairstable;
   typedef eosio::multi_index<"npairs"_n, pairs> npairstable;
+  typedef eosio::multi_index<"subscribers"_n, subscribers> subscriberstable;
+  typedef eosio::multi_index<"crossrates"_n, crossrates> crossratestable;
+  typedef eosio::multi_index<"tombstones"_n, tombstones> tombstonestable;
+  typedef eosio::multi_index<"ordinals"_n, ordinals> ordinalstable;
 
   typedef eosio::multi_index<"datapoints"_n, datapoints,
       indexed_by<"value"_n, const_mem_fun<datapoints, uint64_t, &datapoints::by_value>>,
       indexed_by<"timestamp"_n, const_mem_fun<datapoints, uint64_t, &datapoints::by_timestamp>>> datapointstable;
 
+#if DELPHIORACLE_WITH_LEGACY
   [[deprecated]]
   typedef eosio::multi_index<"hashes"_n, hashes,
       indexed_by<"timestamp"_n, const_mem_fun<hashes, uint64_t, &hashes::by_timestamp>>,
       indexed_by<"owner"_n, const_mem_fun<hashes, uint64_t, &hashes::by_owner>>,
       indexed_by<"hash"_n, const_mem_fun<hashes, checksum256, &hashes::by_hash>>> hashestable;
+#endif
 
+#if DELPHIORACLE_WITH_REWARDS
   typedef eosio::multi_index<"voters"_n, voter_info,
       indexed_by<"voter"_n, const_mem_fun<voter_info, uint64_t, &voter_info::primary_key>>> voters_table;
+#endif
 
   typedef eosio::multi_index<"producers"_n, producer_info,
       indexed_by<"prototalvote"_n, const_mem_fun<producer_info, double, &producer_info::by_votes>>> producers_table;
 
+#if DELPHIORACLE_WITH_REWARDS
   typedef eosio::multi_index<"donations"_n, donations,
       indexed_by<"donator"_n, const_mem_fun<donations, uint64_t, &donations::by_donator>>> donationstable;
 
+  typedef eosio::multi_index<"donortotals"_n, donortotals> donortotalstable;
+
   typedef eosio::multi_index<"users"_n, users,
       indexed_by<"score"_n, const_mem_fun<users, uint64_t, &users::by_score>>> userstable;
 
   typedef eosio::multi_index<"abusers"_n, abusers,
       indexed_by<"votes"_n, const_mem_fun<abusers, uint64_t, &abusers::by_votes>>> abuserstable;
+#endif
   
+#if DELPHIORACLE_WITH_MEDIANS
   typedef eosio::multi_index<"medians"_n, medians,
       indexed_by<"timestamp"_n, const_mem_fun<medians, uint64_t, &medians::by_timestamp>>> medianstable;
+#endif
 
   //Write datapoint
   ACTION write(const name owner, const std::vector<quote>& quotes);
-  ACTION claim(name owner);
+  ACTION writeagg(const name relayer, const std::vector<report>& reports);
+  ACTION writepacked(const name owner, const std::vector<char>& quotes);
+  ACTION addordinal(name pair);
+  ACTION setkey(name owner, public_key key);
+  ACTION setchain(checksum256 chain_id);
   ACTION configure(globalinput g);
   ACTION newbounty(name proposer, pairinput pair);
   ACTION cancelbounty(name name, std::string reason);
@@ -363,14 +672,39 @@ CONTRACT delphioracle : public eosio::contract {
   ACTION unvotebounty(name owner, name bounty);
   ACTION addcustodian(name name);
   ACTION delcustodian(name name);
-  ACTION reguser(name owner);
   ACTION clear(name pair);
-  ACTION updateusers();
+  [[eosio::action]] std::vector<pairquantiles> getquantiles(const std::vector<name>& pairs, const std::vector<uint16_t>& points_bps);
+  ACTION setband(name pair, uint64_t deviation_bps, uint32_t heartbeat);
+  ACTION subscribe(name consumer, name pair, uint64_t deviation_bps, uint32_t heartbeat);
+  ACTION unsubscribe(name consumer, name pair);
+  ACTION pricechange(name pair, uint64_t median, time_point timestamp, const std::vector<name>& consumers);
+  [[eosio::action]] crossrate getcross(name payer, symbol_code base, symbol_code quote, uint8_t max_hops);
+  [[eosio::action]] std::vector<pairram> getram(const std::vector<name>& pairs);
+  ACTION setretire(uint64_t retire_after);
+  ACTION retire(name pair, uint64_t max_rows);
+
+#if DELPHIORACLE_WITH_REWARDS
+  ACTION claim(name owner);
+  ACTION payout(uint64_t max_oracles, asset min_balance);
+  [[eosio::action]] compaction compactdons(name donor, uint64_t max_rows);
+  ACTION reguser(name owner);
+  ACTION updateusers(uint64_t max_users);
   ACTION voteabuser(name owner, name abuser);
+#endif
+
+#if DELPHIORACLE_WITH_MEDIANS
   ACTION makemedians();
+  ACTION rollmedians(name pair, uint64_t max_days);
+  [[eosio::action]] std::vector<periodsummary> getperiods(name pair);
+#endif
+
+#if DELPHIORACLE_WITH_LEGACY
   ACTION initmedians(bool is_active);
   ACTION updtversion();
+#endif
 
+
+#if DELPHIORACLE_WITH_REWARDS
   [[eosio::on_notify("eosio.token::transfer")]]
   void transfer(uint64_t sender, uint64_t receiver) {
     //print("transfer notifier", "\n");
@@ -393,9 +727,14 @@ CONTRACT delphioracle : public eosio::contract {
         process_donation(transfer_data.from, _self, transfer_data.quantity);
     }
   }
+#endif
 
   using write_action = action_wrapper<"write"_n, &delphioracle::write>;
-  using claim_action = action_wrapper<"claim"_n, &delphioracle::claim>;
+  using writeagg_action = action_wrapper<"writeagg"_n, &delphioracle::writeagg>;
+  using writepacked_action = action_wrapper<"writepacked"_n, &delphioracle::writepacked>;
+  using addordinal_action = action_wrapper<"addordinal"_n, &delphioracle::addordinal>;
+  using setkey_action = action_wrapper<"setkey"_n, &delphioracle::setkey>;
+  using setchain_action = action_wrapper<"setchain"_n, &delphioracle::setchain>;
   using configure_action = action_wrapper<"configure"_n, &delphioracle::configure>;
   using newbounty_action = action_wrapper<"newbounty"_n, &delphioracle::newbounty>;
   using cancelbounty_action = action_wrapper<"cancelbounty"_n, &delphioracle::cancelbounty>;
@@ -403,33 +742,127 @@ CONTRACT delphioracle : public eosio::contract {
   using unvotebounty_action = action_wrapper<"unvotebounty"_n, &delphioracle::unvotebounty>;
   using addcustodian_action = action_wrapper<"addcustodian"_n, &delphioracle::addcustodian>;
   using delcustodian_action = action_wrapper<"delcustodian"_n, &delphioracle::delcustodian>;
-  using reguser_action = action_wrapper<"reguser"_n, &delphioracle::reguser>;
   using clear_action = action_wrapper<"clear"_n, &delphioracle::clear>;
+  using getquantiles_action = action_wrapper<"getquantiles"_n, &delphioracle::getquantiles>;
+  using setband_action = action_wrapper<"setband"_n, &delphioracle::setband>;
+  using subscribe_action = action_wrapper<"subscribe"_n, &delphioracle::subscribe>;
+  using unsubscribe_action = action_wrapper<"unsubscribe"_n, &delphioracle::unsubscribe>;
+  using pricechange_action = action_wrapper<"pricechange"_n, &delphioracle::pricechange>;
+  using getcross_action = action_wrapper<"getcross"_n, &delphioracle::getcross>;
+  using getram_action = action_wrapper<"getram"_n, &delphioracle::getram>;
+  using setretire_action = action_wrapper<"setretire"_n, &delphioracle::setretire>;
+  using retire_action = action_wrapper<"retire"_n, &delphioracle::retire>;
+
+#if DELPHIORACLE_WITH_REWARDS
+  using claim_action = action_wrapper<"claim"_n, &delphioracle::claim>;
+  using payout_action = action_wrapper<"payout"_n, &delphioracle::payout>;
+  using compactdons_action = action_wrapper<"compactdons"_n, &delphioracle::compactdons>;
+  using reguser_action = action_wrapper<"reguser"_n, &delphioracle::reguser>;
   using voteabuser_action = action_wrapper<"voteabuser"_n, &delphioracle::voteabuser>;
   using updateusers_action = action_wrapper<"updateusers"_n, &delphioracle::updateusers>;
+  using transfer_action = action_wrapper<name("transfer"), &delphioracle::transfer>;
+#endif
+
+#if DELPHIORACLE_WITH_MEDIANS
   using makemedians_actions = action_wrapper<"makemedians"_n, &delphioracle::makemedians>;
+  using rollmedians_actions = action_wrapper<"rollmedians"_n, &delphioracle::rollmedians>;
+  using getperiods_actions = action_wrapper<"getperiods"_n, &delphioracle::getperiods>;
+#endif
+
+#if DELPHIORACLE_WITH_LEGACY
   using initmedians_actions = action_wrapper<"initmedians"_n, &delphioracle::initmedians>;
   using updtversion_actions = action_wrapper<"updtversion"_n, &delphioracle::updtversion>;
-  using transfer_action = action_wrapper<name("transfer"), &delphioracle::transfer>;
+#endif
 
 private:
+#if DELPHIORACLE_HEAP_STATS
+  heap_stats _heap_stats;
+#endif
+
+#if DELPHIORACLE_WITH_MEDIANS
   bool _is_active_current_week_cashe = false;
 
+  //Coarser buckets a median type folds into, at most two
+  struct median_cascade {
+    median_types types[2];
+    uint8_t size = 0;
+
+    const median_types* begin() const { return types; }
+    const median_types* end() const { return types + size; }
+  };
+
+  //The low, high, first and last a record passes on when it is folded
+  //into a coarser one; unknown for records from before they were kept
+  struct period_range {
+    uint64_t low = 0;
+    uint64_t high = 0;
+    uint64_t first = 0;
+    uint64_t last = 0;
+    bool known = false;
+
+    static period_range of(const medians& m) {
+      if (!m.first.has_value())
+        return {};
+      return {m.low.value_or(0), m.high.value_or(0), *m.first, m.last.value_or(0), true};
+    }
+
+    static period_range single(uint64_t value) {
+      return {value, value, value, value, true};
+    }
+
+    //Folds a later stretch of the same period into a record: low and high
+    //widen and last moves on. A record starting over, or holding no range
+    //yet, takes the stretch's range as it is, unknown included, so a new
+    //period never keeps the range of the one before.
+    void fold_into(medians& obj, bool start_over) const {
+      if (!known) {
+        //the four are the last fields, so they can be dropped together
+        if (start_over) {
+          obj.low.reset();
+          obj.high.reset();
+          obj.first.reset();
+          obj.last.reset();
+        }
+        return;
+      }
+      if (start_over || !obj.first.has_value()) {
+        obj.low = low;
+        obj.high = high;
+        obj.first = first;
+        obj.last = last;
+        return;
+      }
+      obj.low = std::min(obj.low.value_or(low), low);
+      obj.high = std::max(obj.high.value_or(high), high);
+      obj.last = last;
+    }
+  };
+
   void make_records_for_medians_table(median_types type, const name& pair, const name& payer, const medians& default_median);
+  void make_median_slots(const name& pair, const name& payer);
   const time_point get_round_up_current_time(median_types type) const;
+  const time_point get_round_up_time(median_types type, time_t time_sec) const;
   bool is_in_time_range(median_types type, const time_point& start_time_range,
     const time_point& time_value, bool is_previous_value = false) const;
   void erase_medians(const name& pair);
   void update_medians(const name& owner, const uint64_t value, pairstable::const_iterator pair_itr);
-  void update_medians_by_types(median_types type, const name& owner, const name& pair, 
-    const time_point& median_timestamp, const uint64_t median_value, const uint64_t median_request_count = 1);
+  void update_day_median(medianstable& medians_table, const name& owner, const name& pair, const time_point& median_timestamp, const uint64_t median_value);
+  void rollup_day_median(medianstable& medians_table, const name& payer, const name& pair, const medians& day_median);
+  uint64_t rollup_medians(const name& payer, const name& pair, uint64_t max_days);
+  void update_medians_by_types(medianstable& medians_table, median_types type, const name& owner, const name& pair,
+    const time_point& median_timestamp, const uint64_t median_value, const uint64_t median_request_count,
+    const period_range& range);
   bool is_active_current_week() const;
-  std::vector<median_types> GetUpdateMedians(median_types current_type) const;
+  median_cascade GetUpdateMedians(median_types current_type) const;
+#endif
 
   //Check if calling account is a qualified oracle
   bool check_oracle(const name owner) {
     globaltable gtable(_self, _self.value);
-    auto gitr = gtable.begin();
+    return check_oracle(owner, gtable.begin()->minimum_rank);
+  }
+
+  bool check_oracle(const name owner, const uint64_t minimum_rank) {
     //print("Checking oracle: ", owner, "\n");
     
     producers_table ptable("eosio"_n, name("eosio").value);
@@ -445,13 +878,84 @@ private:
       p_itr++;
       count++;
 
-      if (count > gitr->minimum_rank) 
+      if (count > minimum_rank) 
         break;
     }
 
     return false;
   }
 
+  //Active producers check_oracle would accept, sorted, so a batch of
+  //reports walks the producer ranking once
+  void qualified_oracles(const uint64_t minimum_rank, scratch_vector<name>& out) {
+    producers_table ptable("eosio"_n, name("eosio").value);
+    auto p_idx = ptable.get_index<"prototalvote"_n>();
+
+    uint64_t count = 0;
+    for (auto p_itr = p_idx.begin(); p_itr != p_idx.end() && count <= minimum_rank; ++p_itr, ++count) {
+      if (p_itr->active())
+        out.push_back(p_itr->owner);
+    }
+
+    std::sort(out.begin(), out.end());
+  }
+
+  //RAM billed for the rows of a table in one scope, each row's bytes plus
+  //the overhead of the row and of its secondary index entries
+  template <typename Table>
+  tableram table_ram(const Table& table, name table_name, name scope, int64_t secondary_indices) {
+    tableram r{table_name, scope, 0, 0};
+    for (auto itr = table.begin(); itr != table.end(); ++itr) {
+      r.rows++;
+      r.bytes += int64_t(pack_size(*itr)) + row_overhead_bytes * (1 + secondary_indices);
+    }
+    return r;
+  }
+
+  //Erases up to budget rows of a table, from the end, and returns how many
+  template <typename Table>
+  uint64_t erase_rows(Table& table, uint64_t budget) {
+    uint64_t erased = 0;
+    while (erased < budget && table.begin() != table.end()) {
+      auto itr = table.end();
+      itr--;
+      table.erase(itr);
+      erased++;
+    }
+    return erased;
+  }
+
+  //The last datapoint written to a pair. The timestamp index only has second
+  //resolution, so the rows of the last second are compared in full.
+  datapoints latest_datapoint(name pair) {
+    datapointstable dstore(_self, pair.value);
+    auto t_idx = dstore.get_index<"timestamp"_n>();
+
+    datapoints latest{};
+    bool seen = false;
+    auto itr = t_idx.end();
+    while (itr != t_idx.begin()) {
+      --itr;
+      if (seen && itr->by_timestamp() != latest.by_timestamp())
+        break;
+      //writes of one block share their time, and are told apart by seq
+      if (!seen || latest.timestamp < itr->timestamp ||
+          (latest.timestamp == itr->timestamp && latest.seq.value_or(0) < itr->seq.value_or(0)))
+        latest = *itr;
+      seen = true;
+    }
+    return latest;
+  }
+
+  //What an oracle signs for writeagg: the chain id, the contract account,
+  //then the report without its signature, packed
+  checksum256 report_digest(const checksum256& chain_id, const report& r) const {
+    char buffer[72];
+    datastream<char*> ds(buffer, sizeof(buffer));
+    ds << chain_id << _self << r.owner << r.pair << r.value << r.timestamp;
+    return sha256(buffer, sizeof(buffer));
+  }
+
   //Check if calling account is can vote on bounties
   bool check_approver(const name owner) {
     globaltable gtable(_self, _self.value);
@@ -463,30 +967,60 @@ private:
     return (gitr->approver_threshold == 0) || (itr != stats.end() && itr->count >= gitr->approver_threshold);
   }
 
+#if DELPHIORACLE_WITH_REWARDS
   bool check_user(const name owner) {
     userstable utable(_self, _self.value);
     auto user = utable.find(owner.value);
     return user != utable.end();
   }
+#endif
+
+  //Ensure account cannot push data more often than every 60 seconds. gstore is
+  //the caller's contract-scope stats table, shared across the quotes of a write.
+  //Counts the oracle's push on the pair and remembers its value. With
+  //relative, value is a writepacked delta, zigzag encoded, from the
+  //oracle's last value. On a pair with a band, a value inside the band
+  //around the oracle's last one is refused until its heartbeat is due.
+  //Returns the value pushed.
+  uint64_t check_last_push(const name owner, const pairs& pair, const global& config, statstable& gstore,
+                           uint64_t value, bool relative = false) {
+    statstable store(_self, pair.name.value);
 
-  //Ensure account cannot push data more often than every 60 seconds
-  void check_last_push(const name owner, const name pair) {
-    globaltable gtable(_self, _self.value);
-    statstable gstore(_self, _self.value);
-    statstable store(_self, pair.value);
-
-    auto gitr = gtable.begin();
     auto itr = store.find(owner.value);
+    if (relative) {
+      const int64_t delta = int64_t(value >> 1) ^ -int64_t(value & 1);
+      //a difference from nothing would be stored as a price
+      check(itr != store.end() && itr->last_value.has_value(), "no last value to add the difference to, write the value first");
+      const uint64_t last = *itr->last_value;
+      check(delta >= 0 ? value / 2 <= UINT64_MAX - last : uint64_t(-(delta + 1)) < last, "value out of range");
+      value = last + uint64_t(delta);
+    }
+
     if (itr != store.end()) {
       time_point ctime = current_time_point();
-      auto last = store.get(owner.value);
 
-      time_point next_push = eosio::time_point(last.timestamp.elapsed + eosio::microseconds(gitr->write_cooldown));
+      time_point next_push = eosio::time_point(itr->timestamp.elapsed + eosio::microseconds(config.write_cooldown));
       check(ctime >= next_push, "can only call every 60 seconds");
 
+      //the heartbeat write may come a cooldown early, so that it lands
+      //before the oracle's last point goes stale
+      const uint64_t deviation_bps = pair.deviation_bps.value_or(0);
+      const uint32_t heartbeat = pair.heartbeat.value_or(0);
+      if (deviation_bps > 0 && heartbeat > 0 && itr->last_value.has_value() &&
+          ctime - itr->timestamp < eosio::seconds(heartbeat) - eosio::microseconds(config.write_cooldown)) {
+        const uint64_t last = *itr->last_value;
+        const uint64_t diff = value > last ? value - last : last - value;
+        check((unsigned __int128)diff * 10000 >= (unsigned __int128)deviation_bps * last,
+              "value is inside the pair's band and its heartbeat is not due");
+      }
+
       store.modify( itr, _self, [&]( auto& s ) {
+        //rows from before bounties were settled lazily were paid per datapoint
+        if (!s.bounty_settled.has_value())
+          s.bounty_settled = s.count;
         s.timestamp = ctime;
         s.count++;
+        s.last_value = value;
       });
 
     } else {
@@ -496,6 +1030,8 @@ private:
         s.count = 1;
         s.balance = asset(0, symbol("TLOS", 4));
         s.last_claim = NULL_TIME_POINT;
+        s.bounty_settled = 0;
+        s.last_value = value;
       });
     }
 
@@ -515,8 +1051,29 @@ private:
         s.last_claim = NULL_TIME_POINT;
       });
     }
+
+    return value;
+  }
+
+  //Gives a pair the next ordinal, unless it has one
+  void assign_ordinal(pairstable& pairs, pairstable::const_iterator pitr) {
+    if (pitr->ordinal.has_value())
+      return;
+
+    ordinalstable ordinals(_self, _self.value);
+    const uint64_t ordinal = ordinals.available_primary_key();
+    ordinals.emplace(_self, [&](auto& o) {
+      o.ordinal = ordinal;
+      o.pair = pitr->name;
+    });
+
+    pairs.modify(pitr, same_payer, [&](auto& p) {
+      p.fill_extensions();
+      p.ordinal = ordinal;
+    });
   }
 
+#if DELPHIORACLE_WITH_REWARDS
   void update_votes() {
     //print("voting for bps:", "\n");
 
@@ -548,11 +1105,98 @@ private:
     );
     act.send();
   }
+#endif
+
+#if DELPHIORACLE_WITH_REWARDS
+  //Active pairs whose bounty still pays, sorted
+  void open_bounties(pairstable& pairs, scratch_vector<name>& out) {
+    for (auto itr = pairs.begin(); itr != pairs.end(); ++itr) {
+      if (itr->active && !itr->bounty_awarded)
+        out.push_back(itr->name);
+    }
+  }
 
-  //Push oracle message on top of queue, pop oldest element if queue size is larger than datapoints_count
-  void update_datapoints(const name owner, const uint64_t value, pairstable::const_iterator pair_itr) {
+  //Bounties are paid lazily: a write only counts the oracle's datapoints on
+  //the pair, and this credits one larimer for each datapoint counted since
+  //the last settlement, while the pair's bounty lasts. Only what is paid
+  //is settled, so datapoints a bounty ran out before stay owed. Rows not
+  //written since settlement became lazy were paid per datapoint. Returns
+  //what the oracle earned, for the caller to add to its balance.
+  asset settle_bounties(const name owner, pairstable& pairs, const scratch_vector<name>& open) {
+    asset earned = asset(0, tlos_symbol);
+
+    for (auto pair : open) {
+      statstable store(_self, pair.value);
+      auto itr = store.find(owner.value);
+      if (itr == store.end())
+        continue;
+
+      const uint64_t settled = itr->bounty_settled.value_or(itr->count);
+      if (settled >= itr->count)
+        continue;
+
+      auto pitr = pairs.find(pair.value);
+      if (pitr->bounty_awarded)
+        continue;
+
+      int64_t owed = int64_t(itr->count - settled);
+      int64_t paid = std::min(owed, pitr->bounty_amount.amount);
+
+      store.modify(itr, same_payer, [&](auto& s) {
+        s.bounty_settled = settled + uint64_t(paid);
+      });
+
+      pairs.modify(pitr, same_payer, [&](auto& s) {
+        s.bounty_amount.amount -= paid;
+        if (s.bounty_amount < one_larimer())
+          s.bounty_awarded = true;
+      });
+
+      earned.amount += paid;
+    }
+
+    return earned;
+  }
+
+  //A spent bounty is marked awarded when it is settled, and until then
+  //transfers naming the pair still go to it. A write to a pair whose
+  //bounty is already below a larimer marks it, once per pair.
+  void close_spent_bounty(pairstable& pairs, pairstable::const_iterator pitr) {
+    if (pitr->bounty_awarded || pitr->bounty_amount >= one_larimer())
+      return;
+
+    pairs.modify(pitr, same_payer, [&](auto& s) {
+      s.bounty_awarded = true;
+    });
+  }
+#endif
+
+  //Creates a pair's datapoints window, sized by the configured window, and
+  //its median slots, on payer's RAM, which is the contract's. A pair gets
+  //them when it is activated, so a proposal only costs the proposer its
+  //pairs row; a pair activated some other way gets them on its first write.
+  //Pairs proposed before keep the rows they were given.
+  void allocate_pair(name pair, name payer, uint64_t window) {
+    datapointstable dstore(_self, pair.value);
+    if (dstore.begin() == dstore.end()) {
+      for (uint64_t id = 0; id < window; ++id) {
+        dstore.emplace(payer, [&](auto& s) {
+          s.id = id;
+          s.value = 0;
+          s.timestamp = NULL_TIME_POINT;
+        });
+      }
+    }
+
+#if DELPHIORACLE_WITH_MEDIANS
+    make_median_slots(pair, payer);
+#endif
+  }
+
+  //Push oracle message on top of queue, pop oldest element if queue size is larger than datapoints_count.
+  //Returns the new median.
+  uint64_t update_datapoints(const name owner, const uint64_t value, pairstable::const_iterator pair_itr, globaltable& gtable) {
 
-    globaltable gtable(_self, _self.value);
     datapointstable dstore(_self, pair_itr->name.value);
 
     uint64_t median = 0;
@@ -562,27 +1206,50 @@ private:
     // auto latest = dstore.begin();
     // primary_key = latest->id - 1;
 
+    const time_point now = current_time_point();
+
     auto t_idx = dstore.get_index<"timestamp"_n>();
     auto oldest = t_idx.begin();
+    if (oldest == t_idx.end()) {
+      allocate_pair(pair_itr->name, _self, gtable.begin()->datapoints_per_instrument);
+      oldest = t_idx.begin();
+    }
 
     t_idx.modify(oldest, _self, [&](auto& s) {
      // s.id = primary_key;
       s.owner = owner;
       s.value = value;
-      s.timestamp = current_time_point();
+      s.timestamp = now;
+      s.seq = gtable.begin()->total_datapoints_count + 1;
     });
 
     //Get index sorted by value
     auto value_sorted = dstore.get_index<"value"_n>();
 
-    //skip first 10 values
-    auto itr = value_sorted.begin();
-    for (auto i = 1; i < 10; ++i)
-    {
-      itr++;
-    }
+    if (pair_itr->heartbeat.value_or(0) == 0) {
+      //the middle of the whole window, whatever size the pair was given
+      scratch_scope scope;
+      scratch_vector<uint64_t> window;
+      window.reserve(gtable.begin()->datapoints_per_instrument);
+      for (auto itr = value_sorted.begin(); itr != value_sorted.end(); ++itr)
+        window.push_back(itr->value);
 
-    median = itr->value;
+      median = window[(window.size() - 1) / 2];
+    } else {
+      //sparse pairs take the middle of the points still fresh, which
+      //include the one just written
+      const time_point cutoff = stale_before(*pair_itr, *gtable.begin(), now);
+
+      scratch_scope scope;
+      scratch_vector<uint64_t> fresh;
+      fresh.reserve(gtable.begin()->datapoints_per_instrument);
+      for (auto itr = value_sorted.begin(); itr != value_sorted.end(); ++itr) {
+        if (itr->timestamp > cutoff)
+          fresh.push_back(itr->value);
+      }
+
+      median = fresh[(fresh.size() - 1) / 2];
+    }
 
     //set median
     t_idx.modify(oldest, _self, [&](auto& s) {
@@ -596,8 +1263,137 @@ private:
     auto gitr = gtable.begin();
     //print("gtable.begin()->total_datapoints_count:", gitr->total_datapoints_count,  "\n");
 
+#if DELPHIORACLE_WITH_REWARDS
     if (gtable.begin()->total_datapoints_count % gitr->vote_interval == 0)
       update_votes();
+#endif
+
+    return median;
+  }
+
+  //Rotates a batch of one pair's reports into its window, replacing the
+  //oldest datapoints, and sets the median after the whole batch on each of
+  //them: one row update per report. Returns the new median.
+  uint64_t update_datapoints(const report* first, const report* last, pairstable::const_iterator pair_itr, globaltable& gtable) {
+    const global& config = *gtable.begin();
+    const size_t count = last - first;
+    check(count <= config.datapoints_per_instrument, "more reports for a pair than its datapoints window");
+
+    datapointstable dstore(_self, pair_itr->name.value);
+    auto t_idx = dstore.get_index<"timestamp"_n>();
+
+    const time_point now = current_time_point();
+    const bool sparse = pair_itr->heartbeat.value_or(0) > 0;
+    const time_point cutoff = stale_before(*pair_itr, config, now);
+
+    scratch_scope scope;
+    scratch_vector<uint64_t> replaced;
+    scratch_vector<uint64_t> window;
+    replaced.reserve(count);
+    window.reserve(config.datapoints_per_instrument);
+
+    if (t_idx.begin() == t_idx.end())
+      allocate_pair(pair_itr->name, _self, config.datapoints_per_instrument);
+
+    for (auto itr = t_idx.begin(); itr != t_idx.end(); ++itr) {
+      if (replaced.size() < count)
+        replaced.push_back(itr->id);
+      else if (!sparse || itr->timestamp > cutoff)
+        window.push_back(itr->value);
+    }
+    check(replaced.size() == count, "more reports for a pair than its datapoints window");
+    for (auto r = first; r != last; ++r)
+      window.push_back(r->value);
+
+    //same rank as the single write: the middle of the whole window, or of
+    //the fresh points on sparse pairs
+    std::sort(window.begin(), window.end());
+    uint64_t median = window[(window.size() - 1) / 2];
+
+    for (size_t i = 0; i < count; ++i) {
+      dstore.modify(dstore.find(replaced[i]), _self, [&](auto& s) {
+        s.owner = first[i].owner;
+        s.value = first[i].value;
+        s.median = median;
+        s.timestamp = now;
+        s.seq = config.total_datapoints_count + i + 1;
+      });
+    }
+
+    gtable.modify(gtable.begin(), _self, [&](auto& s) {
+      s.total_datapoints_count += count;
+    });
+
+#if DELPHIORACLE_WITH_REWARDS
+    //vote whenever the count passed a multiple of the interval
+    if (gtable.begin()->total_datapoints_count % config.vote_interval < count)
+      update_votes();
+#endif
+
+    return median;
+  }
+
+  //Sends one pricechange to the consumers of a pair whose deviation or
+  //heartbeat the new median crosses. Nothing is allocated unless one is due.
+  void notify_subscribers(const name pair, const uint64_t median) {
+    subscriberstable subs(_self, pair.value);
+    auto itr = subs.begin();
+    if (itr == subs.end())
+      return;
+
+    const time_point now = current_time_point();
+    std::vector<name> due;
+
+    for (; itr != subs.end(); ++itr) {
+      uint64_t diff = median > itr->last_median ? median - itr->last_median : itr->last_median - median;
+
+      bool moved = itr->last_median == 0
+        || (itr->deviation_bps > 0 && (unsigned __int128)diff * 10000 >= (unsigned __int128)itr->deviation_bps * itr->last_median);
+      bool stale = itr->heartbeat > 0 && now - itr->last_notified >= eosio::seconds(itr->heartbeat);
+
+      if (!moved && !stale)
+        continue;
+
+      subs.modify(itr, same_payer, [&](auto& s) {
+        s.last_median = median;
+        s.last_notified = now;
+      });
+      due.push_back(itr->consumer);
+    }
+
+    if (due.empty())
+      return;
+
+    pricechange_action notify(_self, {_self, "active"_n});
+    notify.send(pair, median, now, due);
+  }
+
+  //Datapoints at or before this time are out of the pair's window: empty
+  //slots, and on sparse pairs those older than the heartbeat plus the write
+  //cooldown, by when their oracle should have written again
+  static time_point stale_before(const pairs& pair, const global& config, const time_point now) {
+    uint32_t heartbeat = pair.heartbeat.value_or(0);
+    if (heartbeat == 0)
+      return NULL_TIME_POINT;
+
+    time_point cutoff = now - eosio::seconds(heartbeat) - eosio::microseconds(config.write_cooldown);
+    return cutoff > NULL_TIME_POINT ? cutoff : NULL_TIME_POINT;
+  }
+
+  //Value at points_bps (0-10000) of an ascending window, interpolated between ranks
+  static uint64_t window_quantile(const std::vector<uint64_t>& sorted, uint64_t points_bps) {
+    if (sorted.empty())
+      return 0;
+
+    uint64_t scaled = points_bps * (sorted.size() - 1);
+    uint64_t rank = scaled / 10000;
+    uint64_t remainder = scaled % 10000;
+
+    if (remainder == 0 || rank + 1 >= sorted.size())
+      return sorted[rank];
+
+    unsigned __int128 delta = sorted[rank + 1] - sorted[rank];
+    return sorted[rank] + (uint64_t)(delta * remainder / 10000);
   }
 
   //Delphi Oracle - Bounty logic
@@ -624,6 +1420,7 @@ private:
 
   //The bounty is then paid at a rate of X larimers per datapoint to BPs contributing to it until it runs out.
 
+#if DELPHIORACLE_WITH_REWARDS
   void create_user(name owner) {
     userstable users(_self, _self.value);
     auto itr = users.find(owner.value);
@@ -632,10 +1429,76 @@ private:
         o.name = owner;
         o.score = 0;
         o.creation_timestamp = current_time_point();
+        o.donated = 0;
+        o.proxied = 0;
+        o.refreshed = NULL_TIME_POINT;
       });
     }
   }
 
+  //What an account donated: its totals, plus the rows of a ledger not
+  //compacted yet. Only legacy_scan of those are summed; complete is cleared
+  //when more remain, so the sum is not cached.
+  uint64_t donated_by(name owner, bool* complete = nullptr) {
+    donortotalstable totals(_self, owner.value);
+    int64_t total = 0;
+    for (auto& t : totals)
+      total += t.total.amount;
+
+    donationstable donations(_self, owner.value);
+    uint64_t scanned = 0;
+    for (auto itr = donations.begin(); itr != donations.end(); itr++) {
+      if (itr->folded.value_or(false))
+        continue;
+      if (scanned++ == legacy_scan) {
+        if (complete)
+          *complete = false;
+        break;
+      }
+      total += itr->amount.amount;
+    }
+    return uint64_t(total);
+  }
+
+  //The stake an account proxies to the contract
+  uint64_t proxied_by(name owner) {
+    voters_table vtable("eosio"_n, name("eosio").value);
+    auto v_itr = vtable.find(owner.value);
+    return v_itr != vtable.end() && v_itr->proxy == _self ? uint64_t(v_itr->staked) : 0;
+  }
+
+  bool score_stale(const users& u, time_point now) const {
+    return !u.refreshed.has_value() || now - *u.refreshed >= seconds(score_ttl);
+  }
+
+  //Adds a donation to a user's score, and reads the proxied stake again if
+  //it is stale. Rows from before the score was cached get their donations
+  //summed, and cached once the donor's ledger is small enough to sum whole.
+  //Returns the score.
+  uint64_t refresh_user(userstable& users, userstable::const_iterator uitr, uint64_t donation = 0) {
+    const time_point now = current_time_point();
+    const bool stale = score_stale(*uitr, now);
+    if (!stale && donation == 0)
+      return uitr->score;
+
+    bool complete = true;
+    const uint64_t donated = (uitr->donated.has_value() ? *uitr->donated : donated_by(uitr->name, &complete)) + donation;
+    const uint64_t proxied = stale ? proxied_by(uitr->name) : uitr->proxied.value_or(0);
+
+    //a partial sum is not cached, and the cache fields serialize in order,
+    //so such a row keeps only its score and is summed again next time
+    users.modify(uitr, same_payer, [&](auto& o) {
+      o.score = donated + proxied;
+      if (!complete)
+        return;
+      o.donated = donated;
+      o.proxied = proxied;
+      if (stale)
+        o.refreshed = now;
+    });
+    return donated + proxied;
+  }
+
   void process_donation(name from, name scope, asset quantity) {
     globaltable gtable(_self, _self.value);
     statstable cstore(_self, scope.value);
@@ -647,17 +1510,33 @@ private:
       create_user( from );
 
     uitr = users.find(from.value);
-    users.modify(*uitr, _self, [&]( auto& o) {
-      o.score += quantity.amount;
-    });
+    refresh_user(users, uitr, uint64_t(quantity.amount));
+
+    const time_point now = current_time_point();
+    donortotalstable totals(_self, from.value);
+    fold_donation(totals, scope, quantity, now);
+
+    // keep the donation among the donor's recent ones, dropping the oldest
+    uint64_t id = 0;
+    if (donations.begin() != donations.end()) {
+      auto oldest = donations.begin();
+      auto newest = donations.end();
+      newest--;
+      id = newest->id + 1;
+      if (id - oldest->id >= recent_donations) {
+        if (!oldest->folded.value_or(false))
+          fold_donation(totals, oldest->pair, oldest->amount, oldest->timestamp);
+        donations.erase(oldest);
+      }
+    }
 
-    // store donation in table
     donations.emplace(_self, [&](auto& o) {
-      o.id = donations.available_primary_key();
+      o.id = id;
       o.donator = from;
       o.pair = scope;
-      o.timestamp = current_time_point();
+      o.timestamp = now;
       o.amount = quantity;
+      o.folded = true;
     });
 
     auto gitr = gtable.begin();
@@ -726,6 +1605,30 @@ private:
     }
   }
 
+  //Adds a donation to the donor's totals for the pair. Returns the bytes of
+  //a totals row created, 0 if it existed.
+  int64_t fold_donation(donortotalstable& totals, name pair, asset amount, time_point timestamp) {
+    auto itr = totals.find(pair.value);
+    if (itr == totals.end()) {
+      auto row = totals.emplace(_self, [&](auto& o) {
+        o.pair = pair;
+        o.total = amount;
+        o.count = 1;
+        o.first = timestamp;
+        o.last = timestamp;
+      });
+      return int64_t(pack_size(*row)) + row_overhead_bytes;
+    }
+
+    totals.modify(itr, same_payer, [&](auto& o) {
+      o.total += amount;
+      o.count++;
+      if (timestamp < o.first) o.first = timestamp;
+      if (o.last < timestamp) o.last = timestamp;
+    });
+    return 0;
+  }
+
   void process_bounty(name from, name pair, asset quantity) {
     pairstable pairs(_self, _self.value);
     auto pitr = pairs.find(pair.value);
@@ -733,9 +1636,12 @@ private:
       s.bounty_amount += quantity;
     });
   }
+#endif
 
+#if DELPHIORACLE_WITH_MEDIANS
   bool is_medians_active() {
     singleton_flag_medians flag_medians_instance(get_self(), get_self().value);
     return flag_medians_instance.exists() && flag_medians_instance.get().is_active;
   }
+#endif
 };
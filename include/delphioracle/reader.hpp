@@ -0,0 +1,125 @@
+/*
+
+  delphioracle reader
+
+  For consumer contracts reading prices off delphioracle's tables. Include
+  this instead of copying the contract's structs: it declares the tables as
+  the contract writes them, and latest_price reads the current median with
+  as few database calls as the tables allow.
+
+    #include <delphioracle/reader.hpp>
+
+    auto p = delphi::latest_price("tlosusd"_n, eosio::minutes(5));
+    // p.median, with the pair's quoted_precision decimals
+
+  Published under MIT License
+
+*/
+
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
+
+namespace delphi {
+
+  using eosio::name;
+  using eosio::time_point;
+
+  static constexpr name default_contract = name("delphioracle");
+
+  //A pair's window of datapoints, scoped by pair. Each write overwrites the
+  //oldest row and stores the median of the window after it.
+  struct datapoints {
+    uint64_t id;
+    name owner;
+    uint64_t value;
+    uint64_t median;
+    time_point timestamp;
+
+    //the write's place among all writes, which orders the writes of one
+    //block; rows not written since it was added have none
+    eosio::binary_extension<uint64_t> seq;
+
+    uint64_t primary_key() const { return id; }
+    uint64_t by_timestamp() const { return timestamp.elapsed.to_seconds(); }
+    uint64_t by_value() const { return value; }
+  };
+
+  typedef eosio::multi_index<"datapoints"_n, datapoints,
+      eosio::indexed_by<"value"_n, eosio::const_mem_fun<datapoints, uint64_t, &datapoints::by_value>>,
+      eosio::indexed_by<"timestamp"_n, eosio::const_mem_fun<datapoints, uint64_t, &datapoints::by_timestamp>>> datapointstable;
+
+  //The pairs, scoped by the contract. A value of a pair is the price of one
+  //base in quote, with quoted_precision decimals.
+  struct pairs {
+    bool active = false;
+    bool bounty_awarded = false;
+    bool bounty_edited_by_custodians = false;
+
+    eosio::name proposer;
+    eosio::name name;
+
+    eosio::asset bounty_amount;
+
+    std::vector<eosio::name> approving_custodians;
+    std::vector<eosio::name> approving_oracles;
+
+    eosio::symbol base_symbol;
+    uint16_t base_type;
+    eosio::name base_contract;
+
+    eosio::symbol quote_symbol;
+    uint16_t quote_type;
+    eosio::name quote_contract;
+
+    uint64_t quoted_precision;
+
+    eosio::binary_extension<uint64_t> deviation_bps;
+    eosio::binary_extension<uint32_t> heartbeat;
+    eosio::binary_extension<uint64_t> ordinal;
+
+    uint64_t primary_key() const { return name.value; }
+  };
+
+  typedef eosio::multi_index<"pairs"_n, pairs> pairstable;
+
+  struct price {
+    uint64_t median;
+    time_point timestamp;
+  };
+
+  //The pair's current median, written at most max_age ago.
+  //
+  //The last row of the timestamp index is the latest write only to the
+  //second: two writes in the same second sort by primary key, not by time.
+  //The rows of that second are compared in full, time first and then seq,
+  //since the writes of one block share their time. That is one row more
+  //than reading the last one alone when no two writes share the second.
+  //Walking the whole window by primary key reads all of it.
+  inline price latest_price(name pair, eosio::microseconds max_age, name contract = default_contract) {
+    datapointstable dstore(contract, pair.value);
+    auto t_idx = dstore.get_index<"timestamp"_n>();
+
+    auto itr = t_idx.end();
+    eosio::check(itr != t_idx.begin(), "no datapoints for pair");
+    --itr;
+
+    auto latest = itr;
+    const uint64_t second = itr->by_timestamp();
+    while (itr != t_idx.begin()) {
+      --itr;
+      if (itr->by_timestamp() != second)
+        break;
+      if (latest->timestamp < itr->timestamp ||
+          (latest->timestamp == itr->timestamp && latest->seq.value_or(0) < itr->seq.value_or(0)))
+        latest = itr;
+    }
+
+    eosio::check(latest->median > 0 && eosio::current_time_point() - latest->timestamp <= max_age,
+                 "price is older than max_age");
+    return {latest->median, latest->timestamp};
+  }
+
+} // namespace delphi
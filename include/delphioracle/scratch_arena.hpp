@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+//Per-action scratch memory. The wasm heap only grows during an action, so
+//short-lived containers on the write path take their storage from a fixed
+//bump arena instead. A scratch_scope hands back everything allocated inside
+//it when it ends; requests that do not fit fall back to the heap and are
+//counted.
+class scratch_arena {
+ public:
+  static constexpr size_t capacity = 8 * 1024;
+
+  constexpr scratch_arena() : _buffer{}, _used(0), _peak(0), _overflows(0) {}
+
+  void* allocate(size_t size, size_t align) {
+    size_t start = (_used + align - 1) & ~(align - 1);
+    if (start + size > capacity) {
+      _overflows++;
+      return ::operator new(size);
+    }
+
+    _used = start + size;
+    if (_used > _peak)
+      _peak = _used;
+    return _buffer + start;
+  }
+
+  void deallocate(void* p, size_t size) {
+    if (!owns(p)) {
+      ::operator delete(p);
+      return;
+    }
+
+    //only the latest allocation can be given back before its scope ends
+    if (static_cast<char*>(p) + size == _buffer + _used)
+      _used = static_cast<char*>(p) - _buffer;
+  }
+
+  bool owns(const void* p) const {
+    return p >= _buffer && p < _buffer + capacity;
+  }
+
+  size_t mark() const { return _used; }
+  void rewind(size_t mark) { _used = mark; }
+
+  size_t used() const { return _used; }
+  size_t peak() const { return _peak; }
+  uint64_t overflows() const { return _overflows; }
+
+  //Each action gets a fresh module instance on chain; native harnesses that
+  //reuse the process call this between actions.
+  void reset() {
+    _used = 0;
+    _peak = 0;
+    _overflows = 0;
+  }
+
+ private:
+  alignas(16) char _buffer[capacity];
+  size_t _used;
+  size_t _peak;
+  uint64_t _overflows;
+};
+
+inline scratch_arena& scratch() {
+  static scratch_arena arena;
+  return arena;
+}
+
+//Frees the arena back to where it was when the scope was opened. Containers
+//using it must be declared after the scope so they are destroyed first.
+class scratch_scope {
+ public:
+  scratch_scope() : _mark(scratch().mark()) {}
+  ~scratch_scope() { scratch().rewind(_mark); }
+
+  scratch_scope(const scratch_scope&) = delete;
+  scratch_scope& operator=(const scratch_scope&) = delete;
+
+ private:
+  size_t _mark;
+};
+
+template <typename T>
+struct scratch_allocator {
+  using value_type = T;
+
+  scratch_allocator() = default;
+  template <typename U>
+  scratch_allocator(const scratch_allocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(scratch().allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, size_t n) {
+    scratch().deallocate(p, n * sizeof(T));
+  }
+
+  friend bool operator==(const scratch_allocator&, const scratch_allocator&) { return true; }
+  friend bool operator!=(const scratch_allocator&, const scratch_allocator&) { return false; }
+};
+
+template <typename T>
+using scratch_vector = std::vector<T, scratch_allocator<T>>;
@@ -0,0 +1,57 @@
+#!/bin/bash
+
+# Runs delphifeeder against local mock price sources, once with a single
+# fetch thread (the serial updater.js behaviour) and once with one thread per
+# source, and prints the fetch and end-to-end latency of each. Then counts
+# how many pair quotes a 50 bps band with a one hour heartbeat holds back
+# over ten times as many cycles. Writes are not broadcast.
+#
+# ./bench_feeder.sh <tools build dir> [sources] [delay ms] [cycles]
+
+BUILD=$1
+SOURCES=${2:-8}
+DELAY=${3:-50}
+CYCLES=${4:-20}
+
+if [ -z "$BUILD" ]; then
+  echo "usage: $0 <tools build dir> [sources] [delay ms] [cycles]"
+  exit 1
+fi
+
+WORK=$(mktemp -d)
+PORT=19100
+
+ports=""
+sources=""
+for i in $(seq $SOURCES); do
+  ports="$ports --port $((PORT + i))"
+  [ -n "$sources" ] && sources="$sources,"
+  sources="$sources{\"name\":\"mock$i\",\"url\":\"http://127.0.0.1:$((PORT + i))/\",\"quotes\":{\"tlosusd\":\"tlosusd\",\"btcusd\":\"btcusd\"}}"
+done
+
+$BUILD/feeder/mocksource $ports --price tlosusd=0.0585 --price btcusd=61000 \
+  --delay-ms $DELAY --jitter-ms $((DELAY / 2)) --walk 0.001 2> /dev/null &
+MOCK=$!
+trap "kill $MOCK; rm -rf $WORK" EXIT
+sleep 0.5
+
+for threads in 1 $SOURCES; do
+  cat > $WORK/feeder.json <<CONFIG
+{"owner": "eostitan", "interval_ms": 0, "timeout_ms": 5000, "threads": $threads,
+ "pairs": [{"name": "tlosusd", "scale": 10000, "min_sources": 1},
+           {"name": "btcusd", "scale": 10000, "min_sources": 1}],
+ "sources": [$sources]}
+CONFIG
+  echo "$SOURCES sources, ${DELAY}ms each, $threads thread(s):"
+  $BUILD/feeder/delphifeeder --dry-run --quiet --cycles $CYCLES $WORK/feeder.json
+  echo
+done
+
+cat > $WORK/feeder.json <<CONFIG
+{"owner": "eostitan", "interval_ms": 0, "timeout_ms": 5000, "threads": $SOURCES,
+ "pairs": [{"name": "tlosusd", "scale": 1000000, "min_sources": 1, "deviation_bps": 50, "heartbeat_s": 3600},
+           {"name": "btcusd", "scale": 10000, "min_sources": 1, "deviation_bps": 50, "heartbeat_s": 3600}],
+ "sources": [$sources]}
+CONFIG
+echo "$SOURCES sources, 50 bps band, 1 hour heartbeat:"
+$BUILD/feeder/delphifeeder --dry-run --quiet --cycles $((CYCLES * 10)) $WORK/feeder.json
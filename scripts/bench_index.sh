@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Measures delphiindex ingest: synthesizes a block stream of oracle writes
+# with mockship, indexes it from a file and then from a local socket into
+# fresh stores, and runs a range query against the result.
+#
+# ./bench_index.sh <tools build dir> [datapoints] [pairs]
+
+BUILD=$1
+POINTS=${2:-10000000}
+PAIRS=${3:-8}
+
+if [ -z "$BUILD" ]; then
+  echo "usage: $0 <tools build dir> [datapoints] [pairs]"
+  exit 1
+fi
+
+WORK=$(mktemp -d)
+PORT=19300
+trap "rm -rf $WORK" EXIT
+
+$BUILD/history/mockship --synth $POINTS --pairs $PAIRS --out $WORK/traces.bin || exit 1
+
+echo "from a file:"
+$BUILD/history/delphiindex --file $WORK/traces.bin $WORK/file-store || exit 1
+echo
+echo "again, resuming after the recorded head:"
+$BUILD/history/delphiindex --file $WORK/traces.bin $WORK/file-store || exit 1
+echo
+
+echo "from a socket:"
+$BUILD/history/mockship --in $WORK/traces.bin --serve $PORT 2> /dev/null &
+sleep 0.5
+$BUILD/history/delphiindex --connect 127.0.0.1:$PORT $WORK/socket-store || exit 1
+wait
+echo
+
+echo "range query:"
+$BUILD/history/delphiindex --query tlosusd --from 2024-05-01T13:00:00 --to 2024-05-01T14:00:00 --limit 3 $WORK/file-store
@@ -0,0 +1,35 @@
+#!/bin/bash
+
+# Pushes write transactions at a local mocknode with delphitxbench: first
+# the way a per-push client does it (get_info, serialize, sign, push, one at
+# a time), then with cached TAPOS and the pre-serialized action at
+# increasing pipeline depths, then with signing nonces computed up front.
+# Uses the well known eosio development key.
+#
+# ./bench_push.sh <tools build dir> [count] [node delay ms]
+
+BUILD=$1
+COUNT=${2:-1000}
+DELAY=${3:-15}
+PORT=18888
+
+if [ -z "$BUILD" ]; then
+  echo "usage: $0 <tools build dir> [count] [node delay ms]"
+  exit 1
+fi
+
+export DELPHIFEEDER_KEY=5KQwrPbwdL6PhXujxW37FSSQZ1JiwsST4cqQzDeyXtP79zkvFD3
+$BUILD/feeder/mocknode --port $PORT --key EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV \
+  --delay-ms $DELAY --jitter-ms $((DELAY / 2)) 2> /dev/null &
+NODE=$!
+trap "kill $NODE" EXIT
+sleep 0.5
+
+BENCH="$BUILD/feeder/delphitxbench --node http://127.0.0.1:$PORT --count $COUNT"
+$BENCH --naive --count $((COUNT / 4))
+for depth in 1 4 16; do
+  echo
+  $BENCH --depth $depth
+done
+echo
+$BENCH --depth 16 --nonces $COUNT
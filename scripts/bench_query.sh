@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Measures delphiquery: indexes synthetic oracle writes into a fresh store,
+# serves it on a local port and loads it with delphiqueryload, one kind of
+# request at a time and then the default mix, one request in flight per
+# connection and then pipelined.
+#
+# ./bench_query.sh <tools build dir> [datapoints] [seconds]
+
+BUILD=$1
+POINTS=${2:-10000000}
+SECONDS_EACH=${3:-5}
+
+if [ -z "$BUILD" ]; then
+  echo "usage: $0 <tools build dir> [datapoints] [seconds]"
+  exit 1
+fi
+
+WORK=$(mktemp -d)
+PORT=19310
+SERVER=
+trap '[ -n "$SERVER" ] && kill $SERVER; rm -rf $WORK' EXIT
+
+$BUILD/history/mockship --synth $POINTS --out $WORK/traces.bin 2> /dev/null || exit 1
+$BUILD/history/delphiindex --file $WORK/traces.bin $WORK/store > /dev/null || exit 1
+rm $WORK/traces.bin
+
+$BUILD/history/delphiquery --port $PORT $WORK/store &
+SERVER=$!
+sleep 0.5
+
+for MIX in latest=1 range=1 ohlc=1 twap=1; do
+  echo "$MIX:"
+  $BUILD/history/delphiqueryload --target 127.0.0.1:$PORT --seconds $SECONDS_EACH --mix $MIX | tail -n +2 || exit 1
+  echo
+done
+
+echo "mixed:"
+$BUILD/history/delphiqueryload --target 127.0.0.1:$PORT --seconds $SECONDS_EACH || exit 1
+echo
+echo "mixed, pipelined:"
+$BUILD/history/delphiqueryload --target 127.0.0.1:$PORT --seconds $SECONDS_EACH --connections 4 --pipeline 16 || exit 1
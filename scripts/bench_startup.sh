@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Compares the per-action cost of two builds of the contract on a local node,
+# e.g. before and after a change to its global state. Each wasm goes to its
+# own account and gets the same configure action pushed N times; the median
+# cpu_usage_us covers instantiation, global constructors and the action.
+#
+# ./bench_startup.sh <before build dir> <after build dir> <public key> [N]
+
+BEFORE=$1
+AFTER=$2
+KEY=$3
+N=${4:-50}
+
+if [ -z "$KEY" ]; then
+  echo "usage: $0 <before build dir> <after build dir> <public key> [N]"
+  exit 1
+fi
+
+median() {
+  sort -n | awk '{ v[NR] = $1 } END { print v[int((NR + 1) / 2)] }'
+}
+
+for run in before after; do
+  if [ $run == before ]; then build=$BEFORE; else build=$AFTER; fi
+  account="delphi.$run"
+
+  cleos create account eosio $account $KEY $KEY -p eosio@active > /dev/null 2>&1
+  cleos set account permission $account active --add-code > /dev/null
+  cleos set contract $account $build delphioracle.wasm delphioracle.abi -p $account@active > /dev/null || exit 1
+
+  # the first action after set contract also pays for compiling the module
+  cleos push action -f $account configure "$(cat configure.json)" -p $account > /dev/null
+
+  cpu=$(for i in $(seq $N); do
+    cleos push action -f $account configure "$(cat configure.json)" -p $account --json | jq .processed.receipt.cpu_usage_us
+  done | median)
+
+  echo "$run: median cpu_usage_us of configure over $N actions: $cpu"
+done
@@ -0,0 +1,36 @@
+#!/bin/bash
+
+# Deploys each contract variant to its own account on a local node and reports
+# wasm size, set contract time and the cpu of the first two configure actions.
+# The first configure after set contract pays for instantiating the module.
+#
+# ./bench_variants.sh <build dir> <public key>
+# build with: cmake -DDELPHIORACLE_BUILD_VARIANTS=ON .. && make
+
+BUILD=${1:-../build/delphioracle}
+KEY=$2
+
+if [ -z "$KEY" ]; then
+  echo "usage: $0 <build dir> <public key>"
+  exit 1
+fi
+
+printf "%-8s %10s %12s %14s %14s\n" variant bytes setcode_ms first_cpu_us second_cpu_us
+
+for variant in core rewards full; do
+  account="delphi.$variant"
+  wasm="delphioracle_$variant.wasm"
+  abi="delphioracle_$variant.abi"
+
+  cleos create account eosio $account $KEY $KEY -p eosio@active > /dev/null 2>&1
+  cleos set account permission $account active --add-code > /dev/null
+
+  start=$(date +%s%N)
+  cleos set contract $account $BUILD $wasm $abi -p $account@active > /dev/null || exit 1
+  setcode_ms=$(( ($(date +%s%N) - start) / 1000000 ))
+
+  first=$(cleos push action -f $account configure "$(cat configure.json)" -p $account --json | jq .processed.receipt.cpu_usage_us)
+  second=$(cleos push action -f $account configure "$(cat configure.json)" -p $account --json | jq .processed.receipt.cpu_usage_us)
+
+  printf "%-8s %10s %12s %14s %14s\n" $variant $(stat -c %s $BUILD/$wasm) $setcode_ms $first $second
+done
@@ -0,0 +1,12 @@
+# Fails the build if an object defines global constructors: the contract would
+# run them at the start of every action.
+# cmake "-DOBJECTS=<a.o;b.o>" -P check_ctors.cmake
+cmake_minimum_required(VERSION 3.10)
+
+foreach(object ${OBJECTS})
+   file(STRINGS "${object}" ctors REGEX "_GLOBAL__sub_I_|__cxx_global_var_init")
+   if(ctors)
+      list(REMOVE_DUPLICATES ctors)
+      message(FATAL_ERROR "global constructors in ${object}:\n${ctors}")
+   endif()
+endforeach()
@@ -14,23 +14,55 @@
 */
 
 #include <delphioracle.hpp>
-#include <custom_ctime.hpp>
 #include <algorithm>
 
+#if DELPHIORACLE_WITH_MEDIANS
+#include <custom_ctime.hpp>
+
 namespace {
-  const std::map<median_types, uint8_t> limits = {
-    {median_types::day,          1},
-    {median_types::current_week, 1},
-    {median_types::week,         4},
-    {median_types::month,        12}
-  };
+  //Lookup tables are constexpr switches: a global std::map would be built by
+  //a static constructor at the start of every action.
+
+  //Rows kept per median type; day keeps a few slots so closed days can wait
+  //for rollmedians
+  constexpr uint8_t median_slots(median_types type) {
+    switch (type) {
+      case median_types::day:          return 3;
+      case median_types::current_week: return 1;
+      case median_types::week:         return 4;
+      case median_types::month:        return 12;
+      default:                         return 0;
+    }
+  }
 
-    const std::map<median_types, uint32_t> time_consts = {
-    {median_types::day,          86400},
-    {median_types::current_week, 86400 * 7},
-    {median_types::week,         86400 * 7},
-    {median_types::month,        86400 * 7 * 4}
-  };
+  //Fixed period of a median type in seconds, 0 if it has none
+  constexpr uint32_t median_period(median_types type) {
+    switch (type) {
+      case median_types::day:          return 86400;
+      case median_types::current_week: return 86400 * 7;
+      case median_types::week:         return 86400 * 7;
+      case median_types::month:        return 86400 * 7 * 4;
+      default:                         return 0;
+    }
+  }
+}
+#endif
+
+namespace {
+  //Unsigned LEB128: seven bits a byte, lowest first, the top bit set on
+  //every byte but the last
+  uint64_t read_varint(const char*& pos, const char* end) {
+    uint64_t v = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+      check(pos != end, "packed quotes end inside a number");
+      const uint8_t byte = uint8_t(*pos++);
+      v |= uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return v;
+    }
+    check(false, "number longer than 64 bits in packed quotes");
+    return 0;
+  }
 }
 
 //Write datapoint
@@ -41,14 +73,24 @@ ACTION delphioracle::write(const name owner, const std::vector<quote>& quotes) {
   //print("quotes length ", length, "\n");
 
   check(length > 0, "must supply non-empty array of quotes");
-  check(check_oracle(owner), "account is not a qualified oracle");
+
+  //One instance per table for the whole write, so each row is loaded once
+  //however many quotes there are
+  globaltable gtable(_self, _self.value);
+  const auto& config = *gtable.begin();
+
+  check(check_oracle(owner, config.minimum_rank), "account is not a qualified oracle");
   //print("Oracle passed check_oracle");
 
   statstable stable(_self, _self.value);
   pairstable pairs(_self, _self.value);
 
-  auto oitr = stable.find(owner.value);
-  //print("Found the stable for owner.value");
+#if DELPHIORACLE_WITH_MEDIANS
+  const bool medians_active = is_medians_active();
+  if (medians_active) {
+    _is_active_current_week_cashe = is_active_current_week();
+  }
+#endif
 
   for (int i = 0; i < length; i++) {
     //print("quote ", i, " ", quotes[i].value, " ",  quotes[i].pair, "\n");
@@ -56,34 +98,186 @@ ACTION delphioracle::write(const name owner, const std::vector<quote>& quotes) {
     auto itr = pairs.find(quotes[i].pair.value);
 
     check(itr != pairs.end() && itr->active == true, "pair not allowed");
+#if DELPHIORACLE_WITH_REWARDS
+    close_spent_bounty(pairs, itr);
+#endif
 
-    check_last_push(owner, quotes[i].pair);
+    check_last_push(owner, *itr, config, stable, quotes[i].value);
 
-    if (itr->bounty_amount >= one_larimer && oitr != stable.end()) {
+    uint64_t median = update_datapoints(owner, quotes[i].value, itr, gtable);
+    notify_subscribers(quotes[i].pair, median);
+#if DELPHIORACLE_WITH_MEDIANS
+    if (medians_active) {
+      update_medians(owner, quotes[i].value, itr);
+    }
+#endif
+  }
+}
 
-      //global donation to the contract, split between top oracles across all pairs
-      stable.modify(*oitr, _self, [&]( auto& s ) {
-        s.balance += one_larimer;
-      });
+//Write datapoints packed as varints: for each quote, the pair's ordinal,
+//then the zigzag encoded difference from the oracle's last value on the
+//pair. Decoded as it goes, nothing is unpacked into a vector of quotes.
+ACTION delphioracle::writepacked(const name owner, const std::vector<char>& quotes) {
+  require_auth(owner);
 
-      //global donation to the contract, split between top oracles across all pairs
-      pairs.modify(*itr, _self, [&]( auto& s ) {
-        s.bounty_amount -= one_larimer;
-      });
+  check(quotes.size() > 0, "must supply non-empty array of quotes");
+
+  globaltable gtable(_self, _self.value);
+  const auto& config = *gtable.begin();
+
+  check(check_oracle(owner, config.minimum_rank), "account is not a qualified oracle");
+
+  statstable stable(_self, _self.value);
+  pairstable pairs(_self, _self.value);
+  ordinalstable ordinals(_self, _self.value);
+
+#if DELPHIORACLE_WITH_MEDIANS
+  const bool medians_active = is_medians_active();
+  if (medians_active) {
+    _is_active_current_week_cashe = is_active_current_week();
+  }
+#endif
+
+  const char* pos = quotes.data();
+  const char* end = pos + quotes.size();
+  while (pos != end) {
+    const uint64_t ordinal = read_varint(pos, end);
+    const uint64_t delta = read_varint(pos, end);
+
+    auto oitr = ordinals.find(ordinal);
+    check(oitr != ordinals.end(), "unknown pair ordinal");
+
+    auto itr = pairs.find(oitr->pair.value);
+    check(itr != pairs.end() && itr->active == true && itr->ordinal.value_or(ordinal + 1) == ordinal, "pair not allowed");
+#if DELPHIORACLE_WITH_REWARDS
+    close_spent_bounty(pairs, itr);
+#endif
+
+    const uint64_t value = check_last_push(owner, *itr, config, stable, delta, true);
+
+    uint64_t median = update_datapoints(owner, value, itr, gtable);
+    notify_subscribers(itr->name, median);
+#if DELPHIORACLE_WITH_MEDIANS
+    if (medians_active) {
+      update_medians(owner, value, itr);
     }
-    else if (itr->bounty_awarded == false && itr->bounty_amount < one_larimer)  {
+#endif
+  }
+}
 
-      //global donation to the contract, split between top oracles across all pairs
-      pairs.modify(*itr, _self, [&]( auto& s ) {
-        s.bounty_awarded = true;
-      });
+//give a live pair that has none an ordinal for writepacked; pairs activated
+//by votes get one then
+ACTION delphioracle::addordinal(name pair) {
+  require_auth(_self);
+
+  pairstable pairs(_self, _self.value);
+  auto pitr = pairs.find(pair.value);
+  check(pitr != pairs.end() && pitr->active, "pair not active");
+  check(!pitr->ordinal.has_value(), "pair already has an ordinal");
+
+  assign_ordinal(pairs, pitr);
+}
+
+//Write a batch of reports signed off-chain, relayed by any account
+ACTION delphioracle::writeagg(const name relayer, const std::vector<report>& reports) {
+  require_auth(relayer);
+
+  check(reports.size() > 0, "must supply non-empty array of reports");
+
+  globaltable gtable(_self, _self.value);
+  const auto& config = *gtable.begin();
+
+  statstable stable(_self, _self.value);
+  pairstable pairs(_self, _self.value);
+  oraclekeystable keys(_self, _self.value);
+
+  check(config.chain_id.has_value(), "chain id not set, see setchain");
+  const checksum256 chain_id = *config.chain_id;
+
+  const time_point now = current_time_point();
+
+#if DELPHIORACLE_WITH_MEDIANS
+  const bool medians_active = is_medians_active();
+  if (medians_active) {
+    _is_active_current_week_cashe = is_active_current_week();
+  }
+#endif
+
+  scratch_scope scope;
+  scratch_vector<name> oracles;
+  oracles.reserve(config.minimum_rank + 1);
+  qualified_oracles(config.minimum_rank, oracles);
+
+  //reports come grouped by pair, so each pair's window is updated once
+  const report* first = reports.data();
+  const report* end = reports.data() + reports.size();
+  while (first != end) {
+    auto itr = pairs.find(first->pair.value);
+    check(itr != pairs.end() && itr->active == true, "pair not allowed");
+#if DELPHIORACLE_WITH_REWARDS
+    close_spent_bounty(pairs, itr);
+#endif
+
+    const report* last = first;
+    for (; last != end && last->pair == first->pair; ++last) {
+      check(std::binary_search(oracles.begin(), oracles.end(), last->owner), "account is not a qualified oracle");
+
+      auto kitr = keys.find(last->owner.value);
+      check(kitr != keys.end(), "oracle has no registered key");
+      assert_recover_key(report_digest(chain_id, *last), last->sig, kitr->key);
+
+      //a report is good for one cooldown, during which the oracle cannot
+      //push again, so it cannot be replayed
+      check(last->timestamp <= now && now - last->timestamp < microseconds(config.write_cooldown), "report is stale");
+      check_last_push(last->owner, *itr, config, stable, last->value);
     }
+    check(last == end || first->pair < last->pair, "reports must be sorted by pair");
+
+    uint64_t median = update_datapoints(first, last, itr, gtable);
+    notify_subscribers(first->pair, median);
+#if DELPHIORACLE_WITH_MEDIANS
+    if (medians_active) {
+      for (auto r = first; r != last; ++r)
+        update_medians(r->owner, r->value, itr);
+    }
+#endif
+
+    first = last;
+  }
+}
+
+//register the key an oracle signs writeagg reports with
+ACTION delphioracle::setkey(name owner, public_key key) {
+  require_auth(owner);
 
-    update_datapoints(owner, quotes[i].value, itr);
-    update_medians(owner, quotes[i].value, itr);
+  oraclekeystable keys(_self, _self.value);
+  auto itr = keys.find(owner.value);
+
+  if (itr != keys.end()) {
+    keys.modify(itr, same_payer, [&](auto& s) {
+      s.key = key;
+    });
+  } else {
+    keys.emplace(owner, [&](auto& s) {
+      s.owner = owner;
+      s.key = key;
+    });
   }
 }
 
+//record the id of the chain the contract runs on, which writeagg reports
+//are signed for
+ACTION delphioracle::setchain(checksum256 chain_id) {
+  require_auth(_self);
+
+  globaltable gtable(_self, _self.value);
+  gtable.modify(gtable.begin(), _self, [&](auto& g) {
+    g.fill_extensions();
+    g.chain_id = chain_id;
+  });
+}
+
+#if DELPHIORACLE_WITH_REWARDS
 //claim rewards
 ACTION delphioracle::claim(name owner) {
   require_auth(owner);
@@ -95,9 +289,14 @@ ACTION delphioracle::claim(name owner) {
   auto gitr = gtable.begin();
 
   check(itr != sstore.end(), "oracle not found");
-  check( itr->balance.amount > 0, "no rewards to claim" );
 
-  asset payout = itr->balance;
+  pairstable pairs(_self, _self.value);
+  scratch_scope scope;
+  scratch_vector<name> open;
+  open_bounties(pairs, open);
+
+  asset payout = itr->balance + settle_bounties(owner, pairs, open);
+  check( payout.amount > 0, "no rewards to claim" );
 
   sstore.modify( *itr, _self, [&]( auto& a ) {
       a.balance = asset(0, symbol("TLOS", 4));
@@ -116,9 +315,112 @@ ACTION delphioracle::claim(name owner) {
   act.send();
 }
 
+//pay out the balances of up to max_oracles oracles, resuming where the last
+//batch stopped; anyone can call it
+ACTION delphioracle::payout(uint64_t max_oracles, asset min_balance) {
+  check(max_oracles > 0 && max_oracles <= 100, "must pay between 1 and 100 oracles per batch");
+  check(min_balance.symbol == tlos_symbol && min_balance.amount > 0, "minimum balance must be a positive TLOS amount");
+
+  globaltable gtable(_self, _self.value);
+  statstable sstore(_self, _self.value);
+  pairstable pairs(_self, _self.value);
+
+  auto gitr = gtable.begin();
+  const time_point now = current_time_point();
+
+  scratch_scope scope;
+  scratch_vector<name> open;
+  open_bounties(pairs, open);
+
+  asset total = asset(0, tlos_symbol);
+  uint64_t scanned = 0;
+  auto itr = sstore.lower_bound(gitr->payout_cursor.value_or(0));
+
+  for (; itr != sstore.end() && scanned < max_oracles; ++itr, ++scanned) {
+    asset amount = itr->balance + settle_bounties(itr->owner, pairs, open);
+    if (amount < min_balance) {
+      if (amount != itr->balance)
+        sstore.modify(itr, _self, [&]( auto& a ) { a.balance = amount; });
+      continue;
+    }
+
+    sstore.modify(itr, _self, [&]( auto& a ) {
+      a.balance = asset(0, tlos_symbol);
+      a.last_claim = now;
+    });
+    total += amount;
+
+    action act(
+      permission_level{_self, "active"_n},
+      "eosio.token"_n, "transfer"_n,
+      std::make_tuple(_self, itr->owner, amount, std::string("oracle rewards"))
+    );
+    act.send();
+  }
+
+  //one update of the global row per batch
+  const uint64_t next = itr == sstore.end() ? 0 : itr->owner.value;
+  gtable.modify(gitr, _self, [&]( auto& a ) {
+    a.total_claimed += total;
+    a.payout_cursor = next;
+  });
+}
+
+//fold up to max_rows of a donor's donation rows from before donortotals
+//into the totals, releasing all but the most recent; anyone can call it
+delphioracle::compaction delphioracle::compactdons(name donor, uint64_t max_rows) {
+  check(max_rows > 0 && max_rows <= 500, "must compact between 1 and 500 rows per call");
+
+  donationstable donations(_self, donor.value);
+  donortotalstable totals(_self, donor.value);
+
+  compaction result{donor, 0, 0, 0, true};
+  if (donations.begin() == donations.end())
+    return result;
+
+  //ids are consecutive per donor, so the span of ids is the row count
+  auto newest = donations.end();
+  newest--;
+  uint64_t kept_from = newest->id >= recent_donations ? newest->id - recent_donations + 1 : 0;
+
+  //kept rows already folded are only read, and there are few of them
+  auto itr = donations.begin();
+  uint64_t changed = 0;
+  for (;; changed++) {
+    while (itr != donations.end() && itr->folded.value_or(false) && itr->id >= kept_from)
+      ++itr;
+    if (itr == donations.end() || changed == max_rows)
+      break;
+
+    if (!itr->folded.value_or(false)) {
+      result.ram_reclaimed -= fold_donation(totals, itr->pair, itr->amount, itr->timestamp);
+      result.folded++;
+    }
+
+    if (itr->id < kept_from) {
+      result.ram_reclaimed += int64_t(pack_size(*itr)) + 2 * row_overhead_bytes;
+      result.erased++;
+      itr = donations.erase(itr);
+    } else {
+      if (!itr->folded.value_or(false)) {
+        donations.modify(itr, same_payer, [&](auto& o) {
+          o.folded = true;
+        });
+        result.ram_reclaimed -= 1;
+      }
+      ++itr;
+    }
+  }
+
+  result.done = itr == donations.end();
+  return result;
+}
+#endif
+
 //temp configuration
 ACTION delphioracle::configure(globalinput g) {
   require_auth(_self);
+  check(g.datapoints_per_instrument > 0, "the datapoints window must hold at least one point");
 
   globaltable gtable(_self, _self.value);
   pairstable pairs(_self, _self.value);
@@ -176,28 +478,392 @@ ACTION delphioracle::configure(globalinput g) {
         o.quoted_precision = 4;
       });
 
-      datapointstable dstore(_self, name("tlosusd"_n).value);
+      allocate_pair("tlosusd"_n, _self, gtable.begin()->datapoints_per_instrument);
+      assign_ordinal(pairs, pairs.find("tlosusd"_n.value));
+  }
+}
 
-      //First data point starts at uint64 max
-      uint64_t primary_key = 0;
-      for (uint16_t i = 0; i < 21; i++) {
-        //Insert next datapoint
-        auto c_itr = dstore.emplace(_self, [&](auto& s) {
-          s.id = primary_key;
-          s.value = 0;
-          s.timestamp = NULL_TIME_POINT;
-        });
+//Read-only: quantiles, spread and median absolute deviation of the live window.
+//Each pair is one ordered walk of the value index; nothing is written.
+std::vector<delphioracle::pairquantiles> delphioracle::getquantiles(const std::vector<name>& pairs, const std::vector<uint16_t>& points_bps) {
+  check(pairs.size() > 0 && pairs.size() <= 32, "must supply between 1 and 32 pairs");
+  check(points_bps.size() <= 16, "at most 16 quantiles per query");
+  for (auto bps : points_bps)
+    check(bps <= 10000, "quantile points must be in basis points (0-10000)");
+
+  globaltable gtable(_self, _self.value);
+  pairstable ptable(_self, _self.value);
+  const time_point now = current_time_point();
+
+  std::vector<pairquantiles> result;
+  result.reserve(pairs.size());
+
+  std::vector<uint64_t> window;
+  std::vector<uint64_t> deviations;
+
+  for (const auto& pair : pairs) {
+    auto pitr = ptable.find(pair.value);
+    check(pitr != ptable.end(), "pair not found");
+    const time_point cutoff = stale_before(*pitr, *gtable.begin(), now);
+
+    datapointstable dstore(_self, pair.value);
+    auto value_sorted = dstore.get_index<"value"_n>();
+
+    window.clear();
+    for (auto itr = value_sorted.begin(); itr != value_sorted.end(); ++itr) {
+      if (itr->timestamp > cutoff)
+        window.push_back(itr->value);
+    }
+
+    pairquantiles q{ pair, window.size() };
+    if (!window.empty()) {
+      q.median = window_quantile(window, 5000);
+      q.spread = window.back() - window.front();
+
+      q.quantiles.reserve(points_bps.size());
+      for (auto bps : points_bps)
+        q.quantiles.push_back(window_quantile(window, bps));
+
+      deviations.clear();
+      for (auto value : window)
+        deviations.push_back(value > q.median ? value - q.median : q.median - value);
+      std::sort(deviations.begin(), deviations.end());
+      q.mad = window_quantile(deviations, 5000);
+    } else {
+      q.quantiles.assign(points_bps.size(), 0);
+    }
+
+    result.push_back(std::move(q));
+  }
+
+  return result;
+}
+
+//set how sparsely oracles write a pair; a zero heartbeat has them write every cooldown
+ACTION delphioracle::setband(name pair, uint64_t deviation_bps, uint32_t heartbeat) {
+  require_auth(_self);
+
+  check(deviation_bps <= 10000, "deviation must be in basis points (0-10000)");
+  check(deviation_bps == 0 || heartbeat > 0, "a deviation needs a heartbeat");
+
+  globaltable gtable(_self, _self.value);
+  check(heartbeat == 0 || uint64_t(heartbeat) * 1000000 >= gtable.begin()->write_cooldown,
+    "heartbeat must not be shorter than the write cooldown");
+
+  pairstable pairs(_self, _self.value);
+  auto itr = pairs.find(pair.value);
+  check(itr != pairs.end(), "pair not found");
+
+  pairs.modify(itr, same_payer, [&](auto& s) {
+    s.deviation_bps = deviation_bps;
+    s.heartbeat = heartbeat;
+  });
+}
+
+//subscribe a consumer contract to a pair's median, or change its thresholds
+ACTION delphioracle::subscribe(name consumer, name pair, uint64_t deviation_bps, uint32_t heartbeat) {
+  require_auth(consumer);
+
+  check(deviation_bps <= 10000, "deviation must be in basis points (0-10000)");
+  check(deviation_bps > 0 || heartbeat > 0, "must set a deviation or a heartbeat");
+
+  pairstable pairs(_self, _self.value);
+  auto pitr = pairs.find(pair.value);
+  check(pitr != pairs.end() && pitr->active == true, "pair not active");
+
+  subscriberstable subs(_self, pair.value);
+  auto itr = subs.find(consumer.value);
+
+  if (itr != subs.end()) {
+    subs.modify(itr, same_payer, [&](auto& s) {
+      s.deviation_bps = deviation_bps;
+      s.heartbeat = heartbeat;
+    });
+    return;
+  }
+
+  //a consumer's handler runs inside every write of the pair and can make it
+  //fail, so the contract account approves each new consumer
+  check(has_auth(_self), "a new subscription needs the approval of the contract account");
+  check(uint64_t(std::distance(subs.begin(), subs.end())) < max_subscribers, "pair has the maximum number of subscribers");
+
+  //consumer pays the RAM for its row
+  subs.emplace(consumer, [&](auto& s) {
+    s.consumer = consumer;
+    s.deviation_bps = deviation_bps;
+    s.heartbeat = heartbeat;
+    s.last_median = 0;
+    s.last_notified = NULL_TIME_POINT;
+  });
+}
+
+//unsubscribe a consumer; the contract can evict one whose handler fails writes
+ACTION delphioracle::unsubscribe(name consumer, name pair) {
+  check(has_auth(_self) || has_auth(consumer), "missing required authority of contract or consumer");
 
-        primary_key++;
+  subscriberstable subs(_self, pair.value);
+  auto itr = subs.find(consumer.value);
+  check(itr != subs.end(), "not subscribed");
+  subs.erase(itr);
+}
+
+//sent inline by write to the consumers due a notification
+ACTION delphioracle::pricechange(name pair, uint64_t median, time_point timestamp, const std::vector<name>& consumers) {
+  require_auth(_self);
+
+  for (auto consumer : consumers)
+    require_recipient(consumer);
+}
+
+//derive the rate of base in quote through at most max_hops active pairs. A
+//payer caches the result in crossrates; with no payer nothing is written,
+//so it can be sent as a read-only transaction
+delphioracle::crossrate delphioracle::getcross(name payer, symbol_code base, symbol_code quote, uint8_t max_hops) {
+  check(max_hops > 0 && max_hops <= max_cross_hops, "max_hops must be between 1 and 3");
+  check(base != quote, "base and quote must differ");
+  if (payer != name())
+    require_auth(payer);
+
+  pairstable pairs(_self, _self.value);
+  crossratestable cache(_self, base.raw());
+  auto citr = cache.find(quote.raw());
+
+  //one step of the path: the pair, whether it is walked from its base to its
+  //quote, and its last datapoint
+  struct hop {
+    name pair;
+    bool forward;
+    uint64_t precision;
+    uint64_t median;
+    time_point timestamp;
+  };
+
+  scratch_scope scope;
+  scratch_vector<hop> path;
+
+  //a cached path is reused while its pairs are active; if none of them was
+  //written since, so is its rate
+  if (citr != cache.end() && citr->path.size() <= max_hops) {
+    symbol_code at = base;
+    bool current = true;
+    for (size_t i = 0; i < citr->path.size(); ++i) {
+      auto pitr = pairs.find(citr->path[i].value);
+      if (pitr == pairs.end() || !pitr->active) {
+        path.clear();
+        break;
       }
+      bool forward = pitr->base_symbol.code() == at;
+      at = forward ? pitr->quote_symbol.code() : pitr->base_symbol.code();
 
-      {
-        make_records_for_medians_table(median_types::day,          "tlosusd"_n, get_self(), medians());
-        make_records_for_medians_table(median_types::current_week, "tlosusd"_n, get_self(), medians());
-        make_records_for_medians_table(median_types::week,         "tlosusd"_n, get_self(), medians());
-        make_records_for_medians_table(median_types::month,        "tlosusd"_n, get_self(), medians());
+      auto latest = latest_datapoint(pitr->name);
+      current = current && latest.timestamp == citr->updated[i];
+      path.push_back({pitr->name, forward, pitr->quoted_precision, latest.median, latest.timestamp});
+    }
+
+    if (current && !path.empty()) {
+      crossrate result{base, quote, citr->rate, citr->precision, citr->path, citr->updated[0], true};
+      for (auto& t : citr->updated)
+        result.timestamp = std::min(result.timestamp, t);
+      return result;
+    }
+  }
+
+  if (path.empty()) {
+    //breadth first over the symbol graph of the active pairs, so the path
+    //found has the fewest hops
+    struct edge { name pair; symbol_code base; symbol_code quote; uint64_t precision; };
+    struct node { symbol_code symbol; uint32_t parent; uint32_t edge; uint8_t hops; };
+
+    scratch_vector<edge> edges;
+    for (auto itr = pairs.begin(); itr != pairs.end(); ++itr) {
+      if (itr->active)
+        edges.push_back({itr->name, itr->base_symbol.code(), itr->quote_symbol.code(), itr->quoted_precision});
+    }
+
+    scratch_vector<node> nodes;
+    nodes.push_back({base, 0, 0, 0});
+    size_t found = 0;
+    for (size_t i = 0; i < nodes.size() && found == 0; ++i) {
+      if (nodes[i].hops == max_hops)
+        break;
+      for (size_t e = 0; e < edges.size() && found == 0; ++e) {
+        symbol_code next;
+        if (edges[e].base == nodes[i].symbol) next = edges[e].quote;
+        else if (edges[e].quote == nodes[i].symbol) next = edges[e].base;
+        else continue;
+
+        bool seen = false;
+        for (auto& n : nodes)
+          seen = seen || n.symbol == next;
+        if (seen)
+          continue;
+
+        nodes.push_back({next, uint32_t(i), uint32_t(e), uint8_t(nodes[i].hops + 1)});
+        if (next == quote)
+          found = nodes.size() - 1;
       }
+    }
+    check(found != 0, "no path between base and quote within max_hops");
+
+    path.resize(nodes[found].hops);
+    for (size_t n = found, i = path.size(); n != 0; n = nodes[n].parent) {
+      auto& e = edges[nodes[n].edge];
+      auto latest = latest_datapoint(e.pair);
+      path[--i] = {e.pair, e.base == nodes[nodes[n].parent].symbol, e.precision, latest.median, latest.timestamp};
+    }
+  }
+
+  //fixed point in 128 bits, with 6 guard digits below the result's precision
+  auto pow10 = [](uint64_t e) {
+    unsigned __int128 p = 1;
+    while (e--) p *= 10;
+    return p;
+  };
+  constexpr uint64_t guard_digits = 6;
+  constexpr unsigned __int128 max_rate = ~(unsigned __int128)0;
+
+  uint64_t precision = 0;
+  for (auto& h : path) {
+    //the message names the pair, so it is only built when it is thrown
+    if (h.median == 0)
+      check(false, "pair " + h.pair.to_string() + " has no price yet");
+    precision = std::max(precision, h.precision);
+  }
+  check(precision <= 18, "cross rate precision too high");
+
+  unsigned __int128 rate = pow10(precision + guard_digits);
+  for (auto& h : path) {
+    unsigned __int128 num = h.forward ? h.median : pow10(h.precision);
+    unsigned __int128 den = h.forward ? pow10(h.precision) : h.median;
+    check(rate <= max_rate / num, "cross rate out of range");
+    rate = rate * num / den;
+  }
+  rate = (rate + pow10(guard_digits) / 2) / pow10(guard_digits);
+  check(rate <= UINT64_MAX, "cross rate out of range");
+
+  crossrate result{base, quote, uint64_t(rate), uint8_t(precision), {}, path[0].timestamp, false};
+  std::vector<time_point> updated;
+  for (auto& h : path) {
+    result.path.push_back(h.pair);
+    updated.push_back(h.timestamp);
+    result.timestamp = std::min(result.timestamp, h.timestamp);
+  }
+
+  if (payer != name()) {
+    auto store = [&](auto& o) {
+      o.quote = quote;
+      o.rate = result.rate;
+      o.precision = result.precision;
+      o.path = result.path;
+      o.updated = updated;
+    };
+    if (citr == cache.end())
+      cache.emplace(payer, store);
+    else
+      cache.modify(citr, same_payer, store);
+  }
+
+  return result;
+}
+
+//RAM billed for each pair's rows, by table and scope. It writes nothing, so
+//it can be sent as a read-only transaction
+std::vector<delphioracle::pairram> delphioracle::getram(const std::vector<name>& pairs) {
+  pairstable ptable(_self, _self.value);
+
+  std::vector<pairram> result;
+  for (auto pair : pairs) {
+    auto pitr = ptable.find(pair.value);
+    if (pitr == ptable.end())
+      check(false, "pair " + pair.to_string() + " not found");
+
+    pairram r{pair, int64_t(pack_size(*pitr)) + row_overhead_bytes, {{"pairs"_n, _self, 1, 0}}};
+    r.tables[0].bytes = r.bytes;
+    r.tables.push_back(table_ram(datapointstable(_self, pair.value), "datapoints"_n, pair, 2));
+    r.tables.push_back(table_ram(statstable(_self, pair.value), "stats"_n, pair, 1));
+    r.tables.push_back(table_ram(subscriberstable(_self, pair.value), "subscribers"_n, pair, 0));
+#if DELPHIORACLE_WITH_MEDIANS
+    r.tables.push_back(table_ram(medianstable(_self, pair.value), "medians"_n, pair, 1));
+#endif
+    for (size_t i = 1; i < r.tables.size(); ++i)
+      r.bytes += r.tables[i].bytes;
+    result.push_back(r);
+  }
+  return result;
+}
+
+ACTION delphioracle::setretire(uint64_t retire_after) {
+  require_auth(_self);
+
+  globaltable gtable(_self, _self.value);
+  auto gitr = gtable.begin();
+  check(retire_after == 0 || retire_after * 1000000 > gitr->write_cooldown, "retire_after must be longer than the write cooldown");
+
+  gtable.modify(gitr, _self, [&](auto& g) {
+    g.fill_extensions();
+    g.retire_after = retire_after;
+  });
+}
+
+//retire a pair nobody has written to for retire_after seconds; anyone can
+//call it. The first call stops writes and records the last price in
+//tombstones, then each call releases up to max_rows of the pair's rows, and
+//the last one erases the pair
+ACTION delphioracle::retire(name pair, uint64_t max_rows) {
+  check(max_rows > 0 && max_rows <= 500, "must release between 1 and 500 rows per call");
+
+  globaltable gtable(_self, _self.value);
+  pairstable pairs(_self, _self.value);
+  tombstonestable tombstones(_self, _self.value);
+
+  auto pitr = pairs.find(pair.value);
+  check(pitr != pairs.end(), "pair not found");
+
+  auto titr = tombstones.find(pair.value);
+  if (titr == tombstones.end()) {
+    const uint64_t retire_after = gtable.begin()->retire_after.value_or(0);
+    check(retire_after > 0, "retiring pairs is disabled");
+    check(pitr->active, "only active pairs are retired, cancel the bounty instead");
+#if DELPHIORACLE_WITH_REWARDS
+    //without rewards no bounty is paid, so none is owed
+    check(pitr->bounty_awarded, "pair still owes its bounty to oracles");
+#endif
+
+    auto latest = latest_datapoint(pair);
+    const time_point now = current_time_point();
+    check(now - latest.timestamp >= seconds(int64_t(retire_after)), "pair was written to recently");
+
+    tombstones.emplace(_self, [&](auto& t) {
+      t.pair = pair;
+      t.base_symbol = pitr->base_symbol;
+      t.quote_symbol = pitr->quote_symbol;
+      t.quoted_precision = pitr->quoted_precision;
+      t.median = latest.median;
+      t.timestamp = latest.timestamp;
+      t.retired = now;
+    });
+
+    pairs.modify(pitr, same_payer, [&](auto& p) {
+      p.active = false;
+    });
   }
+
+  uint64_t budget = max_rows;
+  subscriberstable subs(_self, pair.value);
+  budget -= erase_rows(subs, budget);
+  datapointstable dstore(_self, pair.value);
+  budget -= erase_rows(dstore, budget);
+#if DELPHIORACLE_WITH_MEDIANS
+  medianstable medians_table(_self, pair.value);
+  budget -= erase_rows(medians_table, budget);
+#endif
+  statstable lstore(_self, pair.value);
+  budget -= erase_rows(lstore, budget);
+
+  //the ordinals row stays, so its number is never handed out again and an
+  //oracle still packing it gets "pair not allowed"
+  if (budget > 0)
+    pairs.erase(pitr);
 }
 
 //Delphi Oracle - Bounty logic
@@ -229,16 +895,23 @@ ACTION delphioracle::configure(globalinput g) {
 ACTION delphioracle::newbounty(name proposer, pairinput pair) {
   require_auth(proposer);
 
-  //Add request, proposer pays the RAM for the request + data structure for datapoints & bars.
+  //Add request, proposer pays the RAM for the pairs row only. The contract
+  //creates the datapoints and medians on its own RAM when the pair is
+  //activated.
 
   pairstable pairs(_self, _self.value);
-  datapointstable dstore(_self, pair.name.value);
 
   auto itr = pairs.find(pair.name.value);
 
   check(pair.name != "system"_n, "Cannot create a pair named system");
   check(itr == pairs.end(), "A pair with this name already exists.");
 
+  //a retired pair proposed again starts over
+  tombstonestable tombstones(_self, _self.value);
+  auto titr = tombstones.find(pair.name.value);
+  if (titr != tombstones.end())
+    tombstones.erase(titr);
+
   pairs.emplace(proposer, [&](auto& s) {
     s.proposer = proposer;
     s.name = pair.name;
@@ -250,26 +923,6 @@ ACTION delphioracle::newbounty(name proposer, pairinput pair) {
     s.quote_contract = pair.quote_contract;
     s.quoted_precision = pair.quoted_precision;
   });
-
-  //First data point starts at uint64 max
-  uint64_t primary_key = 0;
-  for (uint16_t i = 0; i < 21; i++) {
-    //Insert next datapoint
-    auto c_itr = dstore.emplace(proposer, [&](auto& s) {
-      s.id = primary_key;
-      s.value = 0;
-      s.timestamp = NULL_TIME_POINT;
-    });
-
-    primary_key++;
-  }
-
-  { // for get medians
-    make_records_for_medians_table(median_types::day,          pair.name, proposer, medians());
-    make_records_for_medians_table(median_types::current_week, pair.name, proposer, medians());
-    make_records_for_medians_table(median_types::week,         pair.name, proposer, medians());
-    make_records_for_medians_table(median_types::month,        pair.name, proposer, medians());
-  }
 }
 
 //cancel a bounty
@@ -285,6 +938,10 @@ ACTION delphioracle::cancelbounty(name name, std::string reason) {
   check(has_auth(_self) || has_auth(itr->proposer), "missing required authority of contract or proposer");
   check(itr->active == false, "cannot cancel live pair");
 
+  //a pair being retired is inactive too, but retire releases its rows
+  tombstonestable tombstones(_self, _self.value);
+  check(tombstones.find(name.value) == tombstones.end(), "pair is being retired, call retire instead");
+
   //Cancel bounty, post reason to chain.
 
   pairs.erase(itr);
@@ -296,7 +953,9 @@ ACTION delphioracle::cancelbounty(name name, std::string reason) {
   }
   //TODO: Refund accumulated bounty to balance of user
 
+#if DELPHIORACLE_WITH_MEDIANS
   erase_medians(name);
+#endif
 }
 
 //vote bounty
@@ -306,14 +965,17 @@ ACTION delphioracle::votebounty(name owner, name bounty) {
   pairstable pairs(_self, _self.value);
   auto pitr = pairs.find(bounty.value);
 
-  check(!pitr->active, "pair is already active.");
   check(pitr != pairs.end(), "bounty not found.");
+  check(!pitr->active, "pair is already active.");
+
+  tombstonestable tombstones(_self, _self.value);
+  check(tombstones.find(bounty.value) == tombstones.end(), "pair is being retired.");
 
   custodianstable custodians(_self, _self.value);
   auto itr = custodians.find(owner.value);
 
   bool vote_approved = false;
-  std::string err_msg = "";
+  const char* err_msg = "";
 
   //print("itr->name", itr->name, "\n");
 
@@ -321,15 +983,14 @@ ACTION delphioracle::votebounty(name owner, name bounty) {
     //voter is custodian
     //print("custodian found \n");
 
-    std::vector<eosio::name> cv = pitr->approving_custodians;
+    const auto& cv = pitr->approving_custodians;
     auto citr = find(cv.begin(), cv.end(), owner);
 
     //check(citr == cv.end(), "custodian already voting for bounty");
 
     if (citr == cv.end()) {
-      cv.push_back(owner);
       pairs.modify(*pitr, _self, [&]( auto& s ) {
-        s.approving_custodians = cv;
+        s.approving_custodians.push_back(owner);
       });
 
       //print("custodian added vote \n");
@@ -343,12 +1004,11 @@ ACTION delphioracle::votebounty(name owner, name bounty) {
   //print("checking oracle qualification... \n");
 
   if (check_approver(owner)) {
-    std::vector<eosio::name> ov = pitr->approving_oracles;
+    const auto& ov = pitr->approving_oracles;
     auto oitr = find(ov.begin(), ov.end(), owner);
     if (oitr == ov.end()) {
-      ov.push_back(owner);
       pairs.modify(*pitr, _self, [&]( auto& s ) {
-        s.approving_oracles = ov;
+        s.approving_oracles.push_back(owner);
       });
 
       //print("oracle added vote \n");
@@ -361,7 +1021,7 @@ ACTION delphioracle::votebounty(name owner, name bounty) {
   }
   else err_msg = "owner not a qualified oracle";
 
-  check(vote_approved, err_msg.c_str());
+  check(vote_approved, err_msg);
 
   globaltable gtable(_self, _self.value);
   auto gitr = gtable.begin();
@@ -376,6 +1036,9 @@ ACTION delphioracle::votebounty(name owner, name bounty) {
       pairs.modify(*pitr, _self, [&]( auto& s ) {
         s.active = true;
       });
+
+      allocate_pair(pitr->name, _self, gitr->datapoints_per_instrument);
+      assign_ordinal(pairs, pitr);
   }
 }
 
@@ -386,8 +1049,8 @@ ACTION delphioracle::unvotebounty(name owner, name bounty) {
   pairstable pairs(_self, _self.value);
   auto pitr = pairs.find(bounty.value);
 
-  check(!pitr->active, "pair is already active.");
   check(pitr != pairs.end(), "bounty not found.");
+  check(!pitr->active, "pair is already active.");
 
   custodianstable custodians(_self, _self.value);
   auto itr = custodians.find(owner.value);
@@ -397,13 +1060,11 @@ ACTION delphioracle::unvotebounty(name owner, name bounty) {
     //voter is custodian
     //print("custodian found \n");
 
-    std::vector<eosio::name> cv = pitr->approving_custodians;
-    auto citr = find(cv.begin(), cv.end(), owner);
-    check(citr != cv.end(), "custodian is not voting for bounty");
-    cv.erase(citr);
+    const auto& cv = pitr->approving_custodians;
+    check(find(cv.begin(), cv.end(), owner) != cv.end(), "custodian is not voting for bounty");
 
     pairs.modify(*pitr, _self, [&]( auto& s ) {
-      s.approving_oracles = cv;
+      s.approving_custodians.erase(find(s.approving_custodians.begin(), s.approving_custodians.end(), owner));
     });
 
     //print("custodian removed vote \n");
@@ -412,13 +1073,11 @@ ACTION delphioracle::unvotebounty(name owner, name bounty) {
 
     //check(check_approver(owner), "owner not a qualified oracle"); // not necessary
 
-    std::vector<eosio::name> ov = pitr->approving_oracles;
-    auto oitr = find(ov.begin(), ov.end(), owner);
-    check(oitr != ov.end(), "not an oracle or oracle is not voting for bounty");
-    ov.erase(oitr);
+    const auto& ov = pitr->approving_oracles;
+    check(find(ov.begin(), ov.end(), owner) != ov.end(), "not an oracle or oracle is not voting for bounty");
 
     pairs.modify(*pitr, _self, [&]( auto& s ) {
-      s.approving_oracles = ov;
+      s.approving_oracles.erase(find(s.approving_oracles.begin(), s.approving_oracles.end(), owner));
     });
 
     //print("oracle removed vote \n");
@@ -445,6 +1104,7 @@ ACTION delphioracle::delcustodian(name name) {
   custodians.erase(itr);
 }
 
+#if DELPHIORACLE_WITH_REWARDS
 //registers a user
 ACTION delphioracle::reguser(name owner) {
   require_auth(owner);
@@ -452,28 +1112,33 @@ ACTION delphioracle::reguser(name owner) {
     create_user( owner );
 }
 
-//updates all users voting scores
-//run at some random interval daily
-ACTION delphioracle::updateusers() {
+//refreshes the stale scores among the next max_users users, resuming where
+//the last batch stopped. Scores are also refreshed as they are read, so
+//this only keeps the score index of quiet users from drifting
+ACTION delphioracle::updateusers(uint64_t max_users) {
   require_auth( _self );
+  check(max_users > 0 && max_users <= 500, "must visit between 1 and 500 users per batch");
 
+  globaltable gtable(_self, _self.value);
   userstable users(_self, _self.value);
-  voters_table vtable("eosio"_n, name("eosio").value);
 
-  for(auto itr = users.begin(); itr != users.end(); ++itr) {
-    // add proxy score
-    auto v_itr = vtable.find(itr->name.value);
-    auto score = itr->score;
-
-    if( v_itr != vtable.end() && v_itr->proxy == _self) {
-      score += v_itr->staked;
-    }
+  auto gitr = gtable.begin();
+  const time_point now = current_time_point();
 
-    users.modify(*itr, _self, [&]( auto& o ) {
-      o.score = score;
-    });
+  uint64_t visited = 0;
+  auto itr = users.lower_bound(gitr->users_cursor.value_or(0));
+  for (; itr != users.end() && visited < max_users; ++itr, ++visited) {
+    if (score_stale(*itr, now))
+      refresh_user(users, itr);
   }
+
+  const uint64_t next = itr == users.end() ? 0 : itr->name.value;
+  gtable.modify(gitr, _self, [&](auto& g) {
+    g.fill_extensions();
+    g.users_cursor = next;
+  });
 }
+#endif
 
 //Clear all data
 ACTION delphioracle::clear(name pair) {
@@ -485,6 +1150,13 @@ ACTION delphioracle::clear(name pair) {
   datapointstable estore(_self,  pair.value);
   pairstable pairs(_self, _self.value);
   custodianstable ctable(_self, _self.value);
+  subscriberstable subs(_self, pair.value);
+
+  while (subs.begin() != subs.end()) {
+      auto itr = subs.end();
+      itr--;
+      subs.erase(itr);
+  }
 
   while (ctable.begin() != ctable.end()) {
       auto itr = ctable.end();
@@ -523,37 +1195,24 @@ ACTION delphioracle::clear(name pair) {
   }
 }
 
+#if DELPHIORACLE_WITH_REWARDS
 ACTION delphioracle::voteabuser(const name owner, const name abuser) {
   require_auth(owner);
   check(check_oracle(abuser), "abuser is not a qualified oracle");
 
-  donationstable donations(_self, owner.value);
-  voters_table vtable("eosio"_n, name("eosio").value);
-
-  // donations
-  auto d_idx = donations.get_index<"donator"_n>();
-  auto d_itr = d_idx.find(owner.value);
-
-  auto total_donated = 0;
-  while (d_itr->donator == owner && d_itr != d_idx.end()) {
-    total_donated += d_itr->amount.amount;
-    d_itr++;
-  }
-
-  auto v_itr = vtable.find(owner.value);
-
-  // proxy voting
-  auto total_proxied = 0;
-  if( v_itr != vtable.end() && v_itr->proxy == _self) {
-    total_proxied += v_itr->staked;
-  }
+  // donations plus the stake proxied to the contract, cached on the user
+  // and only looked up again once stale
+  userstable users(_self, _self.value);
+  auto uitr = users.find(owner.value);
+  const uint64_t score = uitr != users.end() ? refresh_user(users, uitr) : donated_by(owner) + proxied_by(owner);
 
-  // TODO: verify user object exists and user has some voting score
-  check(total_donated > 0 || total_proxied > 0, "user must donate or proxy vote to delphioracle to vote for abusers");
+  check(score > 0, "user must donate or proxy vote to delphioracle to vote for abusers");
   //print("user: ", owner, " is voting for abuser: ", abuser, " with total stake: ", total_donated + total_proxied);
   // store data for abuse vote
 }
+#endif
 
+#if DELPHIORACLE_WITH_MEDIANS
 ACTION delphioracle::makemedians() {
   require_auth(get_self());
 
@@ -563,10 +1222,38 @@ ACTION delphioracle::makemedians() {
   
   pairstable pairs(_self, _self.value);
   for (auto itr = pairs.begin(); itr != pairs.end(); ++itr) {
-    make_records_for_medians_table(median_types::day,          itr->name, get_self(), medians());
-    make_records_for_medians_table(median_types::current_week, itr->name, get_self(), medians());
-    make_records_for_medians_table(median_types::week,         itr->name, get_self(), medians());
-    make_records_for_medians_table(median_types::month,        itr->name, get_self(), medians());
+    //pairs not activated yet get theirs on activation
+    if (itr->active)
+      make_median_slots(itr->name, get_self());
+  }
+}
+
+//Tops up every median type to its slots, counting the pair's rows in a
+//single pass
+void delphioracle::make_median_slots(const name& pair, const name& payer) {
+  if (!is_medians_active()) {
+    return;
+  }
+
+  constexpr median_types types[] = {median_types::day, median_types::current_week, median_types::week, median_types::month};
+  uint8_t counts[4] = {};
+
+  medianstable medians_table(get_self(), pair.value);
+  for (auto itr = medians_table.begin(); itr != medians_table.end(); ++itr) {
+    for (size_t t = 0; t < 4; ++t) {
+      if (itr->type == medians::get_type(types[t]))
+        counts[t]++;
+    }
+  }
+
+  uint64_t id = medians_table.available_primary_key();
+  for (size_t t = 0; t < 4; ++t) {
+    for (auto counter = counts[t]; counter < median_slots(types[t]); ++counter) {
+      medians_table.emplace(payer, [&](auto& medians_obj) {
+        medians_obj.id = id++;
+        medians_obj.type = medians::get_type(types[t]);
+      });
+    }
   }
 }
 
@@ -581,8 +1268,8 @@ void delphioracle::make_records_for_medians_table(median_types type, const name&
       return medians_obj.type == medians::get_type(type); 
   });
 
-  if (count_type_elements != limits.at(type)) {
-    const auto need_make_elements = limits.at(type) - count_type_elements;
+  if (count_type_elements != median_slots(type)) {
+    const auto need_make_elements = median_slots(type) - count_type_elements;
     for (auto counter = 0; counter < need_make_elements; ++counter) {
       medians_table.emplace(payer, [&](auto& medians_obj) {
         medians_obj.id = medians_table.available_primary_key();
@@ -599,30 +1286,33 @@ const time_point delphioracle::get_round_up_current_time(median_types type) cons
   time_t current_time_sec = static_cast<time_t>(current_time_point().sec_since_epoch());
 
   if (!_is_active_current_week_cashe) {
-    current_time_sec += time_consts.at(median_types::day) * 20;
+    current_time_sec += median_period(median_types::day) * 20;
   }
 
+  return get_round_up_time(type, current_time_sec);
+}
+
+const time_point delphioracle::get_round_up_time(median_types type, time_t time_sec) const {
   auto get_type_time = [&]() -> time_point {
-  auto itr = time_consts.find(type);
-    if (itr != time_consts.end()) {
-      auto remainder = current_time_sec % itr->second;
-      return time_point_sec(current_time_sec - remainder);
+    const auto period = median_period(type);
+    if (period != 0) {
+      auto remainder = time_sec % period;
+      return time_point_sec(time_sec - remainder);
     }
 
     return NULL_TIME_POINT;
   };
 
   auto get_type_month = [&]() -> time_point {
-    auto struct_current_time = custom_ctime::gmtime(&current_time_sec);
+    std::tm struct_current_time{};
+    check(custom_ctime::gmtime_r(&time_sec, &struct_current_time) != nullptr, "error get current month");
     
-    check(struct_current_time != nullptr, "error get current month");
-    
-    struct_current_time->tm_sec = 0; 
-    struct_current_time->tm_min = 0;
-    struct_current_time->tm_hour = 0;
-    struct_current_time->tm_mday = 1; 
+    struct_current_time.tm_sec = 0; 
+    struct_current_time.tm_min = 0;
+    struct_current_time.tm_hour = 0;
+    struct_current_time.tm_mday = 1; 
 
-    auto current_time = custom_ctime::mktime(struct_current_time);
+    auto current_time = custom_ctime::mktime(&struct_current_time);
     return time_point_sec(static_cast<int32_t>(current_time));
   };
 
@@ -646,30 +1336,26 @@ bool delphioracle::is_in_time_range(median_types type, const time_point& start_t
   const time_point& time_value, bool is_previous_value) const {
   time_point select_time_value = time_value;
 
-  auto is_in_time_consts_range = [&]() {
-    auto itr = time_consts.find(type);
-    if (itr != time_consts.end()) {
+  auto is_in_period_range = [&]() {
+    const auto period = median_period(type);
+    if (period != 0) {
       if (is_previous_value) {
-        select_time_value -= seconds(itr->second);
+        select_time_value -= seconds(period);
       }
-      time_point end_time_range = start_time_range + time_point(seconds(itr->second));
+      time_point end_time_range = start_time_range + time_point(seconds(period));
       return (start_time_range <= select_time_value) && (select_time_value < end_time_range);
     }
     return false;
   };
 
   auto is_in_time_month_range = [&]() {
-    std::tm* result = nullptr;
-    
+    std::tm struct_current_time{};
     time_t current_time_sec = static_cast<time_t>(select_time_value.sec_since_epoch());
-    result = custom_ctime::gmtime(&current_time_sec);
-    check(result != nullptr, "error get current time in range");
-    auto struct_current_time = *result;
+    check(custom_ctime::gmtime_r(&current_time_sec, &struct_current_time) != nullptr, "error get current time in range");
 
+    std::tm struct_start_time_range{};
     time_t start_time_range_sec = static_cast<time_t>(start_time_range.sec_since_epoch());
-    result = custom_ctime::gmtime(&start_time_range_sec);
-    check(result != nullptr, "error get start time in range");
-    auto struct_start_time_range = *result;
+    check(custom_ctime::gmtime_r(&start_time_range_sec, &struct_start_time_range) != nullptr, "error get start time in range");
 
     return struct_start_time_range.tm_year == struct_current_time.tm_year 
         && struct_start_time_range.tm_mon  == struct_current_time.tm_mon 
@@ -679,13 +1365,13 @@ bool delphioracle::is_in_time_range(median_types type, const time_point& start_t
   switch (type)
   {
   case median_types::day:
-    return is_in_time_consts_range();
+    return is_in_period_range();
   case median_types::current_week:
-    return is_in_time_consts_range();
+    return is_in_period_range();
   case median_types::week:
-    return is_in_time_consts_range();
+    return is_in_period_range();
   case median_types::month:
-    return _is_active_current_week_cashe ? is_in_time_month_range() : is_in_time_consts_range();
+    return _is_active_current_week_cashe ? is_in_time_month_range() : is_in_period_range();
   default: {}
   }
 
@@ -702,19 +1388,102 @@ void delphioracle::erase_medians(const name& pair) {
   }
 }
 
+//write checks that medians are active and sets the current week flag once
+//for all of its quotes
 void delphioracle::update_medians(const name& owner, const uint64_t value, pairstable::const_iterator pair_itr) {  
-  if (!is_medians_active()) {
+  medianstable medians_table(get_self(), pair_itr->name.value);
+
+  if (medians_table.begin() != medians_table.end()) {
+    update_day_median(medians_table, owner, pair_itr->name, get_round_up_current_time(median_types::day), value);
+  }
+}
+
+//Only the day bucket is touched on write. A closed day stays in its slot until
+//rollmedians folds it into the coarser buckets; the write path only rolls up
+//itself when every day slot is still waiting.
+void delphioracle::update_day_median(medianstable& medians_table, const name& owner, const name& pair,
+  const time_point& median_timestamp, const uint64_t median_value) {
+
+  auto medians_timestamp_index = medians_table.get_index<"timestamp"_n>();
+
+  const auto day_type = medians::get_type(median_types::day);
+  const auto today = median_timestamp.sec_since_epoch();
+
+  for (auto itr = medians_timestamp_index.lower_bound(today); 
+    itr != medians_timestamp_index.end() && itr->by_timestamp() == today; ++itr) {
+    if (itr->type == day_type) {
+      medians_timestamp_index.modify(itr, owner, [&](medians &obj) {
+        obj.value += median_value;
+        obj.request_count += 1;
+        period_range::single(median_value).fold_into(obj, false);
+      });
+      return;
+    }
+  }
+
+  //empty slots sort first, then the oldest closed day
+  auto slot_itr = medians_timestamp_index.begin();
+  while (slot_itr != medians_timestamp_index.end() && slot_itr->type != day_type) {
+    ++slot_itr;
+  }
+
+  if (slot_itr == medians_timestamp_index.end()) {
     return;
   }
 
-  _is_active_current_week_cashe = is_active_current_week();
-  
-  medianstable medians_table(get_self(), pair_itr->name.value);
-  const auto count_elements = std::distance(medians_table.begin(), medians_table.end());
+  if (slot_itr->request_count != 0) {
+    rollup_day_median(medians_table, owner, pair, *slot_itr);
+  }
+
+  medians_timestamp_index.modify(slot_itr, owner, [&](medians &obj) {
+    obj.value = median_value;
+    obj.request_count = 1;
+    obj.timestamp = median_timestamp;
+    period_range::single(median_value).fold_into(obj, true);
+  });
+}
+
+//Fold one closed day into current_week/week/month and free its slot
+void delphioracle::rollup_day_median(medianstable& medians_table, const name& payer, const name& pair, const medians& day_median) {
+  const auto value = day_median.value;
+  const auto request_count = day_median.request_count;
+  const auto timestamp = day_median.timestamp;
+  const auto range = period_range::of(day_median);
 
-  if (count_elements > 0) {
-    update_medians_by_types(median_types::day, owner, pair_itr->name, get_round_up_current_time(median_types::day), value);
+  if (value != 0 && request_count != 0) {
+    for (auto type : GetUpdateMedians(median_types::day)) {
+      update_medians_by_types(medians_table, type, payer, pair, timestamp, value, request_count, range);
+    }
   }
+
+  medians_table.modify(day_median, payer, [&](medians &obj) {
+    obj.value = 0;
+    obj.request_count = 0;
+    obj.timestamp = NULL_TIME_POINT;
+  });
+}
+
+uint64_t delphioracle::rollup_medians(const name& payer, const name& pair, uint64_t max_days) {
+  const auto today = get_round_up_current_time(median_types::day);
+
+  medianstable medians_table(get_self(), pair.value);
+  auto medians_timestamp_index = medians_table.get_index<"timestamp"_n>();
+
+  uint64_t rolled = 0;
+  auto itr = medians_timestamp_index.begin();
+  while (itr != medians_timestamp_index.end() && rolled < max_days) {
+    if (itr->type != medians::get_type(median_types::day) || itr->request_count == 0 || itr->timestamp >= today) {
+      ++itr;
+      continue;
+    }
+
+    //folding can reorder the index, so restart from the oldest slot
+    rollup_day_median(medians_table, payer, pair, *itr);
+    rolled++;
+    itr = medians_timestamp_index.begin();
+  }
+
+  return rolled;
 }
 
 bool delphioracle::is_active_current_week() const {
@@ -728,10 +1497,10 @@ bool delphioracle::is_active_current_week() const {
   return false;
 }
 
-void delphioracle::update_medians_by_types(median_types type, const name& owner, const name& pair,
-  const time_point& median_timestamp, const uint64_t median_value, const uint64_t median_request_count) {
+void delphioracle::update_medians_by_types(medianstable& medians_table, median_types type, const name& owner, const name& pair,
+  const time_point& median_timestamp, const uint64_t median_value, const uint64_t median_request_count,
+  const period_range& range) {
 
-  medianstable medians_table(get_self(), pair.value);
   auto medians_timestamp_index = medians_table.get_index<"timestamp"_n>();
 
   struct short_type_medians {
@@ -739,7 +1508,10 @@ void delphioracle::update_medians_by_types(median_types type, const name& owner,
     time_point timestamp = NULL_TIME_POINT;
   };
 
-  std::vector<short_type_medians> short_medians_elements;
+  //recursion below opens nested scopes, which unwind in order
+  scratch_scope scope;
+  scratch_vector<short_type_medians> short_medians_elements;
+  short_medians_elements.reserve(median_slots(type));
   for (auto itr = medians_timestamp_index.begin(); itr != medians_timestamp_index.end(); ++itr) {
     if (itr->type == medians::get_type(type)) {
       short_type_medians obj{itr->id, itr->timestamp};
@@ -762,6 +1534,7 @@ void delphioracle::update_medians_by_types(median_types type, const name& owner,
         obj.value = median_value;
         obj.request_count = median_request_count;
         obj.timestamp = median_timestamp;
+        range.fold_into(obj, true);
       });
 
       break;
@@ -776,12 +1549,14 @@ void delphioracle::update_medians_by_types(median_types type, const name& owner,
       medians_table.modify(medians_table_index, owner, [&](medians &obj) {        
         obj.value += median_value;
         obj.request_count += median_request_count;
+        range.fold_into(obj, false);
       });
     } else {
       auto update_itr = medians_table.find(short_medians_elements.begin()->id);
       auto temp_medians_value = update_itr->value;
       auto temp_medians_timestamp = update_itr->timestamp;
       auto temp_medians_request_count = update_itr->request_count;
+      auto temp_medians_range = period_range::of(*update_itr);
 
       // TODO ingore this check, so we have only one record for day or current week
       if (type != median_types::day || type != median_types::current_week) { 
@@ -796,18 +1571,21 @@ void delphioracle::update_medians_by_types(median_types type, const name& owner,
           temp_medians_value = prev_medians_itr->value;
           temp_medians_timestamp = prev_medians_itr->timestamp;  
           temp_medians_request_count = prev_medians_itr->request_count; 
+          temp_medians_range = period_range::of(*prev_medians_itr);
         }
       }
 
       medians_table.modify(*update_itr, owner, [&](medians &obj) {
         obj.value = median_value;
         obj.request_count = median_request_count;
-        obj.timestamp = get_round_up_current_time(type);
+        obj.timestamp = get_round_up_time(type, static_cast<time_t>(median_timestamp.sec_since_epoch()));
+        range.fold_into(obj, true);
       });
 
       if (temp_medians_value != 0 && temp_medians_request_count != 0) {
         for (auto type : GetUpdateMedians(type)) {
-          update_medians_by_types(type, owner, pair, temp_medians_timestamp, temp_medians_value, temp_medians_request_count);
+          update_medians_by_types(medians_table, type, owner, pair, temp_medians_timestamp, temp_medians_value, temp_medians_request_count,
+                                  temp_medians_range);
         }
       }
     }
@@ -816,21 +1594,61 @@ void delphioracle::update_medians_by_types(median_types type, const name& owner,
   }
 }
 
-std::vector<median_types> delphioracle::GetUpdateMedians(median_types current_type) const {
-  using vect = std::vector<median_types>;
+delphioracle::median_cascade delphioracle::GetUpdateMedians(median_types current_type) const {
+  using vect = median_cascade;
   switch (current_type)
   {
     case median_types::day: // update for current_week, month - new implementation
       return _is_active_current_week_cashe ? 
-        vect{median_types::current_week, median_types::month} : vect{median_types::week};
+        vect{{median_types::current_week, median_types::month}, 2} : vect{{median_types::week}, 1};
     case median_types::current_week:
-      return vect{median_types::week};
+      return vect{{median_types::week}, 1};
     case median_types::week:
-      return _is_active_current_week_cashe ? vect() : vect{median_types::month};
+      return _is_active_current_week_cashe ? vect() : vect{{median_types::month}, 1};
     default: return vect();
   }
 }
 
+//Folds closed days into the week and month buckets. Anyone may call it; the
+//contract pays for the rows it touches.
+ACTION delphioracle::rollmedians(name pair, uint64_t max_days) {
+  check(max_days > 0, "max_days must be positive");
+
+  if (!is_medians_active()) {
+    return;
+  }
+
+  _is_active_current_week_cashe = is_active_current_week();
+
+  pairstable pairs(_self, _self.value);
+  check(pairs.find(pair.value) != pairs.end(), "pair not found");
+
+  rollup_medians(get_self(), pair, max_days);
+}
+
+//Read-only: every period of the pair's medians that holds values, oldest
+//first, with its average, low, high, first and last
+std::vector<delphioracle::periodsummary> delphioracle::getperiods(name pair) {
+  pairstable pairs(_self, _self.value);
+  check(pairs.find(pair.value) != pairs.end(), "pair not found");
+
+  medianstable medians_table(get_self(), pair.value);
+  auto medians_timestamp_index = medians_table.get_index<"timestamp"_n>();
+
+  std::vector<periodsummary> periods;
+  for (auto itr = medians_timestamp_index.begin(); itr != medians_timestamp_index.end(); ++itr) {
+    if (itr->request_count == 0)
+      continue;
+
+    periods.push_back({itr->type, itr->timestamp, itr->request_count, itr->value / itr->request_count,
+                       itr->low.value_or(0), itr->high.value_or(0), itr->first.value_or(0), itr->last.value_or(0)});
+  }
+  return periods;
+}
+
+#endif
+
+#if DELPHIORACLE_WITH_LEGACY
 ACTION delphioracle::initmedians(bool is_active) {
   require_auth(get_self());
   
@@ -886,9 +1704,10 @@ ACTION delphioracle::updtversion() {
       if (itr_medians->timestamp != NULL_TIME_POINT) {
         medians_table.modify(*itr_medians, get_self(), [&](medians &obj) {
           uint32_t timestamp_sec = obj.timestamp.sec_since_epoch();
-          obj.timestamp = time_point(seconds(timestamp_sec - time_consts.at(median_types::day) * 20)); // erase bias in prod
+          obj.timestamp = time_point(seconds(timestamp_sec - median_period(median_types::day) * 20)); // erase bias in prod
         });
       }
     }
   }
 }
+#endif
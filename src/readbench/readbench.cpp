@@ -0,0 +1 @@
+#include "readbench.hpp"
@@ -0,0 +1,55 @@
+/*
+
+  readbench
+
+  Reads a pair's current median from delphioracle's tables in each of the
+  ways consumer contracts do, one action per way, so that their cost can be
+  compared: on a node from the cpu_usage_us of each action, natively with
+  tools/readbench. Each action returns the median it found.
+
+*/
+
+#pragma once
+
+#include <reader.hpp>
+
+CONTRACT readbench : public eosio::contract {
+ public:
+  using contract::contract;
+
+  //Every row of the window by primary key, keeping the newest, by time and
+  //then by seq
+  [[eosio::action]] uint64_t byscan(eosio::name pair) {
+    delphi::datapointstable dstore(_oracle, pair.value);
+    uint64_t median = 0;
+    eosio::time_point newest;
+    uint64_t seq = 0;
+    for (auto& d : dstore) {
+      if (newest < d.timestamp || (newest == d.timestamp && seq < d.seq.value_or(0))) {
+        newest = d.timestamp;
+        seq = d.seq.value_or(0);
+        median = d.median;
+      }
+    }
+    return median;
+  }
+
+  //The last row of the timestamp index alone; wrong when two writes share
+  //the last second
+  [[eosio::action]] uint64_t bylast(eosio::name pair) {
+    delphi::datapointstable dstore(_oracle, pair.value);
+    auto t_idx = dstore.get_index<"timestamp"_n>();
+    auto itr = t_idx.end();
+    eosio::check(itr != t_idx.begin(), "no datapoints for pair");
+    --itr;
+    return itr->median;
+  }
+
+  //delphi::latest_price
+  [[eosio::action]] uint64_t bylatest(eosio::name pair) {
+    return delphi::latest_price(pair, eosio::days(3650), _oracle).median;
+  }
+
+ private:
+  static constexpr eosio::name _oracle = delphi::default_contract;
+};
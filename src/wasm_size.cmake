@@ -0,0 +1,12 @@
+# Size report for one built contract variant.
+# cmake -DWASM=<file.wasm> -DVARIANT=<name> -DREPORT=<file.txt> -P wasm_size.cmake
+cmake_minimum_required(VERSION 3.14)
+
+file(SIZE "${WASM}" wasm_bytes)
+math(EXPR wasm_kib "${wasm_bytes} / 1024")
+
+set(line "${VARIANT} ${wasm_bytes} bytes (${wasm_kib} KiB) ${WASM}")
+message(STATUS "delphioracle size: ${line}")
+if(REPORT)
+   file(WRITE "${REPORT}" "${line}\n")
+endif()
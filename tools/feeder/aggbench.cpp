@@ -0,0 +1,161 @@
+/*
+
+  delphiaggbench
+
+  Checks that every aggregation kernel the cpu supports agrees with the
+  reference implementation to the bit, on random and degenerate quote sets,
+  then measures each on synthetic cycles: many pairs of many quotes with
+  noise, outliers and stale entries, as a feeder reading dozens of exchange
+  tickers would see them.
+
+  delphiaggbench [options]
+    --quotes <n>      quotes per pair (default 4096)
+    --pairs <n>       pairs per cycle (default 16)
+    --cycles <n>      timed cycles per kernel (default 200)
+    --checks <n>      random quote sets compared (default 20000)
+    --seed <n>        (default 1)
+
+*/
+
+#include "aggregate.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int64_t now_ms = 1700000000000;
+volatile int64_t sink;
+
+struct generator {
+  std::mt19937_64 rng;
+
+  explicit generator(uint64_t seed) : rng(seed) {}
+
+  uint64_t below(uint64_t n) { return n ? rng() % n : 0; }
+  double unit() { return std::uniform_real_distribution<double>(0, 1)(rng); }
+
+  // one pair's quotes around base: mostly within a few tenths of a percent,
+  // some far off, some stale, volumes spread over orders of magnitude
+  void realistic(feeder::quote_set& q, size_t n, int64_t base) {
+    std::normal_distribution<double> noise(0, 0.002);
+    std::lognormal_distribution<double> volume(10, 2);
+    q.clear();
+    q.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      double r = unit();
+      double price = double(base) * (1 + noise(rng));
+      if (r < 0.03) price *= 0.5 + unit() * 1.5;
+      int64_t age = r > 0.95 ? 120000 + int64_t(below(600000)) : int64_t(below(30000));
+      q.push(int64_t(price), uint64_t(std::min(volume(rng), 4e9)), now_ms - age);
+    }
+  }
+
+  // small sets with heavy ties, zero weights and extreme values, where the
+  // edge cases of every step get hit
+  void adversarial(feeder::quote_set& q, feeder::aggregate_params& p) {
+    size_t n = 1 + below(below(4) == 0 ? 300 : 12);
+    int64_t spread = int64_t(1) << below(62);
+    bool ties = below(3) == 0, zero_weights = below(4) == 0;
+    q.clear();
+    for (size_t i = 0; i < n; ++i) {
+      int64_t v = ties ? int64_t(below(4)) * (spread / 4) : int64_t(below(uint64_t(spread)));
+      uint64_t w = zero_weights ? below(3) / 2 * below(1000) : rng() >> below(64);
+      q.push(v, w, now_ms - int64_t(below(4000)));
+    }
+    p.now = now_ms;
+    p.max_age = below(3) ? int64_t(below(4000)) : 0;
+    p.mad_k_milli = uint32_t(below(8000));
+    p.min_band_bps = below(2) ? uint32_t(below(500)) : 0;
+  }
+};
+
+bool same(const feeder::aggregate_result& a, const feeder::aggregate_result& b) {
+  return a.value == b.value && a.median == b.median && a.mad == b.mad && a.band == b.band && a.fresh == b.fresh &&
+         a.accepted == b.accepted;
+}
+
+void print(const char* what, const feeder::aggregate_result& r) {
+  std::fprintf(stderr, "  %-10s value %lld median %lld mad %lld band %lld fresh %zu accepted %zu\n", what,
+               (long long)r.value, (long long)r.median, (long long)r.mad, (long long)r.band, r.fresh, r.accepted);
+}
+
+void usage() {
+  std::cerr << "usage: delphiaggbench [--quotes <n>] [--pairs <n>] [--cycles <n>] [--checks <n>] [--seed <n>]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t quotes = 4096, pairs = 16, cycles = 200, checks = 20000;
+  uint64_t seed = 1;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--quotes") quotes = std::stoul(next());
+    else if (arg == "--pairs") pairs = std::stoul(next());
+    else if (arg == "--cycles") cycles = std::stoul(next());
+    else if (arg == "--checks") checks = std::stoul(next());
+    else if (arg == "--seed") seed = std::stoull(next());
+    else { usage(); return 2; }
+  }
+
+  std::vector<feeder::aggregate_kernel> kernels;
+  for (auto k : {feeder::aggregate_kernel::reference, feeder::aggregate_kernel::scalar, feeder::aggregate_kernel::avx2})
+    if (feeder::kernel_supported(k)) kernels.push_back(k);
+
+  generator gen(seed);
+  feeder::quote_set q;
+  feeder::aggregate_params p;
+  size_t mismatches = 0;
+  for (size_t c = 0; c < checks; ++c) {
+    if (c % 8 == 0) {
+      gen.realistic(q, 1 + gen.below(2000), 1 + int64_t(gen.below(1000000000)));
+      p = {now_ms, 60000, 3000, uint32_t(gen.below(100))};
+    } else {
+      gen.adversarial(q, p);
+    }
+    auto expected = feeder::aggregate(q, p, feeder::aggregate_kernel::reference);
+    for (auto k : kernels) {
+      auto got = feeder::aggregate(q, p, k);
+      if (same(got, expected)) continue;
+      if (mismatches++ < 5) {
+        std::fprintf(stderr, "mismatch on check %zu, %zu quotes:\n", c, q.size());
+        print("reference", expected);
+        print(feeder::kernel_name(k), got);
+      }
+    }
+  }
+  std::printf("%zu quote sets checked against the reference: %s\n", checks,
+              mismatches ? (std::to_string(mismatches) + " mismatches").c_str() : "identical");
+
+  std::vector<feeder::quote_set> cycle(pairs);
+  for (auto& set : cycle) gen.realistic(set, quotes, 1000 + int64_t(gen.below(100000000)));
+  feeder::aggregate_params params{now_ms, 60000, 3000, 10};
+
+  std::printf("\n%zu pairs x %zu quotes, %zu cycles\n", pairs, quotes, cycles);
+  std::printf("%-10s %12s %12s %12s\n", "kernel", "cycle_us", "ns/quote", "Mquotes/s");
+  for (auto k : kernels) {
+    size_t runs = k == feeder::aggregate_kernel::reference ? std::max<size_t>(1, cycles / 10) : cycles;
+    auto start = clock_type::now();
+    for (size_t c = 0; c < runs; ++c)
+      for (auto& set : cycle) sink = feeder::aggregate(set, params, k).value;
+    double ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+    double per_quote = ns / double(runs * pairs * quotes);
+    std::printf("%-10s %12.1f %12.2f %12.1f\n", feeder::kernel_name(k), ns / double(runs) / 1000.0, per_quote,
+                1000.0 / per_quote);
+  }
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,506 @@
+#include "aggregate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <utility>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define FEEDER_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace feeder {
+
+  void quote_set::clear() {
+    values.clear();
+    weights.clear();
+    times.clear();
+  }
+
+  void quote_set::reserve(size_t n) {
+    values.reserve(n);
+    weights.reserve(n);
+    times.reserve(n);
+  }
+
+  void quote_set::push(int64_t value, uint64_t weight, int64_t time) {
+    values.push_back(value);
+    weights.push_back(std::min<uint64_t>(weight, 0xffffffffu));
+    times.push_back(time);
+  }
+
+  namespace {
+
+    int64_t middle_of_sorted(const std::vector<int64_t>& v) {
+      size_t mid = v.size() / 2;
+      if (v.size() % 2) return v[mid];
+      return v[mid - 1] + (v[mid] - v[mid - 1]) / 2;
+    }
+
+    int64_t band_for(int64_t median, int64_t mad, const aggregate_params& p) {
+      __int128 by_mad = __int128(mad) * p.mad_k_milli / 1000;
+      __int128 floor = __int128(median) * p.min_band_bps / 10000;
+      __int128 b = std::max(by_mad, floor);
+      return b > std::numeric_limits<int64_t>::max() ? std::numeric_limits<int64_t>::max() : int64_t(b);
+    }
+
+    int64_t distance(int64_t v, int64_t m) { return v >= m ? v - m : m - v; }
+
+    // The definition, written for reading: sort, count, sort again.
+    aggregate_result aggregate_reference(const quote_set& q, const aggregate_params& p) {
+      aggregate_result r;
+      std::vector<size_t> fresh;
+      for (size_t i = 0; i < q.size(); ++i)
+        if (p.max_age <= 0 || q.times[i] >= p.now - p.max_age) fresh.push_back(i);
+      r.fresh = fresh.size();
+      if (fresh.empty()) return r;
+
+      std::vector<int64_t> sorted;
+      for (auto i : fresh) sorted.push_back(q.values[i]);
+      std::sort(sorted.begin(), sorted.end());
+      r.median = middle_of_sorted(sorted);
+
+      std::vector<int64_t> devs;
+      for (auto i : fresh) devs.push_back(distance(q.values[i], r.median));
+      std::sort(devs.begin(), devs.end());
+      r.mad = middle_of_sorted(devs);
+      r.band = band_for(r.median, r.mad, p);
+
+      std::vector<std::pair<int64_t, uint64_t>> kept;
+      for (auto i : fresh)
+        if (distance(q.values[i], r.median) <= r.band) kept.emplace_back(q.values[i], q.weights[i]);
+      r.accepted = kept.size();
+      if (kept.empty()) return r;
+
+      std::sort(kept.begin(), kept.end());
+      uint64_t total = 0;
+      for (auto& k : kept) total += k.second;
+      bool uniform = total == 0;
+      if (uniform) total = kept.size();
+      uint64_t cumulative = 0;
+      for (auto& [value, weight] : kept) {
+        cumulative += uniform ? 1 : weight;
+        if (2 * cumulative >= total) {
+          r.value = value;
+          break;
+        }
+      }
+      return r;
+    }
+
+    // The fast kernels share everything but the linear passes, which compact
+    // without branches. Selection narrows to a window around the wanted
+    // rank first, so most of the work is in those passes too.
+    struct passes {
+      // keeps quotes with time >= cutoff
+      size_t (*fresh)(const int64_t* v, const uint64_t* w, const int64_t* t, size_t n, int64_t cutoff, int64_t* out_v,
+                      uint64_t* out_w);
+      void (*deviations)(const int64_t* v, size_t n, int64_t median, int64_t* out);
+      // keeps quotes within band of median, in place, and sums their weights
+      size_t (*within)(int64_t* v, uint64_t* w, size_t n, int64_t median, int64_t band, uint64_t* total);
+      // copies out the values in [lo, hi] and counts those below lo
+      size_t (*between)(const int64_t* v, size_t n, int64_t lo, int64_t hi, int64_t* out, size_t* below);
+      // the same with weights, summing those below lo and those copied
+      size_t (*between_weighted)(const int64_t* v, const uint64_t* w, size_t n, int64_t lo, int64_t hi, int64_t* out_v,
+                                 uint64_t* out_w, uint64_t* below, uint64_t* inside);
+    };
+
+    size_t fresh_scalar(const int64_t* v, const uint64_t* w, const int64_t* t, size_t n, int64_t cutoff, int64_t* out_v,
+                        uint64_t* out_w) {
+      size_t k = 0;
+      for (size_t i = 0; i < n; ++i) {
+        out_v[k] = v[i];
+        out_w[k] = w[i];
+        k += t[i] >= cutoff;
+      }
+      return k;
+    }
+
+    void deviations_scalar(const int64_t* v, size_t n, int64_t median, int64_t* out) {
+      for (size_t i = 0; i < n; ++i) out[i] = distance(v[i], median);
+    }
+
+    size_t within_scalar(int64_t* v, uint64_t* w, size_t n, int64_t median, int64_t band, uint64_t* total) {
+      size_t k = 0;
+      uint64_t sum = 0;
+      for (size_t i = 0; i < n; ++i) {
+        bool keep = distance(v[i], median) <= band;
+        int64_t value = v[i];
+        uint64_t weight = w[i];
+        v[k] = value;
+        w[k] = weight;
+        sum += keep ? weight : 0;
+        k += keep;
+      }
+      *total = sum;
+      return k;
+    }
+
+    size_t between_scalar(const int64_t* v, size_t n, int64_t lo, int64_t hi, int64_t* out, size_t* below) {
+      size_t k = 0, under = 0;
+      for (size_t i = 0; i < n; ++i) {
+        out[k] = v[i];
+        k += v[i] >= lo && v[i] <= hi;
+        under += v[i] < lo;
+      }
+      *below = under;
+      return k;
+    }
+
+    size_t between_weighted_scalar(const int64_t* v, const uint64_t* w, size_t n, int64_t lo, int64_t hi,
+                                   int64_t* out_v, uint64_t* out_w, uint64_t* below, uint64_t* inside) {
+      size_t k = 0;
+      uint64_t under = 0, in = 0;
+      for (size_t i = 0; i < n; ++i) {
+        bool keep = v[i] >= lo && v[i] <= hi;
+        out_v[k] = v[i];
+        out_w[k] = w[i];
+        k += keep;
+        under += v[i] < lo ? w[i] : 0;
+        in += keep ? w[i] : 0;
+      }
+      *below = under;
+      *inside = in;
+      return k;
+    }
+
+    constexpr passes scalar_passes{fresh_scalar, deviations_scalar, within_scalar, between_scalar,
+                                   between_weighted_scalar};
+
+#if FEEDER_HAVE_AVX2
+    // permutevar8x32 indices that move the 64-bit lanes set in a 4-bit mask
+    // to the front, in order
+    struct compress_table {
+      alignas(32) int32_t index[16][8];
+    };
+
+    constexpr compress_table make_compress_table() {
+      compress_table t{};
+      for (int mask = 0; mask < 16; ++mask) {
+        int out = 0;
+        for (int lane = 0; lane < 4; ++lane) {
+          if (mask & (1 << lane)) {
+            t.index[mask][2 * out] = 2 * lane;
+            t.index[mask][2 * out + 1] = 2 * lane + 1;
+            ++out;
+          }
+        }
+      }
+      return t;
+    }
+
+    constexpr compress_table compress = make_compress_table();
+
+    __attribute__((target("avx2"))) inline int lanes(__m256i m) {
+      return _mm256_movemask_pd(_mm256_castsi256_pd(m));
+    }
+
+    __attribute__((target("avx2"))) inline __m256i abs_distance(__m256i v, __m256i m) {
+      __m256i d = _mm256_sub_epi64(v, m);
+      __m256i neg = _mm256_sub_epi64(_mm256_setzero_si256(), d);
+      return _mm256_blendv_epi8(d, neg, _mm256_cmpgt_epi64(_mm256_setzero_si256(), d));
+    }
+
+    // loads come before stores and k <= i, so out may alias the input
+    __attribute__((target("avx2"))) inline size_t compact(__m256i v, __m256i w, int keep, int64_t* out_v,
+                                                          uint64_t* out_w, size_t k) {
+      __m256i perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(compress.index[keep]));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_v + k), _mm256_permutevar8x32_epi32(v, perm));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_w + k), _mm256_permutevar8x32_epi32(w, perm));
+      return k + size_t(__builtin_popcount(unsigned(keep)));
+    }
+
+    __attribute__((target("avx2"))) inline size_t compact(__m256i v, int keep, int64_t* out, size_t k) {
+      __m256i perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(compress.index[keep]));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), _mm256_permutevar8x32_epi32(v, perm));
+      return k + size_t(__builtin_popcount(unsigned(keep)));
+    }
+
+    __attribute__((target("avx2"))) inline uint64_t horizontal_sum(__m256i v) {
+      alignas(32) uint64_t parts[4];
+      _mm256_store_si256(reinterpret_cast<__m256i*>(parts), v);
+      return parts[0] + parts[1] + parts[2] + parts[3];
+    }
+
+    __attribute__((target("avx2"))) size_t fresh_avx2(const int64_t* v, const uint64_t* w, const int64_t* t, size_t n,
+                                                     int64_t cutoff, int64_t* out_v, uint64_t* out_w) {
+      const __m256i limit = _mm256_set1_epi64x(cutoff);
+      size_t k = 0, i = 0;
+      for (; i + 4 <= n; i += 4) {
+        __m256i stale = _mm256_cmpgt_epi64(limit, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t + i)));
+        k = compact(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i)), ~lanes(stale) & 0xf, out_v, out_w, k);
+      }
+      return k + fresh_scalar(v + i, w + i, t + i, n - i, cutoff, out_v + k, out_w + k);
+    }
+
+    __attribute__((target("avx2"))) void deviations_avx2(const int64_t* v, size_t n, int64_t median, int64_t* out) {
+      const __m256i m = _mm256_set1_epi64x(median);
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            abs_distance(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)), m));
+      deviations_scalar(v + i, n - i, median, out + i);
+    }
+
+    __attribute__((target("avx2"))) size_t within_avx2(int64_t* v, uint64_t* w, size_t n, int64_t median,
+                                                      int64_t band, uint64_t* total) {
+      const __m256i m = _mm256_set1_epi64x(median);
+      const __m256i b = _mm256_set1_epi64x(band);
+      __m256i sum = _mm256_setzero_si256();
+      size_t k = 0, i = 0;
+      for (; i + 4 <= n; i += 4) {
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+        __m256i outside = _mm256_cmpgt_epi64(abs_distance(values, m), b);
+        sum = _mm256_add_epi64(sum, _mm256_andnot_si256(outside, weights));
+        k = compact(values, weights, ~lanes(outside) & 0xf, v, w, k);
+      }
+      uint64_t tail = 0;
+      size_t rest = within_scalar(v + i, w + i, n - i, median, band, &tail);
+      // the tail compacts onto itself; move it down behind the vector part
+      std::copy(v + i, v + i + rest, v + k);
+      std::copy(w + i, w + i + rest, w + k);
+      *total = horizontal_sum(sum) + tail;
+      return k + rest;
+    }
+
+    __attribute__((target("avx2"))) size_t between_avx2(const int64_t* v, size_t n, int64_t lo, int64_t hi,
+                                                       int64_t* out, size_t* below) {
+      const __m256i l = _mm256_set1_epi64x(lo);
+      const __m256i h = _mm256_set1_epi64x(hi);
+      size_t k = 0, under = 0, i = 0;
+      for (; i + 4 <= n; i += 4) {
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        int low = lanes(_mm256_cmpgt_epi64(l, values));
+        int high = lanes(_mm256_cmpgt_epi64(values, h));
+        under += size_t(__builtin_popcount(unsigned(low)));
+        k = compact(values, ~(low | high) & 0xf, out, k);
+      }
+      size_t tail = 0;
+      k += between_scalar(v + i, n - i, lo, hi, out + k, &tail);
+      *below = under + tail;
+      return k;
+    }
+
+    __attribute__((target("avx2"))) size_t between_weighted_avx2(const int64_t* v, const uint64_t* w, size_t n,
+                                                                int64_t lo, int64_t hi, int64_t* out_v,
+                                                                uint64_t* out_w, uint64_t* below, uint64_t* inside) {
+      const __m256i l = _mm256_set1_epi64x(lo);
+      const __m256i h = _mm256_set1_epi64x(hi);
+      __m256i under = _mm256_setzero_si256(), in = _mm256_setzero_si256();
+      size_t k = 0, i = 0;
+      for (; i + 4 <= n; i += 4) {
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+        __m256i low = _mm256_cmpgt_epi64(l, values);
+        __m256i outside = _mm256_or_si256(low, _mm256_cmpgt_epi64(values, h));
+        under = _mm256_add_epi64(under, _mm256_and_si256(low, weights));
+        in = _mm256_add_epi64(in, _mm256_andnot_si256(outside, weights));
+        k = compact(values, weights, ~lanes(outside) & 0xf, out_v, out_w, k);
+      }
+      uint64_t tail_below = 0, tail_inside = 0;
+      k += between_weighted_scalar(v + i, w + i, n - i, lo, hi, out_v + k, out_w + k, &tail_below, &tail_inside);
+      *below = horizontal_sum(under) + tail_below;
+      *inside = horizontal_sum(in) + tail_inside;
+      return k;
+    }
+
+    constexpr passes avx2_passes{fresh_avx2, deviations_avx2, within_avx2, between_avx2, between_weighted_avx2};
+#endif
+
+    // Below this, or when the sample misjudges, selection runs over
+    // everything.
+    constexpr size_t narrow_from = 2048;
+    constexpr size_t sample_size = 256;
+    constexpr size_t sample_margin = 20;
+
+    int64_t middle_select(int64_t* a, size_t n) {
+      size_t mid = n / 2;
+      std::nth_element(a, a + mid, a + n);
+      int64_t hi = a[mid];
+      if (n % 2) return hi;
+      int64_t lo = *std::max_element(a, a + mid);
+      return lo + (hi - lo) / 2;
+    }
+
+    // Median of a, which is left as it is. A sorted sample brackets the
+    // middle ranks and the between pass copies out only what lies in the
+    // bracket, so nth_element sees a small fraction of the values.
+    int64_t middle(const passes& k, const int64_t* a, size_t n, int64_t* window) {
+      if (n >= narrow_from) {
+        std::array<int64_t, sample_size> sample;
+        for (size_t i = 0; i < sample_size; ++i) sample[i] = a[i * n / sample_size];
+        std::sort(sample.begin(), sample.end());
+        size_t mid = n / 2, lowest = n % 2 ? mid : mid - 1;
+        size_t at = mid * sample_size / n;
+        int64_t lo = sample[at > sample_margin ? at - sample_margin : 0];
+        int64_t hi = sample[std::min(at + sample_margin, sample_size - 1)];
+
+        size_t below = 0;
+        size_t m = k.between(a, n, lo, hi, window, &below);
+        if (below <= lowest && mid < below + m) {
+          size_t rank = mid - below;
+          std::nth_element(window, window + rank, window + m);
+          int64_t upper = window[rank];
+          if (n % 2) return upper;
+          int64_t lower = *std::max_element(window, window + rank);
+          return lower + (upper - lower) / 2;
+        }
+      }
+      std::copy(a, a + n, window);
+      return middle_select(window, n);
+    }
+
+    // Lowest value whose cumulative weight, on top of below, reaches half of
+    // total, by a three-way quickselect over the parallel columns.
+    template <bool Uniform>
+    int64_t weighted_select(int64_t* v, uint64_t* w, size_t n, uint64_t total, uint64_t below) {
+      size_t lo = 0, hi = n;
+      for (;;) {
+        size_t mid = lo + (hi - lo) / 2;
+        int64_t a = v[lo], b = v[mid], c = v[hi - 1];
+        int64_t pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+
+        // [lo, lt) < pivot, [lt, i) == pivot, (gt, hi) > pivot
+        size_t lt = lo, i = lo, gt = hi;
+        uint64_t w_lt = 0, w_eq = 0;
+        while (i < gt) {
+          uint64_t weight = Uniform ? 1 : w[i];
+          if (v[i] < pivot) {
+            std::swap(v[i], v[lt]);
+            std::swap(w[i], w[lt]);
+            w_lt += weight;
+            ++lt;
+            ++i;
+          } else if (v[i] > pivot) {
+            --gt;
+            std::swap(v[i], v[gt]);
+            std::swap(w[i], w[gt]);
+          } else {
+            w_eq += weight;
+            ++i;
+          }
+        }
+
+        if (2 * (below + w_lt) >= total) {
+          hi = lt;
+        } else if (2 * (below + w_lt + w_eq) >= total) {
+          return pivot;
+        } else {
+          below += w_lt + w_eq;
+          lo = gt;
+        }
+      }
+    }
+
+    // As middle(), with the bracket around where the sample's own weight
+    // crosses half.
+    template <bool Uniform>
+    int64_t weighted_middle(const passes& k, int64_t* v, uint64_t* w, size_t n, uint64_t total, int64_t* window_v,
+                            uint64_t* window_w) {
+      if (n >= narrow_from) {
+        std::array<std::pair<int64_t, uint64_t>, sample_size> sample;
+        uint64_t sample_total = 0;
+        for (size_t i = 0; i < sample_size; ++i) {
+          size_t at = i * n / sample_size;
+          sample[i] = {v[at], Uniform ? 1 : w[at]};
+          sample_total += sample[i].second;
+        }
+        std::sort(sample.begin(), sample.end());
+        size_t at = 0;
+        for (uint64_t cumulative = 0; at < sample_size; ++at)
+          if (2 * (cumulative += sample[at].second) >= sample_total) break;
+        int64_t lo = sample[at > sample_margin ? at - sample_margin : 0].first;
+        int64_t hi = sample[std::min(at + sample_margin, sample_size - 1)].first;
+
+        size_t m = 0;
+        uint64_t below = 0, inside = 0;
+        if (Uniform) {
+          size_t count = 0;
+          m = k.between(v, n, lo, hi, window_v, &count);
+          below = count;
+          inside = m;
+        } else {
+          m = k.between_weighted(v, w, n, lo, hi, window_v, window_w, &below, &inside);
+        }
+        if (2 * below < total && 2 * (below + inside) >= total)
+          return weighted_select<Uniform>(window_v, window_w, m, total, below);
+      }
+      return weighted_select<Uniform>(v, w, n, total, 0);
+    }
+
+    aggregate_result aggregate_with(const quote_set& q, const aggregate_params& p, const passes& k) {
+      thread_local std::vector<int64_t> values, work, window;
+      thread_local std::vector<uint64_t> weights, window_weights;
+      size_t n = q.size();
+      if (values.size() < n) {
+        values.resize(n);
+        work.resize(n);
+        window.resize(n);
+        weights.resize(n);
+        window_weights.resize(n);
+      }
+
+      aggregate_result r;
+      int64_t cutoff = p.max_age > 0 ? p.now - p.max_age : std::numeric_limits<int64_t>::min();
+      size_t fresh = k.fresh(q.values.data(), q.weights.data(), q.times.data(), n, cutoff, values.data(), weights.data());
+      r.fresh = fresh;
+      if (fresh == 0) return r;
+
+      r.median = middle(k, values.data(), fresh, window.data());
+      k.deviations(values.data(), fresh, r.median, work.data());
+      r.mad = middle(k, work.data(), fresh, window.data());
+      r.band = band_for(r.median, r.mad, p);
+
+      uint64_t total = 0;
+      r.accepted = k.within(values.data(), weights.data(), fresh, r.median, r.band, &total);
+      if (r.accepted == 0) return r;
+      r.value = total ? weighted_middle<false>(k, values.data(), weights.data(), r.accepted, total, window.data(),
+                                               window_weights.data())
+                      : weighted_middle<true>(k, values.data(), weights.data(), r.accepted, r.accepted, window.data(),
+                                              window_weights.data());
+      return r;
+    }
+
+  } // namespace
+
+  const char* kernel_name(aggregate_kernel k) {
+    switch (k) {
+      case aggregate_kernel::reference: return "reference";
+      case aggregate_kernel::scalar: return "scalar";
+      case aggregate_kernel::avx2: return "avx2";
+    }
+    return "?";
+  }
+
+  bool kernel_supported(aggregate_kernel k) {
+    if (k != aggregate_kernel::avx2) return true;
+#if FEEDER_HAVE_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+  }
+
+  aggregate_kernel best_kernel() {
+    static const aggregate_kernel best =
+        kernel_supported(aggregate_kernel::avx2) ? aggregate_kernel::avx2 : aggregate_kernel::scalar;
+    return best;
+  }
+
+  aggregate_result aggregate(const quote_set& quotes, const aggregate_params& params, aggregate_kernel k) {
+    switch (k) {
+      case aggregate_kernel::reference: return aggregate_reference(quotes, params);
+#if FEEDER_HAVE_AVX2
+      case aggregate_kernel::avx2:
+        if (kernel_supported(k)) return aggregate_with(quotes, params, avx2_passes);
+        break;
+#endif
+      default: break;
+    }
+    return aggregate_with(quotes, params, scalar_passes);
+  }
+
+} // namespace feeder
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Combines many quotes for one pair into the value the feeder writes:
+// drops stale quotes, drops outliers further than k median absolute
+// deviations from the median, and takes the volume-weighted median of the
+// rest. All integer, so every kernel gives the same answer to the bit.
+namespace feeder {
+
+  /// Quotes for one pair, as parallel columns.
+  struct quote_set {
+    std::vector<int64_t> values;   // scaled price, non-negative
+    std::vector<uint64_t> weights; // relative volume, below 2^32
+    std::vector<int64_t> times;    // ms since epoch
+
+    size_t size() const { return values.size(); }
+    void clear();
+    void reserve(size_t n);
+    /// Clamps weight to 2^32 - 1 so that sums cannot overflow.
+    void push(int64_t value, uint64_t weight, int64_t time);
+  };
+
+  struct aggregate_params {
+    int64_t now = 0;           // ms since epoch
+    int64_t max_age = 0;       // ms; quotes older than now - max_age are stale, 0 keeps all
+    uint32_t mad_k_milli = 3000;
+    uint32_t min_band_bps = 0; // band never narrower than this, as a share of the median
+  };
+
+  struct aggregate_result {
+    int64_t value = 0;   // volume-weighted median of accepted quotes
+    int64_t median = 0;  // of fresh quotes
+    int64_t mad = 0;     // of fresh quotes
+    int64_t band = 0;    // accepted quotes are within this of median
+    size_t fresh = 0;
+    size_t accepted = 0;
+  };
+
+  enum class aggregate_kernel { reference, scalar, avx2 };
+
+  const char* kernel_name(aggregate_kernel k);
+  bool kernel_supported(aggregate_kernel k);
+  /// avx2 when the cpu has it, scalar otherwise.
+  aggregate_kernel best_kernel();
+
+  /// When weights are all zero every accepted quote weighs the same. The
+  /// weighted median is the lowest value whose cumulative weight reaches
+  /// half the total. accepted is 0 when nothing is left.
+  aggregate_result aggregate(const quote_set& quotes, const aggregate_params& params,
+                             aggregate_kernel k = best_kernel());
+
+} // namespace feeder
@@ -0,0 +1,105 @@
+#include "chain.hpp"
+
+#include <mock/json.hpp>
+
+#include <cstdio>
+#include <ctime>
+
+namespace feeder {
+
+  namespace {
+
+    using json = eosio::mock::json;
+
+    sha256_digest digest_from_hex(const std::string& hex) {
+      auto bytes = from_hex(hex);
+      if (bytes.size() != 32) throw http_error("expected a 32 byte hex id");
+      sha256_digest out;
+      std::copy(bytes.begin(), bytes.end(), out.begin());
+      return out;
+    }
+
+    uint32_t parse_block_time(const std::string& s) {
+      std::tm tm{};
+      if (std::sscanf(s.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour,
+                      &tm.tm_min, &tm.tm_sec) != 6)
+        throw http_error("bad head_block_time " + s);
+      tm.tm_year -= 1900;
+      tm.tm_mon -= 1;
+      return uint32_t(timegm(&tm));
+    }
+
+    std::string error_text(const http_response& res) {
+      // nodeos puts the assertion in error.details[0].message
+      try {
+        auto j = json::parse(res.body);
+        if (auto e = j.find("error")) {
+          if (auto d = e->find("details"); d && !d->items.empty())
+            if (auto m = d->items[0].find("message")) return m->text;
+          if (auto w = e->find("what")) return w->text;
+        }
+      } catch (const std::exception&) {
+      }
+      return "http status " + std::to_string(res.status);
+    }
+
+  } // namespace
+
+  chain_client::chain_client(std::string_view node, std::chrono::milliseconds timeout, std::string_view push_path)
+      : _timeout(timeout) {
+    std::string base(node);
+    while (!base.empty() && base.back() == '/') base.pop_back();
+    _get_info = url::parse(base + "/v1/chain/get_info");
+    _push = url::parse(base + std::string(push_path));
+  }
+
+  chain_info chain_client::get_info() const {
+    auto res = http_post(_get_info, "{}", _timeout);
+    if (res.status != 200) throw http_error("get_info: " + error_text(res));
+    try {
+      auto j = json::parse(res.body);
+      chain_info info;
+      info.chain_id = digest_from_hex(j.at("chain_id").text);
+      info.head_block_num = uint32_t(std::stoul(j.at("head_block_num").text));
+      info.head_block_time = parse_block_time(j.at("head_block_time").text);
+      info.last_irreversible_block_id = digest_from_hex(j.at("last_irreversible_block_id").text);
+      return info;
+    } catch (const http_error&) {
+      throw;
+    } catch (const std::exception& e) {
+      throw http_error(std::string("get_info: ") + e.what());
+    }
+  }
+
+  push_result chain_client::push(const signed_write& tx) const {
+    push_result r;
+    auto start = std::chrono::steady_clock::now();
+    try {
+      auto res = http_post(_push, tx.to_json(), _timeout);
+      r.status = res.status;
+      r.ok = res.status == 202 || res.status == 200;
+      if (!r.ok) r.error = error_text(res);
+    } catch (const std::exception& e) {
+      r.error = e.what();
+    }
+    r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return r;
+  }
+
+  tapos_cache::snapshot tapos_cache::current() {
+    std::lock_guard lock(_mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (!_valid || now - _fetched >= _refresh) {
+      _info = _client.get_info();
+      _fetched = now;
+      _valid = true;
+      _fetches++;
+    }
+
+    // the node's clock, advanced by the time since it was read
+    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - _fetched).count();
+    return {_info.chain_id, tapos::from_block_id(_info.last_irreversible_block_id),
+            _info.head_block_time + uint32_t(elapsed) + _expire_seconds};
+  }
+
+} // namespace feeder
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "http.hpp"
+#include "thread_pool.hpp"
+#include "transaction.hpp"
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <semaphore>
+#include <string>
+
+// Talking to a nodeos http endpoint: chain info for TAPOS, cached between
+// pushes, and pushing signed transactions with several in flight.
+namespace feeder {
+
+  struct chain_info {
+    sha256_digest chain_id{};
+    uint32_t head_block_num = 0;
+    uint32_t head_block_time = 0; // seconds since epoch
+    sha256_digest last_irreversible_block_id{};
+  };
+
+  struct push_result {
+    bool ok = false;
+    int status = 0;
+    double ms = 0;
+    std::string error;
+  };
+
+  class chain_client {
+   public:
+    chain_client(std::string_view node, std::chrono::milliseconds timeout,
+                 std::string_view push_path = "/v1/chain/push_transaction");
+
+    chain_info get_info() const;
+    push_result push(const signed_write& tx) const;
+
+   private:
+    url _get_info;
+    url _push;
+    std::chrono::milliseconds _timeout;
+  };
+
+  /// Chain id and a reference block, refetched only when older than refresh.
+  /// The last irreversible block stays valid for TAPOS for hours, so one
+  /// get_info serves every push in between.
+  class tapos_cache {
+   public:
+    struct snapshot {
+      sha256_digest chain_id;
+      tapos ref;
+      uint32_t expiration;
+    };
+
+    tapos_cache(const chain_client& client, std::chrono::seconds refresh = std::chrono::minutes(10),
+                uint32_t expire_seconds = 60)
+        : _client(client), _refresh(refresh), _expire_seconds(expire_seconds) {}
+
+    snapshot current();
+    uint64_t fetches() const { return _fetches; }
+
+   private:
+    const chain_client& _client;
+    std::chrono::seconds _refresh;
+    uint32_t _expire_seconds;
+    std::mutex _mutex;
+    chain_info _info;
+    std::chrono::steady_clock::time_point _fetched;
+    bool _valid = false;
+    uint64_t _fetches = 0;
+  };
+
+  /// Pushes on a pool of depth workers; submit blocks while depth pushes are
+  /// in flight.
+  class push_pipeline {
+   public:
+    push_pipeline(const chain_client& client, size_t depth) : _client(client), _pool(depth), _slots(std::ptrdiff_t(depth)) {}
+
+    std::future<push_result> submit(signed_write tx) {
+      _slots.acquire();
+      return _pool.submit([this, tx = std::move(tx)] {
+        auto r = _client.push(tx);
+        _slots.release();
+        return r;
+      });
+    }
+
+   private:
+    const chain_client& _client;
+    thread_pool _pool;
+    std::counting_semaphore<> _slots;
+  };
+
+} // namespace feeder
@@ -0,0 +1,369 @@
+#include "crypto.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+// The EC_KEY and one-shot digest calls are deprecated in OpenSSL 3 but still
+// the shortest way to raw secp256k1 points and compact signatures.
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+#include <openssl/rand.h>
+#include <openssl/ripemd.h>
+#include <openssl/sha.h>
+
+namespace feeder {
+
+  namespace {
+
+    const char base58_alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+    std::array<uint8_t, 20> ripemd160(const uint8_t* data, size_t size) {
+      std::array<uint8_t, 20> out;
+      RIPEMD160(data, size, out.data());
+      return out;
+    }
+
+    /// First four bytes of ripemd160(data || suffix), the checksum of every
+    /// K1 string form.
+    std::array<uint8_t, 4> checksum(const uint8_t* data, size_t size, std::string_view suffix) {
+      std::vector<uint8_t> buf(data, data + size);
+      buf.insert(buf.end(), suffix.begin(), suffix.end());
+      auto h = ripemd160(buf.data(), buf.size());
+      return {h[0], h[1], h[2], h[3]};
+    }
+
+    template <size_t N>
+    std::string encode_with_checksum(std::string_view prefix, const std::array<uint8_t, N>& data, std::string_view suffix) {
+      std::vector<uint8_t> buf(data.begin(), data.end());
+      auto c = checksum(data.data(), data.size(), suffix);
+      buf.insert(buf.end(), c.begin(), c.end());
+      return std::string(prefix) + base58_encode(buf.data(), buf.size());
+    }
+
+    template <size_t N>
+    std::array<uint8_t, N> decode_with_checksum(std::string_view text, std::string_view suffix, const char* what) {
+      auto raw = base58_decode(text);
+      if (raw.size() != N + 4) throw std::invalid_argument(std::string(what) + " has the wrong length");
+      auto c = checksum(raw.data(), N, suffix);
+      if (std::memcmp(c.data(), raw.data() + N, 4) != 0) throw std::invalid_argument(std::string(what) + " checksum mismatch");
+      std::array<uint8_t, N> out;
+      std::memcpy(out.data(), raw.data(), N);
+      return out;
+    }
+
+    struct bn_ctx {
+      BN_CTX* ctx = BN_CTX_new();
+      ~bn_ctx() { BN_CTX_free(ctx); }
+    };
+
+    BN_CTX* thread_ctx() {
+      thread_local bn_ctx c;
+      return c.ctx;
+    }
+
+    // read-only after construction, shared by all threads
+    struct curve {
+      EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+      BIGNUM* order = BN_new();
+      BIGNUM* half_order = BN_new();
+
+      curve() {
+        EC_GROUP_get_order(group, order, nullptr);
+        BN_rshift1(half_order, order);
+      }
+    };
+
+    const curve& secp256k1() {
+      static const curve c;
+      return c;
+    }
+
+    bool is_canonical(const signature_data& c) {
+      return !(c[1] & 0x80) && !(c[1] == 0 && !(c[2] & 0x80)) && !(c[33] & 0x80) && !(c[33] == 0 && !(c[34] & 0x80));
+    }
+
+    std::optional<public_key_data> point_to_key(const EC_POINT* p) {
+      public_key_data out;
+      if (EC_POINT_point2oct(secp256k1().group, p, POINT_CONVERSION_COMPRESSED, out.data(), out.size(), thread_ctx()) != out.size())
+        return std::nullopt;
+      return out;
+    }
+
+  } // namespace
+
+  sha256_digest sha256(const void* data, size_t size) {
+    sha256_digest out;
+    SHA256(static_cast<const unsigned char*>(data), size, out.data());
+    return out;
+  }
+
+  std::string base58_encode(const uint8_t* data, size_t size) {
+    std::vector<uint8_t> digits; // little-endian base 58
+    for (size_t i = 0; i < size; ++i) {
+      uint32_t carry = data[i];
+      for (auto& d : digits) {
+        carry += uint32_t(d) << 8;
+        d = uint8_t(carry % 58);
+        carry /= 58;
+      }
+      for (; carry; carry /= 58) digits.push_back(uint8_t(carry % 58));
+    }
+    std::string out;
+    for (size_t i = 0; i < size && data[i] == 0; ++i) out += '1';
+    for (auto itr = digits.rbegin(); itr != digits.rend(); ++itr) out += base58_alphabet[*itr];
+    return out;
+  }
+
+  std::vector<uint8_t> base58_decode(std::string_view text) {
+    std::vector<uint8_t> out;
+    for (char c : text) {
+      const char* p = c ? std::strchr(base58_alphabet, c) : nullptr;
+      if (p == nullptr) throw std::invalid_argument(std::string("bad base58 character '") + c + "'");
+      uint32_t carry = uint32_t(p - base58_alphabet);
+      for (auto itr = out.rbegin(); itr != out.rend(); ++itr) {
+        carry += uint32_t(*itr) * 58;
+        *itr = uint8_t(carry);
+        carry >>= 8;
+      }
+      for (; carry; carry >>= 8) out.insert(out.begin(), uint8_t(carry));
+    }
+    for (size_t i = 0; i < text.size() && text[i] == '1'; ++i) out.insert(out.begin(), 0);
+    return out;
+  }
+
+  std::string to_hex(const uint8_t* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+      out[2 * i] = digits[data[i] >> 4];
+      out[2 * i + 1] = digits[data[i] & 0x0f];
+    }
+    return out;
+  }
+
+  std::vector<uint8_t> from_hex(std::string_view hex) {
+    auto nibble = [](char c) -> uint8_t {
+      if (c >= '0' && c <= '9') return uint8_t(c - '0');
+      if (c >= 'a' && c <= 'f') return uint8_t(c - 'a' + 10);
+      if (c >= 'A' && c <= 'F') return uint8_t(c - 'A' + 10);
+      throw std::invalid_argument("bad hex digit");
+    };
+    if (hex.size() % 2) throw std::invalid_argument("hex string has odd length");
+    std::vector<uint8_t> out(hex.size() / 2);
+    for (size_t i = 0; i < out.size(); ++i) out[i] = uint8_t(nibble(hex[2 * i]) << 4 | nibble(hex[2 * i + 1]));
+    return out;
+  }
+
+  std::string public_key_to_string(const public_key_data& key) {
+    return encode_with_checksum("EOS", key, "");
+  }
+
+  public_key_data public_key_from_string(std::string_view text) {
+    if (text.substr(0, 7) == "PUB_K1_") return decode_with_checksum<33>(text.substr(7), "K1", "public key");
+    if (text.substr(0, 3) == "EOS") return decode_with_checksum<33>(text.substr(3), "", "public key");
+    throw std::invalid_argument("public key must start with EOS or PUB_K1_");
+  }
+
+  std::string signature_to_string(const signature_data& sig) {
+    return encode_with_checksum("SIG_K1_", sig, "K1");
+  }
+
+  signature_data signature_from_string(std::string_view text) {
+    if (text.substr(0, 7) != "SIG_K1_") throw std::invalid_argument("only SIG_K1_ signatures are supported");
+    return decode_with_checksum<65>(text.substr(7), "K1", "signature");
+  }
+
+  std::optional<public_key_data> recover_key(const sha256_digest& digest, const signature_data& sig) {
+    int recid = sig[0] - 27;
+    if (recid >= 4) recid -= 4; // compressed flag
+    if (recid < 0 || recid > 3) return std::nullopt;
+
+    auto& c = secp256k1();
+    BN_CTX* ctx = thread_ctx();
+    BN_CTX_start(ctx);
+    BIGNUM* r = BN_CTX_get(ctx);
+    BIGNUM* s = BN_CTX_get(ctx);
+    BIGNUM* x = BN_CTX_get(ctx);
+    BIGNUM* e = BN_CTX_get(ctx);
+    BIGNUM* rinv = BN_CTX_get(ctx);
+    BIGNUM* u1 = BN_CTX_get(ctx);
+    BIGNUM* u2 = BN_CTX_get(ctx);
+    EC_POINT* R = EC_POINT_new(c.group);
+    EC_POINT* Q = EC_POINT_new(c.group);
+
+    std::optional<public_key_data> result;
+    BN_bin2bn(sig.data() + 1, 32, r);
+    BN_bin2bn(sig.data() + 33, 32, s);
+    BN_bin2bn(digest.data(), 32, e);
+
+    // R has x = r (+ n for ids 2 and 3) and the parity given by the id;
+    // then key = r^-1 (s R - e G)
+    bool ok = !BN_is_zero(r) && !BN_is_zero(s) && BN_cmp(r, c.order) < 0 && BN_cmp(s, c.order) < 0 &&
+              BN_copy(x, r) && (recid < 2 || BN_add(x, x, c.order)) &&
+              EC_POINT_set_compressed_coordinates(c.group, R, x, recid & 1, ctx) &&
+              BN_mod_inverse(rinv, r, c.order, ctx) &&
+              BN_mod_mul(u1, e, rinv, c.order, ctx) && BN_mod_sub(u1, c.order, u1, c.order, ctx) &&
+              BN_mod_mul(u2, s, rinv, c.order, ctx) &&
+              EC_POINT_mul(c.group, Q, u1, R, u2, ctx) && !EC_POINT_is_at_infinity(c.group, Q);
+    if (ok) result = point_to_key(Q);
+
+    EC_POINT_free(Q);
+    EC_POINT_free(R);
+    BN_CTX_end(ctx);
+    return result;
+  }
+
+  // k^-1, r = (kG).x mod n and the recovery id of kG: everything in a
+  // signature that does not depend on the digest. Each is used once.
+  struct nonce {
+    BIGNUM* kinv = BN_new();
+    BIGNUM* r = BN_new();
+    uint8_t recid = 0;
+
+    nonce() = default;
+    nonce(nonce&& o) noexcept : kinv(std::exchange(o.kinv, nullptr)), r(std::exchange(o.r, nullptr)), recid(o.recid) {}
+    nonce& operator=(nonce&&) = delete;
+    ~nonce() {
+      BN_clear_free(kinv);
+      BN_clear_free(r);
+    }
+  };
+
+  struct private_key::impl {
+    EC_KEY* key = EC_KEY_new_by_curve_name(NID_secp256k1);
+    std::mutex mutex;
+    std::vector<nonce> pool;
+
+    ~impl() { EC_KEY_free(key); }
+
+    // nodeos wants r's 32 bytes to read as a positive DER integer without
+    // padding: the top bit clear, and a zero first byte only if needed.
+    // Low-s makes the same hold for s, so about half of all nonces are
+    // rejected here rather than after signing.
+    static bool canonical_r(const BIGNUM* r) {
+      int bits = BN_num_bits(r);
+      return bits >= 248 && bits <= 255;
+    }
+
+    static nonce make_nonce() {
+      auto& c = secp256k1();
+      BN_CTX* ctx = thread_ctx();
+      BN_CTX_start(ctx);
+      BIGNUM* k = BN_CTX_get(ctx);
+      BIGNUM* x = BN_CTX_get(ctx);
+      BIGNUM* y = BN_CTX_get(ctx);
+      EC_POINT* R = EC_POINT_new(c.group);
+
+      nonce n;
+      bool ok = false;
+      while (!ok) {
+        ok = BN_priv_rand_range(k, c.order) && !BN_is_zero(k) && EC_POINT_mul(c.group, R, k, nullptr, nullptr, ctx) &&
+             EC_POINT_get_affine_coordinates(c.group, R, x, y, ctx) && BN_nnmod(n.r, x, c.order, ctx) &&
+             BN_mod_inverse(n.kinv, k, c.order, ctx) && canonical_r(n.r);
+      }
+      n.recid = uint8_t((BN_is_odd(y) ? 1 : 0) | (BN_cmp(x, c.order) >= 0 ? 2 : 0));
+
+      EC_POINT_free(R);
+      BN_clear(k);
+      BN_CTX_end(ctx);
+      return n;
+    }
+  };
+
+  private_key::private_key(std::unique_ptr<impl> i) : _impl(std::move(i)) {
+    auto p = point_to_key(EC_KEY_get0_public_key(_impl->key));
+    if (!p) throw std::invalid_argument("cannot derive public key");
+    _public_key = *p;
+  }
+
+  private_key::private_key(private_key&&) noexcept = default;
+  private_key& private_key::operator=(private_key&&) noexcept = default;
+  private_key::~private_key() = default;
+
+  private_key private_key::from_string(std::string_view text) {
+    std::array<uint8_t, 32> secret;
+    if (text.substr(0, 7) == "PVT_K1_") {
+      secret = decode_with_checksum<32>(text.substr(7), "K1", "private key");
+    } else {
+      auto raw = base58_decode(text);
+      if (raw.size() != 37 || raw[0] != 0x80) throw std::invalid_argument("private key is not a WIF K1 key");
+      auto h = sha256(raw.data(), 33);
+      h = sha256(h.data(), h.size());
+      if (std::memcmp(h.data(), raw.data() + 33, 4) != 0) throw std::invalid_argument("private key checksum mismatch");
+      std::memcpy(secret.data(), raw.data() + 1, 32);
+    }
+
+    auto i = std::make_unique<impl>();
+    auto& c = secp256k1();
+    BIGNUM* d = BN_bin2bn(secret.data(), 32, nullptr);
+    EC_POINT* pub = EC_POINT_new(c.group);
+    bool ok = !BN_is_zero(d) && BN_cmp(d, c.order) < 0 && EC_POINT_mul(c.group, pub, d, nullptr, nullptr, thread_ctx()) &&
+              EC_KEY_set_private_key(i->key, d) && EC_KEY_set_public_key(i->key, pub);
+    EC_POINT_free(pub);
+    BN_clear_free(d);
+    if (!ok) throw std::invalid_argument("private key is out of range");
+    return private_key(std::move(i));
+  }
+
+  void private_key::precompute(size_t count) {
+    for (;;) {
+      {
+        std::lock_guard lock(_impl->mutex);
+        if (_impl->pool.size() >= count) return;
+      }
+      auto n = impl::make_nonce();
+      std::lock_guard lock(_impl->mutex);
+      _impl->pool.push_back(std::move(n));
+    }
+  }
+
+  size_t private_key::precomputed() const {
+    std::lock_guard lock(_impl->mutex);
+    return _impl->pool.size();
+  }
+
+  signature_data private_key::sign(const sha256_digest& digest) const {
+    auto& c = secp256k1();
+    for (;;) {
+      std::optional<nonce> n;
+      {
+        std::lock_guard lock(_impl->mutex);
+        if (!_impl->pool.empty()) {
+          n.emplace(std::move(_impl->pool.back()));
+          _impl->pool.pop_back();
+        }
+      }
+      if (!n) n.emplace(impl::make_nonce());
+
+      // with k and r known up front, the recovery id comes for free instead
+      // of by trial recovery
+      ECDSA_SIG* sig = ECDSA_do_sign_ex(digest.data(), int(digest.size()), n->kinv, n->r, _impl->key);
+      if (sig == nullptr) throw std::runtime_error("ECDSA_do_sign_ex failed");
+
+      const BIGNUM* r = nullptr;
+      const BIGNUM* s = nullptr;
+      ECDSA_SIG_get0(sig, &r, &s);
+      uint8_t recid = n->recid;
+      BIGNUM* low_s = BN_dup(s);
+      if (BN_cmp(low_s, c.half_order) > 0) {
+        BN_sub(low_s, c.order, low_s);
+        recid ^= 1; // negating s signs for -R
+      }
+
+      signature_data out{};
+      out[0] = uint8_t(27 + 4 + recid);
+      BN_bn2binpad(r, out.data() + 1, 32);
+      BN_bn2binpad(low_s, out.data() + 33, 32);
+      BN_free(low_s);
+      ECDSA_SIG_free(sig);
+
+      if (is_canonical(out)) return out;
+    }
+  }
+
+} // namespace feeder
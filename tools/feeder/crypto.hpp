@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The few pieces of EOSIO key handling a pusher needs: sha256, K1 keys in
+// their string forms, and compact recoverable signatures as nodeos expects
+// them (canonical, low-s). Backed by OpenSSL's libcrypto.
+namespace feeder {
+
+  using sha256_digest = std::array<uint8_t, 32>;
+  using public_key_data = std::array<uint8_t, 33>; // compressed point
+  using signature_data = std::array<uint8_t, 65>;  // recovery byte, r, s
+
+  sha256_digest sha256(const void* data, size_t size);
+
+  std::string base58_encode(const uint8_t* data, size_t size);
+  std::vector<uint8_t> base58_decode(std::string_view text);
+
+  std::string to_hex(const uint8_t* data, size_t size);
+  std::vector<uint8_t> from_hex(std::string_view hex);
+
+  /// "EOS..." legacy form
+  std::string public_key_to_string(const public_key_data& key);
+  /// "EOS..." or "PUB_K1_..."
+  public_key_data public_key_from_string(std::string_view text);
+
+  /// "SIG_K1_..."
+  std::string signature_to_string(const signature_data& sig);
+  signature_data signature_from_string(std::string_view text);
+
+  /// The key a signature over digest was made with, if it is well formed.
+  std::optional<public_key_data> recover_key(const sha256_digest& digest, const signature_data& sig);
+
+  class private_key {
+   public:
+    /// WIF ("5...") or "PVT_K1_..."; throws std::invalid_argument.
+    static private_key from_string(std::string_view text);
+
+    private_key(private_key&&) noexcept;
+    private_key& operator=(private_key&&) noexcept;
+    ~private_key();
+
+    const public_key_data& public_key() const { return _public_key; }
+
+    /// Retries with fresh nonces until the signature is canonical. Thread
+    /// safe.
+    signature_data sign(const sha256_digest& digest) const;
+
+    /// Signing is mostly the curve multiplication for its random nonce,
+    /// which does not depend on what is signed. Computes nonces ahead, up to
+    /// count in store, so that many signatures later cost a few modular
+    /// operations. Meant for idle time.
+    void precompute(size_t count);
+    size_t precomputed() const;
+
+   private:
+    struct impl;
+    explicit private_key(std::unique_ptr<impl> i);
+
+    std::unique_ptr<impl> _impl;
+    public_key_data _public_key{};
+  };
+
+} // namespace feeder
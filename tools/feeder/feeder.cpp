@@ -0,0 +1,547 @@
+/*
+
+  delphifeeder
+
+  Fetches prices from a set of HTTP sources concurrently, aggregates them
+  per pair and pushes every pair that has enough sources in a single write
+  action, once per interval. Reports, per cycle, how long the fetches took
+  and the latency from the start of the cycle to the broadcast returning.
+
+  delphifeeder [options] <config.json>
+    --cycles <n>     stop after n cycles (default: run until interrupted)
+    --dry-run        print the write action instead of broadcasting it
+    --cleos <path>   broadcast with this cleos binary even when
+                     DELPHIFEEDER_KEY is set
+    --quiet          only print the latency summary
+
+  Config:
+    {
+      "node": "http://127.0.0.1:8888",
+      "contract": "delphioracle",
+      "owner": "eostitan",
+      "permission": "active",
+      "interval_ms": 60000,
+      "cooldown_ms": 55000,
+      "timeout_ms": 5000,
+      "threads": 8,
+      "pairs": [ {"name": "tlosusd", "scale": 10000, "min_sources": 2,
+                  "max_age_ms": 120000, "mad_k": 3, "min_band_bps": 50,
+                  "deviation_bps": 50, "heartbeat_s": 3600} ],
+      "sources": [
+        {"name": "cryptocompare",
+         "url": "https://min-api.cryptocompare.com/data/price?fsym=TLOS&tsyms=USD",
+         "quotes": {"tlosusd": "USD"}},
+        {"name": "kucoin",
+         "url": "https://api.kucoin.com/api/v1/market/stats?symbol=TLOS-USDT",
+         "quotes": {"tlosusd": {"price": "data.last", "volume": "data.volValue",
+                                "time": "data.time"}}}
+      ]
+    }
+  interval_ms should be no shorter than the contract's write_cooldown, which
+  cooldown_ms repeats, and timeout_ms bounds each source request. A source's quotes map pairs to a
+  dotted path into its json response, where numeric parts index arrays
+  ("data.0.price"), or an object with paths to the price and, optionally,
+  its volume and its time in seconds or ms since the epoch. Prices are
+  multiplied by the pair's scale and rounded, as the contract expects
+  integers.
+
+  A pair's quotes are aggregated by feeder::aggregate: quotes older than
+  max_age_ms (0, the default, keeps all; a quote without a time is as old
+  as its response) are dropped, then those further than mad_k median
+  absolute deviations from the median, but never closer than min_band_bps
+  of it. The value written is the volume-weighted median of the rest.
+  Quotes without a volume weigh nothing unless none of the pair's have
+  one, and then all weigh the same. min_sources counts what is left.
+
+  A pair with a heartbeat_s is only written when its value has moved
+  deviation_bps from the last value written, or when the heartbeat is
+  less than cooldown_ms away; these should match the pair's setband on
+  chain, which refuses other writes. Without one, every pair is written
+  every cycle.
+
+  A source that fails or times out is reported and left out; the pairs it
+  fed are still written if min_sources others answered.
+
+  With DELPHIFEEDER_KEY set to the owner's private key the feeder signs
+  locally and pushes to the node itself: TAPOS comes from a cached
+  get_info and signing nonces are computed while waiting for the next
+  cycle, so a push costs one http request. Otherwise cleos signs with the
+  key in keosd.
+
+*/
+
+#include "aggregate.hpp"
+#include "http.hpp"
+#include "thread_pool.hpp"
+#if FEEDER_WITH_SIGNER
+#include "chain.hpp"
+#endif
+
+#include <mock/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace {
+
+using json = eosio::mock::json;
+using clock_type = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+struct pair_config {
+  std::string name;
+  double scale = 10000;
+  size_t min_sources = 1;
+  int64_t max_age_ms = 0;
+  double mad_k = 3;
+  uint32_t min_band_bps = 50;
+  uint64_t deviation_bps = 0;
+  milliseconds heartbeat{0};
+};
+
+// What was last broadcast for a pair, to hold back writes inside its band.
+struct last_write {
+  bool written = false;
+  uint64_t value = 0;
+  clock_type::time_point time;
+};
+
+// A pair with a heartbeat is written when its value has moved deviation_bps
+// from the last one written, or when the heartbeat is less than a cooldown
+// away, the earliest the contract takes a write inside the band.
+bool inside_band(const pair_config& p, const last_write& last, uint64_t value, clock_type::time_point now,
+                 milliseconds cooldown) {
+  if (p.heartbeat.count() == 0 || !last.written) return false;
+  if (now - last.time + cooldown >= p.heartbeat) return false;
+  uint64_t diff = value > last.value ? value - last.value : last.value - value;
+  return (unsigned __int128)diff * 10000 < (unsigned __int128)p.deviation_bps * last.value;
+}
+
+struct quote_paths {
+  std::string pair;
+  std::string price, volume, time; // json paths, volume and time may be empty
+};
+
+struct source_config {
+  std::string name;
+  feeder::url url;
+  std::vector<quote_paths> quotes;
+};
+
+struct feeder_config {
+  std::string node = "http://127.0.0.1:8888";
+  std::string contract = "delphioracle";
+  std::string owner;
+  std::string permission = "active";
+  milliseconds interval{60000};
+  milliseconds cooldown{55000};
+  milliseconds timeout{5000};
+  size_t threads = 8;
+  std::vector<pair_config> pairs;
+  std::vector<source_config> sources;
+};
+
+std::string text_or(const json& j, std::string_view key, std::string fallback) {
+  auto v = j.find(key);
+  return v ? v->text : fallback;
+}
+
+feeder_config load_config(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) throw std::runtime_error("cannot open " + path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  auto j = json::parse(ss.str());
+
+  feeder_config c;
+  c.node = text_or(j, "node", c.node);
+  c.contract = text_or(j, "contract", c.contract);
+  c.owner = j.at("owner").text;
+  c.permission = text_or(j, "permission", c.permission);
+  c.interval = milliseconds(std::stoll(text_or(j, "interval_ms", "60000")));
+  c.cooldown = milliseconds(std::stoll(text_or(j, "cooldown_ms", "55000")));
+  c.timeout = milliseconds(std::stoll(text_or(j, "timeout_ms", "5000")));
+  c.threads = std::stoul(text_or(j, "threads", "8"));
+
+  for (auto& p : j.at("pairs").items) {
+    pair_config pc;
+    pc.name = p.at("name").text;
+    pc.scale = std::stod(text_or(p, "scale", "10000"));
+    pc.min_sources = std::stoul(text_or(p, "min_sources", "1"));
+    pc.max_age_ms = std::stoll(text_or(p, "max_age_ms", "0"));
+    pc.mad_k = std::stod(text_or(p, "mad_k", "3"));
+    pc.min_band_bps = uint32_t(std::stoul(text_or(p, "min_band_bps", "50")));
+    pc.deviation_bps = std::stoull(text_or(p, "deviation_bps", "0"));
+    pc.heartbeat = milliseconds(std::stoll(text_or(p, "heartbeat_s", "0")) * 1000);
+    if (pc.deviation_bps > 0 && pc.heartbeat.count() == 0)
+      throw std::runtime_error("pair " + pc.name + " has a deviation_bps but no heartbeat_s");
+    c.pairs.push_back(pc);
+  }
+  for (auto& s : j.at("sources").items) {
+    source_config sc;
+    sc.url = feeder::url::parse(s.at("url").text);
+    sc.name = text_or(s, "name", sc.url.host);
+    for (auto& [pair, path] : s.at("quotes").members) {
+      bool known = std::any_of(c.pairs.begin(), c.pairs.end(), [&](auto& p) { return p.name == pair; });
+      if (!known) throw std::runtime_error("source " + sc.name + " quotes unknown pair " + pair);
+      if (path.is_object())
+        sc.quotes.push_back({pair, path.at("price").text, text_or(path, "volume", ""), text_or(path, "time", "")});
+      else
+        sc.quotes.push_back({pair, path.text, "", ""});
+    }
+    c.sources.push_back(std::move(sc));
+  }
+  if (c.pairs.empty() || c.sources.empty()) throw std::runtime_error("config needs at least one pair and one source");
+  return c;
+}
+
+const json* resolve(const json& root, std::string_view path) {
+  const json* v = &root;
+  while (v && !path.empty()) {
+    auto dot = path.find('.');
+    auto part = path.substr(0, dot);
+    path = dot == std::string_view::npos ? std::string_view() : path.substr(dot + 1);
+    if (v->is_array()) {
+      size_t i = std::strtoul(std::string(part).c_str(), nullptr, 10);
+      v = i < v->items.size() ? &v->items[i] : nullptr;
+    } else {
+      v = v->find(part);
+    }
+  }
+  return v;
+}
+
+struct sample {
+  std::string pair;
+  double price = 0;
+  double volume = 0; // 0 when the source gives none
+  int64_t time = 0;  // ms since epoch
+};
+
+struct source_result {
+  std::vector<sample> samples;
+  double ms = 0;
+  std::string error;
+};
+
+int64_t epoch_ms() {
+  return std::chrono::duration_cast<milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+double number_at(const json& body, const std::string& path) {
+  auto v = resolve(body, path);
+  if (v == nullptr || !(v->is_number() || v->is_string())) throw std::runtime_error("nothing at " + path);
+  double x = std::strtod(v->text.c_str(), nullptr);
+  if (!std::isfinite(x) || x < 0) throw std::runtime_error("bad number at " + path + ": " + v->text);
+  return x;
+}
+
+source_result fetch(const source_config& s, milliseconds timeout) {
+  source_result r;
+  auto start = clock_type::now();
+  try {
+    auto res = feeder::http_get(s.url, timeout);
+    if (res.status != 200) throw std::runtime_error("http status " + std::to_string(res.status));
+    auto body = json::parse(res.body);
+    int64_t received = epoch_ms();
+    for (auto& q : s.quotes) {
+      sample x{q.pair, number_at(body, q.price), 0, received};
+      if (!(x.price > 0)) throw std::runtime_error("bad price at " + q.price);
+      if (!q.volume.empty()) x.volume = number_at(body, q.volume);
+      if (!q.time.empty()) {
+        double t = number_at(body, q.time);
+        x.time = int64_t(t < 1e11 ? t * 1000 : t);
+      }
+      r.samples.push_back(std::move(x));
+    }
+  } catch (const std::exception& e) {
+    r.samples.clear();
+    r.error = e.what();
+  }
+  r.ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+  return r;
+}
+
+// Volumes only matter relative to each other, so they are scaled to the
+// largest before becoming the aggregator's integer weights.
+void to_quote_set(const std::vector<sample>& samples, double scale, feeder::quote_set& out) {
+  double largest = 0;
+  for (auto& x : samples) largest = std::max(largest, x.volume);
+  out.clear();
+  out.reserve(samples.size());
+  for (auto& x : samples)
+    out.push(std::llround(x.price * scale), largest > 0 ? uint64_t(std::llround(x.volume / largest * 1e9)) : 0, x.time);
+}
+
+struct quote {
+  std::string pair;
+  uint64_t value;
+};
+
+std::string write_action_json(const feeder_config& c, const std::vector<quote>& quotes) {
+  std::string out = "{\"owner\":\"" + c.owner + "\",\"quotes\":[";
+  for (size_t i = 0; i < quotes.size(); ++i) {
+    if (i) out += ",";
+    out += "{\"value\":" + std::to_string(quotes[i].value) + ",\"pair\":\"" + quotes[i].pair + "\"}";
+  }
+  return out + "]}";
+}
+
+struct broadcaster {
+  virtual ~broadcaster() = default;
+  /// Throws on failure.
+  virtual void push(const feeder_config& c, const std::vector<quote>& quotes) = 0;
+  /// Called once a cycle while waiting for the next one.
+  virtual void idle() {}
+};
+
+struct dry_run_broadcaster : broadcaster {
+  bool print = true;
+  void push(const feeder_config& c, const std::vector<quote>& quotes) override {
+    if (print) std::printf("write %s\n", write_action_json(c, quotes).c_str());
+  }
+};
+
+// cleos signs with its wallet; the feeder only needs the key unlocked there
+struct cleos_broadcaster : broadcaster {
+  std::string cleos = "cleos";
+
+  void push(const feeder_config& c, const std::vector<quote>& quotes) override {
+    std::string data = write_action_json(c, quotes);
+    std::string auth = c.owner + "@" + c.permission;
+    std::vector<std::string> args = {cleos, "-u", c.node, "push", "action", c.contract, "write", data, "-p", auth};
+    std::vector<char*> argv;
+    for (auto& a : args) argv.push_back(a.data());
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+
+    pid_t pid = 0;
+    int rc = posix_spawnp(&pid, cleos.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (rc != 0) throw std::runtime_error("cannot run " + cleos + ": " + std::strerror(rc));
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) throw std::runtime_error("cleos push action failed");
+  }
+};
+
+#if FEEDER_WITH_SIGNER
+struct native_broadcaster : broadcaster {
+  feeder::private_key key;
+  feeder::chain_client client;
+  feeder::tapos_cache tapos;
+  feeder::write_builder builder;
+
+  native_broadcaster(const feeder_config& c, feeder::private_key k)
+      : key(std::move(k)), client(c.node, c.timeout), tapos(client), builder(c.contract, c.owner, c.permission) {}
+
+  void push(const feeder_config&, const std::vector<quote>& quotes) override {
+    std::vector<feeder::quote> q;
+    q.reserve(quotes.size());
+    for (auto& x : quotes) q.push_back({x.value, feeder::string_to_name(x.pair)});
+
+    auto snap = tapos.current();
+    auto r = client.push(builder.sign(q, snap.expiration, snap.ref, snap.chain_id, key));
+    if (!r.ok) throw std::runtime_error(r.error);
+  }
+
+  void idle() override { key.precompute(4); }
+};
+#endif
+
+std::atomic<bool> stopping{false};
+
+void on_signal(int) { stopping = true; }
+
+double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[size_t(p * double(v.size() - 1) + 0.5)];
+}
+
+void usage() {
+  std::cerr << "usage: delphifeeder [--cycles <n>] [--dry-run] [--cleos <path>] [--quiet] <config.json>\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string config_path;
+  long cycles = 0;
+  bool dry_run = false;
+  bool quiet = false;
+  std::string cleos;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--cycles") cycles = std::stol(next());
+    else if (arg == "--dry-run") dry_run = true;
+    else if (arg == "--cleos") cleos = next();
+    else if (arg == "--quiet") quiet = true;
+    else if (!arg.empty() && arg[0] == '-') { usage(); return 2; }
+    else config_path = arg;
+  }
+  if (config_path.empty()) { usage(); return 2; }
+
+  feeder_config config;
+  try {
+    config = load_config(config_path);
+  } catch (const std::exception& e) {
+    std::cerr << "delphifeeder: " << e.what() << "\n";
+    return 1;
+  }
+
+  std::unique_ptr<broadcaster> out;
+  const char* key = std::getenv("DELPHIFEEDER_KEY");
+  if (dry_run) {
+    auto d = std::make_unique<dry_run_broadcaster>();
+    d->print = !quiet;
+    out = std::move(d);
+  } else if (key != nullptr && cleos.empty()) {
+#if FEEDER_WITH_SIGNER
+    try {
+      out = std::make_unique<native_broadcaster>(config, feeder::private_key::from_string(key));
+    } catch (const std::exception& e) {
+      std::cerr << "delphifeeder: DELPHIFEEDER_KEY: " << e.what() << "\n";
+      return 1;
+    }
+#else
+    std::cerr << "delphifeeder: built without OpenSSL, cannot sign; unset DELPHIFEEDER_KEY to use cleos\n";
+    return 1;
+#endif
+  } else {
+    auto c = std::make_unique<cleos_broadcaster>();
+    if (!cleos.empty()) c->cleos = cleos;
+    out = std::move(c);
+  }
+
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+
+  feeder::thread_pool pool(std::min(config.threads, config.sources.size()));
+  feeder::quote_set set;
+  std::vector<double> fetch_ms, total_ms;
+  size_t failed_pushes = 0;
+  std::vector<last_write> last(config.pairs.size());
+  size_t pair_writes = 0, pairs_held = 0;
+
+  auto next_cycle = clock_type::now();
+  for (long cycle = 1; !stopping && (cycles == 0 || cycle <= cycles); ++cycle) {
+    auto start = clock_type::now();
+
+    std::vector<std::future<source_result>> pending;
+    pending.reserve(config.sources.size());
+    for (auto& s : config.sources)
+      pending.push_back(pool.submit([&s, &config] { return fetch(s, config.timeout); }));
+
+    std::map<std::string, std::vector<sample>> samples;
+    size_t sources_ok = 0;
+    double slowest = 0;
+    for (size_t i = 0; i < pending.size(); ++i) {
+      auto r = pending[i].get();
+      slowest = std::max(slowest, r.ms);
+      if (!r.error.empty()) {
+        std::fprintf(stderr, "cycle %ld: source %s failed after %.1f ms: %s\n", cycle, config.sources[i].name.c_str(),
+                     r.ms, r.error.c_str());
+        continue;
+      }
+      sources_ok++;
+      for (auto& x : r.samples) samples[x.pair].push_back(std::move(x));
+    }
+    auto fetched = clock_type::now();
+
+    std::vector<quote> quotes;
+    std::vector<size_t> quoted; // index in config.pairs of each quote
+    size_t held = 0;
+    int64_t now = epoch_ms();
+    for (size_t k = 0; k < config.pairs.size(); ++k) {
+      auto& p = config.pairs[k];
+      to_quote_set(samples[p.name], p.scale, set);
+      auto r = feeder::aggregate(set, {now, p.max_age_ms, uint32_t(std::lround(p.mad_k * 1000)), p.min_band_bps});
+      if (r.fresh < set.size() || r.accepted < r.fresh)
+        std::fprintf(stderr, "cycle %ld: %s: dropped %zu stale, %zu outside %lld +- %lld\n", cycle, p.name.c_str(),
+                     set.size() - r.fresh, r.fresh - r.accepted, (long long)r.median, (long long)r.band);
+      if (r.accepted >= p.min_sources && r.accepted > 0) {
+        if (inside_band(p, last[k], uint64_t(r.value), fetched, config.cooldown)) {
+          held++;
+          continue;
+        }
+        quotes.push_back({p.name, uint64_t(r.value)});
+        quoted.push_back(k);
+      } else
+        std::fprintf(stderr, "cycle %ld: skipping %s, %zu of %zu sources\n", cycle, p.name.c_str(), r.accepted, p.min_sources);
+    }
+
+    std::string status = "ok";
+    if (quotes.empty()) {
+      status = "nothing to write";
+    } else {
+      try {
+        out->push(config, quotes);
+        for (size_t i = 0; i < quotes.size(); ++i)
+          last[quoted[i]] = {true, quotes[i].value, fetched};
+        pair_writes += quotes.size();
+      } catch (const std::exception& e) {
+        status = e.what();
+        failed_pushes++;
+      }
+    }
+    auto done = clock_type::now();
+
+    double fetch = std::chrono::duration<double, std::milli>(fetched - start).count();
+    double total = std::chrono::duration<double, std::milli>(done - start).count();
+    fetch_ms.push_back(fetch);
+    if (!quotes.empty()) total_ms.push_back(total);
+    pairs_held += held;
+    if (!quiet)
+      std::printf("cycle %ld  sources %zu/%zu  pairs %zu/%zu (%zu in band)  fetch %.1f ms (slowest source %.1f)  "
+                  "broadcast %.1f ms  total %.1f ms  %s\n",
+                  cycle, sources_ok, config.sources.size(), quotes.size(), config.pairs.size(), held, fetch, slowest,
+                  std::chrono::duration<double, std::milli>(done - fetched).count(), total, status.c_str());
+    std::fflush(stdout);
+
+    if (cycles != 0 && cycle == cycles) break;
+    next_cycle += config.interval;
+    out->idle();
+    while (!stopping && clock_type::now() < next_cycle)
+      std::this_thread::sleep_for(std::min<clock_type::duration>(next_cycle - clock_type::now(), milliseconds(100)));
+  }
+
+  std::printf("\n%-10s %8s %10s %10s %10s\n", "", "cycles", "p50_ms", "p99_ms", "max_ms");
+  std::printf("%-10s %8zu %10.1f %10.1f %10.1f\n", "fetch", fetch_ms.size(), percentile(fetch_ms, 0.5),
+              percentile(fetch_ms, 0.99), percentile(fetch_ms, 1.0));
+  std::printf("%-10s %8zu %10.1f %10.1f %10.1f\n", "end2end", total_ms.size(), percentile(total_ms, 0.5),
+              percentile(total_ms, 0.99), percentile(total_ms, 1.0));
+  if (pairs_held)
+    std::printf("%zu pair quotes written, %zu held inside their band\n", pair_writes, pairs_held);
+  if (failed_pushes) std::printf("%zu broadcast%s failed\n", failed_pushes, failed_pushes == 1 ? "" : "s");
+  return failed_pushes ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+#include "http.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if FEEDER_WITH_TLS
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+namespace feeder {
+
+  url url::parse(std::string_view text) {
+    url u;
+    auto sep = text.find("://");
+    if (sep == std::string_view::npos)
+      throw http_error("url has no scheme: " + std::string(text));
+    u.scheme = std::string(text.substr(0, sep));
+    if (u.scheme != "http" && u.scheme != "https")
+      throw http_error("unsupported url scheme: " + u.scheme);
+    text.remove_prefix(sep + 3);
+
+    auto slash = text.find('/');
+    auto authority = text.substr(0, slash);
+    u.target = slash == std::string_view::npos ? "/" : std::string(text.substr(slash));
+
+    auto colon = authority.rfind(':');
+    if (colon != std::string_view::npos && authority.find(']', colon) == std::string_view::npos) {
+      u.host = std::string(authority.substr(0, colon));
+      u.port = std::string(authority.substr(colon + 1));
+    } else {
+      u.host = std::string(authority);
+      u.port = u.scheme == "https" ? "443" : "80";
+    }
+    if (u.host.size() > 2 && u.host.front() == '[' && u.host.back() == ']')
+      u.host = u.host.substr(1, u.host.size() - 2);
+    if (u.host.empty())
+      throw http_error("url has no host");
+    return u;
+  }
+
+  namespace {
+
+    using clock = std::chrono::steady_clock;
+
+    class connection {
+     public:
+      connection(const url& u, clock::time_point deadline) : _deadline(deadline) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* res = nullptr;
+        if (int rc = getaddrinfo(u.host.c_str(), u.port.c_str(), &hints, &res); rc != 0)
+          throw http_error(u.host + ": " + gai_strerror(rc));
+
+        std::string last_error = "no addresses";
+        for (auto ai = res; ai != nullptr && _fd < 0; ai = ai->ai_next) {
+          int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+          if (fd < 0) continue;
+          if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0 || (errno == EINPROGRESS && wait(fd, POLLOUT))) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err == 0) {
+              _fd = fd;
+              break;
+            }
+            last_error = std::strerror(err);
+          } else {
+            last_error = errno == EINPROGRESS ? "connect timed out" : std::strerror(errno);
+          }
+          ::close(fd);
+        }
+        freeaddrinfo(res);
+        if (_fd < 0)
+          throw http_error(u.host + ":" + u.port + ": " + last_error);
+
+        int one = 1;
+        setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (u.scheme == "https")
+          start_tls(u.host);
+      }
+
+      ~connection() {
+#if FEEDER_WITH_TLS
+        if (_ssl) SSL_free(_ssl);
+#endif
+        if (_fd >= 0) ::close(_fd);
+      }
+
+      connection(const connection&) = delete;
+      connection& operator=(const connection&) = delete;
+
+      void send_all(std::string_view data) {
+        while (!data.empty()) {
+          ssize_t n = write_some(data);
+          if (n > 0) data.remove_prefix(size_t(n));
+        }
+      }
+
+      /// Bytes read, 0 at end of stream.
+      size_t read_some(char* buf, size_t size) {
+        for (;;) {
+#if FEEDER_WITH_TLS
+          if (_ssl) {
+            int n = SSL_read(_ssl, buf, int(size));
+            if (n > 0) return size_t(n);
+            int err = SSL_get_error(_ssl, n);
+            if (err == SSL_ERROR_ZERO_RETURN) return 0;
+            if (err == SSL_ERROR_SYSCALL && ERR_peek_error() == 0) return 0;
+            tls_wait(err, "read");
+            continue;
+          }
+#endif
+          ssize_t n = ::recv(_fd, buf, size, 0);
+          if (n >= 0) return size_t(n);
+          if (errno == EINTR) continue;
+          if (errno != EAGAIN && errno != EWOULDBLOCK) throw http_error(std::string("recv: ") + std::strerror(errno));
+          if (!wait(_fd, POLLIN)) throw http_error("timed out waiting for response");
+        }
+      }
+
+     private:
+      int _fd = -1;
+      clock::time_point _deadline;
+#if FEEDER_WITH_TLS
+      SSL* _ssl = nullptr;
+#endif
+
+      bool wait(int fd, short events) const {
+        for (;;) {
+          auto left = std::chrono::duration_cast<std::chrono::milliseconds>(_deadline - clock::now()).count();
+          if (left <= 0) return false;
+          pollfd p{fd, events, 0};
+          int rc = ::poll(&p, 1, int(left));
+          if (rc > 0) return true;
+          if (rc == 0) return false;
+          if (errno != EINTR) return false;
+        }
+      }
+
+      ssize_t write_some(std::string_view data) {
+#if FEEDER_WITH_TLS
+        if (_ssl) {
+          int n = SSL_write(_ssl, data.data(), int(data.size()));
+          if (n > 0) return n;
+          tls_wait(SSL_get_error(_ssl, n), "write");
+          return 0;
+        }
+#endif
+        ssize_t n = ::send(_fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n >= 0) return n;
+        if (errno == EINTR) return 0;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) throw http_error(std::string("send: ") + std::strerror(errno));
+        if (!wait(_fd, POLLOUT)) throw http_error("timed out sending request");
+        return 0;
+      }
+
+#if FEEDER_WITH_TLS
+      static SSL_CTX* tls_context() {
+        static SSL_CTX* ctx = [] {
+          SSL_CTX* c = SSL_CTX_new(TLS_client_method());
+          SSL_CTX_set_default_verify_paths(c);
+          SSL_CTX_set_verify(c, SSL_VERIFY_PEER, nullptr);
+          return c;
+        }();
+        return ctx;
+      }
+
+      void tls_wait(int err, const char* what) {
+        if (err == SSL_ERROR_WANT_READ) {
+          if (!wait(_fd, POLLIN)) throw http_error(std::string("tls ") + what + " timed out");
+        } else if (err == SSL_ERROR_WANT_WRITE) {
+          if (!wait(_fd, POLLOUT)) throw http_error(std::string("tls ") + what + " timed out");
+        } else {
+          char buf[256];
+          ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+          throw http_error(std::string("tls ") + what + ": " + buf);
+        }
+      }
+
+      void start_tls(const std::string& host) {
+        _ssl = SSL_new(tls_context());
+        SSL_set_fd(_ssl, _fd);
+        SSL_set_tlsext_host_name(_ssl, host.c_str());
+        SSL_set1_host(_ssl, host.c_str());
+        for (;;) {
+          int rc = SSL_connect(_ssl);
+          if (rc == 1) return;
+          tls_wait(SSL_get_error(_ssl, rc), "handshake");
+        }
+      }
+#else
+      void start_tls(const std::string&) {
+        throw http_error("https is not available: tools were built without OpenSSL");
+      }
+#endif
+    };
+
+    std::string decode_chunked(std::string_view body) {
+      std::string out;
+      while (!body.empty()) {
+        auto eol = body.find("\r\n");
+        if (eol == std::string_view::npos) throw http_error("truncated chunked body");
+        size_t size = std::stoul(std::string(body.substr(0, eol)), nullptr, 16);
+        body.remove_prefix(eol + 2);
+        if (size == 0) break;
+        if (body.size() < size + 2) throw http_error("truncated chunked body");
+        out.append(body.substr(0, size));
+        body.remove_prefix(size + 2);
+      }
+      return out;
+    }
+
+    bool header_is(std::string_view headers, std::string_view name, std::string_view value) {
+      auto lower = [](std::string_view s) {
+        std::string r(s);
+        for (auto& c : r) c = char(std::tolower((unsigned char)c));
+        return r;
+      };
+      auto h = lower(headers);
+      auto key = "\r\n" + lower(name) + ":";
+      auto pos = h.find(key);
+      if (pos == std::string::npos) return false;
+      auto end = h.find("\r\n", pos + key.size());
+      return h.substr(pos + key.size(), end - pos - key.size()).find(lower(value)) != std::string::npos;
+    }
+
+  } // namespace
+
+  http_response http_request(const url& u, std::string_view method, std::string_view body,
+                             std::chrono::milliseconds timeout) {
+    connection conn(u, clock::now() + timeout);
+
+    std::string req;
+    req.reserve(256 + body.size());
+    req.append(method).append(" ").append(u.target).append(" HTTP/1.1\r\nHost: ").append(u.host);
+    if (u.port != (u.scheme == "https" ? "443" : "80")) req.append(":").append(u.port);
+    req.append("\r\nUser-Agent: delphifeeder\r\nAccept: application/json\r\nConnection: close\r\n");
+    if (method != "GET") {
+      req.append("Content-Type: application/json\r\nContent-Length: ").append(std::to_string(body.size())).append("\r\n");
+    }
+    req.append("\r\n").append(body);
+    conn.send_all(req);
+
+    // Connection: close, so the response ends with the stream
+    std::string raw;
+    char buf[16384];
+    while (size_t n = conn.read_some(buf, sizeof(buf)))
+      raw.append(buf, n);
+
+    auto header_end = raw.find("\r\n\r\n");
+    if (raw.compare(0, 5, "HTTP/") != 0 || header_end == std::string::npos)
+      throw http_error("malformed http response");
+
+    http_response res;
+    auto space = raw.find(' ');
+    res.status = std::atoi(raw.c_str() + space + 1);
+
+    std::string_view headers(raw.data(), header_end);
+    std::string_view payload(raw.data() + header_end + 4, raw.size() - header_end - 4);
+    res.body = header_is(headers, "Transfer-Encoding", "chunked") ? decode_chunked(payload) : std::string(payload);
+    return res;
+  }
+
+} // namespace feeder
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Blocking HTTP/1.1 client, one connection per request. Enough for price
+// APIs and a nodeos endpoint; https needs the tools built with OpenSSL.
+namespace feeder {
+
+  struct http_error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+  };
+
+  struct url {
+    std::string scheme;
+    std::string host;
+    std::string port;
+    std::string target;
+
+    static url parse(std::string_view text);
+  };
+
+  struct http_response {
+    int status = 0;
+    std::string body;
+  };
+
+  /// Throws http_error on connect, tls or protocol failure, or when the
+  /// whole exchange takes longer than timeout. Any status is returned.
+  http_response http_request(const url& u, std::string_view method, std::string_view body,
+                             std::chrono::milliseconds timeout);
+
+  inline http_response http_get(const url& u, std::chrono::milliseconds timeout) {
+    return http_request(u, "GET", {}, timeout);
+  }
+
+  inline http_response http_post(const url& u, std::string_view body, std::chrono::milliseconds timeout) {
+    return http_request(u, "POST", body, timeout);
+  }
+
+} // namespace feeder
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Thread-per-connection HTTP/1.1 server on loopback ports for the mock
+// sources and node. One request per connection, like the feeder's client.
+namespace feeder::mock {
+
+  struct request {
+    std::string method;
+    std::string target;
+    std::string body;
+  };
+
+  struct reply {
+    int status = 200;
+    std::string body;
+    int delay_ms = 0; // held back this long before it is sent
+  };
+
+  using handler = std::function<reply(const request&)>;
+
+  inline const char* status_text(int status) {
+    switch (status) {
+      case 200: return "OK";
+      case 202: return "Accepted";
+      case 400: return "Bad Request";
+      case 404: return "Not Found";
+      case 500: return "Internal Server Error";
+      case 503: return "Service Unavailable";
+      default: return "";
+    }
+  }
+
+  inline void serve_connection(int fd, const handler& h) {
+    std::string raw;
+    char buf[16384];
+    size_t header_end = std::string::npos;
+    size_t content_length = 0;
+    for (;;) {
+      if (header_end == std::string::npos && (header_end = raw.find("\r\n\r\n")) != std::string::npos) {
+        for (auto key : {"Content-Length:", "content-length:"})
+          if (auto pos = raw.find(key); pos != std::string::npos && pos < header_end)
+            content_length = std::strtoul(raw.c_str() + pos + std::strlen(key), nullptr, 10);
+      }
+      if (header_end != std::string::npos && raw.size() >= header_end + 4 + content_length) break;
+      ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0) { ::close(fd); return; }
+      raw.append(buf, size_t(n));
+    }
+
+    request req;
+    auto sp1 = raw.find(' ');
+    auto sp2 = raw.find(' ', sp1 + 1);
+    req.method = raw.substr(0, sp1);
+    req.target = raw.substr(sp1 + 1, sp2 - sp1 - 1);
+    req.body = raw.substr(header_end + 4, content_length);
+
+    reply rep = h(req);
+    if (rep.delay_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(rep.delay_ms));
+
+    std::string out = "HTTP/1.1 " + std::to_string(rep.status) + " " + status_text(rep.status) +
+                      "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(rep.body.size()) +
+                      "\r\nConnection: close\r\n\r\n" + rep.body;
+    for (std::string_view left = out; !left.empty();) {
+      ssize_t n = ::send(fd, left.data(), left.size(), MSG_NOSIGNAL);
+      if (n <= 0) break;
+      left.remove_prefix(size_t(n));
+    }
+    ::close(fd);
+  }
+
+  /// Listens on 127.0.0.1 at every port and never returns.
+  inline void serve(const std::vector<int>& ports, const handler& h, const char* who) {
+    std::vector<std::thread> listeners;
+    for (int port : ports) {
+      int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      int one = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(uint16_t(port));
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 512) != 0) {
+        std::fprintf(stderr, "%s: cannot listen on port %d: %s\n", who, port, std::strerror(errno));
+        std::exit(1);
+      }
+      listeners.emplace_back([fd, &h] {
+        for (;;) {
+          int client = ::accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+          if (client >= 0) std::thread(serve_connection, client, std::cref(h)).detach();
+        }
+      });
+    }
+    std::fprintf(stderr, "%s: serving %zu port%s\n", who, ports.size(), ports.size() == 1 ? "" : "s");
+    for (auto& t : listeners) t.join();
+  }
+
+} // namespace feeder::mock
@@ -0,0 +1,204 @@
+/*
+
+  mocknode
+
+  Local stand-in for a nodeos http endpoint, enough to push delphifeeder's
+  transactions at: get_info describes a chain that produces a block every
+  half second, and push_transaction checks expiration, TAPOS, the
+  signature and duplicates the way nodeos would before accepting.
+
+  mocknode [options]
+    --port <n>          listen on 127.0.0.1:n (default 8888), may be repeated
+    --key <public key>  only accept transactions signed by this key
+    --delay-ms <n>      time taken to apply a transaction (default 0)
+    --jitter-ms <n>     plus a uniform random 0..n ms
+
+*/
+
+#include "mock_server.hpp"
+#include "transaction.hpp"
+
+#include <mock/json.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::system_clock;
+
+struct settings {
+  std::optional<feeder::public_key_data> key;
+  int delay_ms = 0;
+  int jitter_ms = 0;
+};
+
+const auto chain_start = clock_type::now();
+const auto chain_id = [] {
+  const char seed[] = "delphioracle mock chain";
+  return feeder::sha256(seed, sizeof(seed) - 1);
+}();
+
+uint32_t head_block_num() {
+  return 2 + uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - chain_start).count() / 500);
+}
+
+uint32_t block_time(uint32_t num) {
+  return uint32_t(std::chrono::duration_cast<std::chrono::seconds>(chain_start.time_since_epoch()).count()) + num / 2;
+}
+
+feeder::sha256_digest block_id(uint32_t num) {
+  auto id = feeder::sha256(&num, sizeof(num));
+  id[0] = uint8_t(num >> 24);
+  id[1] = uint8_t(num >> 16);
+  id[2] = uint8_t(num >> 8);
+  id[3] = uint8_t(num);
+  return id;
+}
+
+std::string iso_time(uint32_t secs, uint32_t num) {
+  time_t t = secs;
+  std::tm tm{};
+  gmtime_r(&t, &tm);
+  char buf[40];
+  std::snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%s", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                tm.tm_hour, tm.tm_min, tm.tm_sec, num % 2 ? "500" : "000");
+  return buf;
+}
+
+feeder::mock::reply get_info() {
+  uint32_t head = head_block_num();
+  uint32_t lib = head - 1;
+  auto id = [](uint32_t n) { auto d = block_id(n); return feeder::to_hex(d.data(), d.size()); };
+  feeder::mock::reply rep;
+  rep.body = "{\"server_version\":\"mocknode\",\"chain_id\":\"" + feeder::to_hex(chain_id.data(), chain_id.size()) +
+             "\",\"head_block_num\":" + std::to_string(head) + ",\"last_irreversible_block_num\":" + std::to_string(lib) +
+             ",\"last_irreversible_block_id\":\"" + id(lib) + "\",\"head_block_id\":\"" + id(head) +
+             "\",\"head_block_time\":\"" + iso_time(block_time(head), head) + "\",\"head_block_producer\":\"eosio\"}";
+  return rep;
+}
+
+feeder::mock::reply failure(std::string_view name, std::string_view message) {
+  feeder::mock::reply rep;
+  rep.status = 500;
+  rep.body = "{\"code\":500,\"message\":\"Internal Service Error\",\"error\":{\"code\":0,\"name\":\"" + std::string(name) +
+             "\",\"what\":\"" + std::string(message) + "\",\"details\":[{\"message\":\"" + std::string(message) + "\"}]}}";
+  return rep;
+}
+
+std::mutex seen_mutex;
+std::set<feeder::sha256_digest> seen;
+std::mt19937 rng(7);
+std::atomic<uint64_t> accepted{0}, rejected{0};
+
+feeder::mock::reply push_transaction(const settings& s, const feeder::mock::request& req) {
+  using json = eosio::mock::json;
+
+  std::vector<uint8_t> trx;
+  std::vector<feeder::signature_data> sigs;
+  try {
+    auto j = json::parse(req.body);
+    trx = feeder::from_hex(j.at("packed_trx").text);
+    for (auto& sig : j.at("signatures").items) sigs.push_back(feeder::signature_from_string(sig.text));
+  } catch (const std::exception& e) {
+    return failure("parse_error_exception", e.what());
+  }
+  if (trx.size() < 10) return failure("transaction_type_exception", "packed_trx is too short");
+
+  uint32_t expiration, ref_prefix;
+  uint16_t ref_num;
+  std::memcpy(&expiration, trx.data(), 4);
+  std::memcpy(&ref_num, trx.data() + 4, 2);
+  std::memcpy(&ref_prefix, trx.data() + 6, 4);
+
+  uint32_t head = head_block_num();
+  uint32_t now = block_time(head);
+  if (expiration <= now) return failure("expired_tx_exception", "expired transaction");
+  if (expiration > now + 3600) return failure("tx_exp_too_far_exception", "transaction expiration is too far in the future");
+
+  // the block ref_num names is the most recent one with those low 16 bits
+  uint32_t ref_block = head - uint16_t(head - ref_num);
+  if (ref_block == 0 || feeder::tapos::from_block_id(block_id(ref_block)).ref_block_prefix != ref_prefix)
+    return failure("invalid_ref_block_exception", "transaction's reference block did not match");
+
+  auto digest = feeder::signing_digest(chain_id, trx);
+  if (sigs.empty()) return failure("unsatisfied_authorization", "transaction has no signatures");
+  for (auto& sig : sigs) {
+    auto key = feeder::recover_key(digest, sig);
+    if (!key) return failure("unsatisfied_authorization", "signature does not recover to a key");
+    if (s.key && *key != *s.key)
+      return failure("unsatisfied_authorization", "transaction declares authority but is signed by " + feeder::public_key_to_string(*key));
+  }
+
+  auto id = feeder::sha256(trx.data(), trx.size());
+  feeder::mock::reply rep;
+  {
+    std::lock_guard lock(seen_mutex);
+    if (!seen.insert(id).second) return failure("tx_duplicate", "duplicate transaction " + feeder::to_hex(id.data(), id.size()));
+    rep.delay_ms = s.delay_ms + (s.jitter_ms ? int(rng() % uint32_t(s.jitter_ms + 1)) : 0);
+  }
+
+  rep.status = 202;
+  rep.body = "{\"transaction_id\":\"" + feeder::to_hex(id.data(), id.size()) +
+             "\",\"processed\":{\"block_num\":" + std::to_string(head + 1) +
+             ",\"receipt\":{\"status\":\"executed\",\"cpu_usage_us\":" + std::to_string(100 + rep.delay_ms * 1000) +
+             ",\"net_usage_words\":" + std::to_string((trx.size() + 72 + 7) / 8) + "}}}";
+  return rep;
+}
+
+void usage() {
+  std::cerr << "usage: mocknode [--port <n>]... [--key <public key>] [--delay-ms <n>] [--jitter-ms <n>]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  settings s;
+  std::vector<int> ports;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--port") ports.push_back(std::stoi(next()));
+    else if (arg == "--key") s.key = feeder::public_key_from_string(next());
+    else if (arg == "--delay-ms") s.delay_ms = std::stoi(next());
+    else if (arg == "--jitter-ms") s.jitter_ms = std::stoi(next());
+    else { usage(); return 2; }
+  }
+  if (ports.empty()) ports.push_back(8888);
+
+  std::thread([] {
+    uint64_t last_accepted = 0, last_rejected = 0;
+    for (;;) {
+      std::this_thread::sleep_for(std::chrono::seconds(5));
+      if (accepted != last_accepted || rejected != last_rejected)
+        std::fprintf(stderr, "mocknode: %llu transactions accepted, %llu rejected\n", (unsigned long long)accepted.load(),
+                     (unsigned long long)rejected.load());
+      last_accepted = accepted;
+      last_rejected = rejected;
+    }
+  }).detach();
+
+  feeder::mock::serve(ports, [&s](const feeder::mock::request& req) {
+    if (req.target == "/v1/chain/get_info") return get_info();
+    if (req.target == "/v1/chain/push_transaction" || req.target == "/v1/chain/send_transaction") {
+      auto rep = push_transaction(s, req);
+      (rep.status == 202 ? accepted : rejected)++;
+      return rep;
+    }
+    feeder::mock::reply rep;
+    rep.status = 404;
+    rep.body = "{\"code\":404,\"message\":\"Not Found\"}";
+    return rep;
+  }, "mocknode");
+}
@@ -0,0 +1,97 @@
+/*
+
+  mocksource
+
+  Local stand-in for price APIs, to run delphifeeder against. Every GET on
+  any path answers {"<pair>": <price>, ...} after a delay, so a feeder
+  source can point at it with quotes {"<pair>": "<pair>"}.
+
+  mocksource [options]
+    --port <n>          listen on 127.0.0.1:n, may be repeated to serve
+                        several sources from one process
+    --price <pair=x>    price to serve, may be repeated (default tlosusd=0.05)
+    --delay-ms <n>      answer after n ms (default 0)
+    --jitter-ms <n>     plus a uniform random 0..n ms
+    --fail-rate <p>     answer 503 to this fraction of requests
+    --walk <r>          move every price by up to +-r (relative) per request
+
+*/
+
+#include "mock_server.hpp"
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct settings {
+  std::map<std::string, double> prices;
+  int delay_ms = 0;
+  int jitter_ms = 0;
+  double fail_rate = 0;
+  double walk = 0;
+};
+
+std::mutex state_mutex;
+std::mt19937_64 rng(42);
+
+feeder::mock::reply respond(settings& s) {
+  std::lock_guard lock(state_mutex);
+  feeder::mock::reply rep;
+  rep.delay_ms = s.delay_ms + (s.jitter_ms ? int(rng() % uint64_t(s.jitter_ms + 1)) : 0);
+  if (s.fail_rate > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < s.fail_rate) {
+    rep.status = 503;
+    return rep;
+  }
+
+  rep.body = "{";
+  for (auto& [pair, price] : s.prices) {
+    if (s.walk > 0) price *= 1 + std::uniform_real_distribution<double>(-s.walk, s.walk)(rng);
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.8f", price);
+    if (rep.body.size() > 1) rep.body += ",";
+    rep.body += "\"" + pair + "\":" + buf;
+  }
+  rep.body += "}";
+  return rep;
+}
+
+void usage() {
+  std::cerr << "usage: mocksource --port <n>... [--price <pair=x>]... [--delay-ms <n>] [--jitter-ms <n>] "
+               "[--fail-rate <p>] [--walk <r>]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  settings s;
+  std::vector<int> ports;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--port") ports.push_back(std::stoi(next()));
+    else if (arg == "--price") {
+      auto p = next();
+      auto eq = p.find('=');
+      if (eq == std::string::npos) { usage(); return 2; }
+      s.prices[p.substr(0, eq)] = std::stod(p.substr(eq + 1));
+    }
+    else if (arg == "--delay-ms") s.delay_ms = std::stoi(next());
+    else if (arg == "--jitter-ms") s.jitter_ms = std::stoi(next());
+    else if (arg == "--fail-rate") s.fail_rate = std::stod(next());
+    else if (arg == "--walk") s.walk = std::stod(next());
+    else { usage(); return 2; }
+  }
+  if (ports.empty()) { usage(); return 2; }
+  if (s.prices.empty()) s.prices["tlosusd"] = 0.05;
+
+  feeder::mock::serve(ports, [&s](const feeder::mock::request&) { return respond(s); }, "mocksource");
+}
@@ -0,0 +1,112 @@
+/*
+
+  delphireport
+
+  Signs writeagg reports with an oracle's key, for a relayer to collect.
+  Prints one json report per pair, in the form writeagg takes them. The
+  time is cut to the millisecond, as nodes print time points, so that the
+  report signs what the relayer's json will carry.
+
+  delphireport [options] --chain-id <hex> <owner> <pair>=<value>...
+    --chain-id <hex>      id of the chain the reports are for, as get_info
+                          prints it (required)
+    --contract <account>  account the contract runs as (default delphioracle)
+    --time <t>            report time, "2024-05-01T12:00:00.000" or us since
+                          the epoch (default now)
+  The signing key is read from DELPHIFEEDER_KEY.
+
+*/
+
+#include "transaction.hpp"
+
+#include <mock/abi_json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string format_time(int64_t us) {
+  time_t secs = time_t(us / 1000000);
+  std::tm tm{};
+  gmtime_r(&secs, &tm);
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%03d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                tm.tm_hour, tm.tm_min, tm.tm_sec, int(us / 1000 % 1000));
+  return buf;
+}
+
+void usage() {
+  std::cerr << "usage: delphireport --chain-id <hex> [--contract <account>] [--time <t>] <owner> <pair>=<value>...\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string chain_id, contract = "delphioracle", owner, time;
+  std::vector<std::string> quotes;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--chain-id") chain_id = next();
+    else if (arg == "--contract") contract = next();
+    else if (arg == "--time") time = next();
+    else if (!arg.empty() && arg[0] == '-') { usage(); return 2; }
+    else if (owner.empty()) owner = arg;
+    else quotes.push_back(arg);
+  }
+  if (chain_id.empty() || owner.empty() || quotes.empty()) { usage(); return 2; }
+
+  const char* key_text = std::getenv("DELPHIFEEDER_KEY");
+  if (key_text == nullptr) {
+    std::cerr << "delphireport: set DELPHIFEEDER_KEY to the oracle's key\n";
+    return 2;
+  }
+
+  try {
+    auto key = feeder::private_key::from_string(key_text);
+
+    auto id_bytes = feeder::from_hex(chain_id);
+    if (id_bytes.size() != 32) throw std::invalid_argument("chain id must be 32 bytes of hex");
+    feeder::sha256_digest id;
+    std::copy(id_bytes.begin(), id_bytes.end(), id.begin());
+
+    int64_t us;
+    if (time.empty())
+      us = std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+    else
+      us = eosio::mock::parse_time_point(eosio::mock::json::parse(
+               time.find_first_not_of("0123456789") == std::string::npos ? time : "\"" + time + "\""))
+               .elapsed.count();
+    us -= us % 1000;
+
+    for (auto& q : quotes) {
+      auto eq = q.find('=');
+      if (eq == std::string::npos) { usage(); return 2; }
+      std::string pair = q.substr(0, eq);
+      uint64_t value = std::stoull(q.substr(eq + 1));
+
+      auto digest = feeder::report_digest(id, feeder::string_to_name(contract), feeder::string_to_name(owner),
+                                          feeder::string_to_name(pair), value, us);
+      std::printf("{\"owner\":\"%s\",\"pair\":\"%s\",\"value\":%llu,\"timestamp\":\"%s\",\"sig\":\"%s\"}\n",
+                  owner.c_str(), pair.c_str(), (unsigned long long)value, format_time(us).c_str(),
+                  feeder::signature_to_string(key.sign(digest)).c_str());
+    }
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "delphireport: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace feeder {
+
+  /// Fixed set of workers taking tasks in submission order.
+  class thread_pool {
+   public:
+    explicit thread_pool(size_t threads) {
+      if (threads == 0) threads = 1;
+      _workers.reserve(threads);
+      for (size_t i = 0; i < threads; ++i)
+        _workers.emplace_back([this] { run(); });
+    }
+
+    ~thread_pool() {
+      {
+        std::lock_guard lock(_mutex);
+        _stopping = true;
+      }
+      _ready.notify_all();
+      for (auto& w : _workers) w.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    size_t size() const { return _workers.size(); }
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& f) {
+      // std::function needs a copyable target
+      auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(f));
+      auto result = task->get_future();
+      {
+        std::lock_guard lock(_mutex);
+        _tasks.emplace_back([task] { (*task)(); });
+      }
+      _ready.notify_one();
+      return result;
+    }
+
+   private:
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::deque<std::function<void()>> _tasks;
+    std::vector<std::thread> _workers;
+    bool _stopping = false;
+
+    void run() {
+      for (;;) {
+        std::function<void()> task;
+        {
+          std::unique_lock lock(_mutex);
+          _ready.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+          if (_tasks.empty()) return;
+          task = std::move(_tasks.front());
+          _tasks.pop_front();
+        }
+        task();
+      }
+    }
+  };
+
+} // namespace feeder
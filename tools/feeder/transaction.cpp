@@ -0,0 +1,124 @@
+#include "transaction.hpp"
+
+#include <cstring>
+
+namespace feeder {
+
+  namespace {
+
+    void put_varuint(std::vector<uint8_t>& out, uint32_t v) {
+      do {
+        uint8_t b = v & 0x7f;
+        v >>= 7;
+        out.push_back(b | (v ? 0x80 : 0));
+      } while (v);
+    }
+
+    template <typename T>
+    void put(std::vector<uint8_t>& out, T v) {
+      size_t at = out.size();
+      out.resize(at + sizeof(T));
+      std::memcpy(out.data() + at, &v, sizeof(T)); // the wire format is little endian, like the hosts this runs on
+    }
+
+    uint64_t char_to_symbol(char c) {
+      if (c >= 'a' && c <= 'z') return uint64_t(c - 'a') + 6;
+      if (c >= '1' && c <= '5') return uint64_t(c - '1') + 1;
+      return 0;
+    }
+
+  } // namespace
+
+  uint64_t string_to_name(std::string_view s) {
+    uint64_t n = 0;
+    size_t i = 0;
+    for (; i < s.size() && i < 12; ++i)
+      n |= (char_to_symbol(s[i]) & 0x1f) << (64 - 5 * (i + 1));
+    if (i == 12 && s.size() > 12)
+      n |= char_to_symbol(s[12]) & 0x0f;
+    return n;
+  }
+
+  tapos tapos::from_block_id(const sha256_digest& id) {
+    // the block number is the id's first four bytes, big endian
+    tapos t;
+    t.ref_block_num = uint16_t(id[2] << 8 | id[3]);
+    std::memcpy(&t.ref_block_prefix, id.data() + 8, 4);
+    return t;
+  }
+
+  std::string signed_write::to_json() const {
+    return "{\"signatures\":[\"" + signature_to_string(signature) +
+           "\"],\"compression\":\"none\",\"packed_context_free_data\":\"\",\"packed_trx\":\"" +
+           to_hex(packed_trx.data(), packed_trx.size()) + "\"}";
+  }
+
+  write_builder::write_builder(std::string_view contract, std::string_view owner, std::string_view permission)
+      : _owner(string_to_name(owner)) {
+    auto& h = _action_head;
+    put_varuint(h, 0);                 // max_net_usage_words
+    put<uint8_t>(h, 0);                // max_cpu_usage_ms
+    put_varuint(h, 0);                 // delay_sec
+    put_varuint(h, 0);                 // context_free_actions
+    put_varuint(h, 1);                 // actions
+    put(h, string_to_name(contract));  // account
+    put(h, string_to_name("write"));   // name
+    put_varuint(h, 1);                 // authorization
+    put(h, _owner);
+    put(h, string_to_name(permission));
+  }
+
+  const std::vector<uint8_t>& write_builder::pack(const std::vector<quote>& quotes, uint32_t expiration, const tapos& ref) {
+    auto& p = _packed;
+    p.clear();
+    put(p, expiration);
+    put(p, ref.ref_block_num);
+    put(p, ref.ref_block_prefix);
+    p.insert(p.end(), _action_head.begin(), _action_head.end());
+
+    std::vector<uint8_t> count;
+    put_varuint(count, uint32_t(quotes.size()));
+    put_varuint(p, uint32_t(sizeof(_owner) + count.size() + quotes.size() * 16)); // action data size
+    put(p, _owner);
+    p.insert(p.end(), count.begin(), count.end());
+    for (auto& q : quotes) {
+      put(p, q.value);
+      put(p, q.pair);
+    }
+
+    put_varuint(p, 0); // transaction_extensions
+    return p;
+  }
+
+  sha256_digest signing_digest(const sha256_digest& chain_id, const std::vector<uint8_t>& packed_trx) {
+    std::vector<uint8_t> buf;
+    buf.reserve(chain_id.size() + packed_trx.size() + 32);
+    buf.insert(buf.end(), chain_id.begin(), chain_id.end());
+    buf.insert(buf.end(), packed_trx.begin(), packed_trx.end());
+    buf.resize(buf.size() + 32, 0);
+    return sha256(buf.data(), buf.size());
+  }
+
+  sha256_digest report_digest(const sha256_digest& chain_id, uint64_t contract, uint64_t owner, uint64_t pair,
+                              uint64_t value, int64_t time_us) {
+    std::vector<uint8_t> buf;
+    buf.reserve(72);
+    buf.insert(buf.end(), chain_id.begin(), chain_id.end());
+    put(buf, contract);
+    put(buf, owner);
+    put(buf, pair);
+    put(buf, value);
+    put(buf, time_us);
+    return sha256(buf.data(), buf.size());
+  }
+
+  signed_write write_builder::sign(const std::vector<quote>& quotes, uint32_t expiration, const tapos& ref,
+                                   const sha256_digest& chain_id, const private_key& key) {
+    signed_write out;
+    out.packed_trx = pack(quotes, expiration, ref);
+    out.id = sha256(out.packed_trx.data(), out.packed_trx.size());
+    out.signature = key.sign(signing_digest(chain_id, out.packed_trx));
+    return out;
+  }
+
+} // namespace feeder
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "crypto.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Builds and signs transactions carrying one delphioracle::write action.
+// The action's layout is fixed by the contract, so there is no ABI to
+// fetch: everything but the header and the quotes is serialized once.
+namespace feeder {
+
+  /// delphioracle::quote
+  struct quote {
+    uint64_t value = 0;
+    uint64_t pair = 0; // eosio name
+  };
+
+  /// Reference block for TAPOS, from any recent block id.
+  struct tapos {
+    uint16_t ref_block_num = 0;
+    uint32_t ref_block_prefix = 0;
+
+    static tapos from_block_id(const sha256_digest& id);
+  };
+
+  struct signed_write {
+    std::vector<uint8_t> packed_trx;
+    signature_data signature;
+    sha256_digest id; // transaction id
+
+    /// Body for /v1/chain/push_transaction and send_transaction.
+    std::string to_json() const;
+  };
+
+  uint64_t string_to_name(std::string_view s);
+
+  class write_builder {
+   public:
+    write_builder(std::string_view contract, std::string_view owner, std::string_view permission);
+
+    /// Serialized transaction expiring at expiration (seconds since epoch).
+    const std::vector<uint8_t>& pack(const std::vector<quote>& quotes, uint32_t expiration, const tapos& ref);
+
+    /// pack, then sign for chain_id.
+    signed_write sign(const std::vector<quote>& quotes, uint32_t expiration, const tapos& ref,
+                      const sha256_digest& chain_id, const private_key& key);
+
+   private:
+    uint64_t _owner;
+    std::vector<uint8_t> _action_head; // resource limits through the authorization
+    std::vector<uint8_t> _packed;
+  };
+
+  /// sha256(chain_id || packed_trx || 32 zero bytes): no context free data.
+  sha256_digest signing_digest(const sha256_digest& chain_id, const std::vector<uint8_t>& packed_trx);
+
+  /// What an oracle signs for delphioracle::writeagg: the chain id, the
+  /// contract account, owner, pair, value and time in us since the epoch,
+  /// packed.
+  sha256_digest report_digest(const sha256_digest& chain_id, uint64_t contract, uint64_t owner, uint64_t pair,
+                              uint64_t value, int64_t time_us);
+
+} // namespace feeder
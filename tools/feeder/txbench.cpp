@@ -0,0 +1,167 @@
+/*
+
+  delphitxbench
+
+  Builds, signs and pushes write transactions as fast as a node takes them
+  and reports throughput and latency. The default mode is the feeder's:
+  TAPOS from a cached get_info, one pre-serialized action skeleton and up to
+  --depth pushes in flight. --naive does what a per-push client does: a
+  get_info, a fresh serialization and a push, one transaction at a time.
+
+  delphitxbench [options]
+    --node <url>          (default http://127.0.0.1:8888)
+    --contract <account>  (default delphioracle)
+    --owner <account>     (default eostitan)
+    --permission <name>   (default active)
+    --pairs <n>           quotes per write (default 4)
+    --count <n>           transactions to push (default 1000)
+    --depth <n>           pushes in flight (default 16)
+    --nonces <n>          precompute n signing nonces before starting, as
+                          the feeder does between pushes
+    --naive               serial, no caching
+  The signing key is read from DELPHIFEEDER_KEY.
+
+*/
+
+#include "chain.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double ms_since(clock_type::time_point t) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - t).count();
+}
+
+double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[size_t(p * double(v.size() - 1) + 0.5)];
+}
+
+// values differ per transaction, and per run, so transaction ids do too
+const uint64_t run_base = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                                       std::chrono::system_clock::now().time_since_epoch()).count());
+
+std::vector<feeder::quote> quotes_for(size_t i, size_t pairs) {
+  static const char* names[] = {"tlosusd", "btcusd", "ethusd", "eosusd", "tloseos", "tlosbtc", "usdtusd", "eosbtc"};
+  std::vector<feeder::quote> q;
+  for (size_t p = 0; p < pairs; ++p)
+    q.push_back({run_base + i, feeder::string_to_name(names[p % 8])});
+  return q;
+}
+
+void usage() {
+  std::cerr << "usage: delphitxbench [--node <url>] [--contract <account>] [--owner <account>] [--permission <name>] "
+               "[--pairs <n>] [--count <n>] [--depth <n>] [--nonces <n>] [--naive]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string node = "http://127.0.0.1:8888", contract = "delphioracle", owner = "eostitan", permission = "active";
+  size_t pairs = 4, count = 1000, depth = 16, nonces = 0;
+  bool naive = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--node") node = next();
+    else if (arg == "--contract") contract = next();
+    else if (arg == "--owner") owner = next();
+    else if (arg == "--permission") permission = next();
+    else if (arg == "--pairs") pairs = std::stoul(next());
+    else if (arg == "--count") count = std::stoul(next());
+    else if (arg == "--depth") depth = std::max<size_t>(1, std::stoul(next()));
+    else if (arg == "--nonces") nonces = std::stoul(next());
+    else if (arg == "--naive") naive = true;
+    else { usage(); return 2; }
+  }
+
+  const char* key_text = std::getenv("DELPHIFEEDER_KEY");
+  if (key_text == nullptr) {
+    std::cerr << "delphitxbench: set DELPHIFEEDER_KEY to the signing key\n";
+    return 2;
+  }
+
+  try {
+    auto key = feeder::private_key::from_string(key_text);
+    if (nonces) {
+      auto t0 = clock_type::now();
+      key.precompute(nonces);
+      std::printf("precomputed %zu nonces in %.1f ms\n", nonces, ms_since(t0));
+    }
+    feeder::chain_client client(node, std::chrono::milliseconds(10000));
+    feeder::tapos_cache tapos(client);
+    feeder::write_builder cached_builder(contract, owner, permission);
+    feeder::push_pipeline pipeline(client, naive ? 1 : depth);
+
+    std::vector<double> prepare_ms, push_ms, latency_ms;
+    size_t failed = 0;
+    std::string first_error;
+    auto collect = [&](std::future<feeder::push_result>& f, clock_type::time_point started) {
+      auto r = f.get();
+      push_ms.push_back(r.ms);
+      latency_ms.push_back(ms_since(started));
+      if (!r.ok && failed++ == 0) first_error = r.error;
+    };
+
+    std::deque<std::pair<std::future<feeder::push_result>, clock_type::time_point>> in_flight;
+    auto start = clock_type::now();
+    for (size_t i = 0; i < count; ++i) {
+      auto t0 = clock_type::now();
+      feeder::signed_write tx;
+      if (naive) {
+        auto info = client.get_info();
+        feeder::write_builder builder(contract, owner, permission);
+        tx = builder.sign(quotes_for(i, pairs), info.head_block_time + 60,
+                          feeder::tapos::from_block_id(info.last_irreversible_block_id), info.chain_id, key);
+      } else {
+        auto snap = tapos.current();
+        tx = cached_builder.sign(quotes_for(i, pairs), snap.expiration, snap.ref, snap.chain_id, key);
+      }
+      prepare_ms.push_back(ms_since(t0));
+
+      // the oldest push is collected first so the window keeps moving
+      while (in_flight.size() >= (naive ? 1 : depth)) {
+        collect(in_flight.front().first, in_flight.front().second);
+        in_flight.pop_front();
+      }
+      in_flight.emplace_back(pipeline.submit(std::move(tx)), t0);
+      if (naive) {
+        collect(in_flight.front().first, in_flight.front().second);
+        in_flight.pop_front();
+      }
+    }
+    for (auto& [f, t0] : in_flight) collect(f, t0);
+    double elapsed = ms_since(start);
+
+    std::printf("%s: %zu transactions, %zu quotes each, %zu failed, %.1f s, %.0f tx/s\n",
+                naive ? "naive" : ("pipelined, depth " + std::to_string(depth)).c_str(), count, pairs, failed,
+                elapsed / 1000.0, double(count) / (elapsed / 1000.0));
+    std::printf("%-22s %10s %10s %10s\n", "", "p50_ms", "p99_ms", "max_ms");
+    std::printf("%-22s %10.3f %10.3f %10.3f\n", naive ? "get_info+build+sign" : "build+sign", percentile(prepare_ms, 0.5),
+                percentile(prepare_ms, 0.99), percentile(prepare_ms, 1.0));
+    std::printf("%-22s %10.3f %10.3f %10.3f\n", "push", percentile(push_ms, 0.5), percentile(push_ms, 0.99),
+                percentile(push_ms, 1.0));
+    std::printf("%-22s %10.3f %10.3f %10.3f\n", "build to accepted", percentile(latency_ms, 0.5),
+                percentile(latency_ms, 0.99), percentile(latency_ms, 1.0));
+    if (!naive) std::printf("get_info calls: %llu\n", (unsigned long long)tapos.fetches());
+    if (failed) std::printf("first failure: %s\n", first_error.c_str());
+    return failed ? 1 : 0;
+  } catch (const std::exception& e) {
+    std::cerr << "delphitxbench: " << e.what() << "\n";
+    return 1;
+  }
+}
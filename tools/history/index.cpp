@@ -0,0 +1,242 @@
+/*
+
+  delphiindex
+
+  Indexes the contract's history from a stream of irreversible blocks (see
+  trace_stream.hpp) into a columnar store, or queries a store.
+
+  delphiindex [options] <store dir>
+    --file <traces>          index the blocks in a trace file
+    --connect <host:port>    index the blocks served there until the other
+                             end closes
+    --contract <account>     (default delphioracle)
+    --token <account>        token contract whose transfers the contract is
+                             notified of (default eosio.token)
+    --sync-blocks <n>        flush the store every n blocks (default 100000)
+    --ordinals <file>        the contract's ordinals table, as cleos get table
+                             prints it, to decode writepacked with
+    --global <file>          its global table, for the window size and write
+                             cooldown the medians are taken with (default 21
+                             rows and 55 s)
+    --pairs <file>           its pairs table, for their heartbeats (default
+                             none)
+    --query <pair>           print the pair's datapoints instead
+    --transfers <scope>      print the transfers under scope instead
+    --from <time>            limit a query to rows at or after time, as
+                             "2024-05-01T12:00:00" or us since the epoch
+    --to <time>              and before time
+    --limit <n>              print at most n rows, the latest (default 20)
+
+  Indexing resumes after the block the store last recorded, so the same
+  stream can be fed again. The tables given apply from the first block
+  indexed; configure and setband actions in the stream change them after. It prints the blocks, datapoints and transfers
+  it indexed and the rate, and how many writepacked quotes it skipped for
+  want of an ordinal in --ordinals or of an earlier value in the store.
+
+*/
+
+#include "indexer.hpp"
+
+#include <mock/abi_json.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+uint64_t parse_time(const std::string& text) {
+  auto j = eosio::mock::json::parse(text.find('T') == std::string::npos ? text : "\"" + text + "\"");
+  return uint64_t(eosio::mock::parse_time_point(j).time_since_epoch().count());
+}
+
+std::string format_time(uint64_t us) {
+  time_t secs = time_t(us / 1000000);
+  std::tm tm{};
+  gmtime_r(&secs, &tm);
+  char buf[40];
+  std::snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%03d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                tm.tm_hour, tm.tm_min, tm.tm_sec, int(us / 1000 % 1000));
+  return buf;
+}
+
+std::string format_quantity(uint64_t amount, uint64_t raw_symbol) {
+  eosio::symbol sym(raw_symbol);
+  std::string digits = std::to_string(amount);
+  if (sym.precision()) {
+    if (digits.size() <= sym.precision()) digits.insert(0, sym.precision() + 1 - digits.size(), '0');
+    digits.insert(digits.size() - sym.precision(), ".");
+  }
+  return digits + " " + sym.code().to_string();
+}
+
+// a table as cleos get table prints it: {"rows": [...], "more": false}
+eosio::mock::json load_rows(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) throw std::runtime_error("cannot open " + path);
+  std::stringstream text;
+  text << in.rdbuf();
+  auto j = eosio::mock::json::parse(text.str());
+  return j.at("rows");
+}
+
+void load_tables(history::indexer& idx, const std::string& ordinals, const std::string& global,
+                 const std::string& pairs) {
+  if (!ordinals.empty())
+    for (auto& row : load_rows(ordinals).items)
+      idx.set_ordinal(std::stoull(row.at("ordinal").text), eosio::name(row.at("pair").text).value);
+  if (!global.empty()) {
+    auto rows = load_rows(global);
+    if (rows.items.empty()) throw std::runtime_error(global + " has no global row");
+    idx.set_window(std::stoull(rows.items[0].at("datapoints_per_instrument").text));
+    idx.set_cooldown(std::stoull(rows.items[0].at("write_cooldown").text));
+  }
+  if (!pairs.empty())
+    for (auto& row : load_rows(pairs).items) {
+      // a row written before heartbeats were added has none
+      auto heartbeat = row.find("heartbeat");
+      if (heartbeat && heartbeat->is_number())
+        idx.set_heartbeat(eosio::name(row.at("name").text).value, uint32_t(std::stoul(heartbeat->text)));
+    }
+}
+
+struct query {
+  std::string pair, scope;
+  uint64_t from = 0, to = UINT64_MAX;
+  size_t limit = 20;
+};
+
+int run_query(const std::string& dir, const query& q) {
+  history::store s(dir, false);
+  auto start = clock_type::now();
+  if (!q.pair.empty()) {
+    auto series = s.find_pair(eosio::name(q.pair).value);
+    if (!series) {
+      std::cerr << "delphiindex: no datapoints for " << q.pair << "\n";
+      return 1;
+    }
+    auto r = series->range(q.from, q.to);
+    double us = std::chrono::duration<double, std::micro>(clock_type::now() - start).count();
+    std::printf("%zu datapoints of %zu in range, found in %.1f us\n", r.size(), series->size(), us);
+    std::printf("%-24s %-13s %20s %20s\n", "time", "owner", "value", "median");
+    for (size_t i = r.size() - std::min(r.size(), q.limit); i < r.size(); ++i)
+      std::printf("%-24s %-13s %20llu %20llu\n", format_time(r.time[i]).c_str(),
+                  eosio::name(r.owner[i]).to_string().c_str(), (unsigned long long)r.value[i],
+                  (unsigned long long)r.median[i]);
+  } else {
+    auto series = s.find_transfers(eosio::name(q.scope).value);
+    if (!series) {
+      std::cerr << "delphiindex: no transfers under " << q.scope << "\n";
+      return 1;
+    }
+    auto r = series->range(q.from, q.to);
+    std::printf("%zu transfers of %zu in range\n", r.size(), series->size());
+    std::printf("%-24s %-13s %24s\n", "time", "from", "quantity");
+    for (size_t i = r.size() - std::min(r.size(), q.limit); i < r.size(); ++i)
+      std::printf("%-24s %-13s %24s\n", format_time(r.time[i]).c_str(), eosio::name(r.from[i]).to_string().c_str(),
+                  format_quantity(r.amount[i], r.symbol[i]).c_str());
+  }
+  return 0;
+}
+
+void usage() {
+  std::cerr << "usage: delphiindex [--file <traces> | --connect <host:port>] [--contract <account>] "
+               "[--token <account>] [--sync-blocks <n>] [--ordinals <file>] "
+               "[--global <file>] [--pairs <file>] <store dir>\n"
+               "       delphiindex (--query <pair> | --transfers <scope>) [--from <time>] [--to <time>] "
+               "[--limit <n>] <store dir>\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string dir, file, address, ordinals, global, pairs, contract = "delphioracle", token = "eosio.token";
+  uint64_t sync_blocks = 100000;
+  query q;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--file") file = next();
+    else if (arg == "--connect") address = next();
+    else if (arg == "--contract") contract = next();
+    else if (arg == "--token") token = next();
+    else if (arg == "--sync-blocks") sync_blocks = std::max<uint64_t>(1, std::stoull(next()));
+    else if (arg == "--ordinals") ordinals = next();
+    else if (arg == "--global") global = next();
+    else if (arg == "--pairs") pairs = next();
+    else if (arg == "--query") q.pair = next();
+    else if (arg == "--transfers") q.scope = next();
+    else if (arg == "--from") q.from = parse_time(next());
+    else if (arg == "--to") q.to = parse_time(next());
+    else if (arg == "--limit") q.limit = std::stoul(next());
+    else if (!arg.empty() && arg[0] == '-') { usage(); return 2; }
+    else dir = arg;
+  }
+  bool querying = !q.pair.empty() || !q.scope.empty();
+  if (dir.empty() || querying == (!file.empty() || !address.empty()) || (!file.empty() && !address.empty())) {
+    usage();
+    return 2;
+  }
+
+  try {
+    if (querying) return run_query(dir, q);
+
+    history::store s(dir, true);
+    history::indexer idx(s, eosio::name(contract).value, eosio::name(token).value);
+    load_tables(idx, ordinals, global, pairs);
+    uint64_t resumed = s.head().block;
+    uint64_t bytes = 0, since_sync = 0;
+    auto apply = [&](const history::block_view& b) {
+      idx.apply(b);
+      if (++since_sync == sync_blocks) {
+        idx.sync();
+        since_sync = 0;
+      }
+    };
+
+    auto start = clock_type::now();
+    if (!file.empty()) {
+      history::file_input in(file);
+      bytes = history::for_each_block(in.data(), in.size(), apply);
+      if (bytes != in.size()) std::fprintf(stderr, "delphiindex: %zu bytes of partial frame at the end of %s\n",
+                                           in.size() - bytes, file.c_str());
+    } else {
+      history::socket_input in(address);
+      std::vector<uint8_t> buf;
+      while (in.read(buf) > 0) {
+        size_t used = history::for_each_block(buf.data(), buf.size(), apply);
+        buf.erase(buf.begin(), buf.begin() + used);
+        bytes += used;
+      }
+    }
+    double parsed = std::chrono::duration<double>(clock_type::now() - start).count();
+    idx.sync();
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    auto& st = idx.stats();
+    if (resumed) std::printf("resumed after block %llu, skipped %llu blocks\n", (unsigned long long)resumed,
+                             (unsigned long long)st.skipped_blocks);
+    std::printf("%llu blocks, %llu actions, %llu writes, %llu datapoints, %llu transfers, head %u\n",
+                (unsigned long long)st.blocks, (unsigned long long)st.actions, (unsigned long long)st.writes,
+                (unsigned long long)st.datapoints, (unsigned long long)st.transfers, idx.head().block);
+    if (st.packed_skipped) std::printf("%llu writepacked quotes skipped, without an ordinal or an earlier value\n",
+                                       (unsigned long long)st.packed_skipped);
+    std::printf("%.2f s, %.2f M datapoints/s, %.0f MB/s of stream (%.2f s before the final sync)\n", elapsed,
+                double(st.datapoints) / elapsed / 1e6, double(bytes) / elapsed / 1e6, parsed);
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "delphiindex: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,256 @@
+#include "indexer.hpp"
+
+#include <eosio/name.hpp>
+
+#include <algorithm>
+#include <string_view>
+
+namespace history {
+
+  namespace {
+    // writepacked's numbers: unsigned LEB128, up to 64 bits
+    uint64_t varint(cursor& c) {
+      uint64_t v = 0;
+      for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t b = *c.bytes(1);
+        v |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+      }
+      throw stream_error("varint too long");
+    }
+  } // namespace
+
+  median_window::median_window(size_t slots) : _value(slots), _time(slots), _sorted(slots) { _fresh.reserve(slots); }
+
+  void median_window::replace(uint64_t value, uint64_t time) {
+    // oldest by time, then by row id, as the contract's timestamp index
+    // orders them
+    size_t oldest = 0;
+    for (size_t i = 1; i < _time.size(); ++i)
+      if (_time[i] < _time[oldest]) oldest = i;
+
+    uint64_t old = _value[oldest];
+    _value[oldest] = value;
+    _time[oldest] = time;
+
+    // _sorted holds the same values in order: take old out, put value in
+    auto out = std::lower_bound(_sorted.begin(), _sorted.end(), old);
+    auto in = std::upper_bound(_sorted.begin(), _sorted.end(), value);
+    if (in <= out) {
+      std::move_backward(in, out, out + 1);
+      *in = value;
+    } else {
+      std::move(out + 1, in, out);
+      *(in - 1) = value;
+    }
+  }
+
+  uint64_t median_window::push(uint64_t value, uint64_t time) {
+    replace(value, time);
+    return _sorted[(_sorted.size() - 1) / 2];
+  }
+
+  uint64_t median_window::push(uint64_t value, uint64_t time, uint64_t cutoff) {
+    replace(value, time);
+    _fresh.clear();
+    for (size_t i = 0; i < _value.size(); ++i)
+      if (_time[i] > cutoff) _fresh.push_back(_value[i]);
+    auto mid = _fresh.begin() + (_fresh.size() - 1) / 2;
+    std::nth_element(_fresh.begin(), mid, _fresh.end());
+    return *mid;
+  }
+
+  indexer::indexer(store& s, uint64_t contract, uint64_t token)
+      : _store(s), _contract(contract), _token(token), _head(s.head()) {
+    for (auto& [pair, series] : s.pairs()) _pairs[pair].series = series.get();
+  }
+
+  indexer::pair_state& indexer::state(uint64_t pair) {
+    if (pair == _last_pair && _last_state) return *_last_state;
+    auto& st = _pairs[pair];
+    if (!st.series) st.series = &_store.pair(pair);
+    if (!st.loaded) {
+      st.window = median_window(_slots);
+      size_t n = st.series->size();
+      auto last = st.series->rows(n - std::min<size_t>(n, _slots), n);
+      for (size_t i = 0; i < last.size(); ++i) st.window.push(last.value[i], last.time[i]);
+      auto h = _heartbeats.find(pair);
+      st.heartbeat = h == _heartbeats.end() ? 0 : h->second;
+      st.loaded = true;
+    }
+    _last_pair = pair;
+    _last_state = &st;
+    return st;
+  }
+
+  // the rows that count on a pair with a heartbeat are those written after
+  // now less the heartbeat and a cooldown, as the contract's stale_before
+  uint64_t indexer::push(pair_state& st, uint64_t value, uint64_t time) {
+    if (st.heartbeat == 0) return st.window.push(value, time);
+    uint64_t age = uint64_t(st.heartbeat) * 1000000 + _cooldown;
+    return st.window.push(value, time, time > age ? time - age : 0);
+  }
+
+  void indexer::set_heartbeat(uint64_t pair, uint32_t heartbeat) {
+    _heartbeats[pair] = heartbeat;
+    auto st = _pairs.find(pair);
+    if (st != _pairs.end() && st->second.loaded) st->second.heartbeat = heartbeat;
+  }
+
+  // scans back only over the rows appended since the last look, so an oracle
+  // that writes packed every minute costs a few rows per quote
+  const uint64_t* indexer::last(pair_state& st, uint64_t owner) {
+    auto& l = st.last[owner];
+    size_t n = st.series->size();
+    if (n > l.rows) {
+      auto r = st.series->rows(l.rows, n);
+      for (size_t i = r.size(); i-- > 0;)
+        if (r.owner[i] == owner) {
+          l.value = r.value[i];
+          l.found = true;
+          break;
+        }
+      l.rows = n;
+    }
+    return l.found ? &l.value : nullptr;
+  }
+
+  void indexer::on_write(const action_trace& a, uint64_t time) {
+    cursor c{a.data, a.data + a.size};
+    uint64_t owner = c.get<uint64_t>();
+    uint32_t n = c.varuint();
+    for (uint32_t i = 0; i < n; ++i) {
+      uint64_t value = c.get<uint64_t>();
+      uint64_t pair = c.get<uint64_t>();
+      auto& st = state(pair);
+      st.series->append(time, value, push(st, value, time), owner);
+    }
+    _stats.writes++;
+    _stats.datapoints += n;
+  }
+
+  // writepacked: ordinal and zigzag encoded difference per quote, as the
+  // contract decodes them
+  void indexer::on_writepacked(const action_trace& a, uint64_t time) {
+    cursor c{a.data, a.data + a.size};
+    uint64_t owner = c.get<uint64_t>();
+    uint32_t size = c.varuint();
+    cursor q{c.bytes(size), c.pos};
+    while (q.pos != q.end) {
+      uint64_t ordinal = varint(q);
+      uint64_t delta = varint(q);
+      auto o = _ordinals.find(ordinal);
+      if (o == _ordinals.end() || !_pairs.count(o->second)) {
+        _stats.packed_skipped++;
+        continue;
+      }
+      auto& st = state(o->second);
+      auto prev = last(st, owner);
+      if (!prev) {
+        _stats.packed_skipped++;
+        continue;
+      }
+      uint64_t value = *prev + uint64_t(int64_t(delta >> 1) ^ -int64_t(delta & 1));
+      st.series->append(time, value, push(st, value, time), owner);
+      _stats.datapoints++;
+    }
+    _stats.writes++;
+  }
+
+  // writeagg: reports grouped by pair, and the median after each group set
+  // on all of its rows
+  void indexer::on_writeagg(const action_trace& a, uint64_t time) {
+    cursor c{a.data, a.data + a.size};
+    c.get<uint64_t>(); // relayer
+    uint32_t n = c.varuint();
+    uint64_t group_pair = 0;
+    _group.clear();
+    auto flush = [&] {
+      if (_group.empty()) return;
+      auto& st = state(group_pair);
+      uint64_t median = 0;
+      for (auto& [owner, value] : _group) median = push(st, value, time);
+      for (auto& [owner, value] : _group) st.series->append(time, value, median, owner);
+      _group.clear();
+    };
+    for (uint32_t i = 0; i < n; ++i) {
+      uint64_t owner = c.get<uint64_t>();
+      uint64_t pair = c.get<uint64_t>();
+      uint64_t value = c.get<uint64_t>();
+      c.get<int64_t>(); // report time; the row takes the block's
+      if (c.varuint() > 1) return; // only K1 and R1 signatures have a fixed size
+      c.bytes(65);
+      if (pair != group_pair) flush();
+      group_pair = pair;
+      _group.emplace_back(owner, value);
+    }
+    flush();
+    _stats.writes++;
+    _stats.datapoints += n;
+  }
+
+  void indexer::on_transfer(const action_trace& a, uint64_t time) {
+    cursor c{a.data, a.data + a.size};
+    uint64_t from = c.get<uint64_t>();
+    uint64_t to = c.get<uint64_t>();
+    uint64_t amount = uint64_t(c.get<int64_t>());
+    uint64_t symbol = c.get<uint64_t>();
+    uint32_t memo_size = c.varuint();
+    std::string_view memo(reinterpret_cast<const char*>(c.bytes(memo_size)), memo_size);
+
+    // as the contract's transfer handler reads it
+    if (from == _contract || to != _contract || memo == "system") return;
+    uint64_t scope = memo.empty() ? _contract : eosio::name(memo).value;
+    _store.transfers(scope).append(time, from, amount, symbol);
+    _stats.transfers++;
+  }
+
+  // globalinput: datapoints_per_instrument first, write_cooldown fourth
+  void indexer::on_configure(const action_trace& a) {
+    cursor c{a.data, a.data + a.size};
+    uint64_t slots = c.get<uint64_t>();
+    c.get<uint64_t>(); // bars_per_instrument
+    c.get<uint64_t>(); // vote_interval
+    set_window(slots);
+    set_cooldown(c.get<uint64_t>());
+  }
+
+  void indexer::on_setband(const action_trace& a) {
+    cursor c{a.data, a.data + a.size};
+    uint64_t pair = c.get<uint64_t>();
+    c.get<uint64_t>(); // deviation_bps
+    set_heartbeat(pair, c.get<uint32_t>());
+  }
+
+  void indexer::apply(const block_view& b) {
+    if (b.num <= _head.block) {
+      _stats.skipped_blocks++;
+      return;
+    }
+    static constexpr uint64_t write = "write"_n.value, writepacked = "writepacked"_n.value,
+                              writeagg = "writeagg"_n.value, transfer = "transfer"_n.value,
+                              configure = "configure"_n.value, setband = "setband"_n.value;
+    uint64_t time = b.time_us();
+    b.for_each_action([&](const action_trace& a) {
+      _stats.actions++;
+      if (a.receiver != _contract) return;
+      if (a.account == _contract && a.name == write)
+        on_write(a, time);
+      else if (a.account == _contract && a.name == writepacked)
+        on_writepacked(a, time);
+      else if (a.account == _contract && a.name == writeagg)
+        on_writeagg(a, time);
+      else if (a.account == _token && a.name == transfer)
+        on_transfer(a, time);
+      else if (a.account == _contract && a.name == configure)
+        on_configure(a);
+      else if (a.account == _contract && a.name == setband)
+        on_setband(a);
+    });
+    _head = {b.num, time};
+    _stats.blocks++;
+  }
+
+  void indexer::sync() { _store.sync(_head); }
+
+} // namespace history
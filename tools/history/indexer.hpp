@@ -0,0 +1,128 @@
+#pragma once
+
+#include "store.hpp"
+#include "trace_stream.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Turns the contract's action traces into store rows: every quote of a
+// write becomes a datapoint, with the median the contract computed for it,
+// and every incoming token transfer a row under the scope its memo names.
+//
+// The median depends on the window size and write cooldown in the global
+// row and on each pair's heartbeat. They start from copies of the tables
+// (set_window, set_cooldown, set_heartbeat) and follow the configure and
+// setband traces after that.
+//
+// writepacked names pairs by ordinal and values by their difference from
+// the oracle's last value on the pair. Neither is in the trace: ordinals
+// come from a copy of the contract's ordinals table (set_ordinal), and last
+// values from the store. A quote whose ordinal is not in the copy, or whose
+// oracle has no earlier row for the pair, is skipped and counted.
+namespace history {
+
+  /// The contract's datapoints table for one pair, reduced to what its
+  /// median depends on: as many rows as datapoints_per_instrument was when
+  /// the pair was first written, zero until written, the oldest replaced on
+  /// each write and the middle value read back as the median.
+  class median_window {
+   public:
+    explicit median_window(size_t slots = 21);
+
+    size_t slots() const { return _value.size(); }
+
+    /// The median after writing value at time: the middle of the whole
+    /// window.
+    uint64_t push(uint64_t value, uint64_t time);
+    /// The same on a pair with a heartbeat: the middle of the rows written
+    /// after cutoff, which include the new one.
+    uint64_t push(uint64_t value, uint64_t time, uint64_t cutoff);
+
+   private:
+    void replace(uint64_t value, uint64_t time);
+
+    std::vector<uint64_t> _value, _time;
+    std::vector<uint64_t> _sorted;
+    std::vector<uint64_t> _fresh; // scratch for the cutoff median
+  };
+
+  struct indexer_stats {
+    uint64_t blocks = 0;
+    uint64_t skipped_blocks = 0; // at or below the store's head
+    uint64_t actions = 0;
+    uint64_t writes = 0;
+    uint64_t datapoints = 0;
+    uint64_t transfers = 0;
+    uint64_t packed_skipped = 0; // writepacked quotes that could not be decoded
+  };
+
+  class indexer {
+   public:
+    /// Resumes after the store's head. The median windows are rebuilt from
+    /// the last rows of each pair on the first write to it, so set_window
+    /// may still be called.
+    indexer(store& s, uint64_t contract, uint64_t token);
+
+    /// Maps a writepacked ordinal to its pair. Ordinals are never reused,
+    /// so a copy of the table taken at any later block is good for all the
+    /// blocks before it.
+    void set_ordinal(uint64_t ordinal, uint64_t pair) { _ordinals[ordinal] = pair; }
+    /// datapoints_per_instrument, for pairs first written from now on.
+    void set_window(uint64_t slots) { _slots = std::max<uint64_t>(1, slots); }
+    /// write_cooldown, in microseconds.
+    void set_cooldown(uint64_t cooldown) { _cooldown = cooldown; }
+    /// The pair's heartbeat in seconds; 0 takes the median of the whole window.
+    void set_heartbeat(uint64_t pair, uint32_t heartbeat);
+
+    void apply(const block_view& b);
+    /// Flushes the store and records the last applied block as its head.
+    void sync();
+
+    const store_head& head() const { return _head; }
+    const indexer_stats& stats() const { return _stats; }
+
+   private:
+    /// An oracle's last value as of the first rows rows of the series.
+    struct last_value {
+      size_t rows = 0;
+      uint64_t value = 0;
+      bool found = false;
+    };
+
+    struct pair_state {
+      datapoint_series* series = nullptr;
+      median_window window;
+      uint32_t heartbeat = 0;
+      bool loaded = false; // window rebuilt from the store
+      std::unordered_map<uint64_t, last_value> last; // by owner, those looked up
+    };
+
+    pair_state& state(uint64_t pair);
+    const uint64_t* last(pair_state& st, uint64_t owner);
+    uint64_t push(pair_state& st, uint64_t value, uint64_t time);
+    void on_write(const action_trace& a, uint64_t time);
+    void on_writepacked(const action_trace& a, uint64_t time);
+    void on_writeagg(const action_trace& a, uint64_t time);
+    void on_transfer(const action_trace& a, uint64_t time);
+    void on_configure(const action_trace& a);
+    void on_setband(const action_trace& a);
+
+    store& _store;
+    uint64_t _contract, _token;
+    store_head _head;
+    indexer_stats _stats;
+    std::unordered_map<uint64_t, pair_state> _pairs;
+    std::unordered_map<uint64_t, uint64_t> _ordinals;
+    std::unordered_map<uint64_t, uint32_t> _heartbeats; // also of pairs not written yet
+    uint64_t _slots = 21;
+    uint64_t _cooldown = 55000000;
+    uint64_t _last_pair = 0;
+    pair_state* _last_state = nullptr;
+    std::vector<std::pair<uint64_t, uint64_t>> _group; // owner, value
+  };
+
+} // namespace history
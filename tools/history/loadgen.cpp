@@ -0,0 +1,328 @@
+/*
+
+  delphiqueryload
+
+  Load test for delphiquery: keeps connections to it busy with a mix of
+  latest, range, OHLC and TWAP requests over the pairs it serves, and
+  reports the rate and the latency of each kind.
+
+  delphiqueryload [options]
+    --target <host:port>   (default 127.0.0.1:8900)
+    --connections <n>      keep-alive connections (default 16)
+    --pipeline <n>         requests in flight on each (default 1)
+    --seconds <n>          (default 5)
+    --mix <kind=weight,..> of latest, range, ohlc and twap
+                           (default latest=50,range=20,ohlc=15,twap=15)
+    --window <seconds>     span of range, OHLC and TWAP requests, placed at
+                           random within each pair's history (default 600)
+    --seed <n>
+
+  Any answer but 200 is counted as an error. Run it on the same host, and
+  on a single core expect the two processes to share it.
+
+*/
+
+#include <mock/abi_json.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using json = eosio::mock::json;
+
+enum kind { latest, range, ohlc, twap, kinds };
+const char* kind_names[kinds] = {"latest", "range", "ohlc", "twap"};
+
+struct pair_info {
+  std::string name;
+  uint64_t first = 0, last = 0;
+};
+
+struct request {
+  kind k;
+  std::string text;
+};
+
+int connect_to(const std::string& target) {
+  auto colon = target.rfind(':');
+  if (colon == std::string::npos) throw std::runtime_error("target is host:port, not " + target);
+  addrinfo hints{}, *res = nullptr;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(target.substr(0, colon).c_str(), target.substr(colon + 1).c_str(), &hints, &res) != 0 || !res)
+    throw std::runtime_error("cannot resolve " + target);
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int rc = ::connect(fd, res->ai_addr, res->ai_addrlen);
+  freeaddrinfo(res);
+  if (rc != 0) {
+    ::close(fd);
+    throw std::runtime_error("cannot connect to " + target + ": " + std::strerror(errno));
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+// One HTTP response out of buf, if it is all there: its status and length.
+bool parse_response(std::string_view buf, int& status, size_t& length) {
+  size_t end = buf.find("\r\n\r\n");
+  if (end == std::string_view::npos) return false;
+  auto head = buf.substr(0, end);
+  if (head.size() < 12) throw std::runtime_error("malformed response");
+  status = std::atoi(std::string(head.substr(9, 3)).c_str());
+  size_t body = 0;
+  for (size_t at = head.find("\r\n"); at != std::string_view::npos; at = head.find("\r\n", at + 2)) {
+    auto line = head.substr(at + 2, head.find("\r\n", at + 2) - at - 2);
+    if (line.size() > 15 && strncasecmp(line.data(), "content-length:", 15) == 0)
+      body = std::strtoull(std::string(line.substr(15)).c_str(), nullptr, 10);
+  }
+  if (buf.size() < end + 4 + body) return false;
+  length = end + 4 + body;
+  return true;
+}
+
+std::string fetch(const std::string& target, const std::string& path) {
+  int fd = connect_to(target);
+  std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + target + "\r\n\r\n";
+  ::send(fd, req.data(), req.size(), MSG_NOSIGNAL);
+  std::string buf;
+  char chunk[65536];
+  int status = 0;
+  size_t length = 0;
+  while (!parse_response(buf, status, length)) {
+    ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      ::close(fd);
+      throw std::runtime_error("connection closed fetching " + path);
+    }
+    buf.append(chunk, size_t(n));
+  }
+  ::close(fd);
+  if (status != 200) throw std::runtime_error(path + " answered " + std::to_string(status));
+  return buf.substr(buf.find("\r\n\r\n") + 4, length - buf.find("\r\n\r\n") - 4);
+}
+
+std::vector<pair_info> served_pairs(const std::string& target) {
+  auto j = json::parse(fetch(target, "/v1/pairs"));
+  std::vector<pair_info> out;
+  for (auto& p : j.at("pairs").items)
+    out.push_back({p.at("pair").text, std::stoull(p.at("first").text), std::stoull(p.at("last").text)});
+  if (out.empty()) throw std::runtime_error("the server has no pairs");
+  return out;
+}
+
+std::vector<request> make_requests(const std::vector<pair_info>& pairs, const unsigned (&mix)[kinds],
+                                   uint64_t window_us, uint64_t seed, const std::string& host) {
+  std::mt19937_64 rng(seed);
+  std::discrete_distribution<int> pick(std::begin(mix), std::end(mix));
+  std::vector<request> out;
+  for (int i = 0; i < 4096; ++i) {
+    auto& p = pairs[rng() % pairs.size()];
+    kind k = kind(pick(rng));
+    uint64_t span = p.last > p.first + window_us ? p.last - p.first - window_us : 1;
+    uint64_t from = p.first + rng() % span, to = from + window_us;
+    std::string q;
+    switch (k) {
+      case latest: q = "/v1/latest?pair=" + p.name; break;
+      case range:
+        q = "/v1/range?pair=" + p.name + "&from=" + std::to_string(from) + "&to=" + std::to_string(to) + "&limit=100";
+        break;
+      case ohlc:
+        q = "/v1/ohlc?pair=" + p.name + "&from=" + std::to_string(from) + "&to=" + std::to_string(to) +
+            "&resolution=60";
+        break;
+      default:
+        q = "/v1/twap?pair=" + p.name + "&from=" + std::to_string(from) + "&to=" + std::to_string(to);
+        break;
+    }
+    out.push_back({k, "GET " + q + " HTTP/1.1\r\nHost: " + host + "\r\n\r\n"});
+  }
+  return out;
+}
+
+struct connection {
+  int fd = -1;
+  std::string in, out;
+  size_t sent = 0;
+  std::deque<std::pair<kind, clock_type::time_point>> inflight;
+};
+
+double percentile(std::vector<double>& v, double p) {
+  if (v.empty()) return 0;
+  size_t i = std::min(v.size() - 1, size_t(p * double(v.size())));
+  std::nth_element(v.begin(), v.begin() + long(i), v.end());
+  return v[i];
+}
+
+void usage() {
+  std::cerr << "usage: delphiqueryload [--target <host:port>] [--connections <n>] [--pipeline <n>] "
+               "[--seconds <n>] [--mix <kind=weight,..>] [--window <seconds>] [--seed <n>]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string target = "127.0.0.1:8900";
+  int connections = 16, pipeline = 1;
+  double seconds = 5;
+  unsigned mix[kinds] = {50, 20, 15, 15};
+  uint64_t window = 600, seed = 1;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--target") target = next();
+    else if (arg == "--connections") connections = std::max(1, std::stoi(next()));
+    else if (arg == "--pipeline") pipeline = std::max(1, std::stoi(next()));
+    else if (arg == "--seconds") seconds = std::stod(next());
+    else if (arg == "--window") window = std::max<uint64_t>(1, std::stoull(next()));
+    else if (arg == "--seed") seed = std::stoull(next());
+    else if (arg == "--mix") {
+      std::fill(std::begin(mix), std::end(mix), 0u);
+      std::string m = next();
+      for (size_t at = 0; at < m.size();) {
+        size_t end = std::min(m.find(',', at), m.size());
+        auto part = m.substr(at, end - at);
+        size_t eq = part.find('=');
+        auto k = std::find(std::begin(kind_names), std::end(kind_names), part.substr(0, eq));
+        if (eq == std::string::npos || k == std::end(kind_names)) { usage(); return 2; }
+        mix[k - std::begin(kind_names)] = unsigned(std::stoul(part.substr(eq + 1)));
+        at = end + 1;
+      }
+      if (std::all_of(std::begin(mix), std::end(mix), [](unsigned w) { return w == 0; })) { usage(); return 2; }
+    } else { usage(); return 2; }
+  }
+
+  try {
+    auto pairs = served_pairs(target);
+    auto requests = make_requests(pairs, mix, window * 1000000, seed, target);
+
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<connection> conns(static_cast<size_t>(connections));
+    for (size_t i = 0; i < conns.size(); ++i) {
+      conns[i].fd = connect_to(target);
+      fcntl(conns[i].fd, F_SETFL, fcntl(conns[i].fd, F_GETFL) | O_NONBLOCK);
+      epoll_event e{};
+      e.events = EPOLLIN | EPOLLOUT;
+      e.data.u64 = i;
+      epoll_ctl(ep, EPOLL_CTL_ADD, conns[i].fd, &e);
+    }
+
+    std::vector<double> latency[kinds];
+    for (auto& l : latency) l.reserve(1 << 20);
+    uint64_t errors = 0, next_request = 0;
+    auto start = clock_type::now();
+    auto stop = start + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(seconds));
+
+    auto fill = [&](connection& c, clock_type::time_point now) {
+      while (int(c.inflight.size()) < pipeline && now < stop) {
+        auto& r = requests[next_request++ % requests.size()];
+        c.out += r.text;
+        c.inflight.emplace_back(r.k, now);
+      }
+    };
+    auto now = clock_type::now();
+    for (auto& c : conns) fill(c, now);
+
+    epoll_event events[256];
+    char buf[65536];
+    size_t open = conns.size();
+    while (open > 0) {
+      int n = epoll_wait(ep, events, 256, 100);
+      if (n < 0 && errno != EINTR) throw std::runtime_error(std::string("epoll_wait failed: ") + std::strerror(errno));
+      now = clock_type::now();
+      for (int i = 0; i < n; ++i) {
+        auto& c = conns[events[i].data.u64];
+        if (c.fd < 0) continue;
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) throw std::runtime_error("connection to the server failed");
+        if (events[i].events & EPOLLIN) {
+          for (;;) {
+            ssize_t got = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (got > 0) {
+              c.in.append(buf, size_t(got));
+              continue;
+            }
+            if (got == 0) throw std::runtime_error("the server closed a connection");
+            if (errno == EINTR) continue;
+            break;
+          }
+          int status = 0;
+          size_t used = 0, length = 0;
+          while (!c.inflight.empty() && parse_response(std::string_view(c.in).substr(used), status, length)) {
+            used += length;
+            auto [k, sent_at] = c.inflight.front();
+            c.inflight.pop_front();
+            latency[k].push_back(std::chrono::duration<double, std::micro>(now - sent_at).count());
+            if (status != 200) errors++;
+          }
+          c.in.erase(0, used);
+          fill(c, now);
+        }
+        while (c.sent < c.out.size()) {
+          ssize_t put = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+          if (put > 0) c.sent += size_t(put);
+          else if (put < 0 && errno == EINTR) continue;
+          else if (put < 0 && errno == EAGAIN) break;
+          else throw std::runtime_error("send to the server failed");
+        }
+        if (c.sent == c.out.size()) {
+          c.out.clear();
+          c.sent = 0;
+        }
+        if (c.inflight.empty() && now >= stop) {
+          ::close(c.fd);
+          c.fd = -1;
+          open--;
+        }
+      }
+    }
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+    ::close(ep);
+
+    uint64_t total = 0;
+    std::vector<double> all;
+    std::printf("%u pairs, %d connections, %d in flight each, %.1f s\n", unsigned(pairs.size()), connections,
+                pipeline, elapsed);
+    std::printf("%-8s %10s %12s %10s %10s %10s\n", "kind", "requests", "req/s", "p50 us", "p99 us", "max us");
+    for (int k = 0; k < kinds; ++k) {
+      auto& l = latency[k];
+      if (l.empty()) continue;
+      total += l.size();
+      all.insert(all.end(), l.begin(), l.end());
+      double worst = *std::max_element(l.begin(), l.end());
+      std::printf("%-8s %10zu %12.0f %10.1f %10.1f %10.1f\n", kind_names[k], l.size(), double(l.size()) / elapsed,
+                  percentile(l, 0.5), percentile(l, 0.99), worst);
+    }
+    double worst = all.empty() ? 0 : *std::max_element(all.begin(), all.end());
+    std::printf("%-8s %10llu %12.0f %10.1f %10.1f %10.1f\n", "all", (unsigned long long)total,
+                double(total) / elapsed, percentile(all, 0.5), percentile(all, 0.99), worst);
+    if (errors) std::printf("%llu answers were not 200\n", (unsigned long long)errors);
+    return errors ? 1 : 0;
+  } catch (const std::exception& e) {
+    std::cerr << "delphiqueryload: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,316 @@
+/*
+
+  mockship
+
+  Produces a block stream for delphiindex, standing in for a state-history
+  endpoint: synthetic oracle traffic, or a recorded action log converted,
+  written to a file or served to the first connection on a local port.
+
+  mockship [options]
+    --synth <n>            n datapoints: every oracle writes every block,
+                           each write quoting --quotes of the pairs
+    --pairs <n>            (default 8)
+    --oracles <n>          writes per block (default 21)
+    --quotes <n>           quotes per write (default 4)
+    --donate-every <n>     a donation to a pair every n writes (default 50)
+    --from <actions.jsonl> convert an action log in delphireplay's format
+                           instead; write, writepacked, writeagg and
+                           transfer arguments may be json, anything else
+                           needs hex_data
+    --in <traces>          serve an existing trace file instead
+    --contract <account>   (default delphioracle)
+    --token <account>      (default eosio.token)
+    --start-block <n>      number of the first block (default 2)
+    --out <file>           write the stream here
+    --serve <port>         serve the stream on 127.0.0.1:port, once
+
+*/
+
+#include "trace_stream.hpp"
+
+#include <mock/abi_json.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using eosio::name;
+using json = eosio::mock::json;
+
+constexpr uint64_t start_time_us = 1714564800000000; // 2024-05-01T12:00:00
+
+struct options {
+  uint64_t contract = "delphioracle"_n.value;
+  uint64_t token = "eosio.token"_n.value;
+  uint32_t start_block = 2;
+  uint64_t pairs = 8, oracles = 21, quotes = 4, donate_every = 50;
+};
+
+std::vector<uint64_t> pair_names(uint64_t count) {
+  static const char* known[] = {"tlosusd", "btcusd", "ethusd", "eosusd", "tloseos", "tlosbtc", "usdtusd", "eosbtc"};
+  std::vector<uint64_t> out;
+  for (uint64_t i = 0; i < count; ++i) {
+    if (i < 8) {
+      out.push_back(name(known[i]).value);
+    } else {
+      std::string n = "pair";
+      for (uint64_t v = i; v; v /= 26) n += char('a' + v % 26);
+      out.push_back(name(n).value);
+    }
+  }
+  return out;
+}
+
+std::vector<uint8_t> synthesize(const options& o, uint64_t datapoints) {
+  std::mt19937_64 rng(7);
+  auto pairs = pair_names(o.pairs);
+  std::vector<uint64_t> price(pairs.size());
+  for (auto& p : price) p = 10000 + rng() % 100000000;
+  std::vector<uint64_t> oracles;
+  for (uint64_t i = 0; i < o.oracles; ++i) oracles.push_back(name("oracle" + std::string(1, char('a' + i % 26)) +
+                                                                 std::string(1, char('a' + i / 26 % 26))).value);
+
+  std::vector<uint8_t> out, data;
+  history::frame_writer w;
+  uint64_t written = 0, writes = 0, next_pair = 0;
+  uint32_t block = o.start_block, slot = history::slot_of(start_time_us);
+  while (written < datapoints) {
+    w.begin_block(block++, slot++);
+    for (uint64_t k = 0; k < oracles.size() && written < datapoints; ++k) {
+      uint64_t n = std::min<uint64_t>(o.quotes, datapoints - written);
+      data.clear();
+      history::put(data, oracles[k]);
+      history::put_varuint(data, uint32_t(n));
+      for (uint64_t q = 0; q < n; ++q) {
+        uint64_t p = next_pair++ % pairs.size();
+        // a slow random walk of up to 0.1% a step
+        price[p] += price[p] / 1000 * (rng() % 3) - price[p] / 1000;
+        history::put(data, price[p] + rng() % 16);
+        history::put(data, pairs[p]);
+      }
+      w.add_action(o.contract, o.contract, "write"_n.value, data.data(), data.size());
+      written += n;
+
+      if (o.donate_every && ++writes % o.donate_every == 0) {
+        data.clear();
+        history::put(data, name("donor").value);
+        history::put(data, o.contract);
+        history::put(data, int64_t(10000 + rng() % 1000000));
+        history::put(data, eosio::symbol("TLOS", 4).raw());
+        std::string memo = name(pairs[rng() % pairs.size()]).to_string();
+        history::put_varuint(data, uint32_t(memo.size()));
+        data.insert(data.end(), memo.begin(), memo.end());
+        // the token contract's own trace, then the copy the oracle is notified with
+        w.add_action(o.token, o.token, "transfer"_n.value, data.data(), data.size());
+        w.add_action(o.contract, o.token, "transfer"_n.value, data.data(), data.size());
+      }
+    }
+    auto& frame = w.end_block();
+    out.insert(out.end(), frame.begin(), frame.end());
+  }
+  return out;
+}
+
+std::vector<uint8_t> encode(const json& action, uint64_t act) {
+  std::vector<uint8_t> data;
+  if (auto hex = action.find("hex_data")) {
+    auto bytes = eosio::mock::from_hex(hex->text);
+    return {bytes.begin(), bytes.end()};
+  }
+  auto d = action.find("data");
+  if (d == nullptr) return data;
+  if (d->is_string()) {
+    auto bytes = eosio::mock::from_hex(d->text);
+    return {bytes.begin(), bytes.end()};
+  }
+  if (act == "write"_n.value) {
+    history::put(data, name(d->at("owner").text).value);
+    auto& quotes = d->at("quotes").items;
+    history::put_varuint(data, uint32_t(quotes.size()));
+    for (auto& q : quotes) {
+      history::put(data, uint64_t(std::stoull(q.at("value").text)));
+      history::put(data, name(q.at("pair").text).value);
+    }
+  } else if (act == "writepacked"_n.value) {
+    history::put(data, name(d->at("owner").text).value);
+    auto quotes = eosio::mock::from_hex(d->at("quotes").text);
+    history::put_varuint(data, uint32_t(quotes.size()));
+    data.insert(data.end(), quotes.begin(), quotes.end());
+  } else if (act == "writeagg"_n.value) {
+    history::put(data, name(d->at("relayer").text).value);
+    auto& reports = d->at("reports").items;
+    history::put_varuint(data, uint32_t(reports.size()));
+    for (auto& r : reports) {
+      history::put(data, name(r.at("owner").text).value);
+      history::put(data, name(r.at("pair").text).value);
+      history::put(data, uint64_t(std::stoull(r.at("value").text)));
+      history::put(data, eosio::mock::parse_time_point(r.at("timestamp")).time_since_epoch().count());
+      eosio::ecc_signature sig{};
+      history::put_varuint(data, uint32_t(eosio::mock::parse_key_string(r.at("sig").text, "SIG", sig)));
+      data.insert(data.end(), sig.begin(), sig.end());
+    }
+  } else if (act == "transfer"_n.value) {
+    history::put(data, name(d->at("from").text).value);
+    history::put(data, name(d->at("to").text).value);
+    auto quantity = eosio::mock::parse_asset(d->at("quantity").text);
+    history::put(data, quantity.amount);
+    history::put(data, quantity.symbol.raw());
+    auto memo = d->find("memo") ? d->at("memo").text : std::string();
+    history::put_varuint(data, uint32_t(memo.size()));
+    data.insert(data.end(), memo.begin(), memo.end());
+  }
+  return data;
+}
+
+// One block per distinct time slot in the log, in the order given.
+std::vector<uint8_t> convert(const options& o, const std::string& path) {
+  std::ifstream in(path);
+  if (!in) throw std::runtime_error("cannot open " + path);
+  std::vector<uint8_t> out;
+  history::frame_writer w;
+  uint32_t block = o.start_block, slot = 0;
+  bool open = false;
+  uint64_t skipped = 0;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    auto a = json::parse(line);
+    uint32_t s = a.find("time") ? history::slot_of(uint64_t(eosio::mock::parse_time_point(a.at("time"))
+                                                                 .time_since_epoch().count()))
+                                : slot;
+    if (!open || s != slot) {
+      if (open) {
+        auto& f = w.end_block();
+        out.insert(out.end(), f.begin(), f.end());
+      }
+      w.begin_block(block++, s);
+      slot = s;
+      open = true;
+    }
+    uint64_t account = name(a.at("account").text).value, act = name(a.at("name").text).value;
+    auto data = encode(a, act);
+    if (data.empty()) {
+      skipped++;
+      continue;
+    }
+    w.add_action(account, account, act, data.data(), data.size());
+    if (account == o.token && act == "transfer"_n.value) {
+      auto& d = a.at("data");
+      uint64_t from = name(d.at("from").text).value, to = name(d.at("to").text).value;
+      if (from == o.contract || to == o.contract) w.add_action(o.contract, account, act, data.data(), data.size());
+    }
+  }
+  if (open) {
+    auto& f = w.end_block();
+    out.insert(out.end(), f.begin(), f.end());
+  }
+  if (skipped) std::fprintf(stderr, "mockship: skipped %llu actions without usable data\n", (unsigned long long)skipped);
+  return out;
+}
+
+void serve(uint16_t port, const uint8_t* data, size_t size) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 1) != 0)
+    throw std::runtime_error("cannot listen on port " + std::to_string(port) + ": " + std::strerror(errno));
+  std::fprintf(stderr, "mockship: serving %zu bytes on 127.0.0.1:%u\n", size, port);
+  int client = accept(fd, nullptr, nullptr);
+  ::close(fd);
+  if (client < 0) throw std::runtime_error(std::string("accept failed: ") + std::strerror(errno));
+  for (size_t sent = 0; sent < size;) {
+    ssize_t n = ::send(client, data + sent, size - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      ::close(client);
+      throw std::runtime_error(std::string("send failed: ") + std::strerror(errno));
+    }
+    sent += size_t(n);
+  }
+  ::close(client);
+}
+
+void usage() {
+  std::cerr << "usage: mockship (--synth <n> | --from <actions.jsonl> | --in <traces>) [--pairs <n>] [--oracles <n>] "
+               "[--quotes <n>] [--donate-every <n>] [--contract <account>] [--token <account>] "
+               "[--start-block <n>] [--out <file>] [--serve <port>]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  options o;
+  uint64_t synth = 0;
+  std::string from, in, out;
+  int port = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--synth") synth = std::stoull(next());
+    else if (arg == "--pairs") o.pairs = std::max<uint64_t>(1, std::stoull(next()));
+    else if (arg == "--oracles") o.oracles = std::max<uint64_t>(1, std::stoull(next()));
+    else if (arg == "--quotes") o.quotes = std::max<uint64_t>(1, std::stoull(next()));
+    else if (arg == "--donate-every") o.donate_every = std::stoull(next());
+    else if (arg == "--from") from = next();
+    else if (arg == "--in") in = next();
+    else if (arg == "--contract") o.contract = name(next()).value;
+    else if (arg == "--token") o.token = name(next()).value;
+    else if (arg == "--start-block") o.start_block = uint32_t(std::stoul(next()));
+    else if (arg == "--out") out = next();
+    else if (arg == "--serve") port = std::stoi(next());
+    else { usage(); return 2; }
+  }
+  if (int(synth > 0) + int(!from.empty()) + int(!in.empty()) != 1 || (out.empty() && port == 0)) {
+    usage();
+    return 2;
+  }
+
+  try {
+    std::vector<uint8_t> stream;
+    std::unique_ptr<history::file_input> file;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    if (!in.empty()) {
+      file = std::make_unique<history::file_input>(in);
+      data = file->data();
+      size = file->size();
+    } else {
+      auto start = std::chrono::steady_clock::now();
+      stream = synth ? synthesize(o, synth) : convert(o, from);
+      data = stream.data();
+      size = stream.size();
+      std::fprintf(stderr, "mockship: %zu bytes in %.2f s\n", size,
+                   std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    if (!out.empty()) {
+      std::ofstream f(out, std::ios::binary);
+      f.write(reinterpret_cast<const char*>(data), std::streamsize(size));
+      if (!f) throw std::runtime_error("cannot write " + out);
+    }
+    if (port) serve(uint16_t(port), data, size);
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "mockship: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,89 @@
+#include "query.hpp"
+
+#include <algorithm>
+
+namespace history {
+
+  price_index::price_index(const datapoint_series& s, price_field f) : _series(s), _field(f) { update(); }
+
+  void price_index::update() {
+    size_t from = _integral.size(), n = _series.size();
+    if (n == from) return;
+    auto r = _series.rows(0, n);
+    auto p = prices(r, _field);
+    _integral.reserve(std::max(n, _integral.capacity() * 3 / 2));
+    for (size_t i = from; i < n; ++i)
+      _integral.push_back(i == 0 ? 0 : _integral[i - 1] + (unsigned __int128)p[i - 1] * (r.time[i] - r.time[i - 1]));
+    for (size_t b = _low.size(); (b + 1) * block <= n; ++b) {
+      auto [low, high] = std::minmax_element(p.begin() + long(b * block), p.begin() + long((b + 1) * block));
+      _low.push_back(*low);
+      _high.push_back(*high);
+    }
+  }
+
+  unsigned __int128 price_index::integral(std::span<const uint64_t> time, std::span<const uint64_t> price,
+                                          uint64_t t) const {
+    // the last row at or before t; its price holds from its time on
+    size_t k = size_t(std::upper_bound(time.begin(), time.end(), t) - time.begin()) - 1;
+    return _integral[k] + (unsigned __int128)price[k] * (t - time[k]);
+  }
+
+  twap_result price_index::twap(uint64_t from, uint64_t to) const {
+    twap_result result;
+    size_t n = size();
+    if (to <= from || n == 0) return result;
+    auto r = rows();
+    auto p = prices(r, _field);
+    result.points = size_t(std::lower_bound(r.time.begin(), r.time.end(), to) -
+                           std::lower_bound(r.time.begin(), r.time.end(), from));
+
+    uint64_t start = std::max(from, r.time[0]);
+    if (to <= start) return result;
+    result.covered = to - start;
+    result.price = uint64_t((integral(r.time, p, to) - integral(r.time, p, start)) / result.covered);
+    return result;
+  }
+
+  void price_index::extremes(std::span<const uint64_t> price, size_t begin, size_t end, uint64_t& low,
+                             uint64_t& high) const {
+    low = UINT64_MAX;
+    high = 0;
+    auto scan = [&](size_t b, size_t e) {
+      for (size_t i = b; i < e; ++i) {
+        low = std::min(low, price[i]);
+        high = std::max(high, price[i]);
+      }
+    };
+    size_t first = (begin + block - 1) / block, last = end / block;
+    if (first >= last) return scan(begin, end);
+    scan(begin, first * block);
+    for (size_t b = first; b < last; ++b) {
+      low = std::min(low, _low[b]);
+      high = std::max(high, _high[b]);
+    }
+    scan(last * block, end);
+  }
+
+  std::vector<ohlc_bar>& price_index::ohlc(uint64_t from, uint64_t to, uint64_t resolution,
+                                           std::vector<ohlc_bar>& out) const {
+    auto r = rows();
+    auto p = prices(r, _field);
+    size_t i = size_t(std::lower_bound(r.time.begin(), r.time.end(), from) - r.time.begin());
+    size_t end = size_t(std::lower_bound(r.time.begin() + long(i), r.time.end(), to) - r.time.begin());
+    while (i < end) {
+      ohlc_bar bar;
+      bar.start = r.time[i] - r.time[i] % resolution;
+      uint64_t bar_end = bar.start > UINT64_MAX - resolution ? UINT64_MAX : bar.start + resolution;
+      size_t j = size_t(std::lower_bound(r.time.begin() + long(i), r.time.begin() + long(end), bar_end) -
+                        r.time.begin());
+      bar.open = p[i];
+      bar.close = p[j - 1];
+      bar.count = j - i;
+      extremes(p, i, j, bar.low, bar.high);
+      out.push_back(bar);
+      i = j;
+    }
+    return out;
+  }
+
+} // namespace history
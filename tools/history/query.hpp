@@ -0,0 +1,66 @@
+#pragma once
+
+#include "store.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Aggregates over a pair's stored datapoints. A price_index keeps, next to
+// the mapped columns, the running time integral of the price and the low
+// and high of every block of rows, so a TWAP is two binary searches and an
+// OHLC bar a binary search and a short scan, however long the window.
+namespace history {
+
+  /// Which column is the price: the contract's median (what consumers of
+  /// the oracle read) or each oracle's own value.
+  enum class price_field { median, value };
+
+  inline std::span<const uint64_t> prices(const datapoint_range& r, price_field f) {
+    return f == price_field::median ? r.median : r.value;
+  }
+
+  struct ohlc_bar {
+    uint64_t start = 0; // us since the epoch, a multiple of the resolution
+    uint64_t open = 0, high = 0, low = 0, close = 0;
+    uint64_t count = 0;
+  };
+
+  struct twap_result {
+    uint64_t price = 0;
+    uint64_t covered = 0; // us of [from, to) with a known price
+    size_t points = 0;    // datapoints in [from, to)
+  };
+
+  class price_index {
+   public:
+    static constexpr size_t block = 64;
+
+    price_index(const datapoint_series& s, price_field f);
+
+    /// Takes in the rows appended since; queries see only rows taken in.
+    void update();
+    size_t size() const { return _integral.size(); }
+    datapoint_range rows() const { return _series.rows(0, size()); }
+
+    /// Time-weighted average over [from, to): each price holds until the
+    /// next, and the last one before from counts from from. Nothing is
+    /// covered before the first datapoint.
+    twap_result twap(uint64_t from, uint64_t to) const;
+
+    /// Bars of resolution us over [from, to), only those with datapoints.
+    /// Appends to out, which is returned.
+    std::vector<ohlc_bar>& ohlc(uint64_t from, uint64_t to, uint64_t resolution, std::vector<ohlc_bar>& out) const;
+
+   private:
+    /// Price-us from the first datapoint to time, which is not before it.
+    unsigned __int128 integral(std::span<const uint64_t> time, std::span<const uint64_t> price, uint64_t t) const;
+    void extremes(std::span<const uint64_t> price, size_t begin, size_t end, uint64_t& low, uint64_t& high) const;
+
+    const datapoint_series& _series;
+    price_field _field;
+    std::vector<unsigned __int128> _integral; // up to each row's time
+    std::vector<uint64_t> _low, _high;        // of each full block
+  };
+
+} // namespace history
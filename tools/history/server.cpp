@@ -0,0 +1,535 @@
+/*
+
+  delphiquery
+
+  Serves price history out of a delphiindex store over HTTP, for the
+  dashboards and risk engines that would otherwise page through
+  get_table_rows on a public node. One thread, one epoll loop, keep-alive
+  and pipelined requests; every answer is computed straight off the mapped
+  columns, which are refreshed as the indexer appends to them.
+
+  delphiquery [options] <store dir>
+    --port <n>          listen on 127.0.0.1:n (default 8900)
+    --any               listen on every interface instead
+    --refresh-ms <n>    look for new rows this often (default 250)
+
+  GET /v1/pairs
+      every pair with its row count and first and last datapoint time
+  GET /v1/latest?pair=tlosusd
+      the last datapoint
+  GET /v1/range?pair=&from=&to=&limit=&cursor=
+      datapoints in [from, to) oldest first, at most limit (default 1000,
+      at most 10000); if that cut them short, "next" is the cursor to ask
+      for the rest with
+  GET /v1/ohlc?pair=&from=&to=&resolution=&field=
+      bars of resolution seconds (default 60) that have datapoints, at
+      most 10000 of them
+  GET /v1/twap?pair=&from=&to=&field=
+      time-weighted average over [from, to); to defaults to the last
+      datapoint
+
+  Times are us since the epoch, in requests and answers; from and to may
+  also be given as "2024-05-01T12:00:00". Prices are the contract's median
+  unless field=value asks for each oracle's own. Errors are a status with
+  {"error": "..."}.
+
+*/
+
+#include "query.hpp"
+
+#include <mock/abi_json.hpp>
+
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr size_t max_request = 8192;
+constexpr size_t default_limit = 1000, max_rows = 10000;
+
+volatile std::sig_atomic_t stopping = 0;
+
+struct bad_request {
+  int status;
+  const char* message;
+};
+
+// Appends JSON to a reused buffer without going through a stream.
+struct writer {
+  std::string& out;
+
+  writer& raw(std::string_view s) {
+    out.append(s);
+    return *this;
+  }
+  writer& num(uint64_t v) {
+    char buf[24];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, r.ptr);
+    return *this;
+  }
+  writer& name(uint64_t v) {
+    out += '"';
+    out += eosio::name(v).to_string();
+    out += '"';
+    return *this;
+  }
+};
+
+class query_string {
+ public:
+  explicit query_string(std::string_view q) : _q(q) {}
+
+  /// The value of key, percent-decoded; empty if absent.
+  std::string get(std::string_view key) const {
+    for (size_t at = 0; at < _q.size();) {
+      size_t end = _q.find('&', at);
+      if (end == std::string_view::npos) end = _q.size();
+      auto part = _q.substr(at, end - at);
+      size_t eq = part.find('=');
+      if (part.substr(0, eq) == key) return eq == std::string_view::npos ? std::string() : decode(part.substr(eq + 1));
+      at = end + 1;
+    }
+    return {};
+  }
+
+  uint64_t number(std::string_view key, uint64_t fallback) const {
+    auto v = get(key);
+    if (v.empty()) return fallback;
+    uint64_t out = 0;
+    auto r = std::from_chars(v.data(), v.data() + v.size(), out);
+    if (r.ec != std::errc() || r.ptr != v.data() + v.size()) throw bad_request{400, "malformed number"};
+    return out;
+  }
+
+  uint64_t time(std::string_view key, uint64_t fallback) const {
+    auto v = get(key);
+    if (v.find('T') == std::string::npos) return number(key, fallback);
+    try {
+      auto t = eosio::mock::parse_time_point(eosio::mock::json::parse("\"" + v + "\""));
+      return uint64_t(t.time_since_epoch().count());
+    } catch (const std::exception&) {
+      throw bad_request{400, "malformed time"};
+    }
+  }
+
+ private:
+  static std::string decode(std::string_view s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+      if (s[i] == '%' && i + 2 < s.size()) {
+        unsigned v = 0;
+        auto r = std::from_chars(s.data() + i + 1, s.data() + i + 3, v, 16);
+        if (r.ptr == s.data() + i + 3) {
+          out += char(v);
+          i += 2;
+          continue;
+        }
+      }
+      out += s[i] == '+' ? ' ' : s[i];
+    }
+    return out;
+  }
+
+  std::string_view _q;
+};
+
+class service {
+ public:
+  explicit service(history::store& s) : _store(s) { refresh(); }
+
+  /// Picks up what the indexer appended, and brings the median indexes of
+  /// every pair up to date so that no request waits for one to be built.
+  void refresh() {
+    _store.refresh();
+    for (auto& [pair, s] : _store.pairs()) {
+      auto [it, added] = _indexes.try_emplace({pair, history::price_field::median}, *s, history::price_field::median);
+      if (!added) it->second.update();
+    }
+  }
+
+  /// Writes the body of the answer to target into out; the status.
+  int answer(std::string_view target, std::string& out) {
+    size_t q = target.find('?');
+    auto path = target.substr(0, q);
+    query_string args(q == std::string_view::npos ? std::string_view() : target.substr(q + 1));
+    writer w{out};
+    try {
+      if (path == "/v1/pairs") return pairs(w);
+      if (path == "/v1/latest") return latest(w, series(args));
+      if (path == "/v1/range") return range(w, series(args), args);
+      if (path == "/v1/ohlc") return ohlc(w, index(args), args);
+      if (path == "/v1/twap") return twap(w, index(args), args);
+      throw bad_request{404, "no such endpoint"};
+    } catch (const bad_request& e) {
+      out.clear();
+      w.raw("{\"error\":\"").raw(e.message).raw("\"}");
+      return e.status;
+    }
+  }
+
+ private:
+  const history::datapoint_series& series(const query_string& args) {
+    auto s = _store.find_pair(pair(args));
+    if (s == nullptr || s->size() == 0) throw bad_request{404, "unknown pair"};
+    return *s;
+  }
+
+  // Median indexes are kept for every pair, the others built on first use.
+  history::price_index& index(const query_string& args) {
+    auto f = field(args);
+    auto& s = series(args);
+    auto [it, added] = _indexes.try_emplace({pair(args), f}, s, f);
+    if (!added) it->second.update();
+    return it->second;
+  }
+
+  static uint64_t pair(const query_string& args) {
+    auto pair = args.get("pair");
+    if (pair.empty()) throw bad_request{400, "pair is required"};
+    if (pair.size() > 13) throw bad_request{404, "unknown pair"};
+    return eosio::name(pair).value;
+  }
+
+  static history::price_field field(const query_string& args) {
+    auto f = args.get("field");
+    if (f.empty() || f == "median") return history::price_field::median;
+    if (f == "value") return history::price_field::value;
+    throw bad_request{400, "field is median or value"};
+  }
+
+  int pairs(writer& w) {
+    auto& head = _store.head();
+    w.raw("{\"head\":{\"block\":").num(head.block).raw(",\"time\":").num(head.time).raw("},\"pairs\":[");
+    bool first = true;
+    for (auto& [pair, s] : _store.pairs()) {
+      size_t n = s->size();
+      if (n == 0) continue;
+      w.raw(first ? "{\"pair\":" : ",{\"pair\":").name(pair).raw(",\"count\":").num(n);
+      w.raw(",\"first\":").num(s->column(0, 0, 1)[0]).raw(",\"last\":").num(s->column(0, n - 1, n)[0]).raw("}");
+      first = false;
+    }
+    w.raw("]}");
+    return 200;
+  }
+
+  int latest(writer& w, const history::datapoint_series& s) {
+    size_t n = s.size();
+    auto r = s.rows(n - 1, n);
+    w.raw("{\"time\":").num(r.time[0]).raw(",\"value\":").num(r.value[0]).raw(",\"median\":").num(r.median[0]);
+    w.raw(",\"owner\":").name(r.owner[0]).raw("}");
+    return 200;
+  }
+
+  int range(writer& w, const history::datapoint_series& s, const query_string& args) {
+    uint64_t from = args.time("from", 0), to = args.time("to", UINT64_MAX);
+    size_t limit = std::min<uint64_t>(args.number("limit", default_limit), max_rows);
+    // rows are only ever appended, so a row number is a stable cursor
+    size_t begin = args.get("cursor").empty() ? s.lower_bound(from)
+                                              : std::min<uint64_t>(args.number("cursor", 0), s.size());
+    size_t end = std::max(begin, s.lower_bound(to));
+    auto r = s.rows(begin, end);
+    size_t n = std::min(r.size(), limit);
+    w.raw("{\"count\":").num(n).raw(",\"rows\":[");
+    for (size_t i = 0; i < n; ++i) {
+      w.raw(i ? ",[" : "[").num(r.time[i]).raw(",").num(r.value[i]).raw(",").num(r.median[i]).raw(",");
+      w.name(r.owner[i]).raw("]");
+    }
+    w.raw("]");
+    if (n < r.size()) w.raw(",\"next\":").num(begin + n);
+    w.raw("}");
+    return 200;
+  }
+
+  int ohlc(writer& w, const history::price_index& index, const query_string& args) {
+    uint64_t from = args.time("from", 0), to = args.time("to", UINT64_MAX);
+    uint64_t resolution = args.number("resolution", 60);
+    if (resolution == 0 || resolution > UINT64_MAX / 1000000) throw bad_request{400, "bad resolution"};
+    auto r = index.rows();
+    from = std::max(from, r.time.front());
+    to = std::min(to, r.time.back() + 1);
+    if (to > from && (to - from) / (resolution * 1000000) >= max_rows)
+      throw bad_request{400, "too many bars, narrow the range or widen the resolution"};
+    _bars.clear();
+    index.ohlc(from, to, resolution * 1000000, _bars);
+    w.raw("{\"resolution\":").num(resolution).raw(",\"bars\":[");
+    for (size_t i = 0; i < _bars.size(); ++i) {
+      auto& b = _bars[i];
+      w.raw(i ? ",[" : "[").num(b.start).raw(",").num(b.open).raw(",").num(b.high).raw(",").num(b.low);
+      w.raw(",").num(b.close).raw(",").num(b.count).raw("]");
+    }
+    w.raw("]}");
+    return 200;
+  }
+
+  int twap(writer& w, const history::price_index& index, const query_string& args) {
+    uint64_t from = args.time("from", 0), to = args.time("to", index.rows().time.back() + 1);
+    if (to <= from) throw bad_request{400, "to must be after from"};
+    auto t = index.twap(from, to);
+    w.raw("{\"twap\":").num(t.price).raw(",\"points\":").num(t.points).raw(",\"covered\":").num(t.covered);
+    w.raw(",\"from\":").num(from).raw(",\"to\":").num(to).raw("}");
+    return 200;
+  }
+
+  history::store& _store;
+  std::map<std::pair<uint64_t, history::price_field>, history::price_index> _indexes;
+  std::vector<history::ohlc_bar> _bars;
+};
+
+struct connection {
+  std::string in, out;
+  size_t sent = 0;
+  bool closing = false;
+  uint32_t events = EPOLLIN | EPOLLRDHUP;
+};
+
+const char* status_text(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 431: return "Request Header Fields Too Large";
+    default: return "Error";
+  }
+}
+
+class server {
+ public:
+  server(history::store& s, uint16_t port, bool any) : _service(s) {
+    _listen = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(any ? INADDR_ANY : INADDR_LOOPBACK);
+    if (bind(_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(_listen, 1024) != 0)
+      throw std::runtime_error("cannot listen on port " + std::to_string(port) + ": " + std::strerror(errno));
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    watch(_listen, EPOLLIN, EPOLL_CTL_ADD);
+  }
+
+  ~server() {
+    for (auto& [fd, c] : _connections) ::close(fd);
+    ::close(_listen);
+    ::close(_epoll);
+  }
+
+  void run(int refresh_ms) {
+    epoll_event events[256];
+    auto refreshed = clock_type::now();
+    while (!stopping) {
+      int n = epoll_wait(_epoll, events, 256, refresh_ms);
+      if (n < 0 && errno != EINTR) throw std::runtime_error(std::string("epoll_wait failed: ") + std::strerror(errno));
+      for (int i = 0; i < n; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == _listen) accept_all();
+        else on_event(fd, events[i].events);
+      }
+      if (clock_type::now() - refreshed >= std::chrono::milliseconds(refresh_ms)) {
+        _service.refresh();
+        refreshed = clock_type::now();
+      }
+    }
+  }
+
+  uint64_t requests() const { return _requests; }
+
+ private:
+  void watch(int fd, uint32_t events, int op) {
+    epoll_event e{};
+    e.events = events;
+    e.data.fd = fd;
+    epoll_ctl(_epoll, op, fd, &e);
+  }
+
+  void accept_all() {
+    for (;;) {
+      int fd = accept4(_listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) return;
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      _connections[fd];
+      watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+    }
+  }
+
+  void drop(int fd) {
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    _connections.erase(fd);
+  }
+
+  void on_event(int fd, uint32_t events) {
+    auto it = _connections.find(fd);
+    if (it == _connections.end()) return;
+    auto& c = it->second;
+    if (events & (EPOLLERR | EPOLLHUP)) return drop(fd);
+
+    if ((events & EPOLLIN) && !c.closing) {
+      char buf[16384];
+      bool eof = false;
+      for (;;) {
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+          c.in.append(buf, size_t(n));
+          continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        eof = n == 0 || errno != EAGAIN;
+        break;
+      }
+      handle(c);
+      // answer what was asked before the other end stopped, then close
+      if (eof) c.closing = true;
+    }
+    flush(fd, c);
+  }
+
+  // Answers every complete request in the buffer, in order.
+  void handle(connection& c) {
+    size_t at = 0;
+    while (!c.closing) {
+      size_t end = c.in.find("\r\n\r\n", at);
+      if (end == std::string::npos) {
+        if (c.in.size() - at > max_request) respond(c, 431, "{\"error\":\"request too large\"}", true);
+        break;
+      }
+      std::string_view head(c.in.data() + at, end - at);
+      at = end + 4;
+      size_t sp1 = head.find(' '), sp2 = head.find(' ', sp1 + 1);
+      size_t eol = head.find("\r\n");
+      std::string_view line = head.substr(0, eol);
+      bool close = line.ends_with("HTTP/1.0") || header_says_close(head);
+      if (sp1 == std::string_view::npos || sp2 == std::string_view::npos || sp2 > line.size()) {
+        respond(c, 400, "{\"error\":\"malformed request\"}", true);
+        break;
+      }
+      if (head.substr(0, sp1) != "GET") {
+        // bodies are not read, so the stream cannot be trusted past this
+        respond(c, 405, "{\"error\":\"only GET\"}", true);
+        break;
+      }
+      _body.clear();
+      int status = _service.answer(head.substr(sp1 + 1, sp2 - sp1 - 1), _body);
+      respond(c, status, _body, close);
+      _requests++;
+      if (close) break;
+    }
+    c.in.erase(0, at);
+  }
+
+  static bool header_says_close(std::string_view head) {
+    for (size_t at = head.find("\r\n"); at != std::string_view::npos; at = head.find("\r\n", at + 2)) {
+      auto line = head.substr(at + 2, head.find("\r\n", at + 2) - at - 2);
+      if (line.size() < 11 || strncasecmp(line.data(), "connection:", 11) != 0) continue;
+      auto v = line.substr(11);
+      while (!v.empty() && v[0] == ' ') v.remove_prefix(1);
+      return v.size() >= 5 && strncasecmp(v.data(), "close", 5) == 0;
+    }
+    return false;
+  }
+
+  void respond(connection& c, int status, std::string_view body, bool close) {
+    writer w{c.out};
+    w.raw("HTTP/1.1 ").num(uint64_t(status)).raw(" ").raw(status_text(status));
+    w.raw("\r\nContent-Type: application/json\r\nContent-Length: ").num(body.size());
+    w.raw(close ? "\r\nConnection: close\r\n\r\n" : "\r\n\r\n").raw(body);
+    if (close) c.closing = true;
+  }
+
+  void flush(int fd, connection& c) {
+    while (c.sent < c.out.size()) {
+      ssize_t n = ::send(fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+      if (n > 0) {
+        c.sent += size_t(n);
+        continue;
+      }
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && errno == EAGAIN) break;
+      return drop(fd);
+    }
+    if (c.sent == c.out.size()) {
+      c.out.clear();
+      c.sent = 0;
+      if (c.closing) return drop(fd);
+    }
+    // a closing connection only waits to drain; anything more it sends is ignored
+    uint32_t events = c.closing ? EPOLLOUT : EPOLLIN | EPOLLRDHUP | (c.out.empty() ? 0u : EPOLLOUT);
+    if (events != c.events) {
+      c.events = events;
+      watch(fd, events, EPOLL_CTL_MOD);
+    }
+  }
+
+  service _service;
+  int _listen = -1, _epoll = -1;
+  std::unordered_map<int, connection> _connections;
+  std::string _body;
+  uint64_t _requests = 0;
+};
+
+void usage() {
+  std::cerr << "usage: delphiquery [--port <n>] [--any] [--refresh-ms <n>] <store dir>\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string dir;
+  int port = 8900, refresh_ms = 250;
+  bool any = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--port") port = std::stoi(next());
+    else if (arg == "--any") any = true;
+    else if (arg == "--refresh-ms") refresh_ms = std::max(1, std::stoi(next()));
+    else if (!arg.empty() && arg[0] == '-') { usage(); return 2; }
+    else dir = arg;
+  }
+  if (dir.empty()) {
+    usage();
+    return 2;
+  }
+
+  try {
+    history::store s(dir, false);
+    server srv(s, uint16_t(port), any);
+    std::signal(SIGINT, [](int) { stopping = 1; });
+    std::signal(SIGTERM, [](int) { stopping = 1; });
+    std::fprintf(stderr, "delphiquery: %zu pairs, head %u, on %s:%d\n", s.pairs().size(), s.head().block,
+                 any ? "0.0.0.0" : "127.0.0.1", port);
+    srv.run(refresh_ms);
+    std::fprintf(stderr, "delphiquery: %llu requests answered\n", (unsigned long long)srv.requests());
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "delphiquery: " << e.what() << "\n";
+    return 1;
+  }
+}
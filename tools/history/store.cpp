@@ -0,0 +1,235 @@
+#include "store.hpp"
+
+#include <eosio/name.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace history {
+
+  namespace {
+
+    constexpr char column_magic[8] = {'D', 'L', 'P', 'H', 'C', 'O', 'L', '1'};
+    constexpr size_t header_bytes = 64;
+    constexpr uint64_t initial_rows = 1 << 16;
+
+    std::string errno_text(const std::string& what, const std::string& path) {
+      return what + " " + path + ": " + std::strerror(errno);
+    }
+
+    size_t file_size(int fd) {
+      struct stat st{};
+      fstat(fd, &st);
+      return size_t(st.st_size);
+    }
+
+  } // namespace
+
+  column_file::column_file(const std::string& path, bool writable) : _path(path), _writable(writable) {
+    _fd = ::open(path.c_str(), (writable ? O_RDWR | O_CREAT : O_RDONLY) | O_CLOEXEC, 0644);
+    if (_fd < 0) throw store_error(errno_text("cannot open", path));
+
+    size_t size = file_size(_fd);
+    if (size == 0 && writable) {
+      size = header_bytes + initial_rows * sizeof(uint64_t);
+      if (ftruncate(_fd, off_t(size)) != 0) throw store_error(errno_text("cannot size", path));
+      map(size);
+      std::memcpy(header().magic, column_magic, sizeof(column_magic));
+      header().value_size = sizeof(uint64_t);
+      header().version = 1;
+    } else {
+      if (size < header_bytes) throw store_error(path + " is not a column file");
+      map(size);
+      if (std::memcmp(header().magic, column_magic, sizeof(column_magic)) != 0 || header().value_size != sizeof(uint64_t))
+        throw store_error(path + " is not a column file");
+    }
+    _staged = rows();
+  }
+
+  column_file::~column_file() {
+    if (_base) munmap(_base, _mapped);
+    if (_fd >= 0) ::close(_fd);
+  }
+
+  void column_file::map(size_t bytes) {
+    int prot = _writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* p = _base ? mremap(_base, _mapped, bytes, MREMAP_MAYMOVE) : mmap(nullptr, bytes, prot, MAP_SHARED, _fd, 0);
+    if (p == MAP_FAILED) throw store_error(errno_text("cannot map", _path));
+    _base = static_cast<char*>(p);
+    _mapped = bytes;
+    _values = reinterpret_cast<uint64_t*>(_base + header_bytes);
+    _capacity = (bytes - header_bytes) / sizeof(uint64_t);
+  }
+
+  void column_file::grow() {
+    size_t bytes = header_bytes + _capacity * 2 * sizeof(uint64_t);
+    if (ftruncate(_fd, off_t(bytes)) != 0) throw store_error(errno_text("cannot grow", _path));
+    map(bytes);
+  }
+
+  void column_file::truncate(uint64_t rows) {
+    _staged = std::min(_staged, rows);
+    publish();
+  }
+
+  void column_file::sync() {
+    if (msync(_base, header_bytes + _staged * sizeof(uint64_t), MS_SYNC) != 0)
+      throw store_error(errno_text("cannot sync", _path));
+  }
+
+  bool column_file::refresh() {
+    uint64_t published = std::atomic_ref<uint64_t>(header().rows).load(std::memory_order_acquire);
+    if (published > _capacity) map(file_size(_fd));
+    bool grew = published != _staged;
+    _staged = published;
+    return grew;
+  }
+
+  series::series(const std::string& dir, const std::vector<const char*>& columns, bool writable) {
+    if (writable) std::filesystem::create_directories(dir);
+    for (auto c : columns) _columns.push_back(std::make_unique<column_file>(dir + "/" + c, writable));
+  }
+
+  size_t series::size() const {
+    uint64_t rows = _columns[0]->rows();
+    for (auto& c : _columns) rows = std::min(rows, c->rows());
+    return size_t(rows);
+  }
+
+  size_t series::lower_bound(uint64_t time) const {
+    auto t = _columns[0]->data();
+    return size_t(std::lower_bound(t, t + size(), time) - t);
+  }
+
+  size_t series::upper_bound(uint64_t time) const {
+    auto t = _columns[0]->data();
+    return size_t(std::upper_bound(t, t + size(), time) - t);
+  }
+
+  void series::truncate(size_t rows) {
+    for (auto& c : _columns) c->truncate(rows);
+  }
+
+  void series::sync() {
+    for (auto& c : _columns) c->sync();
+  }
+
+  bool series::refresh() {
+    bool grew = false;
+    for (auto& c : _columns) grew |= c->refresh();
+    return grew;
+  }
+
+  datapoint_series::datapoint_series(const std::string& dir, bool writable)
+      : series(dir, {"time", "value", "median", "owner"}, writable) {}
+
+  datapoint_range datapoint_series::rows(size_t begin, size_t end) const {
+    return {column(0, begin, end), column(1, begin, end), column(2, begin, end), column(3, begin, end)};
+  }
+
+  transfer_series::transfer_series(const std::string& dir, bool writable)
+      : series(dir, {"time", "from", "amount", "symbol"}, writable) {}
+
+  transfer_range transfer_series::rows(size_t begin, size_t end) const {
+    return {column(0, begin, end), column(1, begin, end), column(2, begin, end), column(3, begin, end)};
+  }
+
+  store::store(const std::string& dir, bool writable) : _dir(dir), _writable(writable) {
+    if (writable) {
+      std::filesystem::create_directories(dir + "/pairs");
+      std::filesystem::create_directories(dir + "/transfers");
+    } else if (!std::filesystem::is_directory(dir)) {
+      throw store_error("no store at " + dir);
+    }
+    read_head();
+    scan();
+
+    if (writable) {
+      for (auto& [_, s] : _pairs) s->truncate(s->upper_bound(_head.time));
+      for (auto& [_, s] : _transfers) s->truncate(s->upper_bound(_head.time));
+    }
+  }
+
+  void store::read_head() {
+    int fd = ::open((_dir + "/head").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    store_head h;
+    if (pread(fd, &h.block, sizeof(h.block), 0) == ssize_t(sizeof(h.block)) &&
+        pread(fd, &h.time, sizeof(h.time), 8) == ssize_t(sizeof(h.time)))
+      _head = h;
+    ::close(fd);
+  }
+
+  void store::scan() {
+    auto load = [&](const char* kind, auto& into) {
+      using series_type = typename std::decay_t<decltype(into)>::mapped_type::element_type;
+      std::error_code ec;
+      for (auto& entry : std::filesystem::directory_iterator(_dir + "/" + kind, ec)) {
+        if (!entry.is_directory()) continue;
+        uint64_t key = eosio::name(entry.path().filename().string()).value;
+        if (into.count(key)) continue;
+        // a reader can race the writer creating the columns; it sees the
+        // series on a later refresh
+        try {
+          into.emplace(key, std::make_unique<series_type>(entry.path().string(), _writable));
+        } catch (const store_error&) {
+          if (_writable) throw;
+        }
+      }
+    };
+    load("pairs", _pairs);
+    load("transfers", _transfers);
+  }
+
+  datapoint_series* store::find_pair(uint64_t pair) const {
+    auto itr = _pairs.find(pair);
+    return itr == _pairs.end() ? nullptr : itr->second.get();
+  }
+
+  datapoint_series& store::pair(uint64_t pair) {
+    auto& s = _pairs[pair];
+    if (!s) s = std::make_unique<datapoint_series>(_dir + "/pairs/" + eosio::name(pair).to_string(), _writable);
+    return *s;
+  }
+
+  transfer_series* store::find_transfers(uint64_t scope) const {
+    auto itr = _transfers.find(scope);
+    return itr == _transfers.end() ? nullptr : itr->second.get();
+  }
+
+  transfer_series& store::transfers(uint64_t scope) {
+    auto& s = _transfers[scope];
+    if (!s) s = std::make_unique<transfer_series>(_dir + "/transfers/" + eosio::name(scope).to_string(), _writable);
+    return *s;
+  }
+
+  void store::sync(const store_head& head) {
+    for (auto& [_, s] : _pairs) s->sync();
+    for (auto& [_, s] : _transfers) s->sync();
+
+    std::string path = _dir + "/head";
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) throw store_error(errno_text("cannot open", path));
+    uint8_t buf[16] = {};
+    std::memcpy(buf, &head.block, sizeof(head.block));
+    std::memcpy(buf + 8, &head.time, sizeof(head.time));
+    bool ok = pwrite(fd, buf, sizeof(buf), 0) == ssize_t(sizeof(buf)) && fsync(fd) == 0;
+    ::close(fd);
+    if (!ok) throw store_error(errno_text("cannot write", path));
+    _head = head;
+  }
+
+  void store::refresh() {
+    read_head();
+    scan();
+    for (auto& [_, s] : _pairs) s->refresh();
+    for (auto& [_, s] : _transfers) s->refresh();
+  }
+
+} // namespace history
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Price history on disk as columns: every pair is a directory of files,
+// one per field, each a 64-byte header followed by the values back to
+// back. Files are mapped, so appending is a store into memory and reading
+// a range is a pair of binary searches that hands out spans into the
+// mapping.
+//
+//   <dir>/head                       last block indexed, and its time
+//   <dir>/pairs/<pair>/time          block time, us since the epoch
+//                     /value         as written
+//                     /median        the contract's median after the write
+//                     /owner         oracle, as a name value
+//   <dir>/transfers/<scope>/time     incoming token transfers, by memo
+//                          /from
+//                          /amount
+//                          /symbol
+//
+// One process writes; any number may read, each with its own mapping,
+// and refresh() to see what was appended since.
+namespace history {
+
+  struct store_error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+  };
+
+  /// One column file of uint64 values.
+  class column_file {
+   public:
+    column_file(const std::string& path, bool writable);
+    column_file(const column_file&) = delete;
+    column_file& operator=(const column_file&) = delete;
+    ~column_file();
+
+    /// Rows published, as far as this mapping reaches.
+    uint64_t rows() const {
+      return std::min(std::atomic_ref<uint64_t>(header().rows).load(std::memory_order_acquire), _capacity);
+    }
+    const uint64_t* data() const { return _values; }
+
+    /// Writer only: stages a value; readers see it after publish().
+    void append(uint64_t v) {
+      if (_staged == _capacity) grow();
+      _values[_staged++] = v;
+    }
+    void publish() { std::atomic_ref<uint64_t>(header().rows).store(_staged, std::memory_order_release); }
+    void truncate(uint64_t rows);
+    void sync();
+
+    /// Reader only: maps rows appended since; false if there are none.
+    bool refresh();
+
+   private:
+    struct file_header {
+      char magic[8];
+      uint32_t value_size;
+      uint32_t version;
+      uint64_t rows;
+      uint64_t reserved[5];
+    };
+    static_assert(sizeof(file_header) == 64);
+
+    file_header& header() const { return *reinterpret_cast<file_header*>(_base); }
+    void map(size_t bytes);
+    void grow();
+
+    std::string _path;
+    int _fd = -1;
+    bool _writable = false;
+    char* _base = nullptr;
+    size_t _mapped = 0;
+    uint64_t* _values = nullptr;
+    uint64_t _capacity = 0;
+    uint64_t _staged = 0;
+  };
+
+  /// Columns that grow together, the first of them a non-decreasing time.
+  class series {
+   public:
+    series(const std::string& dir, const std::vector<const char*>& columns, bool writable);
+
+    size_t size() const;
+    std::span<const uint64_t> column(size_t i, size_t begin, size_t end) const {
+      return {_columns[i]->data() + begin, end - begin};
+    }
+
+    /// One value per column, in order.
+    void append(const uint64_t* row) {
+      for (size_t i = 0; i < _columns.size(); ++i) _columns[i]->append(row[i]);
+      for (auto& c : _columns) c->publish();
+    }
+
+    /// First row at or after time, and first row after it.
+    size_t lower_bound(uint64_t time) const;
+    size_t upper_bound(uint64_t time) const;
+    void truncate(size_t rows);
+    void sync();
+    bool refresh();
+
+   private:
+    std::vector<std::unique_ptr<column_file>> _columns;
+  };
+
+  struct datapoint_range {
+    std::span<const uint64_t> time, value, median, owner;
+    size_t size() const { return time.size(); }
+  };
+
+  class datapoint_series : public series {
+   public:
+    static constexpr size_t columns = 4;
+    datapoint_series(const std::string& dir, bool writable);
+
+    void append(uint64_t time, uint64_t value, uint64_t median, uint64_t owner) {
+      const uint64_t row[columns] = {time, value, median, owner};
+      series::append(row);
+    }
+    datapoint_range rows(size_t begin, size_t end) const;
+    /// Datapoints written in [from, to), as views into the mapping; valid
+    /// until this series next grows or refreshes.
+    datapoint_range range(uint64_t from, uint64_t to) const { return rows(lower_bound(from), lower_bound(to)); }
+  };
+
+  struct transfer_range {
+    std::span<const uint64_t> time, from, amount, symbol;
+    size_t size() const { return time.size(); }
+  };
+
+  class transfer_series : public series {
+   public:
+    static constexpr size_t columns = 4;
+    transfer_series(const std::string& dir, bool writable);
+
+    void append(uint64_t time, uint64_t from, uint64_t amount, uint64_t symbol) {
+      const uint64_t row[columns] = {time, from, amount, symbol};
+      series::append(row);
+    }
+    transfer_range rows(size_t begin, size_t end) const;
+    transfer_range range(uint64_t from, uint64_t to) const { return rows(lower_bound(from), lower_bound(to)); }
+  };
+
+  struct store_head {
+    uint32_t block = 0;
+    uint64_t time = 0;
+  };
+
+  class store {
+   public:
+    /// Opens or, when writable, creates the store at dir. A writer drops
+    /// rows newer than the recorded head, which a crash after the last
+    /// sync() can leave behind, so they are not indexed twice.
+    store(const std::string& dir, bool writable);
+
+    const store_head& head() const { return _head; }
+
+    datapoint_series* find_pair(uint64_t pair) const;
+    datapoint_series& pair(uint64_t pair);
+    transfer_series* find_transfers(uint64_t scope) const;
+    transfer_series& transfers(uint64_t scope);
+
+    const std::map<uint64_t, std::unique_ptr<datapoint_series>>& pairs() const { return _pairs; }
+    const std::map<uint64_t, std::unique_ptr<transfer_series>>& transfer_scopes() const { return _transfers; }
+
+    /// Writer: flushes every column, then records head, so that head never
+    /// runs ahead of the data.
+    void sync(const store_head& head);
+
+    /// Reader: picks up new pairs, new rows and the new head.
+    void refresh();
+
+   private:
+    void scan();
+    void read_head();
+
+    std::string _dir;
+    bool _writable;
+    store_head _head;
+    std::map<uint64_t, std::unique_ptr<datapoint_series>> _pairs;
+    std::map<uint64_t, std::unique_ptr<transfer_series>> _transfers;
+  };
+
+} // namespace history
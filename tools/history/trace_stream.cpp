@@ -0,0 +1,121 @@
+#include "trace_stream.hpp"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace history {
+
+  void put_varuint(std::vector<uint8_t>& out, uint32_t v) {
+    do {
+      uint8_t b = v & 0x7f;
+      v >>= 7;
+      out.push_back(b | (v ? 0x80 : 0));
+    } while (v);
+  }
+
+  void frame_writer::begin_block(uint32_t num, uint32_t slot) {
+    _actions.clear();
+    _num = num;
+    _slot = slot;
+    _count = 0;
+  }
+
+  void frame_writer::add_action(uint64_t receiver, uint64_t account, uint64_t name, const void* data, size_t size) {
+    put(_actions, receiver);
+    put(_actions, account);
+    put(_actions, name);
+    put_varuint(_actions, uint32_t(size));
+    auto p = static_cast<const uint8_t*>(data);
+    _actions.insert(_actions.end(), p, p + size);
+    _count++;
+  }
+
+  const std::vector<uint8_t>& frame_writer::end_block() {
+    std::vector<uint8_t> count;
+    put_varuint(count, _count);
+    _frame.clear();
+    put(_frame, uint32_t(8 + count.size() + _actions.size()));
+    put(_frame, _num);
+    put(_frame, _slot);
+    _frame.insert(_frame.end(), count.begin(), count.end());
+    _frame.insert(_frame.end(), _actions.begin(), _actions.end());
+    return _frame;
+  }
+
+  file_input::file_input(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw stream_error("cannot open " + path + ": " + std::strerror(errno));
+    struct stat st{};
+    fstat(fd, &st);
+    _size = size_t(st.st_size);
+    if (_size) {
+      void* p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        int err = errno;
+        ::close(fd);
+        throw stream_error("cannot map " + path + ": " + std::strerror(err));
+      }
+      madvise(p, _size, MADV_SEQUENTIAL);
+      _data = static_cast<const uint8_t*>(p);
+    }
+    ::close(fd);
+  }
+
+  file_input::~file_input() {
+    if (_data) munmap(const_cast<uint8_t*>(_data), _size);
+  }
+
+  socket_input::socket_input(const std::string& address) {
+    auto colon = address.rfind(':');
+    if (colon == std::string::npos) throw stream_error("expected host:port, got " + address);
+    std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &res); rc != 0)
+      throw stream_error(host + ": " + gai_strerror(rc));
+    std::string last_error = "no addresses";
+    for (auto ai = res; ai != nullptr && _fd < 0; ai = ai->ai_next) {
+      int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+      if (fd < 0) continue;
+      if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+        _fd = fd;
+      } else {
+        last_error = std::strerror(errno);
+        ::close(fd);
+      }
+    }
+    freeaddrinfo(res);
+    if (_fd < 0) throw stream_error("cannot connect to " + address + ": " + last_error);
+  }
+
+  socket_input::~socket_input() {
+    if (_fd >= 0) ::close(_fd);
+  }
+
+  size_t socket_input::read(std::vector<uint8_t>& buf) {
+    constexpr size_t chunk = 1 << 20;
+    size_t at = buf.size();
+    buf.resize(at + chunk);
+    for (;;) {
+      ssize_t n = ::recv(_fd, buf.data() + at, chunk, 0);
+      if (n >= 0) {
+        buf.resize(at + size_t(n));
+        return size_t(n);
+      }
+      if (errno != EINTR) {
+        buf.resize(at);
+        throw stream_error(std::string("read failed: ") + std::strerror(errno));
+      }
+    }
+  }
+
+} // namespace history
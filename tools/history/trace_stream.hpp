@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The indexer's input: irreversible blocks and the action traces in them,
+// reduced from what a state-history plugin streams to the fields the
+// indexer reads. Each block is one length-prefixed frame:
+//
+//   uint32  frame size, not counting itself
+//   uint32  block number
+//   uint32  block timestamp, in half-second slots since 2000-01-01
+//   varuint action count
+//   per action:
+//     uint64  receiver
+//     uint64  account
+//     uint64  name
+//     varuint data size
+//     bytes   data, abi-packed action arguments
+//
+// All integers little endian, as on the wire of the chain itself. A frame
+// is parsed in place: action data points into the buffer it came from.
+namespace history {
+
+  struct stream_error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+  };
+
+  struct action_trace {
+    uint64_t receiver = 0;
+    uint64_t account = 0;
+    uint64_t name = 0;
+    const uint8_t* data = nullptr;
+    uint32_t size = 0;
+  };
+
+  struct block_view {
+    uint32_t num = 0;
+    uint32_t slot = 0;
+    const uint8_t* actions = nullptr; // first action
+    const uint8_t* end = nullptr;
+    uint32_t action_count = 0;
+
+    /// Block time in microseconds since the epoch, as current_time_point()
+    /// reads it in the block's actions.
+    uint64_t time_us() const { return (uint64_t(slot) * 500 + 946684800000ull) * 1000; }
+
+    template <typename F>
+    void for_each_action(F&& f) const;
+  };
+
+  /// Reads little-endian fields off a byte range; throws stream_error at
+  /// the end.
+  struct cursor {
+    const uint8_t* pos;
+    const uint8_t* end;
+
+    template <typename T>
+    T get() {
+      if (size_t(end - pos) < sizeof(T)) throw stream_error("truncated frame");
+      T v;
+      std::memcpy(&v, pos, sizeof(T));
+      pos += sizeof(T);
+      return v;
+    }
+
+    uint32_t varuint() {
+      uint32_t v = 0;
+      for (int shift = 0; shift < 35; shift += 7) {
+        if (pos == end) throw stream_error("truncated frame");
+        uint8_t b = *pos++;
+        v |= uint32_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+      }
+      throw stream_error("varuint too long");
+    }
+
+    const uint8_t* bytes(size_t n) {
+      if (size_t(end - pos) < n) throw stream_error("truncated frame");
+      auto p = pos;
+      pos += n;
+      return p;
+    }
+  };
+
+  template <typename F>
+  void block_view::for_each_action(F&& f) const {
+    cursor c{actions, end};
+    for (uint32_t i = 0; i < action_count; ++i) {
+      action_trace a;
+      a.receiver = c.get<uint64_t>();
+      a.account = c.get<uint64_t>();
+      a.name = c.get<uint64_t>();
+      a.size = c.varuint();
+      a.data = c.bytes(a.size);
+      f(a);
+    }
+  }
+
+  /// Parses the complete frames at the front of [data, data + size) and
+  /// returns how many bytes they took; a partial frame at the end is left
+  /// for the caller to complete.
+  template <typename F>
+  size_t for_each_block(const uint8_t* data, size_t size, F&& f) {
+    size_t used = 0;
+    while (size - used >= 4) {
+      uint32_t frame;
+      std::memcpy(&frame, data + used, 4);
+      if (size - used - 4 < frame) break;
+      cursor c{data + used + 4, data + used + 4 + frame};
+      block_view b;
+      b.num = c.get<uint32_t>();
+      b.slot = c.get<uint32_t>();
+      b.action_count = c.varuint();
+      b.actions = c.pos;
+      b.end = c.end;
+      f(static_cast<const block_view&>(b));
+      used += 4 + frame;
+    }
+    return used;
+  }
+
+  /// Builds frames; used by mockship and anything else that produces a
+  /// stream.
+  class frame_writer {
+   public:
+    void begin_block(uint32_t num, uint32_t slot);
+    void add_action(uint64_t receiver, uint64_t account, uint64_t name, const void* data, size_t size);
+    /// Finishes the block and returns the frame, valid until the next
+    /// begin_block.
+    const std::vector<uint8_t>& end_block();
+
+   private:
+    std::vector<uint8_t> _actions;
+    std::vector<uint8_t> _frame;
+    uint32_t _num = 0, _slot = 0, _count = 0;
+  };
+
+  void put_varuint(std::vector<uint8_t>& out, uint32_t v);
+
+  template <typename T>
+  void put(std::vector<uint8_t>& out, T v) {
+    size_t at = out.size();
+    out.resize(at + sizeof(T));
+    std::memcpy(out.data() + at, &v, sizeof(T));
+  }
+
+  /// A trace file, mapped read-only; blocks parsed from it point into the
+  /// mapping.
+  class file_input {
+   public:
+    explicit file_input(const std::string& path);
+    file_input(const file_input&) = delete;
+    file_input& operator=(const file_input&) = delete;
+    ~file_input();
+
+    const uint8_t* data() const { return _data; }
+    size_t size() const { return _size; }
+
+   private:
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+  };
+
+  /// A stream from a socket, as a state-history endpoint would serve it.
+  class socket_input {
+   public:
+    /// "host:port"; throws stream_error.
+    explicit socket_input(const std::string& address);
+    socket_input(const socket_input&) = delete;
+    socket_input& operator=(const socket_input&) = delete;
+    ~socket_input();
+
+    /// Appends what has arrived to buf, blocking until something has;
+    /// returns 0 once the other end has closed.
+    size_t read(std::vector<uint8_t>& buf);
+
+   private:
+    int _fd = -1;
+  };
+
+  /// Microseconds since the epoch to the block slot that contains them.
+  inline uint32_t slot_of(uint64_t time_us) { return uint32_t((time_us / 1000 - 946684800000ull) / 500); }
+
+} // namespace history
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "chain.hpp"
+#include "datastream.hpp"
+
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace eosio {
+
+  struct action {
+    eosio::name account;
+    eosio::name name;
+    std::vector<permission_level> authorization;
+    std::vector<char> data;
+
+    action() = default;
+
+    template <typename T>
+    action(const permission_level& auth, eosio::name a, eosio::name n, T&& value)
+      : account(a), name(n), authorization(1, auth), data(pack(std::forward<T>(value))) {}
+
+    template <typename T>
+    action(std::vector<permission_level> auths, eosio::name a, eosio::name n, T&& value)
+      : account(a), name(n), authorization(std::move(auths)), data(pack(std::forward<T>(value))) {}
+
+    /// Inline actions are recorded; the harness decides whether to run them.
+    void send() const {
+      mock::state().inline_actions.push_back(mock::sent_action{account, name, authorization, data});
+    }
+
+    template <typename T>
+    T data_as() const { return unpack<T>(data); }
+  };
+
+  namespace detail {
+    template <typename T>
+    struct member_function_args;
+
+    template <typename C, typename R, typename... Args>
+    struct member_function_args<R (C::*)(Args...)> {
+      using tuple = std::tuple<std::decay_t<Args>...>;
+    };
+  }
+
+  template <eosio::name::raw Name, auto Action>
+  struct action_wrapper {
+    using args = typename detail::member_function_args<decltype(Action)>::tuple;
+
+    template <typename Code>
+    action_wrapper(Code&& code, std::vector<permission_level>&& perms)
+      : code_name(std::forward<Code>(code)), permissions(std::move(perms)) {}
+
+    template <typename Code>
+    action_wrapper(Code&& code, const permission_level& perm)
+      : code_name(std::forward<Code>(code)), permissions({perm}) {}
+
+    template <typename... Args>
+    action to_action(Args&&... args_in) const {
+      return action(permissions, code_name, eosio::name(Name), args(std::forward<Args>(args_in)...));
+    }
+
+    template <typename... Args>
+    void send(Args&&... args_in) const {
+      to_action(std::forward<Args>(args_in)...).send();
+    }
+
+    eosio::name code_name;
+    std::vector<permission_level> permissions;
+  };
+
+} // namespace eosio
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "check.hpp"
+#include "datastream.hpp"
+#include "name.hpp"
+
+#include <string>
+#include <string_view>
+
+namespace eosio {
+
+  class symbol_code {
+  public:
+    constexpr symbol_code() = default;
+    constexpr explicit symbol_code(uint64_t raw) : value(raw) {}
+    constexpr explicit symbol_code(std::string_view str) {
+      for (auto itr = str.rbegin(); itr != str.rend(); ++itr) {
+        value <<= 8;
+        value |= uint64_t(*itr);
+      }
+    }
+
+    constexpr uint64_t raw() const { return value; }
+
+    std::string to_string() const {
+      std::string s;
+      for (uint64_t v = value; v; v >>= 8) s += char(v & 0xff);
+      return s;
+    }
+
+    friend constexpr bool operator==(const symbol_code& a, const symbol_code& b) { return a.value == b.value; }
+    friend constexpr bool operator!=(const symbol_code& a, const symbol_code& b) { return a.value != b.value; }
+    friend constexpr bool operator<(const symbol_code& a, const symbol_code& b) { return a.value < b.value; }
+
+    template <typename Stream> void pack(Stream& ds) const { pack_value(ds, value); }
+    template <typename Stream> void unpack(Stream& ds) { unpack_value(ds, value); }
+
+  private:
+    uint64_t value = 0;
+  };
+
+  class symbol {
+  public:
+    constexpr symbol() = default;
+    constexpr explicit symbol(uint64_t s) : value(s) {}
+    constexpr symbol(symbol_code sc, uint8_t precision) : value((sc.raw() << 8) | precision) {}
+    constexpr symbol(std::string_view ss, uint8_t precision)
+      : value((symbol_code(ss).raw() << 8) | precision) {}
+
+    constexpr uint64_t raw() const { return value; }
+    constexpr uint8_t precision() const { return uint8_t(value & 0xff); }
+    constexpr symbol_code code() const { return symbol_code(value >> 8); }
+    constexpr bool is_valid() const { return value != 0; }
+    constexpr explicit operator bool() const { return value != 0; }
+
+    friend constexpr bool operator==(const symbol& a, const symbol& b) { return a.value == b.value; }
+    friend constexpr bool operator!=(const symbol& a, const symbol& b) { return a.value != b.value; }
+    friend constexpr bool operator<(const symbol& a, const symbol& b) { return a.value < b.value; }
+
+    std::string to_string() const { return std::to_string(precision()) + "," + code().to_string(); }
+
+    template <typename Stream> void pack(Stream& ds) const { pack_value(ds, value); }
+    template <typename Stream> void unpack(Stream& ds) { unpack_value(ds, value); }
+
+  private:
+    uint64_t value = 0;
+  };
+
+  struct asset {
+    int64_t amount = 0;
+    eosio::symbol symbol;
+
+    static constexpr int64_t max_amount = (1LL << 62) - 1;
+
+    asset() = default;
+    asset(int64_t a, eosio::symbol s) : amount(a), symbol(s) {
+      check(is_amount_within_range(), "magnitude of asset amount must be less than 2^62");
+      check(symbol.is_valid(), "invalid symbol name");
+    }
+
+    bool is_amount_within_range() const { return -max_amount <= amount && amount <= max_amount; }
+    bool is_valid() const { return is_amount_within_range() && symbol.is_valid(); }
+
+    asset operator-() const { asset r = *this; r.amount = -r.amount; return r; }
+
+    asset& operator+=(const asset& a) {
+      check(a.symbol == symbol, "attempt to add asset with different symbol");
+      amount += a.amount;
+      check(amount >= -max_amount, "addition underflow");
+      check(amount <= max_amount, "addition overflow");
+      return *this;
+    }
+
+    asset& operator-=(const asset& a) {
+      check(a.symbol == symbol, "attempt to subtract asset with different symbol");
+      amount -= a.amount;
+      check(amount >= -max_amount, "subtraction underflow");
+      check(amount <= max_amount, "subtraction overflow");
+      return *this;
+    }
+
+    asset& operator*=(int64_t a) { amount *= a; return *this; }
+    asset& operator/=(int64_t a) { check(a != 0, "divide by zero"); amount /= a; return *this; }
+
+    friend asset operator+(const asset& a, const asset& b) { asset r = a; r += b; return r; }
+    friend asset operator-(const asset& a, const asset& b) { asset r = a; r -= b; return r; }
+    friend asset operator*(const asset& a, int64_t b) { asset r = a; r *= b; return r; }
+    friend asset operator/(const asset& a, int64_t b) { asset r = a; r /= b; return r; }
+
+    friend bool operator==(const asset& a, const asset& b) { check(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed"); return a.amount == b.amount; }
+    friend bool operator!=(const asset& a, const asset& b) { return !(a == b); }
+    friend bool operator<(const asset& a, const asset& b) { check(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed"); return a.amount < b.amount; }
+    friend bool operator<=(const asset& a, const asset& b) { return !(b < a); }
+    friend bool operator>(const asset& a, const asset& b) { return b < a; }
+    friend bool operator>=(const asset& a, const asset& b) { return !(a < b); }
+
+    std::string to_string() const {
+      std::string s = std::to_string(amount);
+      return s + " " + symbol.code().to_string();
+    }
+
+    template <typename Stream> void pack(Stream& ds) const { pack_value(ds, amount); pack_value(ds, symbol); }
+    template <typename Stream> void unpack(Stream& ds) { unpack_value(ds, amount); unpack_value(ds, symbol); }
+  };
+
+  struct extended_asset {
+    asset quantity;
+    name contract;
+  };
+
+} // namespace eosio
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "check.hpp"
+
+#include <optional>
+#include <utility>
+
+namespace eosio {
+
+  /// Trailing field that may be absent from rows written before it existed.
+  template <typename T>
+  class binary_extension {
+  public:
+    constexpr binary_extension() = default;
+    constexpr binary_extension(const T& ext) : _ext(ext) {}
+    constexpr binary_extension(T&& ext) : _ext(std::move(ext)) {}
+
+    constexpr bool has_value() const { return _ext.has_value(); }
+    constexpr explicit operator bool() const { return has_value(); }
+
+    T& value() {
+      check(has_value(), "binary extension is empty");
+      return *_ext;
+    }
+    const T& value() const {
+      check(has_value(), "binary extension is empty");
+      return *_ext;
+    }
+
+    T value_or(const T& def = T()) const { return _ext ? *_ext : def; }
+
+    T& operator*() { return value(); }
+    const T& operator*() const { return value(); }
+    T* operator->() { return &value(); }
+    const T* operator->() const { return &value(); }
+
+    template <typename... Args>
+    T& emplace(Args&&... args) { return _ext.emplace(std::forward<Args>(args)...); }
+
+    binary_extension& operator=(const T& v) { _ext = v; return *this; }
+    binary_extension& operator=(T&& v) { _ext = std::move(v); return *this; }
+
+    void reset() { _ext.reset(); }
+
+    template <typename Stream>
+    void pack(Stream& ds) const {
+      if (_ext) pack_value(ds, *_ext);
+    }
+
+    template <typename Stream>
+    void unpack(Stream& ds) {
+      if (ds.remaining()) {
+        T v{};
+        unpack_value(ds, v);
+        _ext = std::move(v);
+      } else {
+        _ext.reset();
+      }
+    }
+
+  private:
+    std::optional<T> _ext;
+  };
+
+} // namespace eosio
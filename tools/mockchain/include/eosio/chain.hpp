@@ -0,0 +1,213 @@
+#pragma once
+
+#include "asset.hpp"
+#include "check.hpp"
+#include "crypto.hpp"
+#include "datastream.hpp"
+#include "name.hpp"
+#include "time.hpp"
+
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// In-process stand-in for the chain state the contract sees through its
+// intrinsics. One global instance; the harness resets or seeds it between
+// actions and reads the counters back.
+namespace eosio {
+
+  struct permission_level {
+    name actor;
+    name permission;
+
+    friend bool operator==(const permission_level& a, const permission_level& b) {
+      return a.actor == b.actor && a.permission == b.permission;
+    }
+  };
+
+  namespace mock {
+
+    /// Billable overhead per row, as charged by nodeos.
+    static constexpr int64_t row_overhead_bytes = 112;
+    static constexpr int64_t secondary_overhead_bytes = 112;
+
+    struct table_key {
+      uint64_t code;
+      uint64_t scope;
+      uint64_t table;
+
+      friend auto operator<=>(const table_key&, const table_key&) = default;
+    };
+
+    struct row_data {
+      std::vector<char> bytes;
+      name payer;
+    };
+
+    struct table_data {
+      std::map<uint64_t, row_data> rows;
+      // secondary index number -> ordered (encoded key, primary key)
+      std::map<int, std::set<std::pair<std::string, uint64_t>>> secondary;
+      // secondary index number -> primary key -> encoded key
+      std::map<int, std::map<uint64_t, std::string>> secondary_by_pk;
+    };
+
+    struct db_counters {
+      uint64_t reads = 0;
+      uint64_t stores = 0;
+      uint64_t updates = 0;
+      uint64_t removes = 0;
+
+      uint64_t touched() const { return reads + stores + updates + removes; }
+    };
+
+    /// Prior contents of one row, kept so a failed action can be undone.
+    struct undo_entry {
+      table_key key;
+      uint64_t pk;
+      std::optional<row_data> row;
+      std::map<int, std::string> secondary;
+    };
+
+    struct sent_action {
+      eosio::name account;
+      eosio::name act;
+      std::vector<permission_level> authorization;
+      std::vector<char> data;
+    };
+
+    struct chain_state {
+      std::map<table_key, table_data> tables;
+
+      time_point now;
+      name receiver;
+      name first_receiver;
+      name action;
+      std::vector<char> action_data;
+      std::set<uint64_t> auths;
+
+      std::vector<name> recipients;
+      std::vector<sent_action> inline_actions;
+      std::map<uint64_t, int64_t> ram_usage;
+      db_counters counters;
+
+      std::vector<undo_entry> undo_log;
+      std::set<std::pair<table_key, uint64_t>> journaled;
+      std::map<uint64_t, int64_t> ram_at_begin;
+
+      /// Clears everything that is per-action, keeping the database.
+      void begin_action(name rcv, name code, name act, std::vector<char> data, std::set<uint64_t> authorizers) {
+        receiver = rcv;
+        first_receiver = code;
+        action = act;
+        action_data = std::move(data);
+        auths = std::move(authorizers);
+        recipients.clear();
+        inline_actions.clear();
+        counters = db_counters{};
+        undo_log.clear();
+        journaled.clear();
+        ram_at_begin = ram_usage;
+      }
+
+      /// Remembers a row before its first change in the current action.
+      void journal(const table_key& key, uint64_t pk) {
+        if (!journaled.insert({key, pk}).second)
+          return;
+        auto& tbl = tables[key];
+        undo_entry entry{key, pk, std::nullopt, {}};
+        if (auto itr = tbl.rows.find(pk); itr != tbl.rows.end())
+          entry.row = itr->second;
+        for (auto& [index, by_pk] : tbl.secondary_by_pk)
+          if (auto itr = by_pk.find(pk); itr != by_pk.end())
+            entry.secondary[index] = itr->second;
+        undo_log.push_back(std::move(entry));
+      }
+
+      /// Restores every row the current action touched, as the chain does
+      /// when a transaction fails.
+      void rollback() {
+        for (auto entry = undo_log.rbegin(); entry != undo_log.rend(); ++entry) {
+          auto& tbl = tables[entry->key];
+          for (auto& [index, by_pk] : tbl.secondary_by_pk) {
+            auto itr = by_pk.find(entry->pk);
+            if (itr == by_pk.end()) continue;
+            tbl.secondary[index].erase({itr->second, entry->pk});
+            by_pk.erase(itr);
+          }
+          if (!entry->row) {
+            tbl.rows.erase(entry->pk);
+            continue;
+          }
+          tbl.rows[entry->pk] = *entry->row;
+          for (auto& [index, key] : entry->secondary) {
+            tbl.secondary[index].insert({key, entry->pk});
+            tbl.secondary_by_pk[index][entry->pk] = key;
+          }
+        }
+        undo_log.clear();
+        journaled.clear();
+        ram_usage = ram_at_begin;
+        inline_actions.clear();
+      }
+
+      table_data* find_table(name code, uint64_t scope, name table) {
+        auto itr = tables.find(table_key{code.value, scope, table.value});
+        return itr == tables.end() ? nullptr : &itr->second;
+      }
+
+      table_data& get_table(name code, uint64_t scope, name table) {
+        return tables[table_key{code.value, scope, table.value}];
+      }
+
+      void bill(name payer, int64_t delta) {
+        ram_usage[payer.value] += delta;
+      }
+    };
+
+    inline chain_state& state() {
+      static chain_state s;
+      return s;
+    }
+
+  } // namespace mock
+
+  inline bool has_auth(name n) { return mock::state().auths.count(n.value) > 0; }
+
+  inline void require_auth(name n) {
+    check(has_auth(n), "missing authority of " + n.to_string());
+  }
+
+  inline void require_auth(const permission_level& level) { require_auth(level.actor); }
+
+  inline void require_recipient(name n) {
+    auto& recipients = mock::state().recipients;
+    for (auto r : recipients)
+      if (r == n) return;
+    recipients.push_back(n);
+  }
+
+  template <typename... Names>
+  void require_recipient(name n, Names... more) {
+    require_recipient(n);
+    require_recipient(more...);
+  }
+
+  inline bool is_account(name n) { return n.value != 0; }
+
+  inline time_point current_time_point() { return mock::state().now; }
+  inline block_timestamp current_block_time() { return block_timestamp(mock::state().now); }
+
+  inline uint32_t action_data_size() { return uint32_t(mock::state().action_data.size()); }
+
+  template <typename T>
+  T unpack_action_data() {
+    return unpack<T>(mock::state().action_data);
+  }
+
+  inline name current_receiver() { return mock::state().receiver; }
+
+} // namespace eosio
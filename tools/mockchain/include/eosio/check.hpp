@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace eosio {
+
+  /// Raised by check() natively; the chain would abort the transaction.
+  struct check_failure : std::runtime_error {
+    using std::runtime_error::runtime_error;
+  };
+
+  inline void check(bool pred, const char* msg) {
+    if (!pred) throw check_failure(msg);
+  }
+
+  inline void check(bool pred, const std::string& msg) {
+    if (!pred) throw check_failure(msg);
+  }
+
+  namespace mock {
+    /// print() output is discarded unless a harness enables it.
+    inline bool& print_enabled() {
+      static bool enabled = false;
+      return enabled;
+    }
+  }
+
+  // stdio rather than iostream, which would add a global constructor to
+  // every translation unit that includes it
+  template <typename T>
+  inline void print_one(const T& v) {
+    auto write = [](std::string_view s) { std::fwrite(s.data(), 1, s.size(), stdout); };
+    if constexpr (std::is_same_v<T, bool>)
+      write(v ? "true" : "false");
+    else if constexpr (std::is_same_v<T, char>)
+      std::fputc(v, stdout);
+    else if constexpr (std::is_arithmetic_v<T>)
+      write(std::to_string(v));
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+      write(std::string_view(v));
+    else if constexpr (requires { v.to_string(); })
+      write(v.to_string());
+    else if constexpr (requires { v.print(); })
+      v.print();
+  }
+
+  template <typename... Args>
+  inline void print(const Args&... args) {
+    if (mock::print_enabled())
+      (print_one(args), ...);
+  }
+
+} // namespace eosio
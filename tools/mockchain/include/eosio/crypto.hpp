@@ -0,0 +1,70 @@
+#pragma once
+
+#include "check.hpp"
+#include "datastream.hpp"
+
+#include <array>
+#include <cstring>
+#include <string>
+#include <variant>
+
+namespace eosio {
+
+  template <size_t Size>
+  class fixed_bytes {
+  public:
+    constexpr fixed_bytes() : _data{} {}
+    explicit fixed_bytes(const std::array<uint8_t, Size>& d) : _data(d) {}
+
+    const uint8_t* data() const { return _data.data(); }
+    uint8_t* data() { return _data.data(); }
+    static constexpr size_t size() { return Size; }
+
+    std::array<uint8_t, Size> extract_as_byte_array() const { return _data; }
+
+    friend bool operator==(const fixed_bytes& a, const fixed_bytes& b) { return a._data == b._data; }
+    friend bool operator!=(const fixed_bytes& a, const fixed_bytes& b) { return a._data != b._data; }
+    friend bool operator<(const fixed_bytes& a, const fixed_bytes& b) { return a._data < b._data; }
+
+    template <typename Stream> void pack(Stream& ds) const { ds.write((const char*)_data.data(), Size); }
+    template <typename Stream> void unpack(Stream& ds) { ds.read((char*)_data.data(), Size); }
+
+  private:
+    std::array<uint8_t, Size> _data;
+  };
+
+  using checksum160 = fixed_bytes<20>;
+  using checksum256 = fixed_bytes<32>;
+  using checksum512 = fixed_bytes<64>;
+
+  using ecc_public_key = std::array<char, 33>;
+  using ecc_signature = std::array<char, 65>;
+
+  struct webauthn_public_key {
+    enum class user_presence_t : uint8_t { USER_PRESENCE_NONE, USER_PRESENCE_PRESENT, USER_PRESENCE_VERIFIED };
+    ecc_public_key key{};
+    user_presence_t user_presence = user_presence_t::USER_PRESENCE_NONE;
+    std::string rpid;
+
+    friend bool operator==(const webauthn_public_key& a, const webauthn_public_key& b) { return a.key == b.key && a.user_presence == b.user_presence && a.rpid == b.rpid; }
+    friend bool operator<(const webauthn_public_key& a, const webauthn_public_key& b) { return a.key < b.key; }
+  };
+
+  struct webauthn_signature {
+    ecc_signature compact_signature{};
+    std::vector<uint8_t> auth_data;
+    std::string client_json;
+
+    friend bool operator==(const webauthn_signature& a, const webauthn_signature& b) { return a.compact_signature == b.compact_signature; }
+  };
+
+  using public_key = std::variant<ecc_public_key, ecc_public_key, webauthn_public_key>;
+  using signature = std::variant<ecc_signature, ecc_signature, webauthn_signature>;
+
+  /// Provided by the harness; the chain computes these natively.
+  checksum256 sha256(const char* data, uint32_t length);
+  void assert_sha256(const char* data, uint32_t length, const checksum256& hash);
+  public_key recover_key(const checksum256& digest, const signature& sig);
+  void assert_recover_key(const checksum256& digest, const signature& sig, const public_key& pubkey);
+
+} // namespace eosio
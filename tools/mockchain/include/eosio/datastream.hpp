@@ -0,0 +1,264 @@
+#pragma once
+
+#include "check.hpp"
+#include "reflect.hpp"
+
+#include <array>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace eosio {
+
+  /// Same wire format as the CDT datastream; the pointer flavour reads, the
+  /// size_t flavour only measures.
+  template <typename T>
+  class datastream {
+  public:
+    datastream(T start, size_t s) : _start(start), _pos(start), _end(start + s) {}
+
+    void read(char* d, size_t s) {
+      check(size_t(_end - _pos) >= s, "datastream attempted to read past the end");
+      std::memcpy(d, _pos, s);
+      _pos += s;
+    }
+
+    void write(const char* d, size_t s) {
+      check(size_t(_end - _pos) >= s, "datastream attempted to write past the end");
+      std::memcpy((void*)_pos, d, s);
+      _pos += s;
+    }
+
+    void skip(size_t s) { _pos += s; }
+    T pos() const { return _pos; }
+    size_t tellp() const { return size_t(_pos - _start); }
+    size_t remaining() const { return size_t(_end - _pos); }
+
+  private:
+    T _start;
+    T _pos;
+    T _end;
+  };
+
+  template <>
+  class datastream<size_t> {
+  public:
+    explicit datastream(size_t init = 0) : _size(init) {}
+    void write(const char*, size_t s) { _size += s; }
+    void skip(size_t s) { _size += s; }
+    size_t tellp() const { return _size; }
+    size_t remaining() const { return 0; }
+
+  private:
+    size_t _size;
+  };
+
+  struct unsigned_int {
+    uint32_t value = 0;
+    unsigned_int(uint32_t v = 0) : value(v) {}
+    operator uint32_t() const { return value; }
+  };
+
+  template <typename Stream>
+  void pack_value(Stream& ds, const unsigned_int& v) {
+    uint64_t val = v.value;
+    do {
+      uint8_t b = uint8_t(val) & 0x7f;
+      val >>= 7;
+      b |= ((val > 0) << 7);
+      ds.write((const char*)&b, 1);
+    } while (val);
+  }
+
+  template <typename Stream>
+  void unpack_value(Stream& ds, unsigned_int& v) {
+    uint64_t val = 0;
+    uint8_t b = 0;
+    uint8_t by = 0;
+    do {
+      ds.read((char*)&b, 1);
+      val |= uint64_t(b & 0x7f) << by;
+      by += 7;
+    } while (b & 0x80);
+    v.value = uint32_t(val);
+  }
+
+  template <typename T>
+  struct is_vector : std::false_type {};
+  template <typename T>
+  struct is_vector<std::vector<T>> : std::true_type {};
+
+  template <typename T>
+  struct is_tuple : std::false_type {};
+  template <typename... T>
+  struct is_tuple<std::tuple<T...>> : std::true_type {};
+
+  template <typename T>
+  struct is_std_array : std::false_type {};
+  template <typename T, size_t N>
+  struct is_std_array<std::array<T, N>> : std::true_type {};
+
+  template <typename T>
+  struct is_variant : std::false_type {};
+  template <typename... T>
+  struct is_variant<std::variant<T...>> : std::true_type {};
+
+  template <typename T>
+  struct is_optional : std::false_type {};
+  template <typename T>
+  struct is_optional<std::optional<T>> : std::true_type {};
+
+  template <typename T>
+  struct is_map : std::false_type {};
+  template <typename K, typename V>
+  struct is_map<std::map<K, V>> : std::true_type {};
+
+  template <typename Stream, typename T>
+  void pack_value(Stream& ds, const T& v);
+  template <typename Stream, typename T>
+  void unpack_value(Stream& ds, T& v);
+
+  template <typename Stream, typename T>
+  void pack_value(Stream& ds, const T& v) {
+    if constexpr (requires { v.pack(ds); }) {
+      v.pack(ds);
+    } else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+      ds.write((const char*)&v, sizeof(T));
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      pack_value(ds, unsigned_int(v.size()));
+      ds.write(v.data(), v.size());
+    } else if constexpr (is_vector<T>::value) {
+      pack_value(ds, unsigned_int(v.size()));
+      for (const auto& e : v) pack_value(ds, e);
+    } else if constexpr (is_map<T>::value) {
+      pack_value(ds, unsigned_int(v.size()));
+      for (const auto& [k, e] : v) { pack_value(ds, k); pack_value(ds, e); }
+    } else if constexpr (is_std_array<T>::value) {
+      for (const auto& e : v) pack_value(ds, e);
+    } else if constexpr (is_tuple<T>::value) {
+      std::apply([&](const auto&... e) { (pack_value(ds, e), ...); }, v);
+    } else if constexpr (is_optional<T>::value) {
+      pack_value(ds, bool(v));
+      if (v) pack_value(ds, *v);
+    } else if constexpr (is_variant<T>::value) {
+      pack_value(ds, unsigned_int(v.index()));
+      std::visit([&](const auto& e) { pack_value(ds, e); }, v);
+    } else {
+      static_assert(std::is_aggregate_v<T>, "type is not serializable");
+      reflect::for_each_field(v, [&](const auto& f) { pack_value(ds, f); });
+    }
+  }
+
+  template <typename Variant, size_t I = 0>
+  void unpack_variant(auto& ds, Variant& v, uint32_t index) {
+    if constexpr (I < std::variant_size_v<Variant>) {
+      if (index == I) {
+        std::variant_alternative_t<I, Variant> e{};
+        unpack_value(ds, e);
+        v.template emplace<I>(std::move(e));
+      } else {
+        unpack_variant<Variant, I + 1>(ds, v, index);
+      }
+    } else {
+      check(false, "invalid variant index");
+    }
+  }
+
+  template <typename Stream, typename T>
+  void unpack_value(Stream& ds, T& v) {
+    if constexpr (requires { v.unpack(ds); }) {
+      v.unpack(ds);
+    } else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+      ds.read((char*)&v, sizeof(T));
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      unsigned_int s;
+      unpack_value(ds, s);
+      v.resize(s.value);
+      if (s.value) ds.read(v.data(), s.value);
+    } else if constexpr (is_vector<T>::value) {
+      unsigned_int s;
+      unpack_value(ds, s);
+      v.clear();
+      v.resize(s.value);
+      for (auto& e : v) unpack_value(ds, e);
+    } else if constexpr (is_map<T>::value) {
+      unsigned_int s;
+      unpack_value(ds, s);
+      v.clear();
+      for (uint32_t i = 0; i < s.value; ++i) {
+        typename T::key_type k{};
+        typename T::mapped_type e{};
+        unpack_value(ds, k);
+        unpack_value(ds, e);
+        v.emplace(std::move(k), std::move(e));
+      }
+    } else if constexpr (is_std_array<T>::value) {
+      for (auto& e : v) unpack_value(ds, e);
+    } else if constexpr (is_tuple<T>::value) {
+      std::apply([&](auto&... e) { (unpack_value(ds, e), ...); }, v);
+    } else if constexpr (is_optional<T>::value) {
+      bool has = false;
+      unpack_value(ds, has);
+      if (has) {
+        typename T::value_type e{};
+        unpack_value(ds, e);
+        v = std::move(e);
+      } else {
+        v.reset();
+      }
+    } else if constexpr (is_variant<T>::value) {
+      unsigned_int index;
+      unpack_value(ds, index);
+      unpack_variant(ds, v, index.value);
+    } else {
+      static_assert(std::is_aggregate_v<T>, "type is not serializable");
+      reflect::for_each_field(v, [&](auto& f) { unpack_value(ds, f); });
+    }
+  }
+
+  template <typename S, typename T>
+  datastream<S>& operator<<(datastream<S>& ds, const T& v) {
+    pack_value(ds, v);
+    return ds;
+  }
+
+  template <typename S, typename T>
+  datastream<S>& operator>>(datastream<S>& ds, T& v) {
+    unpack_value(ds, v);
+    return ds;
+  }
+
+  template <typename T>
+  size_t pack_size(const T& v) {
+    datastream<size_t> ds;
+    pack_value(ds, v);
+    return ds.tellp();
+  }
+
+  template <typename T>
+  std::vector<char> pack(const T& v) {
+    std::vector<char> result(pack_size(v));
+    datastream<char*> ds(result.data(), result.size());
+    pack_value(ds, v);
+    return result;
+  }
+
+  template <typename T>
+  T unpack(const char* buffer, size_t len) {
+    T result{};
+    datastream<const char*> ds(buffer, len);
+    unpack_value(ds, result);
+    return result;
+  }
+
+  template <typename T>
+  T unpack(const std::vector<char>& bytes) {
+    return unpack<T>(bytes.data(), bytes.size());
+  }
+
+} // namespace eosio
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "action.hpp"
+#include "asset.hpp"
+#include "binary_extension.hpp"
+#include "chain.hpp"
+#include "check.hpp"
+#include "contract.hpp"
+#include "crypto.hpp"
+#include "datastream.hpp"
+#include "multi_index.hpp"
+#include "name.hpp"
+#include "time.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
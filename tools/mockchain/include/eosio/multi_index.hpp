@@ -0,0 +1,461 @@
+#pragma once
+
+#include "chain.hpp"
+
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+namespace eosio {
+
+  /// Passed to modify to keep the row's current payer.
+  constexpr name same_payer{};
+
+  template <class Class, typename Type, Type (Class::*PtrToMemberFunction)() const>
+  struct const_mem_fun {
+    typedef std::remove_cvref_t<Type> result_type;
+    Type operator()(const Class& x) const { return (x.*PtrToMemberFunction)(); }
+  };
+
+  template <name::raw IndexName, typename Extractor>
+  struct indexed_by {
+    static constexpr name index_name = name(IndexName);
+    typedef Extractor secondary_extractor_type;
+  };
+
+  namespace mock {
+
+    // Secondary keys are stored as byte strings whose memcmp order matches
+    // the chain's ordering for the key type.
+    inline std::string encode_key(uint64_t v) {
+      std::string s(8, '\0');
+      for (int i = 7; i >= 0; --i) { s[i] = char(v & 0xff); v >>= 8; }
+      return s;
+    }
+
+    inline std::string encode_key(unsigned __int128 v) {
+      return encode_key(uint64_t(v >> 64)) + encode_key(uint64_t(v));
+    }
+
+    inline std::string encode_key(double d) {
+      uint64_t bits;
+      std::memcpy(&bits, &d, sizeof(bits));
+      bits = (bits & (1ull << 63)) ? ~bits : (bits | (1ull << 63));
+      return encode_key(bits);
+    }
+
+    inline std::string encode_key(const checksum256& c) {
+      return std::string((const char*)c.data(), c.size());
+    }
+
+  } // namespace mock
+
+  template <name::raw TableName, typename T, typename... Indices>
+  class multi_index {
+  public:
+    class const_iterator;
+
+    template <int I>
+    class index;
+
+    multi_index(name code, uint64_t scope) : _code(code), _scope(scope) {}
+
+    multi_index(const multi_index&) = delete;
+    multi_index& operator=(const multi_index&) = delete;
+
+    name get_code() const { return _code; }
+    uint64_t get_scope() const { return _scope; }
+
+    class const_iterator {
+    public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = const T;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const T*;
+      using reference = const T&;
+
+      const_iterator() = default;
+
+      const T& operator*() const {
+        check(_pk.has_value(), "cannot dereference end iterator");
+        return _multidx->load(*_pk);
+      }
+      const T* operator->() const { return &**this; }
+
+      const_iterator& operator++() {
+        check(_pk.has_value(), "cannot increment end iterator");
+        auto& rows = _multidx->table().rows;
+        auto itr = rows.upper_bound(*_pk);
+        _pk = itr == rows.end() ? std::nullopt : std::optional<uint64_t>(itr->first);
+        return *this;
+      }
+
+      const_iterator& operator--() {
+        auto& rows = _multidx->table().rows;
+        auto itr = _pk ? rows.lower_bound(*_pk) : rows.end();
+        check(itr != rows.begin(), "cannot decrement iterator at beginning of table");
+        --itr;
+        _pk = itr->first;
+        return *this;
+      }
+
+      const_iterator operator++(int) { auto r = *this; ++*this; return r; }
+      const_iterator operator--(int) { auto r = *this; --*this; return r; }
+
+      friend bool operator==(const const_iterator& a, const const_iterator& b) { return a._pk == b._pk; }
+      friend bool operator!=(const const_iterator& a, const const_iterator& b) { return a._pk != b._pk; }
+
+    private:
+      friend class multi_index;
+      const_iterator(const multi_index* mi, std::optional<uint64_t> pk) : _multidx(mi), _pk(pk) {}
+
+      const multi_index* _multidx = nullptr;
+      std::optional<uint64_t> _pk;
+    };
+
+    template <int I>
+    class index {
+      using index_type = std::tuple_element_t<I, std::tuple<Indices...>>;
+      using extractor = typename index_type::secondary_extractor_type;
+
+    public:
+      using secondary_key_type = typename extractor::result_type;
+
+      class const_iterator {
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = const T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+
+        const T& operator*() const {
+          check(_pk.has_value(), "cannot dereference end iterator");
+          return _multidx->load(*_pk);
+        }
+        const T* operator->() const { return &**this; }
+
+        const_iterator& operator++() {
+          check(_pk.has_value(), "cannot increment end iterator");
+          auto& set = _multidx->table().secondary[I];
+          auto key = _multidx->table().secondary_by_pk[I].at(*_pk);
+          auto itr = set.upper_bound({key, *_pk});
+          _pk = itr == set.end() ? std::nullopt : std::optional<uint64_t>(itr->second);
+          return *this;
+        }
+
+        const_iterator& operator--() {
+          auto& set = _multidx->table().secondary[I];
+          auto itr = set.end();
+          if (_pk)
+            itr = set.lower_bound({_multidx->table().secondary_by_pk[I].at(*_pk), *_pk});
+          check(itr != set.begin(), "cannot decrement iterator at beginning of index");
+          --itr;
+          _pk = itr->second;
+          return *this;
+        }
+
+        const_iterator operator++(int) { auto r = *this; ++*this; return r; }
+        const_iterator operator--(int) { auto r = *this; --*this; return r; }
+
+        friend bool operator==(const const_iterator& a, const const_iterator& b) { return a._pk == b._pk; }
+        friend bool operator!=(const const_iterator& a, const const_iterator& b) { return a._pk != b._pk; }
+
+      private:
+        friend class index;
+        const_iterator(const multi_index* mi, std::optional<uint64_t> pk) : _multidx(mi), _pk(pk) {}
+
+        const multi_index* _multidx = nullptr;
+        std::optional<uint64_t> _pk;
+      };
+
+      using iterator = const_iterator;
+
+      explicit index(multi_index* mi) : _multidx(mi) {}
+
+      const_iterator begin() const {
+        auto& set = _multidx->table().secondary[I];
+        return make(set.begin());
+      }
+      const_iterator end() const { return const_iterator(_multidx, std::nullopt); }
+      const_iterator cbegin() const { return begin(); }
+      const_iterator cend() const { return end(); }
+      std::reverse_iterator<const_iterator> rbegin() const { return std::make_reverse_iterator(end()); }
+      std::reverse_iterator<const_iterator> rend() const { return std::make_reverse_iterator(begin()); }
+
+      const_iterator lower_bound(const secondary_key_type& key) const {
+        auto& set = _multidx->table().secondary[I];
+        return make(set.lower_bound({mock::encode_key(key), 0}));
+      }
+
+      const_iterator upper_bound(const secondary_key_type& key) const {
+        auto& set = _multidx->table().secondary[I];
+        return make(set.upper_bound({mock::encode_key(key), ~uint64_t(0)}));
+      }
+
+      const_iterator find(const secondary_key_type& key) const {
+        auto& set = _multidx->table().secondary[I];
+        auto enc = mock::encode_key(key);
+        auto itr = set.lower_bound({enc, 0});
+        if (itr == set.end() || itr->first != enc) return end();
+        return make(itr);
+      }
+
+      const T& get(const secondary_key_type& key, const char* error_msg = "unable to find secondary key") const {
+        auto itr = find(key);
+        check(itr != end(), error_msg);
+        return *itr;
+      }
+
+      const_iterator iterator_to(const T& obj) const { return const_iterator(_multidx, obj.primary_key()); }
+
+      template <typename Lambda>
+      void modify(const_iterator itr, name payer, Lambda&& updater) {
+        _multidx->modify(*itr, payer, std::forward<Lambda>(updater));
+      }
+
+      const_iterator erase(const_iterator itr) {
+        check(itr != end(), "cannot pass end iterator to erase");
+        auto next = itr;
+        ++next;
+        _multidx->erase(*itr);
+        return next;
+      }
+
+      static auto extract_secondary_key(const T& obj) { return extractor()(obj); }
+
+    private:
+      const_iterator make(std::set<std::pair<std::string, uint64_t>>::const_iterator itr) const {
+        auto& set = _multidx->table().secondary[I];
+        if (itr == set.end()) return end();
+        return const_iterator(_multidx, itr->second);
+      }
+
+      multi_index* _multidx;
+    };
+
+    using iterator = const_iterator;
+
+    const_iterator begin() const {
+      auto& rows = table().rows;
+      return rows.empty() ? end() : const_iterator(this, rows.begin()->first);
+    }
+    const_iterator end() const { return const_iterator(this, std::nullopt); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+    std::reverse_iterator<const_iterator> rbegin() const { return std::make_reverse_iterator(end()); }
+    std::reverse_iterator<const_iterator> rend() const { return std::make_reverse_iterator(begin()); }
+
+    const_iterator lower_bound(uint64_t primary) const {
+      auto& rows = table().rows;
+      auto itr = rows.lower_bound(primary);
+      return itr == rows.end() ? end() : const_iterator(this, itr->first);
+    }
+
+    const_iterator upper_bound(uint64_t primary) const {
+      auto& rows = table().rows;
+      auto itr = rows.upper_bound(primary);
+      return itr == rows.end() ? end() : const_iterator(this, itr->first);
+    }
+
+    const_iterator find(uint64_t primary) const {
+      auto& rows = table().rows;
+      if (rows.find(primary) == rows.end()) return end();
+      load(primary);
+      return const_iterator(this, primary);
+    }
+
+    const_iterator require_find(uint64_t primary, const char* error_msg = "unable to find key") const {
+      auto itr = find(primary);
+      check(itr != end(), error_msg);
+      return itr;
+    }
+
+    const T& get(uint64_t primary, const char* error_msg = "unable to find key") const {
+      auto itr = find(primary);
+      check(itr != end(), error_msg);
+      return *itr;
+    }
+
+    const_iterator iterator_to(const T& obj) const { return const_iterator(this, obj.primary_key()); }
+
+    uint64_t available_primary_key() const {
+      auto& rows = table().rows;
+      if (rows.empty()) return 0;
+      check(rows.rbegin()->first < ~uint64_t(1), "next primary key in table is at autoincrement limit");
+      return rows.rbegin()->first + 1;
+    }
+
+    template <name::raw IndexName>
+    auto get_index() {
+      constexpr int I = index_number<IndexName>();
+      static_assert(I >= 0, "name does not match any secondary index");
+      return index<I>(this);
+    }
+
+    template <name::raw IndexName>
+    auto get_index() const {
+      constexpr int I = index_number<IndexName>();
+      static_assert(I >= 0, "name does not match any secondary index");
+      return index<I>(const_cast<multi_index*>(this));
+    }
+
+    template <typename Lambda>
+    const_iterator emplace(name payer, Lambda&& constructor) {
+      check(_code == current_receiver(), "cannot create objects in table of another contract");
+      auto obj = std::make_unique<T>();
+      constructor(*obj);
+      const uint64_t pk = obj->primary_key();
+
+      auto& tbl = table();
+      check(tbl.rows.find(pk) == tbl.rows.end(), "could not insert object, most likely a uniqueness constraint was violated");
+      journal(pk);
+
+      auto bytes = pack(*obj);
+      mock::state().bill(payer, int64_t(bytes.size()) + mock::row_overhead_bytes + secondary_overhead());
+      tbl.rows[pk] = mock::row_data{std::move(bytes), payer};
+      store_secondaries(pk, *obj);
+      mock::state().counters.stores++;
+
+      _cache[pk] = std::move(obj);
+      return const_iterator(this, pk);
+    }
+
+    template <typename Lambda>
+    void modify(const_iterator itr, name payer, Lambda&& updater) {
+      check(itr != end(), "cannot pass end iterator to modify");
+      modify(*itr, payer, std::forward<Lambda>(updater));
+    }
+
+    template <typename Lambda>
+    void modify(const T& obj, name payer, Lambda&& updater) {
+      check(_code == current_receiver(), "cannot modify objects in table of another contract");
+      const uint64_t pk = obj.primary_key();
+      auto citr = _cache.find(pk);
+      check(citr != _cache.end() && citr->second.get() == &obj, "object passed to modify is not in multi_index");
+
+      T& mutable_obj = *citr->second;
+      updater(mutable_obj);
+      check(pk == mutable_obj.primary_key(), "updater cannot change primary key when modifying an object");
+
+      journal(pk);
+      auto& tbl = table();
+      auto& row = tbl.rows.at(pk);
+      auto bytes = pack(mutable_obj);
+      if (payer.value == 0) payer = row.payer;
+      mock::state().bill(row.payer, -(int64_t(row.bytes.size()) + mock::row_overhead_bytes + secondary_overhead()));
+      mock::state().bill(payer, int64_t(bytes.size()) + mock::row_overhead_bytes + secondary_overhead());
+      row = mock::row_data{std::move(bytes), payer};
+      erase_secondaries(pk);
+      store_secondaries(pk, mutable_obj);
+      mock::state().counters.updates++;
+    }
+
+    const_iterator erase(const_iterator itr) {
+      check(itr != end(), "cannot pass end iterator to erase");
+      auto next = itr;
+      ++next;
+      erase(*itr);
+      return next;
+    }
+
+    void erase(const T& obj) {
+      check(_code == current_receiver(), "cannot erase objects in table of another contract");
+      const uint64_t pk = obj.primary_key();
+      auto& tbl = table();
+      auto itr = tbl.rows.find(pk);
+      check(itr != tbl.rows.end(), "attempt to remove object that was not in multi_index");
+      journal(pk);
+      mock::state().bill(itr->second.payer, -(int64_t(itr->second.bytes.size()) + mock::row_overhead_bytes + secondary_overhead()));
+      tbl.rows.erase(itr);
+      erase_secondaries(pk);
+      mock::state().counters.removes++;
+      _cache.erase(pk);
+    }
+
+  private:
+    template <name::raw IndexName, int I = 0>
+    static constexpr int index_number() {
+      if constexpr (I >= int(sizeof...(Indices))) {
+        return -1;
+      } else if constexpr (std::tuple_element_t<I, std::tuple<Indices...>>::index_name == name(IndexName)) {
+        return I;
+      } else {
+        return index_number<IndexName, I + 1>();
+      }
+    }
+
+    static constexpr int64_t secondary_overhead() {
+      return int64_t(sizeof...(Indices)) * mock::secondary_overhead_bytes;
+    }
+
+    void journal(uint64_t pk) const {
+      mock::state().journal(mock::table_key{_code.value, _scope, name(TableName).value}, pk);
+    }
+
+    mock::table_data& table() const {
+      return mock::state().get_table(_code, _scope, name(TableName));
+    }
+
+    const T& load(uint64_t pk) const {
+      auto citr = _cache.find(pk);
+      if (citr != _cache.end()) return *citr->second;
+
+      auto& row = table().rows.at(pk);
+      auto obj = std::make_unique<T>(unpack<T>(row.bytes));
+      mock::state().counters.reads++;
+      auto& ref = *obj;
+      _cache[pk] = std::move(obj);
+      return ref;
+    }
+
+    void store_secondaries(uint64_t pk, const T& obj) {
+      store_secondaries_impl(pk, obj, std::make_index_sequence<sizeof...(Indices)>{});
+    }
+
+    template <size_t... I>
+    void store_secondaries_impl(uint64_t pk, const T& obj, std::index_sequence<I...>) {
+      auto& tbl = table();
+      ((void)[&] {
+         auto key = mock::encode_key(index<int(I)>::extract_secondary_key(obj));
+         tbl.secondary[int(I)].insert({key, pk});
+         tbl.secondary_by_pk[int(I)][pk] = key;
+       }(), ...);
+    }
+
+    void erase_secondaries(uint64_t pk) {
+      auto& tbl = table();
+      for (int i = 0; i < int(sizeof...(Indices)); ++i) {
+        auto& by_pk = tbl.secondary_by_pk[i];
+        auto itr = by_pk.find(pk);
+        if (itr == by_pk.end()) continue;
+        tbl.secondary[i].erase({itr->second, pk});
+        by_pk.erase(itr);
+      }
+    }
+
+    name _code;
+    uint64_t _scope;
+    mutable std::map<uint64_t, std::unique_ptr<T>> _cache;
+
+  public:
+    /// Harness hook: rebuilds secondary indices for rows that were seeded as
+    /// raw bytes.
+    static void reindex(name code, uint64_t scope) {
+      multi_index mi(code, scope);
+      auto& tbl = mi.table();
+      tbl.secondary.clear();
+      tbl.secondary_by_pk.clear();
+      for (auto& [pk, row] : tbl.rows)
+        mi.store_secondaries(pk, unpack<T>(row.bytes));
+    }
+  };
+
+} // namespace eosio
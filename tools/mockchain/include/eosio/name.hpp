@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace eosio {
+
+  struct name {
+    enum class raw : uint64_t {};
+
+    uint64_t value = 0;
+
+    constexpr name() = default;
+    constexpr explicit name(uint64_t v) : value(v) {}
+    constexpr name(raw r) : value(static_cast<uint64_t>(r)) {}
+    constexpr explicit name(std::string_view str) : value(0) {
+      uint64_t n = 0;
+      int i = 0;
+      for (; i < (int)str.size() && i < 12; ++i)
+        n |= (char_to_value(str[i]) & 0x1f) << (64 - 5 * (i + 1));
+      if (i == 12 && str.size() > 12)
+        n |= char_to_value(str[12]) & 0x0f;
+      value = n;
+    }
+
+    static constexpr uint64_t char_to_value(char c) {
+      if (c == '.') return 0;
+      if (c >= '1' && c <= '5') return (c - '1') + 1;
+      if (c >= 'a' && c <= 'z') return (c - 'a') + 6;
+      return 0;
+    }
+
+    constexpr operator raw() const { return raw(value); }
+    constexpr explicit operator bool() const { return value != 0; }
+
+    std::string to_string() const {
+      static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+      std::string str(13, '.');
+      uint64_t tmp = value;
+      for (uint32_t i = 0; i <= 12; ++i) {
+        char c = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
+        str[12 - i] = c;
+        tmp >>= (i == 0 ? 4 : 5);
+      }
+      auto last = str.find_last_not_of('.');
+      str.resize(last == std::string::npos ? 0 : last + 1);
+      return str;
+    }
+
+    template <typename Stream> void pack(Stream& ds) const { ds.write((const char*)&value, sizeof(value)); }
+    template <typename Stream> void unpack(Stream& ds) { ds.read((char*)&value, sizeof(value)); }
+
+    friend constexpr bool operator==(const name& a, const name& b) { return a.value == b.value; }
+    friend constexpr bool operator!=(const name& a, const name& b) { return a.value != b.value; }
+    friend constexpr bool operator<(const name& a, const name& b) { return a.value < b.value; }
+  };
+
+  namespace detail {
+    template <size_t N>
+    struct fixed_string {
+      char data[N]{};
+      constexpr fixed_string(const char (&s)[N]) {
+        for (size_t i = 0; i < N; ++i) data[i] = s[i];
+      }
+    };
+  }
+
+  inline namespace literals {
+    template <detail::fixed_string Str>
+    constexpr name operator""_n() {
+      return name(std::string_view(Str.data, sizeof(Str.data) - 1));
+    }
+  }
+
+} // namespace eosio
+
+using namespace eosio::literals;
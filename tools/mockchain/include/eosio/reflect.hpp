@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Field-by-field visitation of plain aggregates, so contract structs without
+// EOSLIB_SERIALIZE serialize natively in declaration order like abigen does.
+namespace eosio::reflect {
+
+  struct any_field {
+    template <typename T>
+    constexpr operator T&() const&& noexcept;
+  };
+
+  template <typename T, size_t... I>
+  constexpr bool brace_constructible(std::index_sequence<I...>) {
+    return requires { T{ (void(I), any_field{})... }; };
+  }
+
+  template <typename T, size_t N = 0>
+  constexpr size_t field_count() {
+    if constexpr (N > 40) {
+      return size_t(-1);
+    } else if constexpr (brace_constructible<T>(std::make_index_sequence<N + 1>{})) {
+      return field_count<T, N + 1>();
+    } else {
+      return N;
+    }
+  }
+
+  template <typename T, typename F>
+  constexpr void for_each_field(T&& obj, F&& f) {
+    using U = std::remove_cvref_t<T>;
+    constexpr size_t n = field_count<U>();
+    static_assert(n <= 40, "too many fields to reflect");
+    if constexpr (n == 0) {
+    }
+    else if constexpr (n == 1) {
+      auto& [m0] = obj;
+      f(m0);
+    }
+    else if constexpr (n == 2) {
+      auto& [m0,m1] = obj;
+      f(m0); f(m1);
+    }
+    else if constexpr (n == 3) {
+      auto& [m0,m1,m2] = obj;
+      f(m0); f(m1); f(m2);
+    }
+    else if constexpr (n == 4) {
+      auto& [m0,m1,m2,m3] = obj;
+      f(m0); f(m1); f(m2); f(m3);
+    }
+    else if constexpr (n == 5) {
+      auto& [m0,m1,m2,m3,m4] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4);
+    }
+    else if constexpr (n == 6) {
+      auto& [m0,m1,m2,m3,m4,m5] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5);
+    }
+    else if constexpr (n == 7) {
+      auto& [m0,m1,m2,m3,m4,m5,m6] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6);
+    }
+    else if constexpr (n == 8) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7);
+    }
+    else if constexpr (n == 9) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8);
+    }
+    else if constexpr (n == 10) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9);
+    }
+    else if constexpr (n == 11) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10);
+    }
+    else if constexpr (n == 12) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11);
+    }
+    else if constexpr (n == 13) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12);
+    }
+    else if constexpr (n == 14) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13);
+    }
+    else if constexpr (n == 15) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14);
+    }
+    else if constexpr (n == 16) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15);
+    }
+    else if constexpr (n == 17) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16);
+    }
+    else if constexpr (n == 18) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17);
+    }
+    else if constexpr (n == 19) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18);
+    }
+    else if constexpr (n == 20) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19);
+    }
+    else if constexpr (n == 21) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20);
+    }
+    else if constexpr (n == 22) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21);
+    }
+    else if constexpr (n == 23) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22);
+    }
+    else if constexpr (n == 24) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23);
+    }
+    else if constexpr (n == 25) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24);
+    }
+    else if constexpr (n == 26) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25);
+    }
+    else if constexpr (n == 27) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26);
+    }
+    else if constexpr (n == 28) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27);
+    }
+    else if constexpr (n == 29) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28);
+    }
+    else if constexpr (n == 30) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29);
+    }
+    else if constexpr (n == 31) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30);
+    }
+    else if constexpr (n == 32) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30,m31] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30); f(m31);
+    }
+    else if constexpr (n == 33) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30,m31,m32] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30); f(m31); f(m32);
+    }
+    else if constexpr (n == 34) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30,m31,m32,m33] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30); f(m31); f(m32); f(m33);
+    }
+    else if constexpr (n == 35) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30,m31,m32,m33,m34] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30); f(m31); f(m32); f(m33); f(m34);
+    }
+    else if constexpr (n == 36) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30,m31,m32,m33,m34,m35] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30); f(m31); f(m32); f(m33); f(m34); f(m35);
+    }
+    else if constexpr (n == 37) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30,m31,m32,m33,m34,m35,m36] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30); f(m31); f(m32); f(m33); f(m34); f(m35); f(m36);
+    }
+    else if constexpr (n == 38) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30,m31,m32,m33,m34,m35,m36,m37] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30); f(m31); f(m32); f(m33); f(m34); f(m35); f(m36); f(m37);
+    }
+    else if constexpr (n == 39) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30,m31,m32,m33,m34,m35,m36,m37,m38] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30); f(m31); f(m32); f(m33); f(m34); f(m35); f(m36); f(m37); f(m38);
+    }
+    else if constexpr (n == 40) {
+      auto& [m0,m1,m2,m3,m4,m5,m6,m7,m8,m9,m10,m11,m12,m13,m14,m15,m16,m17,m18,m19,m20,m21,m22,m23,m24,m25,m26,m27,m28,m29,m30,m31,m32,m33,m34,m35,m36,m37,m38,m39] = obj;
+      f(m0); f(m1); f(m2); f(m3); f(m4); f(m5); f(m6); f(m7); f(m8); f(m9); f(m10); f(m11); f(m12); f(m13); f(m14); f(m15); f(m16); f(m17); f(m18); f(m19); f(m20); f(m21); f(m22); f(m23); f(m24); f(m25); f(m26); f(m27); f(m28); f(m29); f(m30); f(m31); f(m32); f(m33); f(m34); f(m35); f(m36); f(m37); f(m38); f(m39);
+    }
+  }
+
+} // namespace eosio::reflect
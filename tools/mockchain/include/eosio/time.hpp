@@ -0,0 +1,123 @@
+#pragma once
+
+#include "datastream.hpp"
+
+#include <cstdint>
+
+namespace eosio {
+
+  class microseconds {
+  public:
+    constexpr microseconds() : _count(0) {}
+    constexpr explicit microseconds(int64_t c) : _count(c) {}
+
+    constexpr int64_t count() const { return _count; }
+    constexpr int64_t to_seconds() const { return _count / 1000000; }
+
+    constexpr microseconds& operator+=(const microseconds& c) { _count += c._count; return *this; }
+    constexpr microseconds& operator-=(const microseconds& c) { _count -= c._count; return *this; }
+
+    friend constexpr microseconds operator+(const microseconds& l, const microseconds& r) { return microseconds(l._count + r._count); }
+    friend constexpr microseconds operator-(const microseconds& l, const microseconds& r) { return microseconds(l._count - r._count); }
+    friend constexpr bool operator==(const microseconds& l, const microseconds& r) { return l._count == r._count; }
+    friend constexpr bool operator!=(const microseconds& l, const microseconds& r) { return l._count != r._count; }
+    friend constexpr bool operator<(const microseconds& l, const microseconds& r) { return l._count < r._count; }
+    friend constexpr bool operator<=(const microseconds& l, const microseconds& r) { return l._count <= r._count; }
+    friend constexpr bool operator>(const microseconds& l, const microseconds& r) { return l._count > r._count; }
+    friend constexpr bool operator>=(const microseconds& l, const microseconds& r) { return l._count >= r._count; }
+
+    template <typename Stream> void pack(Stream& ds) const { pack_value(ds, _count); }
+    template <typename Stream> void unpack(Stream& ds) { unpack_value(ds, _count); }
+
+  private:
+    int64_t _count;
+  };
+
+  constexpr microseconds seconds(int64_t s) { return microseconds(s * 1000000); }
+  constexpr microseconds milliseconds(int64_t s) { return microseconds(s * 1000); }
+  constexpr microseconds minutes(int64_t m) { return seconds(60 * m); }
+  constexpr microseconds hours(int64_t h) { return minutes(60 * h); }
+  constexpr microseconds days(int64_t d) { return hours(24 * d); }
+
+  class time_point {
+  public:
+    constexpr time_point() = default;
+    constexpr explicit time_point(microseconds e) : elapsed(e) {}
+
+    microseconds elapsed;
+
+    constexpr const microseconds& time_since_epoch() const { return elapsed; }
+    constexpr uint32_t sec_since_epoch() const { return uint32_t(elapsed.count() / 1000000); }
+
+    constexpr time_point& operator+=(const microseconds& m) { elapsed += m; return *this; }
+    constexpr time_point& operator-=(const microseconds& m) { elapsed -= m; return *this; }
+    constexpr time_point operator+(const microseconds& m) const { return time_point(elapsed + m); }
+    constexpr time_point operator+(const time_point& m) const { return time_point(elapsed + m.elapsed); }
+    constexpr time_point operator-(const microseconds& m) const { return time_point(elapsed - m); }
+    constexpr microseconds operator-(const time_point& m) const { return microseconds(elapsed.count() - m.elapsed.count()); }
+
+    friend constexpr bool operator==(const time_point& l, const time_point& r) { return l.elapsed == r.elapsed; }
+    friend constexpr bool operator!=(const time_point& l, const time_point& r) { return l.elapsed != r.elapsed; }
+    friend constexpr bool operator<(const time_point& l, const time_point& r) { return l.elapsed < r.elapsed; }
+    friend constexpr bool operator<=(const time_point& l, const time_point& r) { return l.elapsed <= r.elapsed; }
+    friend constexpr bool operator>(const time_point& l, const time_point& r) { return l.elapsed > r.elapsed; }
+    friend constexpr bool operator>=(const time_point& l, const time_point& r) { return l.elapsed >= r.elapsed; }
+
+    template <typename Stream> void pack(Stream& ds) const { elapsed.pack(ds); }
+    template <typename Stream> void unpack(Stream& ds) { elapsed.unpack(ds); }
+  };
+
+  class time_point_sec {
+  public:
+    constexpr time_point_sec() : utc_seconds(0) {}
+    constexpr explicit time_point_sec(uint32_t seconds) : utc_seconds(seconds) {}
+    constexpr time_point_sec(const time_point& t) : utc_seconds(uint32_t(t.time_since_epoch().count() / 1000000ll)) {}
+
+    constexpr uint32_t sec_since_epoch() const { return utc_seconds; }
+    constexpr operator time_point() const { return time_point(eosio::seconds(utc_seconds)); }
+
+    constexpr time_point_sec operator+(uint32_t offset) const { return time_point_sec(utc_seconds + offset); }
+    constexpr time_point_sec operator-(uint32_t offset) const { return time_point_sec(utc_seconds - offset); }
+
+    friend constexpr bool operator==(const time_point_sec& a, const time_point_sec& b) { return a.utc_seconds == b.utc_seconds; }
+    friend constexpr bool operator!=(const time_point_sec& a, const time_point_sec& b) { return a.utc_seconds != b.utc_seconds; }
+    friend constexpr bool operator<(const time_point_sec& a, const time_point_sec& b) { return a.utc_seconds < b.utc_seconds; }
+    friend constexpr bool operator<=(const time_point_sec& a, const time_point_sec& b) { return a.utc_seconds <= b.utc_seconds; }
+    friend constexpr bool operator>(const time_point_sec& a, const time_point_sec& b) { return a.utc_seconds > b.utc_seconds; }
+    friend constexpr bool operator>=(const time_point_sec& a, const time_point_sec& b) { return a.utc_seconds >= b.utc_seconds; }
+
+    template <typename Stream> void pack(Stream& ds) const { pack_value(ds, utc_seconds); }
+    template <typename Stream> void unpack(Stream& ds) { unpack_value(ds, utc_seconds); }
+
+    uint32_t utc_seconds;
+  };
+
+  class block_timestamp {
+  public:
+    constexpr block_timestamp() : slot(0) {}
+    constexpr explicit block_timestamp(uint32_t s) : slot(s) {}
+    block_timestamp(const time_point& t) { set_time_point(t); }
+
+    static constexpr int32_t block_interval_ms = 500;
+    static constexpr int64_t block_timestamp_epoch = 946684800000ll;
+
+    time_point to_time_point() const {
+      int64_t msec = slot * (int64_t)block_interval_ms;
+      msec += block_timestamp_epoch;
+      return time_point(milliseconds(msec));
+    }
+
+    template <typename Stream> void pack(Stream& ds) const { pack_value(ds, slot); }
+    template <typename Stream> void unpack(Stream& ds) { unpack_value(ds, slot); }
+
+    uint32_t slot;
+
+  private:
+    void set_time_point(const time_point& t) {
+      int64_t micro_since_epoch = t.time_since_epoch().count();
+      int64_t msec_since_epoch = micro_since_epoch / 1000;
+      slot = uint32_t((msec_since_epoch - block_timestamp_epoch) / int64_t(block_interval_ms));
+    }
+  };
+
+} // namespace eosio
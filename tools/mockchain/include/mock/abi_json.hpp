@@ -0,0 +1,267 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <mock/json.hpp>
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// JSON to native values the way abieos maps them: names, assets and times
+// as strings, 64-bit integers as numbers or strings, bytes and checksums as
+// hex, and structs as objects whose members are taken in field order (or
+// as arrays).
+namespace eosio::mock {
+
+  inline uint8_t hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return uint8_t(c - '0');
+    if (c >= 'a' && c <= 'f') return uint8_t(c - 'a' + 10);
+    if (c >= 'A' && c <= 'F') return uint8_t(c - 'A' + 10);
+    eosio::check(false, std::string("bad hex digit '") + c + "'");
+    return 0;
+  }
+
+  inline std::vector<char> from_hex(std::string_view hex) {
+    eosio::check(hex.size() % 2 == 0, "hex string has odd length");
+    std::vector<char> out(hex.size() / 2);
+    for (size_t i = 0; i < out.size(); ++i)
+      out[i] = char((hex_nibble(hex[2 * i]) << 4) | hex_nibble(hex[2 * i + 1]));
+    return out;
+  }
+
+  inline std::string to_hex(const char* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+      out[2 * i] = digits[uint8_t(data[i]) >> 4];
+      out[2 * i + 1] = digits[uint8_t(data[i]) & 0x0f];
+    }
+    return out;
+  }
+
+  inline std::vector<uint8_t> base58_decode(std::string_view s) {
+    static const char alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    std::vector<uint8_t> out;
+    for (char c : s) {
+      const char* p = std::strchr(alphabet, c);
+      eosio::check(c != '\0' && p != nullptr, std::string("bad base58 character '") + c + "'");
+      uint32_t carry = uint32_t(p - alphabet);
+      for (auto itr = out.rbegin(); itr != out.rend(); ++itr) {
+        carry += uint32_t(*itr) * 58;
+        *itr = uint8_t(carry);
+        carry >>= 8;
+      }
+      for (; carry; carry >>= 8)
+        out.insert(out.begin(), uint8_t(carry));
+    }
+    for (size_t i = 0; i < s.size() && s[i] == '1'; ++i)
+      out.insert(out.begin(), 0);
+    return out;
+  }
+
+  /// Key and signature strings ("EOS...", "PUB_K1_...", "SIG_K1_...") to the
+  /// variant index and raw bytes; the trailing checksum is dropped unchecked.
+  template <typename Bytes>
+  size_t parse_key_string(std::string_view s, std::string_view kind, Bytes& out) {
+    size_t index = 0;
+    if (kind == "PUB" && s.substr(0, 3) == "EOS") {
+      s.remove_prefix(3);
+    } else {
+      eosio::check(s.substr(0, kind.size()) == kind && s.size() > kind.size() + 4, "bad key string");
+      auto curve = s.substr(kind.size() + 1, 2);
+      eosio::check(curve == "K1" || curve == "R1", "only K1 and R1 keys are supported");
+      index = curve == "K1" ? 0 : 1;
+      s.remove_prefix(kind.size() + 4);
+    }
+    auto raw = base58_decode(s);
+    eosio::check(raw.size() == out.size() + 4, "key string has the wrong length");
+    std::memcpy(out.data(), raw.data(), out.size());
+    return index;
+  }
+
+  /// Days since 1970-01-01 for a proleptic Gregorian date.
+  constexpr int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = unsigned(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + int64_t(doe) - 719468;
+  }
+
+  /// "2024-05-01T12:00:00.500" (optionally with a trailing Z) or a number of
+  /// microseconds since the epoch.
+  inline eosio::time_point parse_time_point(const json& j) {
+    if (j.is_number())
+      return eosio::time_point(eosio::microseconds(std::stoll(j.text)));
+
+    eosio::check(j.is_string(), "time must be a string or a number of microseconds");
+    const std::string& s = j.text;
+    int y = 0, mo = 0, d = 0, h = 0, mi = 0, sec = 0, used = 0;
+    eosio::check(std::sscanf(s.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &y, &mo, &d, &h, &mi, &sec, &used) == 6,
+                 "bad time '" + s + "'");
+
+    int64_t micros = 0;
+    if (size_t(used) < s.size() && s[used] == '.') {
+      int64_t scale = 100000;
+      for (size_t i = used + 1; i < s.size() && std::isdigit((unsigned char)s[i]); ++i, scale /= 10)
+        micros += (s[i] - '0') * scale;
+    }
+
+    int64_t secs = days_from_civil(y, unsigned(mo), unsigned(d)) * 86400 + h * 3600 + mi * 60 + sec;
+    return eosio::time_point(eosio::microseconds(secs * 1000000 + micros));
+  }
+
+  inline eosio::asset parse_asset(std::string_view s) {
+    auto space = s.find(' ');
+    eosio::check(space != std::string_view::npos, "asset must look like \"1.0000 TLOS\"");
+    auto amount = s.substr(0, space);
+    auto code = s.substr(space + 1);
+
+    bool negative = !amount.empty() && amount[0] == '-';
+    if (negative) amount.remove_prefix(1);
+
+    auto dot = amount.find('.');
+    uint8_t precision = dot == std::string_view::npos ? 0 : uint8_t(amount.size() - dot - 1);
+    int64_t value = 0;
+    for (char c : amount) {
+      if (c == '.') continue;
+      eosio::check(std::isdigit((unsigned char)c), "bad asset amount");
+      value = value * 10 + (c - '0');
+    }
+    return eosio::asset(negative ? -value : value, eosio::symbol(code, precision));
+  }
+
+  template <typename T>
+  void from_json(const json& j, T& v);
+
+  template <typename T>
+  T number_from_json(const json& j) {
+    if (j.type == json::kind::boolean) return T(j.boolean);
+    eosio::check(j.is_number() || j.is_string(), "expected a number");
+    const std::string& s = j.text;
+    T v{};
+    if constexpr (std::is_floating_point_v<T>) {
+      v = T(std::stod(s));
+    } else {
+      auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+      eosio::check(ec == std::errc() && ptr == s.data() + s.size(), "bad integer '" + s + "'");
+    }
+    return v;
+  }
+
+  template <typename Tuple, size_t... I>
+  void tuple_from_json(const json& j, Tuple& t, std::index_sequence<I...>) {
+    constexpr size_t n = sizeof...(I);
+    if (j.is_array()) {
+      eosio::check(j.items.size() == n, "wrong number of elements");
+      (from_json(j.items[I], std::get<I>(t)), ...);
+    } else {
+      eosio::check(j.is_object() && j.members.size() == n, "expected an object with one member per field");
+      (from_json(j.members[I].second, std::get<I>(t)), ...);
+    }
+  }
+
+  template <typename T>
+  void from_json(const json& j, T& v) {
+    using namespace eosio;
+
+    if constexpr (std::is_same_v<T, name>) {
+      v = name(std::string_view(j.text));
+    } else if constexpr (std::is_same_v<T, bool>) {
+      v = j.type == json::kind::boolean ? j.boolean : number_from_json<int>(j) != 0;
+    } else if constexpr (std::is_enum_v<T>) {
+      v = T(number_from_json<std::underlying_type_t<T>>(j));
+    } else if constexpr (std::is_arithmetic_v<T>) {
+      v = number_from_json<T>(j);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      v = j.text;
+    } else if constexpr (std::is_same_v<T, unsigned_int>) {
+      v = unsigned_int(number_from_json<uint32_t>(j));
+    } else if constexpr (std::is_same_v<T, symbol_code>) {
+      v = symbol_code(std::string_view(j.text));
+    } else if constexpr (std::is_same_v<T, symbol>) {
+      auto comma = j.text.find(',');
+      eosio::check(comma != std::string::npos, "symbol must look like \"4,TLOS\"");
+      v = symbol(std::string_view(j.text).substr(comma + 1), uint8_t(std::stoi(j.text.substr(0, comma))));
+    } else if constexpr (std::is_same_v<T, asset>) {
+      v = parse_asset(j.text);
+    } else if constexpr (std::is_same_v<T, time_point>) {
+      v = parse_time_point(j);
+    } else if constexpr (std::is_same_v<T, time_point_sec>) {
+      v = time_point_sec(parse_time_point(j));
+    } else if constexpr (std::is_same_v<T, block_timestamp>) {
+      v = block_timestamp(parse_time_point(j));
+    } else if constexpr (std::is_same_v<T, microseconds>) {
+      v = microseconds(number_from_json<int64_t>(j));
+    } else if constexpr (std::is_same_v<T, public_key>) {
+      ecc_public_key key{};
+      if (parse_key_string(j.text, "PUB", key) == 0) v.template emplace<0>(key);
+      else v.template emplace<1>(key);
+    } else if constexpr (std::is_same_v<T, signature>) {
+      ecc_signature sig{};
+      if (parse_key_string(j.text, "SIG", sig) == 0) v.template emplace<0>(sig);
+      else v.template emplace<1>(sig);
+    } else if constexpr (requires { T::size(); v.data(); v.extract_as_byte_array(); }) {
+      auto bytes = from_hex(j.text);
+      eosio::check(bytes.size() == T::size(), "checksum has the wrong length");
+      std::memcpy(v.data(), bytes.data(), bytes.size());
+    } else if constexpr (is_vector<T>::value) {
+      using E = typename T::value_type;
+      if constexpr (sizeof(E) == 1 && std::is_integral_v<E>) {
+        if (j.is_string()) {
+          auto bytes = from_hex(j.text);
+          v.assign(bytes.begin(), bytes.end());
+          return;
+        }
+      }
+      eosio::check(j.is_array(), "expected an array");
+      v.clear();
+      v.resize(j.items.size());
+      for (size_t i = 0; i < j.items.size(); ++i) from_json(j.items[i], v[i]);
+    } else if constexpr (is_optional<T>::value) {
+      if (j.is_null()) {
+        v.reset();
+      } else {
+        typename T::value_type e{};
+        from_json(j, e);
+        v = std::move(e);
+      }
+    } else if constexpr (requires { v.has_value(); v.reset(); v.emplace(); v.value_or(); }) {
+      // binary_extension: handled by the enclosing struct
+      std::remove_cvref_t<decltype(v.value())> e{};
+      from_json(j, e);
+      v.emplace(std::move(e));
+    } else if constexpr (is_tuple<T>::value) {
+      tuple_from_json(j, v, std::make_index_sequence<std::tuple_size_v<T>>{});
+    } else {
+      static_assert(std::is_aggregate_v<T>, "type has no json mapping");
+      eosio::check(j.is_object() || j.is_array(), "expected an object");
+      const size_t given = j.is_array() ? j.items.size() : j.members.size();
+      size_t i = 0;
+      reflect::for_each_field(v, [&](auto& f) {
+        // trailing binary extensions may be left out
+        if (i < given)
+          from_json(j.is_array() ? j.items[i] : j.members[i].second, f);
+        else
+          eosio::check(requires { f.reset(); f.has_value(); }, "too few fields in object");
+        ++i;
+      });
+      eosio::check(i >= given, "too many fields in object");
+    }
+  }
+
+  template <typename T>
+  std::vector<char> json_to_bin(const json& j) {
+    T v{};
+    from_json(j, v);
+    return eosio::pack(v);
+  }
+
+} // namespace eosio::mock
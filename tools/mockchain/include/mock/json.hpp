@@ -0,0 +1,197 @@
+#pragma once
+
+#include <eosio/check.hpp>
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Just enough JSON for action logs and table dumps. Numbers keep their
+// literal text so 64-bit values survive, and object members keep their
+// order, which is the ABI field order in everything nodeos emits.
+namespace eosio::mock {
+
+  struct json {
+    enum class kind : uint8_t { null, boolean, number, string, array, object };
+
+    kind type = kind::null;
+    bool boolean = false;
+    std::string text;
+    std::vector<json> items;
+    std::vector<std::pair<std::string, json>> members;
+
+    bool is_null() const { return type == kind::null; }
+    bool is_string() const { return type == kind::string; }
+    bool is_number() const { return type == kind::number; }
+    bool is_array() const { return type == kind::array; }
+    bool is_object() const { return type == kind::object; }
+
+    const json* find(std::string_view key) const {
+      for (auto& [k, v] : members)
+        if (k == key) return &v;
+      return nullptr;
+    }
+
+    const json& at(std::string_view key) const {
+      auto v = find(key);
+      eosio::check(v != nullptr, "missing json member " + std::string(key));
+      return *v;
+    }
+
+    static json parse(std::string_view src) {
+      parser p{src};
+      p.skip_ws();
+      json v = p.value();
+      p.skip_ws();
+      eosio::check(p.pos == src.size(), "trailing characters after json value");
+      return v;
+    }
+
+  private:
+    struct parser {
+      std::string_view src;
+      size_t pos = 0;
+
+      char peek() const { return pos < src.size() ? src[pos] : '\0'; }
+
+      void skip_ws() {
+        while (pos < src.size() && (src[pos] == ' ' || src[pos] == '\t' || src[pos] == '\n' || src[pos] == '\r'))
+          ++pos;
+      }
+
+      void expect(char c) {
+        eosio::check(peek() == c, std::string("json: expected '") + c + "' at offset " + std::to_string(pos));
+        ++pos;
+      }
+
+      void literal(std::string_view word) {
+        eosio::check(src.substr(pos, word.size()) == word, "json: bad literal at offset " + std::to_string(pos));
+        pos += word.size();
+      }
+
+      json value() {
+        json v;
+        switch (peek()) {
+          case '{': v.type = kind::object; object(v); break;
+          case '[': v.type = kind::array; array(v); break;
+          case '"': v.type = kind::string; v.text = string(); break;
+          case 't': literal("true"); v.type = kind::boolean; v.boolean = true; break;
+          case 'f': literal("false"); v.type = kind::boolean; break;
+          case 'n': literal("null"); break;
+          default: v.type = kind::number; v.text = number(); break;
+        }
+        return v;
+      }
+
+      void object(json& v) {
+        expect('{');
+        skip_ws();
+        if (peek() == '}') { ++pos; return; }
+        for (;;) {
+          skip_ws();
+          std::string key = string();
+          skip_ws();
+          expect(':');
+          skip_ws();
+          v.members.emplace_back(std::move(key), value());
+          skip_ws();
+          if (peek() == ',') { ++pos; continue; }
+          expect('}');
+          return;
+        }
+      }
+
+      void array(json& v) {
+        expect('[');
+        skip_ws();
+        if (peek() == ']') { ++pos; return; }
+        for (;;) {
+          skip_ws();
+          v.items.push_back(value());
+          skip_ws();
+          if (peek() == ',') { ++pos; continue; }
+          expect(']');
+          return;
+        }
+      }
+
+      std::string number() {
+        size_t start = pos;
+        while (pos < src.size() && (std::isdigit((unsigned char)src[pos]) || src[pos] == '-' || src[pos] == '+' ||
+                                    src[pos] == '.' || src[pos] == 'e' || src[pos] == 'E'))
+          ++pos;
+        eosio::check(pos > start, "json: unexpected character at offset " + std::to_string(pos));
+        return std::string(src.substr(start, pos - start));
+      }
+
+      static void append_utf8(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+          out += char(cp);
+        } else if (cp < 0x800) {
+          out += char(0xc0 | (cp >> 6));
+          out += char(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+          out += char(0xe0 | (cp >> 12));
+          out += char(0x80 | ((cp >> 6) & 0x3f));
+          out += char(0x80 | (cp & 0x3f));
+        } else {
+          out += char(0xf0 | (cp >> 18));
+          out += char(0x80 | ((cp >> 12) & 0x3f));
+          out += char(0x80 | ((cp >> 6) & 0x3f));
+          out += char(0x80 | (cp & 0x3f));
+        }
+      }
+
+      uint32_t hex4() {
+        eosio::check(pos + 4 <= src.size(), "json: truncated \\u escape");
+        uint32_t cp = 0;
+        for (int i = 0; i < 4; ++i) {
+          char c = src[pos++];
+          cp <<= 4;
+          if (c >= '0' && c <= '9') cp |= uint32_t(c - '0');
+          else if (c >= 'a' && c <= 'f') cp |= uint32_t(c - 'a' + 10);
+          else if (c >= 'A' && c <= 'F') cp |= uint32_t(c - 'A' + 10);
+          else eosio::check(false, "json: bad \\u escape");
+        }
+        return cp;
+      }
+
+      std::string string() {
+        expect('"');
+        std::string out;
+        for (;;) {
+          eosio::check(pos < src.size(), "json: unterminated string");
+          char c = src[pos++];
+          if (c == '"') return out;
+          if (c != '\\') { out += c; continue; }
+          eosio::check(pos < src.size(), "json: unterminated escape");
+          char e = src[pos++];
+          switch (e) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+              uint32_t cp = hex4();
+              if (cp >= 0xd800 && cp < 0xdc00 && src.substr(pos, 2) == "\\u") {
+                pos += 2;
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (hex4() - 0xdc00);
+              }
+              append_utf8(out, cp);
+              break;
+            }
+            default: eosio::check(false, "json: bad escape");
+          }
+        }
+      }
+    };
+  };
+
+} // namespace eosio::mock
@@ -0,0 +1,131 @@
+/*
+
+  delphireadbench
+
+  Runs readbench's actions natively against a datapoints window laid out as
+  delphioracle leaves it, and reports for each way of reading the current
+  median the rows it loads, the time it takes and whether it found the
+  right median. The window is read three times: with every write in its own
+  second, with the last two writes in the same second, and with the last
+  two writes at the same time, as in one block. The later of the two is on
+  the lower primary key.
+
+  delphireadbench [options]
+    --window <n>   datapoints per pair (default 21)
+    --calls <n>    timed calls per action (default 100000)
+
+*/
+
+#include <readbench.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+const eosio::name oracle = delphi::default_contract;
+const eosio::name pair = "tlosusd"_n;
+constexpr int64_t start_us = 1700000000000000;
+
+enum class tie { none, second, block };
+
+//Fills the window as successive writes leave it, one per second, each
+//median 1 more than the last. With a tie, the row after the newest is
+//written again before it, in the newest row's second or at its very time.
+uint64_t seed(uint64_t window, tie t) {
+  auto& st = eosio::mock::state();
+  st.tables.clear();
+  st.begin_action(oracle, oracle, "seed"_n, {}, {oracle.value});
+
+  delphi::datapointstable dstore(oracle, pair.value);
+  uint64_t newest = window / 3;
+  for (uint64_t i = 0; i < window; ++i) {
+    //writes go round the window starting after the newest row
+    uint64_t age = (newest + window - i) % window;
+    int64_t at = start_us + int64_t(window - age) * 1000000;
+    dstore.emplace(oracle, [&](auto& d) {
+      d.id = i;
+      d.owner = "oracle"_n;
+      d.value = 1000 + window - age;
+      d.median = d.value;
+      d.timestamp = eosio::time_point(eosio::microseconds(at));
+      d.seq = window - age;
+    });
+  }
+
+  uint64_t expected = 1000 + window;
+  if (t != tie::none) {
+    //the oldest row, just after the newest in primary key order, is
+    //overwritten earlier in the newest row's second, or in its block
+    auto newest_row = dstore.find(newest);
+    auto earlier = dstore.find(newest + 1);
+    auto second = eosio::time_point(eosio::seconds(int64_t(newest_row->by_timestamp())));
+    dstore.modify(newest_row, oracle, [&](auto& d) {
+      d.timestamp = second + eosio::milliseconds(500);
+      d.seq = window + 2;
+    });
+    dstore.modify(earlier, oracle, [&](auto& d) {
+      d.value = 999;
+      d.median = 999;
+      d.timestamp = second + eosio::milliseconds(t == tie::block ? 500 : 100);
+      d.seq = window + 1;
+    });
+  }
+  return expected;
+}
+
+template <typename F>
+void run(const char* name, uint64_t calls, uint64_t expected, F&& f) {
+  auto& st = eosio::mock::state();
+  st.begin_action(oracle, oracle, "read"_n, {}, {});
+  uint64_t median = f();
+  uint64_t loads = st.counters.reads;
+
+  volatile uint64_t sink = 0;
+  auto begin = clock_type::now();
+  for (uint64_t c = 0; c < calls; ++c)
+    sink = sink + f();
+  double ns = std::chrono::duration<double, std::nano>(clock_type::now() - begin).count() / double(calls);
+
+  std::printf("%-10s %10llu %10.1f %10llu %8s\n", name, (unsigned long long)loads, ns,
+              (unsigned long long)median, median == expected ? "ok" : "WRONG");
+}
+
+void usage() {
+  std::cerr << "usage: delphireadbench [--window <n>] [--calls <n>]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  uint64_t window = 21, calls = 100000;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) { usage(); return 2; }
+    if (arg == "--window") window = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "--calls") calls = std::strtoull(argv[++i], nullptr, 10);
+    else { usage(); return 2; }
+  }
+  if (window < 3 || calls == 0) { usage(); return 2; }
+
+  eosio::mock::state().now = eosio::time_point(eosio::microseconds(start_us + int64_t(window + 60) * 1000000));
+  readbench c("readbench"_n, "readbench"_n, eosio::datastream<const char*>(nullptr, 0));
+
+  for (tie t : {tie::none, tie::second, tie::block}) {
+    uint64_t expected = seed(window, t);
+    std::printf("\n%llu datapoints, %s\n", (unsigned long long)window,
+                t == tie::none     ? "one write per second"
+                : t == tie::second ? "last two writes in the same second"
+                                   : "last two writes in the same block");
+    std::printf("%-10s %10s %10s %10s %8s\n", "action", "row_loads", "ns/call", "median", "");
+    run("byscan", calls, expected, [&] { return c.byscan(pair); });
+    run("bylast", calls, expected, [&] { return c.bylast(pair); });
+    run("bylatest", calls, expected, [&] { return c.bylatest(pair); });
+  }
+  return 0;
+}
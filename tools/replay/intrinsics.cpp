@@ -0,0 +1,52 @@
+// The chain's crypto intrinsics, which the natively built contract calls
+// for writeagg. K1 keys and signatures go through the feeder's OpenSSL
+// backed code; built without it, any action that needs them fails.
+
+#include <eosio/crypto.hpp>
+
+#if REPLAY_WITH_CRYPTO
+#include "crypto.hpp"
+
+#include <cstring>
+#endif
+
+namespace eosio {
+
+#if REPLAY_WITH_CRYPTO
+  checksum256 sha256(const char* data, uint32_t length) {
+    return checksum256(feeder::sha256(data, length));
+  }
+
+  public_key recover_key(const checksum256& digest, const signature& sig) {
+    check(sig.index() == 0, "only K1 signatures are supported");
+    feeder::signature_data raw;
+    std::memcpy(raw.data(), std::get<0>(sig).data(), raw.size());
+
+    auto key = feeder::recover_key(digest.extract_as_byte_array(), raw);
+    check(key.has_value(), "unable to recover key from signature");
+
+    ecc_public_key out;
+    std::memcpy(out.data(), key->data(), out.size());
+    return public_key(std::in_place_index<0>, out);
+  }
+#else
+  checksum256 sha256(const char*, uint32_t) {
+    check(false, "built without OpenSSL, no sha256");
+    return {};
+  }
+
+  public_key recover_key(const checksum256&, const signature&) {
+    check(false, "built without OpenSSL, no recover_key");
+    return {};
+  }
+#endif
+
+  void assert_sha256(const char* data, uint32_t length, const checksum256& hash) {
+    check(sha256(data, length) == hash, "hash mismatch");
+  }
+
+  void assert_recover_key(const checksum256& digest, const signature& sig, const public_key& pubkey) {
+    check(recover_key(digest, sig) == pubkey, "Error expected key different than recovered key");
+  }
+
+} // namespace eosio
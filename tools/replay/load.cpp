@@ -0,0 +1,352 @@
+/*
+
+  delphiload
+
+  Synthetic load on the contract compiled natively on top of
+  tools/mockchain: sets up a chain with an eosio.system producers and
+  voters table holding N producers, M active pairs and a set of donors,
+  then drives write, donation and claim traffic at the given rates over a
+  simulated span of time. Reports how many of each action went through,
+  why the others failed, and the time each took per action, to find where
+  the contract falls over as oracles and pairs are added.
+
+  delphiload [options]
+    --oracles <n>          registered producers (default 105)
+    --rank <n>             how many of them qualify as oracles (default 105)
+    --pairs <n>            active pairs (default 24)
+    --quotes <n>           pairs quoted per write, at most --pairs (default all)
+    --minutes <n>          simulated time (default 30)
+    --interval <s>         seconds between an oracle's writes (default 60)
+    --jitter <s>           writes land up to this early or late (default 5)
+    --cooldown <s>         the contract's write_cooldown (default 55)
+    --packed               write with writepacked instead of write
+    --donors <n>           accounts sending donations (default 200)
+    --donations <n>        donations per minute, across donors (default 10)
+    --claims <n>           claims per minute, by random oracles (default 5)
+    --deadline-us <n>      fail an action whose scaled time exceeds this,
+                           as a node does past max_transaction_cpu_usage
+                           (default 30000)
+    --cpu-scale <x>        multiply native times by x before the deadline
+                           and the percentiles, to estimate a wasm runtime
+                           (default 1)
+    --seed <n>
+
+  Times are native, so they rank actions and show how cost grows with N
+  and M; they are not the cpu a node bills. A failed action is rolled back
+  as the chain would. The data column is the mean size of the action data,
+  what the action adds to a transaction's NET.
+
+*/
+
+#include <delphioracle.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using eosio::name;
+
+const name self = "delphioracle"_n;
+constexpr int64_t start_us = 1714564800000000; // 2024-05-01T12:00:00
+
+struct settings {
+  uint64_t oracles = 105, rank = 105, pairs = 24, quotes = 0, minutes = 30;
+  uint64_t interval = 60, jitter = 5, cooldown = 55;
+  uint64_t donors = 200;
+  double donations = 10, claims = 5;
+  int64_t deadline_us = 30000;
+  double cpu_scale = 1;
+  uint64_t seed = 1;
+  bool packed = false;
+};
+
+enum class kind { write, donation, claim };
+const char* kind_name(kind k) { return k == kind::write ? "write" : k == kind::donation ? "transfer" : "claim"; }
+
+struct event {
+  int64_t time_us;
+  kind what;
+  uint64_t who;
+};
+
+struct kind_stats {
+  uint64_t sent = 0, ok = 0, bytes = 0;
+  std::vector<int64_t> us;
+  std::map<std::string, uint64_t> failures;
+};
+
+// Distinct account names from an index: prefix then base-26 letters.
+name account(const char* prefix, uint64_t i) {
+  std::string s = prefix;
+  for (int d = 0; d < 5; ++d, i /= 26)
+    s += char('a' + i % 26);
+  return name(std::string_view(s));
+}
+
+delphioracle instance() {
+  return delphioracle(self, self, eosio::datastream<const char*>(nullptr, 0));
+}
+
+void begin(int64_t time_us, name code, name act, std::vector<char> data, std::set<uint64_t> auths) {
+  auto& st = eosio::mock::state();
+  st.now = eosio::time_point(eosio::microseconds(time_us));
+  st.begin_action(self, code, act, std::move(data), std::move(auths));
+  scratch().reset();
+}
+
+// writepacked's encoding: unsigned LEB128, signed numbers zigzag encoded first
+void put_varint(std::vector<char>& out, uint64_t v) {
+  for (; v >= 0x80; v >>= 7)
+    out.push_back(char(v | 0x80));
+  out.push_back(char(v));
+}
+
+uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+
+void setup(const settings& s, std::vector<name>& oracles, std::vector<name>& pairs, std::vector<name>& donors) {
+  auto& st = eosio::mock::state();
+  st = eosio::mock::chain_state{};
+
+  begin(start_us - 3600000000, self, "configure"_n, {}, {self.value});
+  instance().configure({21, 30, 10000, s.cooldown * 1000000, 1, 1, 1, s.rank, 21, 604800, 259200});
+
+  // eosio.system's tables, written as eosio
+  st.receiver = "eosio"_n;
+  delphioracle::producers_table producers("eosio"_n, "eosio"_n.value);
+  for (uint64_t i = 0; i < s.oracles; ++i) {
+    oracles.push_back(account("orc", i));
+    producers.emplace("eosio"_n, [&](auto& p) {
+      p.owner = oracles.back();
+      p.total_votes = double(s.oracles - i) * 1e12;
+      p.is_active = true;
+    });
+  }
+#if DELPHIORACLE_WITH_REWARDS
+  delphioracle::voters_table voters("eosio"_n, "eosio"_n.value);
+  for (uint64_t i = 0; i < s.donors; ++i) {
+    donors.push_back(account("don", i));
+    voters.emplace("eosio"_n, [&](auto& v) {
+      v.owner = donors.back();
+      v.proxy = i % 2 ? self : name();
+      v.staked = int64_t(1000000 + i);
+    });
+  }
+#endif
+  st.receiver = self;
+
+  // tlosusd comes with configure; the rest are proposed and switched on
+  pairs.push_back("tlosusd"_n);
+  for (uint64_t i = 1; i < s.pairs; ++i) {
+    pairs.push_back(account("pair", i));
+    begin(start_us - 3600000000, self, "newbounty"_n, {}, {"loadgen"_n.value});
+    instance().newbounty("loadgen"_n, {pairs.back(), eosio::symbol("TLOS", 4), 1, "eosio.token"_n,
+                                       eosio::symbol("USD", 2), 1, name(), 4});
+  }
+  delphioracle::pairstable ptable(self, self.value);
+  for (auto itr = ptable.begin(); itr != ptable.end(); ++itr)
+    ptable.modify(itr, self, [](auto& p) {
+      p.active = true;
+      p.bounty_awarded = true;
+    });
+
+  // switched on without votes, so they are numbered by hand
+  for (auto& p : pairs) {
+    begin(start_us - 3600000000, self, "addordinal"_n, {}, {self.value});
+    if (!ptable.find(p.value)->ordinal.has_value())
+      instance().addordinal(p);
+  }
+}
+
+std::vector<event> schedule(const settings& s, uint64_t donors, std::mt19937_64& rng) {
+  std::vector<event> events;
+  const int64_t end_us = start_us + int64_t(s.minutes) * 60000000;
+  std::uniform_int_distribution<int64_t> offset(0, int64_t(s.interval) * 1000000 - 1);
+  std::uniform_int_distribution<int64_t> jitter(-int64_t(s.jitter) * 1000000, int64_t(s.jitter) * 1000000);
+
+  for (uint64_t o = 0; o < s.oracles; ++o) {
+    for (int64_t t = start_us + offset(rng); t < end_us; t += int64_t(s.interval) * 1000000)
+      events.push_back({std::max(start_us, t + jitter(rng)), kind::write, o});
+  }
+
+  auto poisson = [&](double per_minute, kind k, uint64_t among) {
+    if (per_minute <= 0 || among == 0) return;
+    std::exponential_distribution<double> gap(per_minute / 60000000.0);
+    std::uniform_int_distribution<uint64_t> pick(0, among - 1);
+    for (double t = double(start_us) + gap(rng); t < double(end_us); t += gap(rng))
+      events.push_back({int64_t(t), k, pick(rng)});
+  };
+#if DELPHIORACLE_WITH_REWARDS
+  poisson(s.donations, kind::donation, donors);
+  poisson(s.claims, kind::claim, std::min(s.oracles, s.rank));
+#endif
+
+  std::stable_sort(events.begin(), events.end(), [](const event& a, const event& b) { return a.time_us < b.time_us; });
+  return events;
+}
+
+std::string cause(const std::string& error) {
+  if (error.find("can only call every") != std::string::npos) return "cooldown";
+  return error;
+}
+
+int64_t percentile(std::vector<int64_t> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[size_t(p * double(v.size() - 1) + 0.5)];
+}
+
+void usage() {
+  std::cerr << "usage: delphiload [--oracles <n>] [--rank <n>] [--pairs <n>] [--quotes <n>] [--minutes <n>]\n"
+               "                  [--interval <s>] [--jitter <s>] [--cooldown <s>] [--packed] [--donors <n>]\n"
+               "                  [--donations <n>] [--claims <n>] [--deadline-us <n>] [--cpu-scale <x>] [--seed <n>]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  settings s;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--packed") { s.packed = true; continue; }
+    if (i + 1 >= argc) { usage(); return 2; }
+    const char* v = argv[++i];
+    if (arg == "--oracles") s.oracles = std::strtoull(v, nullptr, 10);
+    else if (arg == "--rank") s.rank = std::strtoull(v, nullptr, 10);
+    else if (arg == "--pairs") s.pairs = std::strtoull(v, nullptr, 10);
+    else if (arg == "--quotes") s.quotes = std::strtoull(v, nullptr, 10);
+    else if (arg == "--minutes") s.minutes = std::strtoull(v, nullptr, 10);
+    else if (arg == "--interval") s.interval = std::strtoull(v, nullptr, 10);
+    else if (arg == "--jitter") s.jitter = std::strtoull(v, nullptr, 10);
+    else if (arg == "--cooldown") s.cooldown = std::strtoull(v, nullptr, 10);
+    else if (arg == "--donors") s.donors = std::strtoull(v, nullptr, 10);
+    else if (arg == "--donations") s.donations = std::strtod(v, nullptr);
+    else if (arg == "--claims") s.claims = std::strtod(v, nullptr);
+    else if (arg == "--deadline-us") s.deadline_us = std::strtoll(v, nullptr, 10);
+    else if (arg == "--cpu-scale") s.cpu_scale = std::strtod(v, nullptr);
+    else if (arg == "--seed") s.seed = std::strtoull(v, nullptr, 10);
+    else { usage(); return 2; }
+  }
+  if (s.oracles == 0 || s.pairs == 0 || s.interval == 0 || s.cpu_scale <= 0) { usage(); return 2; }
+  if (s.quotes == 0 || s.quotes > s.pairs) s.quotes = s.pairs;
+
+  std::vector<name> oracles, pairs, donors;
+  setup(s, oracles, pairs, donors);
+
+  std::mt19937_64 rng(s.seed);
+  auto events = schedule(s, donors.size(), rng);
+
+  std::vector<uint64_t> price(pairs.size(), 10000);
+  std::vector<uint64_t> ordinal;
+  delphioracle::pairstable ptable(self, self.value);
+  for (auto& p : pairs)
+    ordinal.push_back(ptable.find(p.value)->ordinal.value());
+  // each oracle's last value per pair, which packed values are relative to;
+  // 0 until its first write, which goes unpacked
+  std::vector<uint64_t> last(oracles.size() * pairs.size(), 0), sending;
+  std::uniform_int_distribution<int> step(-20, 20);
+  std::uniform_int_distribution<uint64_t> first_pair(0, pairs.size() - 1);
+  std::uniform_int_distribution<int64_t> amount(1, 100000);
+
+  std::map<kind, kind_stats> stats;
+  auto wall_begin = std::chrono::steady_clock::now();
+  for (auto& e : events) {
+    auto& ks = stats[e.what];
+    ks.sent++;
+
+    std::string error;
+    std::vector<delphioracle::quote> quotes;
+    std::vector<char> packed;
+    bool use_packed = s.packed;
+    if (e.what == kind::write) {
+      sending.assign(last.begin() + e.who * pairs.size(), last.begin() + (e.who + 1) * pairs.size());
+      for (uint64_t q = 0, p = first_pair(rng); q < s.quotes; ++q, p = (p + 1) % pairs.size()) {
+        price[p] = uint64_t(std::max<int64_t>(1, int64_t(price[p]) + step(rng)));
+        quotes.push_back({price[p], pairs[p]});
+        put_varint(packed, ordinal[p]);
+        put_varint(packed, zigzag(int64_t(price[p] - sending[p])));
+        use_packed = use_packed && sending[p] != 0;
+        sending[p] = price[p];
+      }
+      ks.bytes += use_packed ? eosio::pack(std::make_tuple(oracles[e.who], packed)).size()
+                             : eosio::pack(std::make_tuple(oracles[e.who], quotes)).size();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+      if (e.what == kind::write && use_packed) {
+        begin(e.time_us, self, "writepacked"_n, {}, {oracles[e.who].value});
+        instance().writepacked(oracles[e.who], packed);
+      } else if (e.what == kind::write) {
+        begin(e.time_us, self, "write"_n, {}, {oracles[e.who].value});
+        instance().write(oracles[e.who], quotes);
+      }
+#if DELPHIORACLE_WITH_REWARDS
+      else if (e.what == kind::donation) {
+        // three in four donations name a pair in the memo
+        delphioracle::st_transfer t{donors[e.who], self, eosio::asset(amount(rng), eosio::symbol("TLOS", 4)),
+                                    rng() % 4 ? pairs[rng() % pairs.size()].to_string() : std::string()};
+        ks.bytes += eosio::pack(t).size();
+        begin(e.time_us, "eosio.token"_n, "transfer"_n, eosio::pack(t), {donors[e.who].value});
+        instance().transfer(self.value, "eosio.token"_n.value);
+      } else {
+        ks.bytes += sizeof(name);
+        begin(e.time_us, self, "claim"_n, {}, {oracles[e.who].value});
+        instance().claim(oracles[e.who]);
+      }
+#endif
+    } catch (const eosio::check_failure& f) {
+      error = f.what();
+    }
+    auto us = int64_t(double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()) *
+                      s.cpu_scale / 1000.0);
+
+    if (error.empty() && us > s.deadline_us)
+      error = "cpu deadline";
+    if (!error.empty()) {
+      eosio::mock::state().rollback();
+      ks.failures[cause(error)]++;
+    } else {
+      ks.ok++;
+      if (e.what == kind::write)
+        std::copy(sending.begin(), sending.end(), last.begin() + e.who * pairs.size());
+    }
+    ks.us.push_back(us);
+  }
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_begin).count();
+
+  std::printf("%llu oracles (%llu qualify), %llu pairs, %llu quotes per write, %llu simulated minutes\n",
+              (unsigned long long)s.oracles, (unsigned long long)std::min(s.oracles, s.rank),
+              (unsigned long long)s.pairs, (unsigned long long)s.quotes, (unsigned long long)s.minutes);
+  std::printf("%-11s %8s %8s %8s %10s %9s %9s %9s %9s %9s\n", "action", "sent", "ok", "failed",
+              "ok/min", "data_B", "p50_us", "p90_us", "p99_us", "max_us");
+  uint64_t total = 0;
+  for (auto& [k, ks] : stats) {
+    total += ks.sent;
+    std::printf("%-11s %8llu %8llu %8llu %10.1f %9llu %9lld %9lld %9lld %9lld\n",
+                k == kind::write && s.packed ? "writepacked" : kind_name(k), (unsigned long long)ks.sent,
+                (unsigned long long)ks.ok, (unsigned long long)(ks.sent - ks.ok), double(ks.ok) / double(s.minutes),
+                (unsigned long long)(ks.sent ? ks.bytes / ks.sent : 0), (long long)percentile(ks.us, 0.5), (long long)percentile(ks.us, 0.9),
+                (long long)percentile(ks.us, 0.99), (long long)percentile(ks.us, 1.0));
+  }
+
+  bool any = false;
+  for (auto& [k, ks] : stats) {
+    for (auto& [why, n] : ks.failures) {
+      if (!any) std::printf("\nfailures\n");
+      any = true;
+      std::printf("  %-10s %8llu  %s\n", kind_name(k), (unsigned long long)n, why.c_str());
+    }
+  }
+
+  std::printf("\n%llu actions in %.2f s native, %.0f actions/s\n", (unsigned long long)total, wall_s,
+              wall_s > 0 ? double(total) / wall_s : 0.0);
+  return 0;
+}
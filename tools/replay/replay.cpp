@@ -0,0 +1,507 @@
+/*
+
+  delphireplay
+
+  Replays a recorded action log against the contract compiled natively on
+  top of tools/mockchain, starting from a table dump, and reports the rows
+  each action touched and the time it took, along with the heap allocations
+  it made and how much of the scratch arena it used.
+
+  delphireplay [options] <actions.jsonl>
+    --contract <account>   account the contract runs as (default delphioracle)
+    --seed <rows.jsonl>    table rows to start from, may be repeated
+    --runs <n>             replay n times from the seed and keep the fastest
+                           wall time per action (default 1)
+    --csv                  per-action rows as csv
+    --summary              only print the per-action-name summary
+    --print                let the contract's print() through to stdout
+
+  Action log, one json object per line as found in action traces:
+    {"time":"2024-05-01T12:00:00.000","account":"delphioracle","name":"write",
+     "authorization":[{"actor":"eostitan","permission":"active"}],
+     "data":{"owner":"eostitan","quotes":[{"value":58500,"pair":"eosusd"}]}}
+  "signer" may stand in for authorization, and "hex_data" (or "data" as a
+  hex string) for the decoded arguments. Actions of other accounts, such as
+  eosio.token transfers, are delivered as notifications.
+
+  Table dump, one row per line:
+    {"code":"delphioracle","scope":"eosusd","table":"datapoints",
+     "payer":"delphioracle","data":{...}}
+
+*/
+
+#include <delphioracle.hpp>
+#include <mock/abi_json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+// Every heap allocation in the process goes through here; run_action reads
+// the difference across the contract call.
+namespace heap {
+  uint64_t allocs = 0;
+  uint64_t bytes = 0;
+}
+
+void* operator new(size_t size) {
+  heap::allocs++;
+  heap::bytes += size;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using eosio::name;
+using bytes = std::vector<char>;
+
+struct action_handler {
+  bytes (*from_json)(const eosio::mock::json&);
+  void (*apply)(name self, name code, const bytes& data);
+};
+
+template <auto Action>
+action_handler contract_action() {
+  using args = typename eosio::detail::member_function_args<decltype(Action)>::tuple;
+  return {
+    [](const eosio::mock::json& j) { return eosio::mock::json_to_bin<args>(j); },
+    [](name self, name code, const bytes& data) {
+      auto a = eosio::unpack<args>(data);
+      delphioracle c(self, code, eosio::datastream<const char*>(data.data(), data.size()));
+      std::apply([&](auto&... xs) { (void)(c.*Action)(xs...); }, a);
+    }};
+}
+
+// keyed by action name for the contract's own actions and by
+// "account::action" for notifications
+std::map<std::string, action_handler> action_handlers() {
+  std::map<std::string, action_handler> h;
+  h["write"] = contract_action<&delphioracle::write>();
+  h["writeagg"] = contract_action<&delphioracle::writeagg>();
+  h["writepacked"] = contract_action<&delphioracle::writepacked>();
+  h["addordinal"] = contract_action<&delphioracle::addordinal>();
+  h["setkey"] = contract_action<&delphioracle::setkey>();
+  h["setchain"] = contract_action<&delphioracle::setchain>();
+  h["configure"] = contract_action<&delphioracle::configure>();
+  h["newbounty"] = contract_action<&delphioracle::newbounty>();
+  h["cancelbounty"] = contract_action<&delphioracle::cancelbounty>();
+  h["votebounty"] = contract_action<&delphioracle::votebounty>();
+  h["unvotebounty"] = contract_action<&delphioracle::unvotebounty>();
+  h["addcustodian"] = contract_action<&delphioracle::addcustodian>();
+  h["delcustodian"] = contract_action<&delphioracle::delcustodian>();
+  h["clear"] = contract_action<&delphioracle::clear>();
+  h["getquantiles"] = contract_action<&delphioracle::getquantiles>();
+  h["setband"] = contract_action<&delphioracle::setband>();
+  h["subscribe"] = contract_action<&delphioracle::subscribe>();
+  h["unsubscribe"] = contract_action<&delphioracle::unsubscribe>();
+  h["pricechange"] = contract_action<&delphioracle::pricechange>();
+  h["getcross"] = contract_action<&delphioracle::getcross>();
+  h["getram"] = contract_action<&delphioracle::getram>();
+  h["setretire"] = contract_action<&delphioracle::setretire>();
+  h["retire"] = contract_action<&delphioracle::retire>();
+#if DELPHIORACLE_WITH_REWARDS
+  h["claim"] = contract_action<&delphioracle::claim>();
+  h["payout"] = contract_action<&delphioracle::payout>();
+  h["compactdons"] = contract_action<&delphioracle::compactdons>();
+  h["reguser"] = contract_action<&delphioracle::reguser>();
+  h["updateusers"] = contract_action<&delphioracle::updateusers>();
+  h["voteabuser"] = contract_action<&delphioracle::voteabuser>();
+  h["eosio.token::transfer"] = {
+    [](const eosio::mock::json& j) { return eosio::mock::json_to_bin<delphioracle::st_transfer>(j); },
+    [](name self, name code, const bytes& data) {
+      delphioracle c(self, code, eosio::datastream<const char*>(data.data(), data.size()));
+      c.transfer(self.value, code.value);
+    }};
+#endif
+#if DELPHIORACLE_WITH_MEDIANS
+  h["makemedians"] = contract_action<&delphioracle::makemedians>();
+  h["rollmedians"] = contract_action<&delphioracle::rollmedians>();
+  h["getperiods"] = contract_action<&delphioracle::getperiods>();
+#endif
+#if DELPHIORACLE_WITH_LEGACY
+  h["initmedians"] = contract_action<&delphioracle::initmedians>();
+  h["updtversion"] = contract_action<&delphioracle::updtversion>();
+#endif
+  return h;
+}
+
+struct table_handler {
+  bytes (*from_json)(const eosio::mock::json&);
+  uint64_t (*primary_key)(const bytes&);
+  void (*reindex)(name code, uint64_t scope);
+};
+
+template <typename Table, typename Row>
+table_handler table() {
+  return {
+    [](const eosio::mock::json& j) { return eosio::mock::json_to_bin<Row>(j); },
+    [](const bytes& b) { return eosio::unpack<Row>(b).primary_key(); },
+    [](name code, uint64_t scope) { Table::reindex(code, scope); }};
+}
+
+template <eosio::name::raw Name, typename Row>
+table_handler singleton() {
+  return {
+    [](const eosio::mock::json& j) { return eosio::mock::json_to_bin<Row>(j); },
+    [](const bytes&) { return uint64_t(Name); },
+    [](name, uint64_t) {}};
+}
+
+std::map<std::string, table_handler> table_handlers() {
+  std::map<std::string, table_handler> h;
+  h["global"] = table<delphioracle::globaltable, delphioracle::global>();
+  h["custodians"] = table<delphioracle::custodianstable, delphioracle::custodians>();
+  h["stats"] = table<delphioracle::statstable, delphioracle::stats>();
+  h["pairs"] = table<delphioracle::pairstable, delphioracle::pairs>();
+  h["npairs"] = table<delphioracle::npairstable, delphioracle::pairs>();
+  h["datapoints"] = table<delphioracle::datapointstable, delphioracle::datapoints>();
+  h["crossrates"] = table<delphioracle::crossratestable, delphioracle::crossrates>();
+  h["tombstones"] = table<delphioracle::tombstonestable, delphioracle::tombstones>();
+  h["ordinals"] = table<delphioracle::ordinalstable, delphioracle::ordinals>();
+  h["producers"] = table<delphioracle::producers_table, delphioracle::producer_info>();
+#if DELPHIORACLE_WITH_REWARDS
+  h["voters"] = table<delphioracle::voters_table, delphioracle::voter_info>();
+  h["donations"] = table<delphioracle::donationstable, delphioracle::donations>();
+  h["donortotals"] = table<delphioracle::donortotalstable, delphioracle::donortotals>();
+  h["users"] = table<delphioracle::userstable, delphioracle::users>();
+  h["abusers"] = table<delphioracle::abuserstable, delphioracle::abusers>();
+#endif
+#if DELPHIORACLE_WITH_MEDIANS
+  h["medians"] = table<delphioracle::medianstable, delphioracle::medians>();
+  h["flagmedians"] = singleton<"flagmedians"_n, delphioracle::flagmedians>();
+#endif
+  return h;
+}
+
+// A name, or a number for scopes that are not names.
+uint64_t scope_value(const eosio::mock::json& j) {
+  if (j.is_number()) return eosio::mock::number_from_json<uint64_t>(j);
+  return name(std::string_view(j.text)).value;
+}
+
+bytes data_bytes(const eosio::mock::json& j, const eosio::mock::json* data, bytes (*from_json)(const eosio::mock::json&)) {
+  if (auto hex = j.find("hex_data")) return eosio::mock::from_hex(hex->text);
+  if (data == nullptr) return from_json(eosio::mock::json{eosio::mock::json::kind::object});
+  if (data->is_string()) return eosio::mock::from_hex(data->text);
+  return from_json(*data);
+}
+
+struct recorded_action {
+  size_t line;
+  eosio::time_point time;
+  name account;
+  name act;
+  std::set<uint64_t> auths;
+  std::string handler_key;
+  bytes data;
+};
+
+struct action_result {
+  eosio::mock::db_counters counters;
+  size_t inline_actions = 0;
+  int64_t ram_delta = 0;
+  int64_t wall_ns = 0;
+  uint64_t allocs = 0;
+  uint64_t alloc_bytes = 0;
+  size_t scratch_peak = 0;
+  std::string error;
+};
+
+struct seed_row {
+  const table_handler* handler;
+  name code;
+  uint64_t scope;
+  name table;
+  name payer;
+  bytes data;
+};
+
+template <typename F>
+void for_each_line(const std::string& path, F&& f) {
+  std::ifstream in(path);
+  eosio::check(bool(in), "cannot open " + path);
+  std::string line;
+  for (size_t n = 1; std::getline(in, line); ++n) {
+    auto first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') continue;
+    try {
+      f(n, eosio::mock::json::parse(line));
+    } catch (const eosio::check_failure& e) {
+      throw eosio::check_failure(path + ":" + std::to_string(n) + ": " + e.what());
+    }
+  }
+}
+
+std::vector<seed_row> load_seed(const std::string& path, name contract, const std::map<std::string, table_handler>& tables) {
+  std::vector<seed_row> rows;
+  for_each_line(path, [&](size_t, const eosio::mock::json& j) {
+    auto table_name = j.at("table").text;
+    auto itr = tables.find(table_name);
+    eosio::check(itr != tables.end(), "no row type known for table " + table_name);
+
+    seed_row row{&itr->second, contract, 0, name(std::string_view(table_name)), contract, {}};
+    if (auto code = j.find("code")) row.code = name(std::string_view(code->text));
+    row.scope = j.find("scope") ? scope_value(j.at("scope")) : row.code.value;
+    if (auto payer = j.find("payer")) row.payer = name(std::string_view(payer->text));
+    auto& data = j.at("data");
+    row.data = data.is_string() ? eosio::mock::from_hex(data.text) : itr->second.from_json(data);
+    rows.push_back(std::move(row));
+  });
+  return rows;
+}
+
+std::vector<recorded_action> load_actions(const std::string& path, name contract, const std::map<std::string, action_handler>& handlers) {
+  std::vector<recorded_action> actions;
+  for_each_line(path, [&](size_t line, const eosio::mock::json& j) {
+    recorded_action a;
+    a.line = line;
+    a.account = j.find("account") ? name(std::string_view(j.at("account").text)) : contract;
+    a.act = name(std::string_view((j.find("name") ? j.at("name") : j.at("action")).text));
+
+    const eosio::mock::json* time = j.find("time");
+    if (time == nullptr) time = j.find("block_time");
+    if (time != nullptr) a.time = eosio::mock::parse_time_point(*time);
+
+    if (auto auth = j.find("authorization")) {
+      for (auto& level : auth->items)
+        a.auths.insert(name(std::string_view(level.at("actor").text)).value);
+    } else if (auto signer = j.find("signer")) {
+      a.auths.insert(name(std::string_view(signer->text)).value);
+    }
+
+    a.handler_key = a.account == contract ? a.act.to_string() : a.account.to_string() + "::" + a.act.to_string();
+    auto itr = handlers.find(a.handler_key);
+    eosio::check(itr != handlers.end(), "contract has no handler for " + a.handler_key);
+    a.data = data_bytes(j, j.find("data"), itr->second.from_json);
+    actions.push_back(std::move(a));
+  });
+  return actions;
+}
+
+void seed_state(name contract, const std::vector<seed_row>& rows) {
+  auto& st = eosio::mock::state();
+  st = eosio::mock::chain_state{};
+  st.receiver = contract;
+
+  std::set<std::tuple<const table_handler*, uint64_t, uint64_t>> to_index;
+  for (auto& row : rows) {
+    auto& tbl = st.get_table(row.code, row.scope, row.table);
+    tbl.rows[row.handler->primary_key(row.data)] = eosio::mock::row_data{row.data, row.payer};
+    st.bill(row.payer, int64_t(row.data.size()) + eosio::mock::row_overhead_bytes);
+    to_index.insert({row.handler, row.code.value, row.scope});
+  }
+  for (auto& [handler, code, scope] : to_index)
+    handler->reindex(name(code), scope);
+}
+
+action_result run_action(name contract, const recorded_action& a, const action_handler& handler) {
+  auto& st = eosio::mock::state();
+  st.now = a.time;
+  st.begin_action(contract, a.account, a.act, a.data, a.auths);
+  scratch().reset();
+
+  action_result r;
+  const uint64_t allocs = heap::allocs, alloc_bytes = heap::bytes;
+  auto start = std::chrono::steady_clock::now();
+  try {
+    handler.apply(contract, a.account, a.data);
+  } catch (const eosio::check_failure& e) {
+    r.error = e.what();
+  }
+  r.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  r.allocs = heap::allocs - allocs;
+  r.alloc_bytes = heap::bytes - alloc_bytes;
+  r.scratch_peak = scratch().peak();
+
+  r.counters = st.counters;
+  if (!r.error.empty()) {
+    st.rollback();
+    return r;
+  }
+  r.inline_actions = st.inline_actions.size();
+  for (auto& [payer, usage] : st.ram_usage) {
+    auto before = st.ram_at_begin.find(payer);
+    r.ram_delta += usage - (before == st.ram_at_begin.end() ? 0 : before->second);
+  }
+  return r;
+}
+
+std::string format_time(const eosio::time_point& t) {
+  time_t secs = time_t(t.sec_since_epoch());
+  std::tm tm{};
+  gmtime_r(&secs, &tm);
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%03d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                tm.tm_hour, tm.tm_min, tm.tm_sec, int(t.time_since_epoch().count() / 1000 % 1000));
+  return buf;
+}
+
+std::string csv_field(std::string s) {
+  if (s.find_first_of(",\"\n") == std::string::npos) return s;
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"') out += '"';
+    out += c;
+  }
+  return out + "\"";
+}
+
+int64_t percentile(std::vector<int64_t> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[size_t(p * double(v.size() - 1) + 0.5)];
+}
+
+void usage() {
+  std::cerr << "usage: delphireplay [--contract <account>] [--seed <rows.jsonl>]... [--runs <n>] [--csv] [--summary] [--print] <actions.jsonl>\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  name contract = "delphioracle"_n;
+  std::vector<std::string> seed_paths;
+  std::string log_path;
+  int runs = 1;
+  bool csv = false;
+  bool summary_only = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) { usage(); std::exit(2); }
+      return argv[++i];
+    };
+    if (arg == "--contract") contract = name(std::string_view(next()));
+    else if (arg == "--seed") seed_paths.push_back(next());
+    else if (arg == "--runs") runs = std::max(1, std::stoi(next()));
+    else if (arg == "--csv") csv = true;
+    else if (arg == "--summary") summary_only = true;
+    else if (arg == "--print") eosio::mock::print_enabled() = true;
+    else if (!arg.empty() && arg[0] == '-') { usage(); return 2; }
+    else log_path = arg;
+  }
+  if (log_path.empty()) { usage(); return 2; }
+
+  auto handlers = action_handlers();
+  auto tables = table_handlers();
+
+  std::vector<seed_row> seed;
+  std::vector<recorded_action> actions;
+  try {
+    for (auto& path : seed_paths) {
+      auto rows = load_seed(path, contract, tables);
+      seed.insert(seed.end(), std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+    }
+    actions = load_actions(log_path, contract, handlers);
+  } catch (const eosio::check_failure& e) {
+    std::cerr << "delphireplay: " << e.what() << "\n";
+    return 1;
+  }
+
+  // Rows touched must not change between runs; wall time keeps the minimum.
+  std::vector<action_result> results;
+  bool deterministic = true;
+  for (int run = 0; run < runs; ++run) {
+    seed_state(contract, seed);
+    for (size_t i = 0; i < actions.size(); ++i) {
+      auto r = run_action(contract, actions[i], handlers.at(actions[i].handler_key));
+      if (run == 0) {
+        results.push_back(std::move(r));
+        continue;
+      }
+      auto& best = results[i];
+      if (r.counters.touched() != best.counters.touched() || r.error != best.error)
+        deterministic = false;
+      best.wall_ns = std::min(best.wall_ns, r.wall_ns);
+    }
+  }
+
+  if (!summary_only) {
+    if (csv)
+      std::printf("line,time,account,action,reads,stores,updates,removes,touched,inline,ram_delta,allocs,alloc_bytes,"
+                  "scratch_peak,wall_us,error\n");
+    else
+      std::printf("%6s  %-23s  %-24s  %6s %6s %6s %6s %7s %6s %9s %6s %7s %10s  %s\n", "line", "time", "action", "reads",
+                  "stores", "upd", "rm", "touched", "inline", "ram", "allocs", "scratch", "wall_us", "status");
+
+    for (size_t i = 0; i < actions.size(); ++i) {
+      auto& a = actions[i];
+      auto& r = results[i];
+      double wall_us = double(r.wall_ns) / 1000.0;
+      if (csv) {
+        std::printf("%zu,%s,%s,%s,%llu,%llu,%llu,%llu,%llu,%zu,%lld,%llu,%llu,%zu,%.3f,%s\n", a.line,
+                    format_time(a.time).c_str(), a.account.to_string().c_str(), a.act.to_string().c_str(),
+                    (unsigned long long)r.counters.reads, (unsigned long long)r.counters.stores,
+                    (unsigned long long)r.counters.updates, (unsigned long long)r.counters.removes,
+                    (unsigned long long)r.counters.touched(), r.inline_actions, (long long)r.ram_delta,
+                    (unsigned long long)r.allocs, (unsigned long long)r.alloc_bytes, r.scratch_peak, wall_us,
+                    csv_field(r.error).c_str());
+      } else {
+        std::printf("%6zu  %-23s  %-24s  %6llu %6llu %6llu %6llu %7llu %6zu %9lld %6llu %7zu %10.1f  %s\n", a.line,
+                    format_time(a.time).c_str(), a.handler_key.c_str(), (unsigned long long)r.counters.reads,
+                    (unsigned long long)r.counters.stores, (unsigned long long)r.counters.updates,
+                    (unsigned long long)r.counters.removes, (unsigned long long)r.counters.touched(), r.inline_actions,
+                    (long long)r.ram_delta, (unsigned long long)r.allocs, r.scratch_peak, wall_us,
+                    r.error.empty() ? "ok" : r.error.c_str());
+      }
+    }
+  }
+
+  if (csv && !summary_only) return deterministic ? 0 : 3;
+
+  struct totals {
+    size_t count = 0;
+    size_t failed = 0;
+    uint64_t touched = 0;
+    uint64_t max_touched = 0;
+    uint64_t allocs = 0;
+    size_t scratch_peak = 0;
+    std::vector<int64_t> wall_ns;
+  };
+  std::map<std::string, totals> by_action;
+  for (size_t i = 0; i < actions.size(); ++i) {
+    auto& t = by_action[actions[i].handler_key];
+    auto& r = results[i];
+    t.count++;
+    t.failed += r.error.empty() ? 0 : 1;
+    t.touched += r.counters.touched();
+    t.max_touched = std::max(t.max_touched, r.counters.touched());
+    t.allocs += r.allocs;
+    t.scratch_peak = std::max(t.scratch_peak, r.scratch_peak);
+    t.wall_ns.push_back(r.wall_ns);
+  }
+
+  std::printf("\n%-24s %7s %6s %12s %11s %11s %12s %10s %10s %10s %10s %12s\n", "action", "count", "failed",
+              "touched_avg", "touched_max", "allocs_avg", "scratch_max", "wall_avg", "wall_p50", "wall_p99", "wall_max",
+              "wall_total");
+  for (auto& [key, t] : by_action) {
+    int64_t total = 0;
+    for (auto ns : t.wall_ns) total += ns;
+    std::printf("%-24s %7zu %6zu %12.1f %11llu %11.1f %12zu %10.1f %10.1f %10.1f %10.1f %12.1f\n", key.c_str(), t.count,
+                t.failed, double(t.touched) / double(t.count), (unsigned long long)t.max_touched,
+                double(t.allocs) / double(t.count), t.scratch_peak, double(total) / double(t.count) / 1000.0, double(percentile(t.wall_ns, 0.5)) / 1000.0,
+                double(percentile(t.wall_ns, 0.99)) / 1000.0, double(percentile(t.wall_ns, 1.0)) / 1000.0,
+                double(total) / 1000.0);
+  }
+  std::printf("(wall times in microseconds, best of %d run%s)\n", runs, runs == 1 ? "" : "s");
+
+  if (!deterministic) {
+    std::fprintf(stderr, "delphireplay: rows touched differed between runs\n");
+    return 3;
+  }
+  return 0;
+}